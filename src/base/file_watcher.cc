@@ -0,0 +1,145 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::~FileWatcher() {
+    Stop();
+}
+
+#if defined(__linux__)
+
+namespace {
+
+/////// BEGIN SETTINGS
+// IN_MODIFY comes with every write(), so an append is seen while it is still going on; rows
+//  not yet ended by a '\n' are left for the next change. IN_ATTRIB comes when the file is
+//  unlinked, which is all that happens to it when another file is renamed over it while it
+//  is still mapped.
+constexpr uint32_t kWatchedEvents = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+/////// END SETTINGS
+
+} // namespace
+
+bool FileWatcher::Start(const std::string& filename, std::string& error) {
+    Stop();
+    inotify_descriptor_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_descriptor_ < 0) {
+        error = std::string("inotify: ") + std::strerror(errno);
+        return false;
+    }
+    filename_ = filename;
+    if (!AddWatch_()) {
+        error = "cannot watch " + filename + ": " + std::strerror(errno);
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+bool FileWatcher::AddWatch_() {
+    struct stat status;
+    if (stat(filename_.c_str(), &status) != 0) return false;
+    watch_descriptor_ = inotify_add_watch(inotify_descriptor_, filename_.c_str(), kWatchedEvents);
+    inode_ = static_cast<uint64_t>(status.st_ino);
+    return watch_descriptor_ >= 0;
+}
+
+void FileWatcher::Stop() {
+    if (inotify_descriptor_ >= 0) close(inotify_descriptor_);
+    inotify_descriptor_ = -1;
+    watch_descriptor_ = -1;
+    filename_.clear();
+    inode_ = 0;
+}
+
+FileWatcher::Change FileWatcher::Wait(int input_descriptor) {
+    while (IsWatching()) {
+        pollfd descriptors[2] = {{input_descriptor, POLLIN, 0}, {inotify_descriptor_, POLLIN, 0}};
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // Input (or its end) comes first, so a change never holds up a command
+        if (descriptors[0].revents != 0) break;
+        Change change = ReadEvents_();
+        if (change != Change::kNone) return change;
+    }
+    return Change::kNone;
+}
+
+FileWatcher::Change FileWatcher::Poll() {
+    return IsWatching() ? ReadEvents_() : Change::kNone;
+}
+
+FileWatcher::Change FileWatcher::ReadEvents_() {
+    Change change = Change::kNone;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t size;
+    while ((size = read(inotify_descriptor_, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t offset = 0; offset < size;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            if (event->wd != watch_descriptor_) continue; // A watch moved away from
+            if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) {
+                change = Change::kReplaced;
+            } else if (event->mask & (IN_MODIFY | IN_ATTRIB)) {
+                change = std::max(change, Change::kModified);
+            }
+        }
+    }
+    // chmod and touch come as IN_ATTRIB too, and leave the name with the same file
+    struct stat status;
+    if (change == Change::kModified && (stat(filename_.c_str(), &status) != 0 || static_cast<uint64_t>(status.st_ino) != inode_)) {
+        change = Change::kReplaced;
+    }
+    if (change == Change::kReplaced) {
+        inotify_rm_watch(inotify_descriptor_, watch_descriptor_);
+        if (!AddWatch_()) Stop();
+    }
+    return change;
+}
+
+#else
+
+bool FileWatcher::Start(const std::string& filename, std::string& error) {
+    error = "watching files needs inotify, which only Linux has";
+    return false;
+}
+
+void FileWatcher::Stop() {
+}
+
+FileWatcher::Change FileWatcher::Wait(int input_descriptor) {
+    return Change::kNone;
+}
+
+FileWatcher::Change FileWatcher::Poll() {
+    return Change::kNone;
+}
+
+FileWatcher::Change FileWatcher::ReadEvents_() {
+    return Change::kNone;
+}
+
+bool FileWatcher::AddWatch_() {
+    return false;
+}
+
+#endif
+
+bool FileWatcher::IsWatching() const {
+    return inotify_descriptor_ >= 0;
+}
+
+const std::string& FileWatcher::GetFilename() const {
+    return filename_;
+}
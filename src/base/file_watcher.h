@@ -0,0 +1,51 @@
+#ifndef INVENTORY_MANAGEMENT_FILE_WATCHER_H
+#define INVENTORY_MANAGEMENT_FILE_WATCHER_H
+
+#include <cstdint>
+#include <string>
+
+// Tells when a file is written to or replaced, through inotify (Linux only; elsewhere Start()
+//  fails). Nothing runs in the background: the REPL waits for its next command with Wait(),
+//  which also returns when the file changes, so the tables are only touched between commands.
+class FileWatcher {
+public:
+    enum class Change {
+        kNone = 0,
+        kModified,  // Written to, e.g. appended
+        kReplaced,  // Renamed, deleted or renamed over. The new file at the path, if any, is watched instead.
+    };
+
+    FileWatcher() = default;
+    ~FileWatcher();
+    FileWatcher(const FileWatcher& other) = delete;
+    FileWatcher& operator=(const FileWatcher& other) = delete;
+
+    // Starts watching filename, stopping whatever was watched before. Returns false with the
+    //  reason in error if it can't be watched.
+    bool Start(const std::string& filename, std::string& error);
+    void Stop();
+    bool IsWatching() const;
+    const std::string& GetFilename() const;
+
+    // Waits until input_descriptor has something to read, or the file changes. Returns the
+    //  change (the larger one, if there were several), or kNone once there is input.
+    Change Wait(int input_descriptor);
+    // The changes seen since the last call, without waiting
+    Change Poll();
+
+private:
+    // Reads the events waiting and returns the larger change among them. After kReplaced the
+    //  watch is moved to the new file, or stopped if there is none.
+    Change ReadEvents_();
+    // Watches the file at filename_ now, which may not be the one watched before. False if
+    //  there is none.
+    bool AddWatch_();
+
+    int inotify_descriptor_ = -1;
+    int watch_descriptor_ = -1;
+    std::string filename_;
+    // Of the file watched, to tell when another has taken its name
+    uint64_t inode_ = 0;
+};
+
+#endif //INVENTORY_MANAGEMENT_FILE_WATCHER_H
@@ -3,23 +3,30 @@
 //
 #include "header.h"
 
-void AddToCategory(std::string category_name, const std::string& uniq_id, HashTable<std::string, std::vector<std::string>>& categories_database) {
-    std::vector<std::string> current_category_ids;
+void AddToCategory(std::string category_name, ProductStore::RowId row, CategoryDatabase& categories_database) {
     if (category_name.empty()) {
         category_name = "NA";
     }
-    auto && i = categories_database.Find(category_name);
-    if (i != categories_database.end()) {
-    // Inserting into an existing category
-        (*i).second.push_back(uniq_id);
-        return;
+    // Creates an empty list for a new category, and leaves an existing one as it is.
+    auto && i = categories_database.TryEmplace(std::move(category_name));
+    (*i.first).second.push_back(row);
+}
+
+// Upper bound on the number of rows in a csv file: its newline count. Only quoted fields with
+//  embedded newlines make it overestimate. Reading the file in large blocks is cheap next to
+//  parsing it, and lets the product table be allocated once at its final size.
+std::size_t EstimateRowCount(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> buffer(1 << 16);
+    std::size_t newline_count = 0;
+    while (file) {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        newline_count += std::count(buffer.begin(), buffer.begin() + file.gcount(), '\n');
     }
-    current_category_ids.push_back(uniq_id);
-    // Because of our insert implementation, this overrides previous category.
-    categories_database.Insert(category_name, current_category_ids);
+    return newline_count;
 }
 
-std::vector<std::string> SeparateIntoCategories(const std::string& input) {
+std::vector<std::string> SeparateIntoCategories(std::string_view input) {
     std::vector<std::string> categories;
     std::string current_string;
     for (char i : input) {
@@ -36,32 +43,210 @@ std::vector<std::string> SeparateIntoCategories(const std::string& input) {
     return categories;
 }
 
-void LoadDataFromFile(const std::string& filename, HashTable<std::string, Product>& product_database, HashTable<std::string, std::vector<std::string>>& categories_database) {
-    std::ifstream file(filename);
-    std::vector<std::string> header_line = csv::ReadLine(file);
-    std::vector<std::string> data_line = csv::ReadLine(file);
-    while (!data_line[0].empty()) {
-        ///
-        /// Insert into product database
-        ///
-        // create Product, fields cleared automatically by loop.
-        Product this_product;
-        for (int i = 0; i < header_line.size(); i++) {
-            this_product.fields.Insert(header_line[i], data_line[i]);
-        }
-        // Insert Product into product database
-        product_database.Insert(data_line[0],this_product); // data_line[0] is Uniq_ID
-
-        ///
-        /// Insert into categories database
-        ///
-        unsigned int constexpr kCategoryFieldIndex = 4;
-        std::vector<std::string> categories = SeparateIntoCategories(data_line[kCategoryFieldIndex]);
-        for (std::string& category : categories) {
-            AddToCategory(category, data_line[0], categories_database);
-        }
+namespace {
+
+/////// BEGIN SETTINGS
+// Smallest share of the file worth a thread of its own
+constexpr std::size_t kMinimumBytesPerThread = 1 << 20;
+// Column holding a product's categories, separated by " | "
+constexpr std::size_t kCategoryFieldIndex = 4;
+/////// END SETTINGS
+
+} // namespace
+
+std::vector<std::size_t> FindColumns(const std::vector<std::string>& header_line, const std::vector<std::string>& columns) {
+    std::vector<std::size_t> indexes;
+    for (std::size_t i = 0; i < header_line.size(); i++) {
+        // The category lists refer to products by their row in the store, whose uniq_id is there
+        if (i == 0 || columns.empty() || std::find(columns.begin(), columns.end(), header_line[i]) != columns.end()) indexes.push_back(i);
+    }
+    return indexes;
+}
 
-        data_line = csv::ReadLine(file);
+void ParseRow(const std::vector<std::size_t>& kept_columns, const csv::Row& data_line, std::size_t row_start, LoadedRow& row) {
+    row.uniq_id = data_line[0];
+    // A row cut short has no categories, which makes it "NA"
+    row.categories = SeparateIntoCategories(kCategoryFieldIndex < data_line.size() ? data_line[kCategoryFieldIndex] : std::string_view());
+    row.row_start = row_start;
+    // Assigned in place, so a row that is reused keeps its strings' memory
+    row.values.resize(kept_columns.size());
+    for (std::size_t k = 0; k < kept_columns.size(); k++) {
+        const std::size_t i = kept_columns[k];
+        row.values[k].assign(i < data_line.size() ? data_line[i] : std::string_view());
     }
-    file.close();
-}
\ No newline at end of file
+}
+
+namespace {
+
+// Adds row to the store and the tables. The row of an earlier product with the same ID is
+//  replaced in the product table and added to replaced, to be taken out of the categories
+//  once every row is in (see DropReplacedRows).
+void AddRow(LoadedRow& row, ProductDatabase& product_database, ProductStore& product_store, CategoryDatabase& categories_database,
+            std::vector<ProductStore::RowId>& replaced) {
+    const ProductStore::RowId row_id = product_store.AddRow(row.values, row.row_start);
+    for (std::string& category : row.categories) {
+        AddToCategory(std::move(category), row_id, categories_database);
+    }
+    auto && inserted = product_database.TryEmplace(std::move(row.uniq_id), row_id);
+    if (!inserted.second) {
+        replaced.push_back((*inserted.first).second);
+        (*inserted.first).second = row_id;
+    }
+}
+
+// Takes the replaced rows out of every category, in one pass over them, and drops the
+//  categories left empty
+void DropReplacedRows(std::vector<ProductStore::RowId>& replaced, CategoryDatabase& categories_database) {
+    if (replaced.empty()) return;
+    std::sort(replaced.begin(), replaced.end());
+    std::vector<std::string> emptied;
+    for (auto && category : categories_database) {
+        std::vector<ProductStore::RowId>& rows = category.second;
+        rows.erase(std::remove_if(rows.begin(), rows.end(), [&](ProductStore::RowId row) {
+            return std::binary_search(replaced.begin(), replaced.end(), row);
+        }), rows.end());
+        if (rows.empty()) emptied.push_back(category.first);
+    }
+    for (const std::string& name : emptied) categories_database.Delete(name);
+}
+
+// Parses the rest of reader's rows into the tables, one after another, up to the first that
+//  starts at rows_end.
+template <typename RowReader>
+void LoadRows(RowReader& reader, const std::vector<std::size_t>& kept_columns, ProductDatabase& product_database,
+              ProductStore& product_store, CategoryDatabase& categories_database,
+              std::vector<ProductStore::RowId>& replaced, std::size_t rows_end) {
+    LoadedRow row;
+    std::size_t row_start = reader.GetPosition();
+    csv::ForEachRow(reader, [&](const csv::Row& fields) {
+        if (fields[0].empty()) return false; // A blank line ends the data, as with ReadLine
+        if (row_start >= rows_end) return false;
+        ParseRow(kept_columns, fields, row_start, row);
+        AddRow(row, product_database, product_store, categories_database, replaced);
+        // Where the row just read ends
+        row_start = reader.GetPosition();
+        return true;
+    });
+}
+
+// Parses a gzip or zstd file as it is decompressed, on a thread of its own (see
+//  csv::DecompressingSource). Its rows can't be read again from the file, so every column is
+//  kept, and it can't be split into chunks without decompressing it first.
+void LoadCompressedFile(const std::string& filename, ProductDatabase& product_database, ProductStore& product_store,
+                        CategoryDatabase& categories_database, std::vector<std::string>& field_names,
+                        const csv::Utf8Policy& utf8_policy) {
+    csv::Reader reader;
+    if (!reader.Open(filename)) throw std::runtime_error(reader.GetError());
+    reader.SetUtf8Policy(utf8_policy);
+    csv::Row data_line;
+    std::vector<std::string> header_line;
+    if (reader.ReadRow(data_line)) header_line.assign(data_line.begin(), data_line.end());
+    field_names = header_line;
+    product_store = ProductStore(header_line);
+    std::vector<ProductStore::RowId> replaced;
+    // Nothing is appended to it later, so a last row with no '\n' is as complete as it gets
+    LoadRows(reader, FindColumns(header_line, {}), product_database, product_store, categories_database, replaced,
+             std::numeric_limits<std::size_t>::max());
+    DropReplacedRows(replaced, categories_database);
+    if (!reader.GetError().empty()) throw std::runtime_error(filename + ": " + reader.GetError());
+}
+
+} // namespace
+
+std::size_t LoadDataFromFile(const std::string& filename, ProductDatabase& product_database, ProductStore& product_store,
+                             CategoryDatabase& categories_database,
+                             std::vector<std::string>& field_names, const std::vector<std::string>& columns,
+                             const csv::Utf8Policy& utf8_policy, std::size_t thread_count, std::size_t min_bytes_per_thread) {
+    if (csv::DetectCompression(filename) != csv::Compression::kNone) {
+        LoadCompressedFile(filename, product_database, product_store, categories_database, field_names, utf8_policy);
+        return 0;
+    }
+    // Fields are views into the mapped file (see csv_parser.h), valid until the next ReadRow,
+    //  so they are copied only into the columns the store keeps.
+    csv::MappedReader reader;
+    if (!reader.Open(filename)) throw std::runtime_error("cannot open " + filename);
+    reader.SetUtf8Policy(utf8_policy);
+    csv::Row data_line;
+    std::vector<std::string> header_line;
+    if (reader.ReadRow(data_line)) header_line.assign(data_line.begin(), data_line.end());
+    field_names = header_line;
+    const std::vector<std::size_t> kept_columns = FindColumns(header_line, columns);
+    std::vector<std::string> kept_names;
+    for (std::size_t i : kept_columns) kept_names.push_back(header_line[i]);
+    product_store = ProductStore(std::move(kept_names));
+    std::size_t row_count = EstimateRowCount(filename);
+    if (row_count > 0) { // Minus the header line
+        product_database.Reserve(row_count - 1);
+        product_store.Reserve(row_count - 1);
+    }
+    // Rows past the last '\n' may still be being written, but the header never counts as one.
+    //  They aren't loaded, nor is whatever ReadChunks finds appended after this mapping was
+    //  made: Inventory::IngestAppended takes them in once they are complete.
+    const std::size_t rows_end = std::max(reader.GetContents().rfind('\n') + 1, reader.GetPosition());
+
+    if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+    if (min_bytes_per_thread == 0) min_bytes_per_thread = kMinimumBytesPerThread;
+    thread_count = std::min(thread_count, std::max<std::size_t>(1, reader.GetSize() / min_bytes_per_thread));
+    std::vector<ProductStore::RowId> replaced;
+    if (thread_count == 1) {
+        LoadRows(reader, kept_columns, product_database, product_store, categories_database, replaced, rows_end);
+        DropReplacedRows(replaced, categories_database);
+        return rows_end;
+    }
+
+    // Rows are parsed into products on one thread per chunk of the file, then added to the
+    //  tables here in file order, so duplicate IDs and category lists end up as above.
+    std::vector<std::vector<LoadedRow>> chunks(thread_count);
+    // Chunks whose last row is the blank line that ends the data, or that reach rows_end
+    std::vector<char> ends_data(thread_count, false);
+    const bool read = csv::ReadChunks(filename, reader.GetPosition(), thread_count,
+        [&](std::size_t chunk, const csv::Row& fields, std::size_t row_start) {
+            if (fields[0].empty() || row_start >= rows_end) {
+                ends_data[chunk] = true;
+                return false;
+            }
+            ParseRow(kept_columns, fields, row_start, chunks[chunk].emplace_back());
+            return true;
+        },
+        [&](std::size_t chunk) {
+            for (; chunk < chunks.size(); chunk++) {
+                chunks[chunk].clear();
+                ends_data[chunk] = false;
+            }
+        },
+        '"', utf8_policy);
+    // Each thread maps the file again, and it may have gone since the header was read
+    if (!read) throw std::runtime_error("cannot open " + filename);
+    for (std::size_t chunk = 0; chunk < chunks.size(); chunk++) {
+        for (LoadedRow& row : chunks[chunk]) AddRow(row, product_database, product_store, categories_database, replaced);
+        // Freed as it goes, as the fields have been copied into the store
+        std::vector<LoadedRow>().swap(chunks[chunk]);
+        if (ends_data[chunk]) break;
+    }
+    DropReplacedRows(replaced, categories_database);
+    return rows_end;
+}
+
+void LoadInventory(const std::string& csv_filename, const std::string& snapshot_filename, Inventory& inventory) {
+    std::string error;
+    if (inventory.LoadSnapshot(snapshot_filename, csv_filename, error)) {
+        std::cout << "Mapped snapshot " << snapshot_filename << std::endl;
+        return;
+    }
+    std::cout << "Not using snapshot (" << error << "), parsing " << csv_filename << std::endl;
+    try {
+        inventory.LoadCsv(csv_filename);
+    } catch (const std::runtime_error& e) {
+        // A missing file, or a cut off or corrupt compressed one: nothing is served, and no snapshot
+        //  is taken
+        std::cout << e.what() << std::endl;
+        return;
+    }
+    // Only a faster start is lost if this fails
+    try {
+        inventory.SaveSnapshot(snapshot_filename, csv_filename);
+        std::cout << "Saved snapshot " << snapshot_filename << std::endl;
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
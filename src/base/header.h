@@ -6,21 +6,74 @@
 #define INVENTORY_MANAGEMENT_HEADER_H
 
 #include "csv_parser.h"
+#include "csv_parser_test.h"
 #include "hash_table.h"
 #include "hash_table_test.h"
+#include "inventory.h"
+#include "inventory_test.h"
 #include "product.h"
 #include "repl_manager.h"
+#include "snapshot_test.h"
 #include "my_commands.h"
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <stdexcept>
+#include <limits>
+#include <thread>
 
-void LoadDataFromFile(
+// Splits a category field at its " | " separators
+std::vector<std::string> SeparateIntoCategories(std::string_view input);
+// Adds row to the category's list, creating it if needed. An empty name is "NA".
+void AddToCategory(std::string category_name, ProductStore::RowId row, CategoryDatabase& categories_database);
+// Indexes of the columns of header_line named in columns, in column order, always starting
+//  with the first column, the uniq_id. All of them if columns is empty.
+std::vector<std::size_t> FindColumns(const std::vector<std::string>& header_line, const std::vector<std::string>& columns);
+// Turns data_line, which starts at byte row_start, into row. Only the kept columns are copied
+//  into row.values; the views of the others are left where they are.
+void ParseRow(
+    const std::vector<std::size_t>& kept_columns,
+    const csv::Row& data_line,
+    std::size_t row_start,
+    LoadedRow & row
+    );
+
+// Parses filename into the tables, on up to thread_count threads (0: one per core), each
+//  reading its own part of the file, of at least min_bytes_per_thread (0: 1 MB). The result
+//  is the same for any thread_count.
+//  product_store is replaced by one whose columns are the first one, the uniq_id, and the
+//  ones named in columns (all of them, if it is empty), and each row's fields of those
+//  columns are added to it; product_database maps the uniq_ids to their rows, and
+//  categories_database the categories to theirs. The rest stay in the file, where
+//  ProductStore::GetRowStart() says the row is. A uniq_id that comes again replaces its
+//  product, which is taken out of its categories.
+//  Every field, the header's too, is sanitized as utf8_policy says.
+//  A gzip or zstd file (told apart by its first bytes) is decompressed while it is parsed, on
+//  one thread, and keeps every column. Throws std::runtime_error if the file can't be opened,
+//  or can't be decompressed to the end.
+//  Returns the byte just past the last '\n' of the file as it was loaded, where rows appended
+//  later start (0 for a compressed file, which can't be read from a byte on).
+std::size_t LoadDataFromFile(
     const std::string& filename,
-    HashTable<std::string, Product> & product_database,
-    HashTable<std::string, std::vector<std::string>> & categories_database
+    ProductDatabase & product_database,
+    ProductStore & product_store,
+    CategoryDatabase & categories_database,
+    std::vector<std::string> & field_names,
+    const std::vector<std::string> & columns = {},
+    const csv::Utf8Policy & utf8_policy = csv::Utf8Policy(),
+    std::size_t thread_count = 0,
+    std::size_t min_bytes_per_thread = 0
+    );
+
+// Serves inventory from snapshot_filename if it is a current snapshot of csv_filename.
+//  Otherwise parses csv_filename and saves a new snapshot for the next start.
+void LoadInventory(
+    const std::string& csv_filename,
+    const std::string& snapshot_filename,
+    Inventory & inventory
     );
 
 #endif //INVENTORY_MANAGEMENT_HEADER_H
\ No newline at end of file
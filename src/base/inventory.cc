@@ -0,0 +1,371 @@
+#include "inventory.h"
+#include "header.h"
+
+#include <iterator>
+
+namespace {
+
+/////// BEGIN SETTINGS
+// Column listed next to each uniq_id by VisitCategory
+constexpr std::string_view kProductNameField = "Product Name";
+// Column of the categories a product is listed under, which an update takes it out of
+constexpr std::string_view kCategoryField = "Category";
+// Columns the product store keeps in memory, which list_inventory can filter on. find reads
+//  the rest of a row from the CSV.
+constexpr std::string_view kLoadedColumns[] = {kProductNameField, "Brand Name", kCategoryField};
+// Store column of the uniq_id, which LoadDataFromFile always keeps first
+constexpr std::size_t kIdColumn = 0;
+// What is done to the CSV's text as it is read: control characters are dropped, as a terminal
+//  would take them for escape sequences, and bytes that aren't UTF-8 become U+FFFD. Other
+//  characters, like the é of "Home Décor", are kept.
+constexpr csv::Utf8Policy kUtf8Policy = {true, csv::InvalidUtf8::kReplace, true};
+/////// END SETTINGS
+
+} // namespace
+
+void Inventory::LoadCsv(const std::string& csv_filename) {
+    snapshot_.Close();
+    csv_file_.Close();
+    product_database_ = FrozenProductDatabase();
+    updated_products_ = ProductDatabase();
+    moved_rows_ = std::vector<ProductStore::RowId>();
+    added_count_ = 0;
+    ingested_end_ = 0;
+    categories_database_ = CategoryDatabase();
+    product_store_ = ProductStore();
+    field_names_.clear();
+    ProductDatabase products;
+    const std::vector<std::string> columns(std::begin(kLoadedColumns), std::end(kLoadedColumns));
+    std::size_t rows_end;
+    try {
+        rows_end = LoadDataFromFile(csv_filename, products, product_store_, categories_database_, field_names_, columns, kUtf8Policy);
+    } catch (const std::runtime_error&) {
+        categories_database_ = CategoryDatabase();
+        product_store_ = ProductStore();
+        field_names_.clear();
+        throw;
+    }
+    product_database_ = FrozenProductDatabase(std::move(products));
+    product_store_.ShrinkToFit();
+    // Products of a compressed file have every field already
+    if (csv::DetectCompression(csv_filename) == csv::Compression::kNone) {
+        csv_file_.Open(csv_filename);
+        csv_file_.SetUtf8Policy(kUtf8Policy);
+        ingested_end_ = rows_end;
+    }
+}
+
+bool Inventory::LoadSnapshot(const std::string& filename, const std::string& csv_filename, std::string& error) {
+    snapshot::SourceStamp source;
+    if (!snapshot::SourceStamp::Of(csv_filename, source)) {
+        error = "cannot read " + csv_filename + ", so " + filename + " can't be checked against it";
+        return false;
+    }
+    snapshot::Snapshot loaded;
+    if (!loaded.Open(filename, error)) return false;
+    if (source != loaded.GetSource()) {
+        error = filename + " is stale: " + csv_filename + " has changed since it was taken";
+        return false;
+    }
+    product_database_ = FrozenProductDatabase();
+    updated_products_ = ProductDatabase();
+    moved_rows_ = std::vector<ProductStore::RowId>();
+    added_count_ = 0;
+    ingested_end_ = 0;
+    categories_database_ = CategoryDatabase();
+    product_store_ = ProductStore();
+    field_names_.clear();
+    csv_file_.Close();
+    // The snapshot that was loaded before, if any, is unmapped along with loaded
+    snapshot_.Swap(loaded);
+    return true;
+}
+
+void Inventory::SaveSnapshot(const std::string& filename, const std::string& csv_filename) {
+    snapshot::SourceStamp source;
+    if (!snapshot::SourceStamp::Of(csv_filename, source)) {
+        throw std::runtime_error("cannot read " + csv_filename + ", so no snapshot of it is saved");
+    }
+    std::vector<std::string_view> values;
+    if (IsSnapshot()) {
+        std::vector<std::string> field_names;
+        for (std::size_t i = 0; i < snapshot_.FieldCount(); i++) field_names.emplace_back(snapshot_.FieldName(i));
+        snapshot::Writer writer(field_names);
+        for (uint32_t product = 0; product < snapshot_.ProductCount(); product++) {
+            values.clear();
+            for (std::size_t i = 0; i < field_names.size(); i++) values.push_back(snapshot_.ProductField(product, i));
+            writer.AddProduct(snapshot_.ProductId(product), values);
+        }
+        for (uint32_t category = 0; category < snapshot_.CategoryCount(); category++) {
+            uint32_t number = writer.AddCategory(snapshot_.CategoryName(category));
+            for (uint32_t product : snapshot_.CategoryProducts(category)) writer.AddToCategory(number, snapshot_.ProductId(product));
+        }
+        writer.Write(filename, source);
+        return;
+    }
+    snapshot::Writer writer(field_names_);
+    // Store column of each CSV column, for products whose row can't be read
+    std::vector<std::size_t> columns;
+    for (const std::string& name : field_names_) columns.push_back(product_store_.FindColumn(name));
+    ForEachProduct_([&](std::string_view id, ProductStore::RowId row) {
+        values.clear();
+        if (ReadRow_(id, row)) {
+            for (std::size_t i = 0; i < field_names_.size(); i++) values.push_back(i < row_.size() ? row_[i] : std::string_view());
+            writer.AddProduct(id, values);
+            return;
+        }
+        for (std::size_t column : columns) {
+            values.push_back(column != ProductStore::kNoColumn ? product_store_.GetField(row, column) : std::string_view());
+        }
+        writer.AddProduct(id, values);
+    });
+    for (auto && category : categories_database_) {
+        uint32_t number = writer.AddCategory(category.first);
+        for (ProductStore::RowId row : category.second) writer.AddToCategory(number, product_store_.GetField(row, kIdColumn));
+    }
+    writer.Write(filename, source);
+}
+
+Inventory::IngestResult Inventory::IngestAppended(const std::string& csv_filename) {
+    if (!CanIngest()) throw std::runtime_error("rows are only ingested into tables loaded from a CSV file that isn't compressed");
+    IngestResult result;
+    // Checked first, as the data loaded so far is still read from the mapping
+    if (!std::ifstream(csv_filename)) throw std::runtime_error("cannot open " + csv_filename);
+    // Mapped again, to take in what was appended
+    csv_file_.Open(csv_filename);
+    csv_file_.SetUtf8Policy(kUtf8Policy);
+    // Shortened, or empty when loaded: the rows parsed before can't be told apart from new ones
+    if (csv_file_.GetSize() < ingested_end_ || field_names_.empty()) {
+        LoadCsv(csv_filename);
+        result.reloaded = true;
+        return result;
+    }
+    const std::vector<std::string> columns(std::begin(kLoadedColumns), std::end(kLoadedColumns));
+    const std::vector<std::size_t> kept_columns = FindColumns(field_names_, columns);
+    LoadedRow row;
+    csv_file_.Seek(ingested_end_);
+    while (csv_file_.ReadRow(row_) && csv_file_.LastRowTerminated()) {
+        const std::size_t row_end = csv_file_.GetPosition();
+        if (!row_[0].empty()) {
+            ParseRow(kept_columns, row_, ingested_end_, row);
+            if (Upsert_(row)) {
+                result.added++;
+            } else {
+                result.updated++;
+            }
+        }
+        ingested_end_ = row_end;
+    }
+    return result;
+}
+
+bool Inventory::CanIngest() const {
+    return !IsSnapshot() && csv_file_.IsOpen();
+}
+
+bool Inventory::IsSnapshot() const {
+    return snapshot_.IsOpen();
+}
+
+const snapshot::Snapshot& Inventory::GetSnapshot() const {
+    return snapshot_;
+}
+
+FrozenProductDatabase& Inventory::GetProductDatabase() {
+    return product_database_;
+}
+
+ProductDatabase& Inventory::GetUpdatedProducts() {
+    return updated_products_;
+}
+
+CategoryDatabase& Inventory::GetCategoryDatabase() {
+    return categories_database_;
+}
+
+const ProductStore& Inventory::GetProductStore() const {
+    return product_store_;
+}
+
+std::size_t Inventory::ProductCount() const {
+    return IsSnapshot() ? snapshot_.ProductCount() : product_database_.size() + added_count_;
+}
+
+bool Inventory::VisitProduct(std::string_view id, const PairVisitor& visit) {
+    if (IsSnapshot()) {
+        uint32_t product = snapshot_.FindProduct(id);
+        if (product == snapshot::Snapshot::kNotFound) return false;
+        for (std::size_t i = 0; i < snapshot_.FieldCount(); i++) visit(snapshot_.FieldName(i), snapshot_.ProductField(product, i));
+        return true;
+    }
+    const ProductStore::RowId* listed = FindProduct_(id);
+    if (listed == nullptr) return false;
+    const ProductStore::RowId row = CurrentRow_(*listed);
+    if (ReadRow_(id, row)) {
+        for (std::size_t column = 0; column < field_names_.size() && column < row_.size(); column++) visit(field_names_[column], row_[column]);
+        return true;
+    }
+    // The store's columns are in CSV column order
+    for (std::size_t column = 0; column < product_store_.ColumnCount(); column++) {
+        visit(product_store_.ColumnName(column), product_store_.GetField(row, column));
+    }
+    return true;
+}
+
+bool Inventory::VisitCategory(std::string_view category, const PairVisitor& visit) {
+    if (IsSnapshot()) {
+        uint32_t number = snapshot_.FindCategory(category);
+        if (number == snapshot::Snapshot::kNotFound) return false;
+        uint32_t name_field = snapshot_.FindField(kProductNameField);
+        for (uint32_t product : snapshot_.CategoryProducts(number)) {
+            visit(snapshot_.ProductId(product), name_field == snapshot::Snapshot::kNotFound ? std::string_view() : snapshot_.ProductField(product, name_field));
+        }
+        return true;
+    }
+    auto && i = categories_database_.Find(category);
+    if (i == categories_database_.end()) return false;
+    // Both fields are read straight from the store's columns, with no lookup by uniq_id. The
+    //  row a product is listed under has its uniq_id even once it has been updated.
+    const std::size_t name_column = product_store_.FindColumn(kProductNameField);
+    for (ProductStore::RowId row : (*i).second) {
+        visit(product_store_.GetField(row, kIdColumn),
+              name_column != ProductStore::kNoColumn ? product_store_.GetField(CurrentRow_(row), name_column) : std::string_view());
+    }
+    return true;
+}
+
+bool Inventory::VisitCategory(std::string_view category, std::string_view field, std::string_view value, const PairVisitor& visit) {
+    if (IsSnapshot()) {
+        uint32_t number = snapshot_.FindCategory(category);
+        if (number == snapshot::Snapshot::kNotFound) return false;
+        uint32_t filter_field = snapshot_.FindField(field);
+        uint32_t name_field = snapshot_.FindField(kProductNameField);
+        for (uint32_t product : snapshot_.CategoryProducts(number)) {
+            if (snapshot_.ProductField(product, filter_field) != value) continue;
+            visit(snapshot_.ProductId(product), name_field == snapshot::Snapshot::kNotFound ? std::string_view() : snapshot_.ProductField(product, name_field));
+        }
+        return true;
+    }
+    auto && i = categories_database_.Find(category);
+    if (i == categories_database_.end()) return false;
+    // Filtered on the rows that hold the products' fields now, which have their uniq_ids too
+    std::vector<ProductStore::RowId> current;
+    if (!moved_rows_.empty()) {
+        current.reserve((*i).second.size());
+        for (ProductStore::RowId row : (*i).second) current.push_back(CurrentRow_(row));
+    }
+    const std::size_t name_column = product_store_.FindColumn(kProductNameField);
+    for (ProductStore::RowId row : product_store_.Filter(product_store_.FindColumn(field), value, moved_rows_.empty() ? (*i).second : current)) {
+        visit(product_store_.GetField(row, kIdColumn), name_column != ProductStore::kNoColumn ? product_store_.GetField(row, name_column) : std::string_view());
+    }
+    return true;
+}
+
+bool Inventory::CanFilter(std::string_view field) const {
+    if (IsSnapshot()) return snapshot_.FindField(field) != snapshot::Snapshot::kNotFound;
+    return product_store_.FindColumn(field) != ProductStore::kNoColumn;
+}
+
+bool Inventory::ReadRow_(std::string_view id, ProductStore::RowId row) {
+    if (product_store_.ColumnCount() == field_names_.size() || !csv_file_.IsOpen()) return false;
+    csv_file_.Seek(product_store_.GetRowStart(row));
+    // The uniq_id check catches a file that was rewritten after loading
+    return csv_file_.ReadRow(row_) && row_[0] == id;
+}
+
+const ProductStore::RowId* Inventory::FindProduct_(std::string_view id) const {
+    if (updated_products_.size() > 0) {
+        auto && updated = updated_products_.Find(id);
+        if (updated != updated_products_.end()) return &(*updated).second;
+    }
+    auto && i = product_database_.Find(id);
+    return i != product_database_.end() ? &(*i).second : nullptr;
+}
+
+void Inventory::ForEachProduct_(const std::function<void(std::string_view, ProductStore::RowId)>& visit) const {
+    for (auto && product : product_database_) {
+        // Updated products are visited with the updated table instead
+        if (updated_products_.size() > 0 && updated_products_.Find(product.first) != updated_products_.end()) continue;
+        visit(product.first, product.second);
+    }
+    for (auto && product : updated_products_) visit(product.first, CurrentRow_(product.second));
+}
+
+ProductStore::RowId Inventory::CurrentRow_(ProductStore::RowId row) const {
+    return moved_rows_.empty() ? row : moved_rows_[row];
+}
+
+bool Inventory::Upsert_(LoadedRow& row) {
+    // Named as AddToCategory names them, so they compare equal to the listed ones
+    for (std::string& category : row.categories) {
+        if (category.empty()) category = "NA";
+    }
+    const ProductStore::RowId* old_product = FindProduct_(row.uniq_id);
+    const bool added = old_product == nullptr;
+    const ProductStore::RowId new_row = product_store_.AddRow(row.values, row.row_start);
+    if (!moved_rows_.empty()) moved_rows_.push_back(new_row);
+    // A new product is listed under its own row, an updated one under the row it had
+    const ProductStore::RowId listed = added ? new_row : *old_product;
+    // Taken from the store rather than the CSV, whose old rows may have been rewritten since
+    const std::size_t category_column = product_store_.FindColumn(kCategoryField);
+    std::vector<std::string> new_categories;
+    if (added) {
+        new_categories = std::move(row.categories);
+    } else if (category_column != ProductStore::kNoColumn) {
+        // Only the categories the product leaves or joins are touched
+        std::vector<std::string> old_categories = SeparateIntoCategories(product_store_.GetField(CurrentRow_(listed), category_column));
+        std::vector<std::string> left;
+        for (std::string& category : old_categories) {
+            if (category.empty()) category = "NA";
+            if (std::find(row.categories.begin(), row.categories.end(), category) == row.categories.end()) left.push_back(category);
+        }
+        RemoveFromCategories_(listed, &left);
+        for (std::string& category : row.categories) {
+            if (std::find(old_categories.begin(), old_categories.end(), category) == old_categories.end()) {
+                new_categories.push_back(std::move(category));
+            }
+        }
+    } else {
+        // The file has no category column by that name, so the categories it is listed under
+        //  aren't known
+        RemoveFromCategories_(listed, nullptr);
+        new_categories = std::move(row.categories);
+    }
+    if (!added) {
+        if (moved_rows_.empty()) {
+            moved_rows_.resize(product_store_.RowCount());
+            for (std::size_t i = 0; i < moved_rows_.size(); i++) moved_rows_[i] = static_cast<ProductStore::RowId>(i);
+        }
+        moved_rows_[listed] = new_row;
+    }
+    for (std::string& category : new_categories) AddToCategory(std::move(category), listed, categories_database_);
+    if (added) added_count_++;
+    updated_products_.Emplace(std::move(row.uniq_id), listed);
+    return added;
+}
+
+void Inventory::RemoveFromCategories_(ProductStore::RowId row, const std::vector<std::string>* categories) {
+    std::vector<std::string> emptied;
+    auto remove = [&](std::string_view name, std::vector<ProductStore::RowId>& rows) {
+        rows.erase(std::remove(rows.begin(), rows.end(), row), rows.end());
+        if (rows.empty()) emptied.emplace_back(name);
+    };
+    if (categories != nullptr) {
+        for (const std::string& name : *categories) {
+            auto && i = categories_database_.Find(name);
+            if (i != categories_database_.end()) remove(name, (*i).second);
+        }
+    } else {
+        for (auto && category : categories_database_) remove(category.first, category.second);
+    }
+    // A category is only listed while a product has it, as after loading
+    for (const std::string& name : emptied) categories_database_.Delete(name);
+}
+
+void Inventory::VisitIds(const std::function<void(std::string_view)>& visit) {
+    if (IsSnapshot()) {
+        for (uint32_t product = 0; product < snapshot_.ProductCount(); product++) visit(snapshot_.ProductId(product));
+        return;
+    }
+    ForEachProduct_([&visit](std::string_view id, ProductStore::RowId) { visit(id); });
+}
@@ -0,0 +1,131 @@
+#ifndef INVENTORY_MANAGEMENT_INVENTORY_H
+#define INVENTORY_MANAGEMENT_INVENTORY_H
+
+#include "csv_parser.h"
+#include "product.h"
+#include "snapshot.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The products and categories the REPL serves. They come either from the CSV file, parsed into
+//  the product and category tables, or from a snapshot file (see snapshot.h) whose records are
+//  read in place. The Visit functions work the same on both, so commands don't need to care.
+//  The tables map uniq_ids to rows of a ProductStore, which only keeps the columns
+//  list_inventory needs; the others are read from the CSV, which stays mapped, when a
+//  product's row is asked for.
+//  Rows appended to the CSV later are ingested into a small table of their own, which is
+//  searched before the frozen one (see IngestAppended()).
+class Inventory {
+public:
+    // Called with (field name, value) or (uniq_id, product name)
+    typedef std::function<void(std::string_view, std::string_view)> PairVisitor;
+
+    // What IngestAppended() did
+    struct IngestResult {
+        std::size_t added = 0;    // Rows with a new uniq_id
+        std::size_t updated = 0;  // Rows that replaced the product with their uniq_id
+        // The CSV was shorter than what had been parsed, so it was loaded again in full
+        bool reloaded = false;
+    };
+
+    Inventory() = default;
+    ~Inventory() = default;
+    Inventory(const Inventory& other) = delete;
+    Inventory& operator=(const Inventory& other) = delete;
+
+    // Replaces the current data with the rows of csv_filename, which must not change while it
+    //  is loaded. It may be gzip or zstd compressed (see LoadDataFromFile()). Throws
+    //  std::runtime_error, leaving the inventory empty, if it can't be opened or decompressed.
+    void LoadCsv(const std::string& csv_filename);
+    // Replaces the current data with the snapshot at filename, if it is valid and was taken of
+    //  csv_filename as it is now. Otherwise, or if csv_filename doesn't exist, returns false
+    //  with the reason in error and keeps the current data.
+    bool LoadSnapshot(const std::string& filename, const std::string& csv_filename, std::string& error);
+    // Writes the current data to filename, stamped with csv_filename's size and modification
+    //  time. Throws std::runtime_error if csv_filename doesn't exist or the file can't be
+    //  written.
+    void SaveSnapshot(const std::string& filename, const std::string& csv_filename);
+    // Parses the rows appended to csv_filename since it was loaded, or last ingested, and
+    //  upserts them: a new uniq_id is added, and an existing one's product is replaced and
+    //  moved from the categories it no longer has to the ones it now has. Only rows ended by a
+    //  '\n' are taken, so a row still being written is taken by a later call. Blank rows are
+    //  skipped. The work is in proportion to the rows appended (and the size of the categories
+    //  an updated product leaves), not to the file.
+    //  Throws std::runtime_error unless CanIngest().
+    IngestResult IngestAppended(const std::string& csv_filename);
+    // Whether the data was loaded from a CSV file that isn't compressed, which is what
+    //  IngestAppended() reads from
+    bool CanIngest() const;
+
+    // True while the data is served from a snapshot
+    bool IsSnapshot() const;
+    const snapshot::Snapshot& GetSnapshot() const;
+    // The tables and the store, empty while a snapshot is loaded. Products ingested since the
+    //  CSV was loaded are in the updated table, and take the place of any with the same
+    //  uniq_id in the frozen one.
+    FrozenProductDatabase& GetProductDatabase();
+    ProductDatabase& GetUpdatedProducts();
+    CategoryDatabase& GetCategoryDatabase();
+    const ProductStore& GetProductStore() const;
+
+    std::size_t ProductCount() const;
+    // Calls visit(field name, value) for every field of the product, in CSV column order.
+    //  Returns false if there is no such product.
+    bool VisitProduct(std::string_view id, const PairVisitor& visit);
+    // Calls visit(uniq_id, product name) for every product in the category. Returns false if
+    //  there is no such category.
+    bool VisitCategory(std::string_view category, const PairVisitor& visit);
+    // Like the above, for the products in the category whose field is value. field must be one
+    //  CanFilter() accepts.
+    bool VisitCategory(std::string_view category, std::string_view field, std::string_view value, const PairVisitor& visit);
+    // Whether products can be filtered by field: any field of a snapshot, or a column the
+    //  product store keeps
+    bool CanFilter(std::string_view field) const;
+    void VisitIds(const std::function<void(std::string_view)>& visit);
+
+private:
+    // Reads the row of the product with this id from the CSV into row_. False if the store
+    //  has every column, or the row can't be read.
+    bool ReadRow_(std::string_view id, ProductStore::RowId row);
+    // The row the product with this id is listed under, from the updated table if it is there.
+    //  nullptr if there is none.
+    const ProductStore::RowId* FindProduct_(std::string_view id) const;
+    // The row that holds the fields of the product listed under row now (see moved_rows_)
+    ProductStore::RowId CurrentRow_(ProductStore::RowId row) const;
+    // Calls visit(uniq_id, current row) once for every product, updated or not
+    void ForEachProduct_(const std::function<void(std::string_view, ProductStore::RowId)>& visit) const;
+    // Adds or replaces the product of row, and moves it between categories. Returns whether
+    //  the uniq_id is new.
+    bool Upsert_(LoadedRow& row);
+    // Takes row out of the lists of categories, dropping categories left empty. Out of every
+    //  list if categories is nullptr.
+    void RemoveFromCategories_(ProductStore::RowId row, const std::vector<std::string>* categories);
+
+    FrozenProductDatabase product_database_;
+    // Products ingested after loading, new and updated
+    ProductDatabase updated_products_;
+    // Products in updated_products_ that aren't in product_database_
+    std::size_t added_count_ = 0;
+    // Byte of the CSV where the rows not ingested yet start
+    std::size_t ingested_end_ = 0;
+    CategoryDatabase categories_database_;
+    // Fields of every product in the tables, updated ones included
+    ProductStore product_store_;
+    // Row that holds the fields of the product listed under each row, once a product has been
+    //  updated since loading (empty until then). The tables and the category lists keep the
+    //  row a product was first listed under, so an update leaves alone the categories the
+    //  product stays in.
+    std::vector<ProductStore::RowId> moved_rows_;
+    // CSV header, in column order. The tables don't keep an order of their own.
+    std::vector<std::string> field_names_;
+    // The CSV the tables were loaded from, and the last row read from it
+    csv::MappedReader csv_file_;
+    csv::Row row_;
+    snapshot::Snapshot snapshot_;
+};
+
+#endif //INVENTORY_MANAGEMENT_INVENTORY_H
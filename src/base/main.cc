@@ -1,29 +1,54 @@
 #include "header.h"
 
-int main(void) {
+#include <chrono>
+
+// Serves the CSV file named by the first argument (gzip or zstd compressed, or not), or the
+//  marketing sample
+int main(int argc, char* argv[]) {
+  // std::cin keeps its own buffer, which the watch command checks before waiting on the descriptor
+  std::ios::sync_with_stdio(false);
   hash_table_test::TestAll();
+  csv_parser_test::TestAll();
+  snapshot_test::TestAll();
+  inventory_test::TestAll();
   std::cout << "Loading Database..." << std::endl;
-  HashTable<std::string, Product> product_database;
-  HashTable<std::string, std::vector<std::string>> categories_database;
-  LoadDataFromFile("../data/marketing_sample.csv", product_database, categories_database);
-  std::cout << "Done!" << std::endl;
+  const std::string kCsvFile(argc > 1 ? argv[1] : "../data/marketing_sample.csv");
+  const std::string kSnapshotFile(argc > 1 ? kCsvFile + ".snapshot" : "../data/marketing_sample.snapshot");
+  auto load_start = std::chrono::steady_clock::now();
+  Inventory inventory;
+  LoadInventory(kCsvFile, kSnapshotFile, inventory);
+  std::chrono::duration<double, std::milli> load_time = std::chrono::steady_clock::now() - load_start;
+  std::cout << "Done! (" << load_time.count() << " ms)" << std::endl;
 
   std::cout << "Starting Repl..." << std::endl;
 
   bool exit = false;
   ReplManager my_repl_manager;
   ExitCommand my_exit(exit);
-  FindCommand my_find(product_database);
-  ListInventoryCommand my_list_inventory(product_database, categories_database);
+  FindCommand my_find(inventory);
+  ListInventoryCommand my_list_inventory(inventory);
+  HashReportCommand my_hash_report(inventory);
+  StatsCommand my_stats(inventory);
+  SaveSnapshotCommand my_save_snapshot(inventory, kCsvFile, kSnapshotFile);
+  LoadSnapshotCommand my_load_snapshot(inventory, kCsvFile, kSnapshotFile);
+  FileWatcher watcher;
+  WatchCommand my_watch(inventory, watcher, kCsvFile);
   my_repl_manager.AddReplCommand(&my_exit);
   my_repl_manager.AddReplCommand(&my_find);
   my_repl_manager.AddReplCommand(&my_list_inventory);
+  my_repl_manager.AddReplCommand(&my_hash_report);
+  my_repl_manager.AddReplCommand(&my_stats);
+  my_repl_manager.AddReplCommand(&my_save_snapshot);
+  my_repl_manager.AddReplCommand(&my_load_snapshot);
+  my_repl_manager.AddReplCommand(&my_watch);
 
   std::string line;
   const std::string kPrompt("> ");
   while (!exit) {
     std::cout << kPrompt << std::flush;
+    my_watch.WaitForCommand(kPrompt);
     std::getline(std::cin, line);
+    my_watch.IngestChanges();
     if (!line.empty()) my_repl_manager.Evaluate(line);
   }
 
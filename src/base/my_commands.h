@@ -6,10 +6,17 @@
 #define INVENTORY_MANAGEMENT_MY_COMMANDS_H
 
 #include "repl_command.h"
+#include "file_watcher.h"
 #include "product.h"
+#include "inventory.h"
 #include "hash_table.h"
+#include "hash_distribution.h"
 
 #include <string>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
 #include <vector>
 #include <iostream>
 
@@ -26,7 +33,7 @@ private:
 
 class FindCommand : public ReplCommand {
     public:
-    explicit FindCommand(HashTable<std::string, Product>& product_database) : product_database_(product_database) {};
+    explicit FindCommand(Inventory& inventory) : inventory_(inventory) {};
     ~FindCommand() = default;
     std::string GetCommand() const override {
         return {"find"};
@@ -35,49 +42,295 @@ class FindCommand : public ReplCommand {
         return {"find product details from inventory ID. Usage: find <uniq_id>"};
     }
     void Execute(std::string argument) const override {
-        std::string product_id = argument.substr(argument.find(' ')+1);
-        auto && i = product_database_.Find(product_id);
-        if (i != product_database_.end()) {
-            for (auto && q : (*i).second.fields) {
-                std::cout << q.first << ": " << q.second << std::endl;
-            }
-        } else {
+        // View into argument, so the lookup doesn't copy the ID
+        std::string_view product_id = std::string_view(argument).substr(argument.find(' ')+1);
+        bool found = inventory_.VisitProduct(product_id, [](std::string_view field, std::string_view value) {
+            std::cout << field << ": " << value << std::endl;
+        });
+        if (!found) {
             // Invalid product ID
             std::cout << "Inventory/Product not found." << std::endl;
         }
     }
 
 private:
-    HashTable<std::string, Product>& product_database_;
+    Inventory& inventory_;
 };
 
 class ListInventoryCommand : public ReplCommand {
+    // Starts the filter, if any, after the category name, which never has it
+    static constexpr std::string_view kWhere = " where ";
 public:
-    explicit ListInventoryCommand(HashTable<std::string, Product>& product_database, HashTable<std::string, std::vector<std::string>>& categories_database)
-        : product_database_(product_database), categories_database_(categories_database) {};
+    explicit ListInventoryCommand(Inventory& inventory) : inventory_(inventory) {};
     ~ListInventoryCommand() = default;
     std::string GetCommand() const override {
         return {"list_inventory"};
     }
     std::string GetHelpText() const override {
-        return {"returns a list of product names and uniq_ids in a category. Usage: list_inventory <category>"};
+        return {"returns a list of product names and uniq_ids in a category, optionally only those whose field has a value. "
+                "Usage: list_inventory <category> [where <field>=<value>]"};
+    }
+    void Execute(std::string argument) const override {
+        std::string_view category = std::string_view(argument).substr(argument.find(' ')+1);
+        auto print = [](std::string_view id, std::string_view name) {
+            std::cout << id << ": " << name << std::endl;
+        };
+        bool found;
+        std::size_t where = category.find(kWhere);
+        if (where == std::string_view::npos) {
+            found = inventory_.VisitCategory(category, print);
+        } else {
+            std::string_view condition = category.substr(where + kWhere.size());
+            category = category.substr(0, where);
+            std::size_t equals = condition.find('=');
+            if (equals == std::string_view::npos) {
+                std::cout << "Usage: list_inventory <category> where <field>=<value>" << std::endl;
+                return;
+            }
+            std::string_view field = condition.substr(0, equals);
+            if (!inventory_.CanFilter(field)) {
+                std::cout << "Cannot filter by " << field << "." << std::endl;
+                return;
+            }
+            found = inventory_.VisitCategory(category, field, condition.substr(equals + 1), print);
+        }
+        if (!found) {
+            std::cout << "Invalid Category." << std::endl;
+        }
+    }
+private:
+    Inventory& inventory_;
+};
+
+class HashReportCommand : public ReplCommand {
+public:
+    explicit HashReportCommand(Inventory& inventory) : inventory_(inventory) {};
+    ~HashReportCommand() = default;
+    std::string GetCommand() const override {
+        return {"hash_report"};
+    }
+    std::string GetHelpText() const override {
+        return {"shows how evenly the uniq_ids spread over hash buckets, with the table's hash and with std::hash."};
+    }
+    void Execute(std::string argument) const override {
+        std::vector<std::string_view> ids;
+        ids.reserve(inventory_.ProductCount());
+        inventory_.VisitIds([&ids](std::string_view id) { ids.push_back(id); });
+        // Capacity a chained table would grow to for this many keys (load factor <= 0.7)
+        std::size_t bucket_count = static_cast<std::size_t>(static_cast<double>(ids.size()) / 0.7) + 1;
+        std::cout << "HashTableHash (seeded):" << std::endl
+                  << AnalyzeHashDistribution(ids.begin(), ids.end(), bucket_count, HashTableHash<std::string>());
+        std::cout << "std::hash:" << std::endl
+                  << AnalyzeHashDistribution(ids.begin(), ids.end(), bucket_count, std::hash<std::string_view>());
+    }
+
+private:
+    Inventory& inventory_;
+};
+
+class StatsCommand : public ReplCommand {
+public:
+    explicit StatsCommand(Inventory& inventory) : inventory_(inventory) {};
+    ~StatsCommand() = default;
+    std::string GetCommand() const override {
+        return {"stats"};
+    }
+    std::string GetHelpText() const override {
+        return {"shows chain lengths, lookup and rehash counts and memory use of the tables and the product store. Usage: stats [products|categories|store]"};
     }
     void Execute(std::string argument) const override {
-        std::string category = argument.substr(argument.find(' ')+1);
-        auto && i = categories_database_.Find(category);
-        if (i != categories_database_.end()) {
-            for (const std::string & q : (*i).second) {
-                auto && j = product_database_.Find(q);
-                if (j != product_database_.end()) {
-                    std::cout << (*j).first << ": " << (*((*j).second.fields.Find("Product Name"))).second << std::endl;
+        std::size_t separator = argument.find(' ');
+        std::string_view table = separator == std::string::npos ? std::string_view() : std::string_view(argument).substr(separator + 1);
+        bool all = table.empty();
+        if (!all && table != "products" && table != "categories" && table != "store") {
+            std::cout << "Unknown table. Usage: stats [products|categories|store]" << std::endl;
+            return;
+        }
+        if (inventory_.IsSnapshot()) {
+            // No tables are built while a snapshot is served
+            const snapshot::Snapshot& snapshot = inventory_.GetSnapshot();
+            std::cout << "Serving from a snapshot: " << snapshot.ProductCount() << " products, " << snapshot.CategoryCount()
+                      << " categories, " << snapshot.FieldCount() << " fields, " << snapshot.GetSize() << " bytes mapped" << std::endl;
+            return;
+        }
+        if (all || table == "products") {
+            std::cout << "product_database: " << inventory_.GetProductDatabase().GetStats();
+            if (inventory_.GetUpdatedProducts().size() > 0) {
+                std::cout << "updated products (see watch): " << inventory_.GetUpdatedProducts().GetStats();
+            }
+        }
+        if (all || table == "categories") {
+            std::cout << "categories_database: " << inventory_.GetCategoryDatabase().GetStats();
+        }
+        if (all || table == "store") {
+            const ProductStore& store = inventory_.GetProductStore();
+            std::cout << "product_store: " << store.RowCount() << " rows (replaced ones included), " << store.ColumnCount() << " columns" << std::endl;
+            for (std::size_t column = 0; column < store.ColumnCount(); column++) {
+                std::cout << "  " << store.ColumnName(column) << ": ";
+                if (store.IsEncoded(column)) {
+                    std::cout << "dictionary of " << store.DistinctCount(column) << " values" << std::endl;
+                } else {
+                    std::cout << "plain" << std::endl;
                 }
             }
+            std::cout << "  memory: " << store.MemoryBytes() << " bytes" << std::endl;
+        }
+    }
+
+private:
+    Inventory& inventory_;
+};
+
+class SaveSnapshotCommand : public ReplCommand {
+public:
+    SaveSnapshotCommand(Inventory& inventory, const std::string& csv_filename, const std::string& snapshot_filename)
+        : inventory_(inventory), csv_filename_(csv_filename), snapshot_filename_(snapshot_filename) {};
+    ~SaveSnapshotCommand() = default;
+    std::string GetCommand() const override {
+        return {"save_snapshot"};
+    }
+    std::string GetHelpText() const override {
+        return {"writes the inventory to a snapshot file, loaded at the next start. Usage: save_snapshot [path]"};
+    }
+    void Execute(std::string argument) const override {
+        std::size_t separator = argument.find(' ');
+        std::string path = separator == std::string::npos ? snapshot_filename_ : argument.substr(separator + 1);
+        try {
+            inventory_.SaveSnapshot(path, csv_filename_);
+            std::cout << "Saved snapshot " << path << std::endl;
+        } catch (const std::runtime_error& e) {
+            std::cout << e.what() << std::endl;
+        }
+    }
+
+private:
+    Inventory& inventory_;
+    std::string csv_filename_;
+    std::string snapshot_filename_;
+};
+
+class LoadSnapshotCommand : public ReplCommand {
+public:
+    LoadSnapshotCommand(Inventory& inventory, const std::string& csv_filename, const std::string& snapshot_filename)
+        : inventory_(inventory), csv_filename_(csv_filename), snapshot_filename_(snapshot_filename) {};
+    ~LoadSnapshotCommand() = default;
+    std::string GetCommand() const override {
+        return {"load_snapshot"};
+    }
+    std::string GetHelpText() const override {
+        return {"serves the inventory from a snapshot file, if it is current. Usage: load_snapshot [path]"};
+    }
+    void Execute(std::string argument) const override {
+        std::size_t separator = argument.find(' ');
+        std::string path = separator == std::string::npos ? snapshot_filename_ : argument.substr(separator + 1);
+        std::string error;
+        if (inventory_.LoadSnapshot(path, csv_filename_, error)) {
+            std::cout << "Mapped snapshot " << path << std::endl;
         } else {
-            std::cout << "Invalid Category." << std::endl;
+            std::cout << "Snapshot not loaded: " << error << std::endl;
         }
     }
+
 private:
-    HashTable<std::string, Product>& product_database_;
-    HashTable<std::string, std::vector<std::string>>& categories_database_;
+    Inventory& inventory_;
+    std::string csv_filename_;
+    std::string snapshot_filename_;
+};
+
+class WatchCommand : public ReplCommand {
+public:
+    WatchCommand(Inventory& inventory, FileWatcher& watcher, const std::string& csv_filename)
+        : inventory_(inventory), watcher_(watcher), csv_filename_(csv_filename) {};
+    ~WatchCommand() = default;
+    std::string GetCommand() const override {
+        return {"watch"};
+    }
+    std::string GetHelpText() const override {
+        return {"ingests rows appended to the CSV while they are written. Usage: watch [on|off]"};
+    }
+    void Execute(std::string argument) const override {
+        std::size_t separator = argument.find(' ');
+        std::string_view mode = separator == std::string::npos ? std::string_view() : std::string_view(argument).substr(separator + 1);
+        if (mode.empty()) {
+            std::cout << (watcher_.IsWatching() ? "Watching " : "Not watching ") << csv_filename_ << std::endl;
+            return;
+        }
+        if (mode == "off") {
+            watcher_.Stop();
+            std::cout << "Stopped watching " << csv_filename_ << std::endl;
+            return;
+        }
+        if (mode != "on") {
+            std::cout << "Usage: watch [on|off]" << std::endl;
+            return;
+        }
+        if (!inventory_.CanIngest()) {
+            if (csv::DetectCompression(csv_filename_) != csv::Compression::kNone) {
+                std::cout << "Cannot watch " << csv_filename_ << ": rows can't be appended to a compressed file" << std::endl;
+                return;
+            }
+            // Nothing can be added to a snapshot
+            std::cout << "Parsing " << csv_filename_ << " to watch it" << std::endl;
+            try {
+                inventory_.LoadCsv(csv_filename_);
+            } catch (const std::runtime_error& e) {
+                std::cout << e.what() << std::endl;
+                return;
+            }
+        }
+        std::string error;
+        if (!watcher_.Start(csv_filename_, error)) {
+            std::cout << error << std::endl;
+            return;
+        }
+        std::cout << "Watching " << csv_filename_ << std::endl;
+        // Rows appended since it was loaded
+        std::cout << Ingest_(FileWatcher::Change::kModified);
+    }
+
+    // Waits for the next command. While the CSV is watched, its changes are ingested in the
+    //  meantime, and prompt is printed again after saying what was done.
+    void WaitForCommand(const std::string& prompt) const {
+        // Lines std::cin has already read ahead don't show on the descriptor
+        while (watcher_.IsWatching() && std::cin.rdbuf()->in_avail() <= 0) {
+            FileWatcher::Change change = watcher_.Wait(0); // Standard input
+            if (change == FileWatcher::Change::kNone) break;
+            std::string done = Ingest_(change);
+            // A row still being written is left for later, and changes nothing yet
+            if (!done.empty()) std::cout << std::endl << done << prompt << std::flush;
+        }
+    }
+    // Ingests the changes not seen yet, so the next command sees them
+    void IngestChanges() const {
+        if (watcher_.IsWatching()) std::cout << Ingest_(watcher_.Poll());
+    }
+
+private:
+    // Returns what was done, one line per thing, or nothing
+    std::string Ingest_(FileWatcher::Change change) const {
+        if (change == FileWatcher::Change::kNone) return {};
+        if (!inventory_.CanIngest()) {
+            watcher_.Stop();
+            return "Stopped watching " + csv_filename_ + ": the inventory is no longer loaded from it\n";
+        }
+        try {
+            if (change == FileWatcher::Change::kReplaced) {
+                if (!watcher_.IsWatching()) return csv_filename_ + " is gone; stopped watching it, and kept the inventory\n";
+                inventory_.LoadCsv(csv_filename_);
+                return csv_filename_ + " was replaced, parsed it again\n";
+            }
+            Inventory::IngestResult result = inventory_.IngestAppended(csv_filename_);
+            if (result.reloaded) return csv_filename_ + " got shorter, parsed it again\n";
+            if (result.added + result.updated == 0) return {};
+            return "Ingested " + std::to_string(result.added) + " new and " + std::to_string(result.updated) + " updated products from " +
+                   csv_filename_ + "\n";
+        } catch (const std::runtime_error& e) {
+            return std::string(e.what()) + "\n";
+        }
+    }
+
+    Inventory& inventory_;
+    FileWatcher& watcher_;
+    std::string csv_filename_;
 };
-#endif //INVENTORY_MANAGEMENT_MY_COMMANDS_H
\ No newline at end of file
+#endif //INVENTORY_MANAGEMENT_MY_COMMANDS_H
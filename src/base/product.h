@@ -6,14 +6,31 @@
 #define INVENTORY_MANAGEMENT_PRODUCT_H
 
 #include "hash_table.h"
+#include "frozen_hash_table.h"
+#include "product_store.h"
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
-class Product {
-public:
-    Product() = default;
-    ~Product() = default;
-    HashTable<std::string, std::string> fields;
+// A CSV row turned into what the tables and the product store keep, ready to be added to them
+//  (see ParseRow)
+struct LoadedRow {
+    std::string uniq_id;
+    std::vector<std::string> categories;
+    // Fields of the columns the store keeps, in column order
+    std::vector<std::string> values;
+    std::size_t row_start = 0;
 };
 
+// uniq_id -> the product's row in the ProductStore, and category -> the rows of its products.
+//  A category lists 32-bit rows rather than copies of the uniq_ids, which the store has in
+//  its first column. Lookups into these are the hot path of the REPL, so they use the
+//  open-addressing layout.
+typedef HashTable<std::string, ProductStore::RowId, FlatLayout> ProductDatabase;
+typedef HashTable<std::string, std::vector<ProductStore::RowId>, FlatLayout> CategoryDatabase;
+// The product table once loading is done: nothing is inserted after that, so it is frozen into
+//  a minimal perfect hash table and every find is one probe.
+typedef FrozenHashTable<std::string, ProductStore::RowId> FrozenProductDatabase;
+
 #endif //INVENTORY_MANAGEMENT_PRODUCT_H
\ No newline at end of file
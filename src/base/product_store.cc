@@ -0,0 +1,147 @@
+#include "product_store.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+/////// BEGIN SETTINGS
+// Rows added before the columns' encodings are first chosen. A power of two, as they are
+//  chosen again each time the row count doubles.
+constexpr std::size_t kSampleRows = 4096;
+// An encoded column stays encoded while its values are used by this many rows each, on
+//  average. Below that the codes and the index cost more than they save.
+constexpr std::size_t kMinRowsPerValue = 4;
+/////// END SETTINGS
+
+} // namespace
+
+ProductStore::ProductStore(std::vector<std::string> column_names, std::size_t max_column_bytes)
+    : max_column_bytes_(std::min(max_column_bytes, kMaxColumnBytes)) {
+    columns_.resize(column_names.size());
+    for (std::size_t i = 0; i < column_names.size(); i++) columns_[i].name = std::move(column_names[i]);
+}
+
+std::size_t ProductStore::ColumnCount() const {
+    return columns_.size();
+}
+
+const std::string& ProductStore::ColumnName(std::size_t column) const {
+    return columns_[column].name;
+}
+
+std::size_t ProductStore::FindColumn(std::string_view name) const {
+    for (std::size_t column = 0; column < columns_.size(); column++) {
+        if (columns_[column].name == name) return column;
+    }
+    return kNoColumn;
+}
+
+bool ProductStore::IsEncoded(std::size_t column) const {
+    return columns_[column].encoded;
+}
+
+std::size_t ProductStore::DistinctCount(std::size_t column) const {
+    return columns_[column].values.size();
+}
+
+std::size_t ProductStore::RowCount() const {
+    return row_starts_.size();
+}
+
+void ProductStore::Reserve(std::size_t row_count) {
+    row_starts_.reserve(row_count);
+    for (Column& column : columns_) {
+        if (column.encoded) {
+            column.codes.reserve(row_count);
+        } else {
+            column.offsets.reserve(row_count + 1);
+        }
+    }
+}
+
+ProductStore::RowId ProductStore::AddRow(const std::vector<std::string>& values, std::size_t row_start) {
+    if (row_starts_.size() == std::numeric_limits<RowId>::max()) throw std::runtime_error("too many products for a ProductStore");
+    for (std::size_t i = 0; i < columns_.size(); i++) {
+        Column& column = columns_[i];
+        const std::string_view value = i < values.size() ? std::string_view(values[i]) : std::string_view();
+        if (column.encoded) {
+            column.codes.push_back(column.values.Intern(value));
+        } else {
+            AppendPlain_(column, value);
+        }
+    }
+    row_starts_.push_back(row_start);
+    const std::size_t row_count = row_starts_.size();
+    if (row_count >= kSampleRows && (row_count & (row_count - 1)) == 0) ChooseEncodings_();
+    return static_cast<RowId>(row_count - 1);
+}
+
+void ProductStore::ShrinkToFit() {
+    // A store of fewer than kSampleRows rows is only checked here
+    ChooseEncodings_();
+    for (Column& column : columns_) {
+        column.text.shrink_to_fit();
+        column.offsets.shrink_to_fit();
+        column.codes.shrink_to_fit();
+    }
+    row_starts_.shrink_to_fit();
+}
+
+std::string_view ProductStore::GetField(RowId row, std::size_t column) const {
+    const Column& fields = columns_[column];
+    if (fields.encoded) return fields.values.Get(fields.codes[row]);
+    return std::string_view(fields.text.data() + fields.offsets[row], fields.offsets[row + 1] - fields.offsets[row]);
+}
+
+std::size_t ProductStore::GetRowStart(RowId row) const {
+    return row_starts_[row];
+}
+
+std::vector<ProductStore::RowId> ProductStore::Filter(std::size_t column, std::string_view value, const std::vector<RowId>& rows) const {
+    std::vector<RowId> matches;
+    const Column& fields = columns_[column];
+    if (fields.encoded) {
+        const StringPool::Id code = fields.values.Find(value);
+        if (code == StringPool::kNotFound) return matches;
+        for (RowId row : rows) {
+            if (fields.codes[row] == code) matches.push_back(row);
+        }
+        return matches;
+    }
+    for (RowId row : rows) {
+        if (GetField(row, column) == value) matches.push_back(row);
+    }
+    return matches;
+}
+
+std::size_t ProductStore::MemoryBytes() const {
+    std::size_t bytes = columns_.capacity() * sizeof(Column) + row_starts_.capacity() * sizeof(std::size_t);
+    for (const Column& column : columns_) {
+        bytes += column.text.capacity() + column.offsets.capacity() * sizeof(uint32_t);
+        if (column.encoded) bytes += column.values.MemoryBytes() + column.codes.capacity() * sizeof(StringPool::Id);
+    }
+    return bytes;
+}
+
+void ProductStore::ChooseEncodings_() {
+    for (Column& column : columns_) {
+        if (!column.encoded || column.values.size() * kMinRowsPerValue <= column.codes.size()) continue;
+        column.encoded = false;
+        column.offsets.reserve(column.codes.capacity() + 1);
+        for (StringPool::Id code : column.codes) AppendPlain_(column, column.values.Get(code));
+        column.values = StringPool();
+        std::vector<StringPool::Id>().swap(column.codes);
+    }
+}
+
+void ProductStore::AppendPlain_(Column& column, std::string_view value) const {
+    if (column.offsets.empty()) column.offsets.push_back(0);
+    if (column.text.size() + value.size() > max_column_bytes_) {
+        throw std::runtime_error("the " + column.name + " column holds more than " + std::to_string(max_column_bytes_) + " bytes");
+    }
+    column.text += value;
+    column.offsets.push_back(static_cast<uint32_t>(column.text.size()));
+}
@@ -0,0 +1,89 @@
+#ifndef INVENTORY_MANAGEMENT_PRODUCT_STORE_H
+#define INVENTORY_MANAGEMENT_PRODUCT_STORE_H
+
+#include "string_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The fields of every product, stored by column: one schema of column names for all products,
+//  and for each column one buffer holding its fields back to back, with the offset where each
+//  row's field starts. A product is a dense row number, so a field is two offset reads and a
+//  view into the buffer, and scanning a column reads only that column's memory.
+//  Columns that repeat a few values, like brands, are dictionary-encoded instead: each
+//  distinct value is interned once into the column's StringPool, and a row holds its value's
+//  32-bit code. Which columns are encoded is found from the rows themselves: every column
+//  starts encoded, and one whose values turn out to be mostly distinct once kSampleRows rows
+//  (and again each time the row count doubles) are in is turned back into plain text.
+//  Rows are only appended. A row that is replaced (a uniq_id loaded twice, or updated by
+//  Inventory::IngestAppended) keeps its place, unused, until the store is loaded again.
+class ProductStore {
+public:
+    typedef uint32_t RowId;
+    // What FindColumn() returns for a name that isn't a column
+    static constexpr std::size_t kNoColumn = static_cast<std::size_t>(-1);
+    // Most characters a plain column holds in all, as its offsets are 32-bit
+    static constexpr std::size_t kMaxColumnBytes = UINT32_MAX;
+
+    ProductStore() = default;
+    // max_column_bytes may be set lower than kMaxColumnBytes, to test running out
+    explicit ProductStore(std::vector<std::string> column_names, std::size_t max_column_bytes = kMaxColumnBytes);
+
+    std::size_t ColumnCount() const;
+    const std::string& ColumnName(std::size_t column) const;
+    // Index of the column with this name, or kNoColumn
+    std::size_t FindColumn(std::string_view name) const;
+    // Whether the column's rows hold codes into a StringPool, and how many distinct values an
+    //  encoded column has
+    bool IsEncoded(std::size_t column) const;
+    std::size_t DistinctCount(std::size_t column) const;
+
+    // Rows added so far, replaced ones included
+    std::size_t RowCount() const;
+    // Makes room for row_count rows in all, so adding that many doesn't reallocate the offsets
+    void Reserve(std::size_t row_count);
+    // Appends a row whose field in column i is values[i] (empty past the end of values), and
+    //  returns its id. row_start is the byte where the row starts in the CSV (see
+    //  GetRowStart()). Throws std::runtime_error if a plain column's fields pass the store's
+    //  max_column_bytes in all.
+    RowId AddRow(const std::vector<std::string>& values, std::size_t row_start);
+    // Gives back the memory reserved past the rows added, once no more are expected soon
+    void ShrinkToFit();
+
+    // Valid until the next AddRow()
+    std::string_view GetField(RowId row, std::size_t column) const;
+    // Byte where the row starts in the CSV file, which has the columns the store leaves out
+    std::size_t GetRowStart(RowId row) const;
+    // Rows among rows whose field in column is value, in the order given. On an encoded
+    //  column value is looked up once, and each row is an integer compare.
+    std::vector<RowId> Filter(std::size_t column, std::string_view value, const std::vector<RowId>& rows) const;
+
+    // Heap memory of everything
+    std::size_t MemoryBytes() const;
+
+private:
+    struct Column {
+        std::string name;
+        bool encoded = true;
+        // Plain: row's field is text[offsets[row], offsets[row + 1])
+        std::string text;
+        std::vector<uint32_t> offsets;
+        // Encoded: row's field is values.Get(codes[row])
+        StringPool values;
+        std::vector<StringPool::Id> codes;
+    };
+
+    // Turns the encoded columns whose values are mostly distinct into plain ones
+    void ChooseEncodings_();
+    // Appends value as column's field of the next row
+    void AppendPlain_(Column& column, std::string_view value) const;
+
+    std::vector<Column> columns_;
+    std::vector<std::size_t> row_starts_;
+    std::size_t max_column_bytes_ = kMaxColumnBytes;
+};
+
+#endif //INVENTORY_MANAGEMENT_PRODUCT_STORE_H
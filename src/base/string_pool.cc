@@ -0,0 +1,33 @@
+#include "string_pool.h"
+
+#include <stdexcept>
+
+StringPool::Id StringPool::Intern(std::string_view value) {
+    auto && found = index_.Find(value);
+    if (found != index_.end()) return (*found).second;
+    if (strings_.size() >= kNotFound) throw std::runtime_error("a StringPool holds more than 2^32 - 1 strings");
+    const Id id = static_cast<Id>(strings_.size());
+    strings_.emplace_back(value);
+    // Keyed by the pool's own copy, as value may not outlive the call
+    index_.Insert(strings_.back(), id);
+    return id;
+}
+
+StringPool::Id StringPool::Find(std::string_view value) const {
+    auto && found = index_.Find(value);
+    return found != index_.end() ? (*found).second : kNotFound;
+}
+
+std::string_view StringPool::Get(Id id) const {
+    return strings_[id];
+}
+
+std::size_t StringPool::size() const {
+    return strings_.size();
+}
+
+std::size_t StringPool::MemoryBytes() const {
+    std::size_t bytes = strings_.size() * sizeof(std::string) + index_.GetStats().TotalBytes();
+    for (const std::string& string : strings_) bytes += HashTableHeapBytes(string);
+    return bytes;
+}
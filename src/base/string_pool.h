@@ -0,0 +1,46 @@
+#ifndef INVENTORY_MANAGEMENT_STRING_POOL_H
+#define INVENTORY_MANAGEMENT_STRING_POOL_H
+
+#include "hash_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+// Interned strings: each distinct string is kept once and numbered from 0 in the order it was
+//  first interned, so two strings of one pool are equal exactly when their ids are. A flat
+//  HashTable keyed by views of the strings, hashed by the seeded table hash, finds a string's
+//  id. The strings are kept in a deque, which never moves them, so the views stay valid as
+//  the pool grows.
+class StringPool {
+public:
+    typedef uint32_t Id;
+    // What Find() returns for a string that isn't in the pool
+    static constexpr Id kNotFound = static_cast<Id>(-1);
+
+    StringPool() = default;
+    // The index's keys point into the strings, so pools are moved, never copied
+    StringPool(const StringPool& other) = delete;
+    StringPool& operator=(const StringPool& other) = delete;
+    StringPool(StringPool&& other) = default;
+    StringPool& operator=(StringPool&& other) = default;
+
+    // The id of value, which is added if it is new. Throws std::runtime_error if the pool
+    //  would hold kNotFound strings.
+    Id Intern(std::string_view value);
+    // The id of value, or kNotFound
+    Id Find(std::string_view value) const;
+    // Valid as long as the pool
+    std::string_view Get(Id id) const;
+    // Distinct strings interned
+    std::size_t size() const;
+    std::size_t MemoryBytes() const;
+
+private:
+    std::deque<std::string> strings_;
+    HashTable<std::string_view, Id, FlatLayout, NodePool, HashTableHash<std::string>> index_;
+};
+
+#endif //INVENTORY_MANAGEMENT_STRING_POOL_H
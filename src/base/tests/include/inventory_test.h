@@ -0,0 +1,12 @@
+#ifndef INVENTORY_MANAGEMENT_INVENTORY_TEST_H
+#define INVENTORY_MANAGEMENT_INVENTORY_TEST_H
+
+namespace inventory_test {
+    void ProductStoreTest();
+    void EncodingTest();
+    void IngestTest();
+    void WatchTest();
+    void TestAll();
+}
+
+#endif //INVENTORY_MANAGEMENT_INVENTORY_TEST_H
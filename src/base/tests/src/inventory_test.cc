@@ -0,0 +1,636 @@
+#include "inventory_test.h"
+#include "file_watcher.h"
+#include "header.h"
+#include "inventory.h"
+#include "product_store.h"
+#include "string_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Category is the fifth column, as in the dataset. Color isn't kept in the product store, so
+//  find reads it from the CSV.
+constexpr std::string_view kHeader = "Uniq Id,Product Name,Brand Name,Asin,Category,Color\n";
+
+std::string Pass() {
+    return " -- PASSED\n";
+}
+
+// Path of a file in the temporary directory
+std::string TemporaryPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// Writes kHeader and rows to a CSV file in the temporary directory and returns its path
+std::string WriteCsv(const std::string& rows, const std::string& name = "inventory_test.csv") {
+    std::string path = TemporaryPath(name);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << kHeader << rows;
+    return path;
+}
+
+void Append(const std::string& path, const std::string& text) {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << text;
+}
+
+// "uniq_id: product name" for each product in category, in the order listed; just "none" if
+//  there is no such category
+std::vector<std::string> List(Inventory& inventory, std::string_view category) {
+    std::vector<std::string> products;
+    bool found = inventory.VisitCategory(category, [&products](std::string_view id, std::string_view name) {
+        products.push_back(std::string(id) + ": " + std::string(name));
+    });
+    return found ? products : std::vector<std::string>{"none"};
+}
+
+// The product's field, or "none" if there is no such product
+std::string Field(Inventory& inventory, std::string_view id, std::string_view field) {
+    std::string value = "none";
+    inventory.VisitProduct(id, [&](std::string_view name, std::string_view field_value) {
+        if (name == field) value = field_value;
+    });
+    return value;
+}
+
+// Rows with quoted commas, quotes and newlines, empty fields and a row cut short
+const std::string kTrickyRows = "p1,\"Name, with comma\",Acme,,Toys | Puzzles,\"say \"\"hi\"\"\"\n"
+                                "p2,,LEGO,,,\n"
+                                "p3,Short\n"
+                                "p4,\"multi\nline\",Hasbro,,Games,red\n";
+
+// Checks that store, which LoadDataFromFile filled from path, has every row of the file, and
+//  that reading a column by index gives the field the CSV has there
+void CheckStoreMatchesFile(const std::string& path, const ProductDatabase& products, const ProductStore& store) {
+    csv::MappedReader reader;
+    assert(reader.Open(path));
+    csv::Row row;
+    assert(reader.ReadRow(row));
+    const std::vector<std::string> header(row.begin(), row.end());
+    std::size_t row_count = 0;
+    while (reader.ReadRow(row)) {
+        auto && i = products.Find(row[0]);
+        assert(i != products.end());
+        const ProductStore::RowId product = (*i).second;
+        for (std::size_t column = 0; column < store.ColumnCount(); column++) {
+            std::size_t field = std::find(header.begin(), header.end(), store.ColumnName(column)) - header.begin();
+            assert(field < header.size());
+            assert(store.GetField(product, column) == (field < row.size() ? row[field] : std::string_view()));
+        }
+        row_count++;
+    }
+    assert(store.RowCount() == row_count);
+}
+
+////                        ////////////////////////////////////////////////////
+//// PRODUCT STORE TESTING  ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+void AddRowTest() {
+    std::cout << "AddRowTest";
+    ProductStore store({"Uniq Id", "Product Name", "Brand Name"});
+    assert(store.ColumnCount() == 3 && store.RowCount() == 0);
+    assert(store.ColumnName(1) == "Product Name");
+    assert(store.FindColumn("Brand Name") == 2 && store.FindColumn("Color") == ProductStore::kNoColumn);
+    assert(store.AddRow({"a", "Apple", "Acme"}, 52) == 0);
+    // Fields past the end of values are empty
+    assert(store.AddRow({"b"}, 70) == 1);
+    assert(store.AddRow({"c", "", "LEGO"}, 74) == 2);
+    assert(store.RowCount() == 3);
+    assert(store.GetField(0, 0) == "a" && store.GetField(0, 1) == "Apple" && store.GetField(0, 2) == "Acme");
+    assert(store.GetField(1, 0) == "b" && store.GetField(1, 1).empty() && store.GetField(1, 2).empty());
+    assert(store.GetField(2, 1).empty() && store.GetField(2, 2) == "LEGO");
+    assert(store.GetRowStart(0) == 52 && store.GetRowStart(1) == 70 && store.GetRowStart(2) == 74);
+    // The same after the encodings are chosen, which turns these mostly distinct columns plain
+    store.ShrinkToFit();
+    assert(!store.IsEncoded(0));
+    assert(store.GetField(0, 1) == "Apple" && store.GetField(1, 1).empty() && store.GetField(2, 2) == "LEGO");
+    assert(store.GetRowStart(2) == 74);
+    std::cout << Pass();
+}
+
+void ColumnReadTest() {
+    std::cout << "ColumnReadTest";
+    std::string path = WriteCsv(kTrickyRows);
+    ProductDatabase products;
+    ProductStore store;
+    CategoryDatabase categories;
+    std::vector<std::string> field_names;
+    // Every column
+    LoadDataFromFile(path, products, store, categories, field_names);
+    assert(store.ColumnCount() == field_names.size() && field_names.size() == 6);
+    for (std::size_t column = 0; column < field_names.size(); column++) assert(store.ColumnName(column) == field_names[column]);
+    CheckStoreMatchesFile(path, products, store);
+    assert(store.GetField((*products.Find("p1")).second, 5) == "say \"hi\"");
+    assert(store.GetField((*products.Find("p4")).second, 1) == "multi\nline");
+    assert(store.GetField((*products.Find("p3")).second, 4).empty());
+    std::cout << Pass();
+}
+
+void ProjectedColumnsTest() {
+    std::cout << "ProjectedColumnsTest";
+    std::string path = WriteCsv(kTrickyRows);
+    ProductDatabase products;
+    ProductStore store;
+    CategoryDatabase categories;
+    std::vector<std::string> field_names;
+    // Kept in CSV order, after the uniq_id, whichever order they are named in
+    LoadDataFromFile(path, products, store, categories, field_names, {"Color", "Product Name"});
+    assert(field_names.size() == 6);
+    assert(store.ColumnCount() == 3);
+    assert(store.ColumnName(0) == "Uniq Id" && store.ColumnName(1) == "Product Name" && store.ColumnName(2) == "Color");
+    assert(store.FindColumn("Brand Name") == ProductStore::kNoColumn);
+    CheckStoreMatchesFile(path, products, store);
+    // The rest of a row is read from where the store says it starts
+    csv::MappedReader reader;
+    assert(reader.Open(path));
+    csv::Row row;
+    for (std::string_view id : {"p1", "p2", "p3", "p4"}) {
+        const ProductStore::RowId product = (*products.Find(id)).second;
+        reader.Seek(store.GetRowStart(product));
+        assert(reader.ReadRow(row) && row[0] == id);
+    }
+    reader.Seek(store.GetRowStart((*products.Find("p4")).second));
+    assert(reader.ReadRow(row) && row.size() == 6 && row[2] == "Hasbro");
+    std::cout << Pass();
+}
+
+void ShrinkToFitTest() {
+    std::cout << "ShrinkToFitTest";
+    ProductStore store({"Uniq Id", "Product Name"});
+    store.Reserve(10000);
+    std::size_t characters = 0;
+    for (int i = 0; i < 10; i++) {
+        std::string id = "id" + std::to_string(i);
+        std::string name = "name" + std::to_string(i);
+        characters += id.size() + name.size();
+        store.AddRow({id, name}, 0);
+    }
+    const std::size_t reserved = store.MemoryBytes();
+    // Room for 10000 rows' offsets or codes in each column
+    assert(reserved >= 2 * 10000 * sizeof(uint32_t));
+    store.ShrinkToFit();
+    assert(store.MemoryBytes() < reserved / 10);
+    assert(store.MemoryBytes() >= characters);
+    for (int i = 0; i < 10; i++) assert(store.GetField(static_cast<ProductStore::RowId>(i), 1) == "name" + std::to_string(i));
+    std::cout << Pass();
+}
+
+void ColumnLimitTest() {
+    std::cout << "ColumnLimitTest";
+    // Columns of at most 16 characters, instead of 4 GiB
+    ProductStore store({"Uniq Id", "Product Name"}, 16);
+    store.AddRow({"a", "1234"}, 0);
+    store.AddRow({"b", "5678"}, 0);
+    // Both plain now, with 8 characters of names
+    store.ShrinkToFit();
+    assert(!store.IsEncoded(1));
+    // Up to the limit
+    store.AddRow({"c", "abcdefgh"}, 0);
+    bool thrown = false;
+    try {
+        store.AddRow({"d", "x"}, 0);
+    } catch (const std::runtime_error& e) {
+        thrown = std::string(e.what()).find("Product Name") != std::string::npos;
+    }
+    assert(thrown);
+    assert(store.GetField(2, 1) == "abcdefgh");
+    std::cout << Pass();
+}
+
+// A CSV of rows whose uniq_ids come again in later chunks, with quoted fields holding
+//  newlines, some an empty line, and a last row with no '\n'. A blank line follows row
+//  blank_line, if it is one of them, and row stray_quote has a quote inside an unquoted field.
+std::string ThreadedLoadCsv(int blank_line, int stray_quote) {
+    std::string rows;
+    for (int i = 0; i < 300; i++) {
+        const std::string id = "p" + std::to_string(i % 170);
+        const std::string categories = i % 3 == 0 ? "Toys | Puzzles" : i % 3 == 1 ? "Games" : "";
+        if (i % 7 == 0) {
+            rows += id + ",\"line one\n" + (i % 2 == 0 ? "\n" : "") + "line " + std::to_string(i) + "\",Acme,," + categories + ",red\n";
+        } else {
+            rows += id + ",Name " + std::to_string(i) + (i == stray_quote ? " 5\" tall" : "") + ",LEGO,,\"" + categories + "\",blue\n";
+        }
+        if (i == blank_line) rows += "\n";
+    }
+    return WriteCsv(rows + "p1,Unfinished,Acme,,Toys,gr");
+}
+
+void ThreadedLoadTest() {
+    std::cout << "ThreadedLoadTest";
+    // The blank line ends the data in a chunk; the row with no '\n' ends it in the last one;
+    //  and the stray quote throws the guessed row starts off, so later chunks are read again
+    for (std::pair<int, int> file : {std::make_pair(240, -1), std::make_pair(-1, -1), std::make_pair(-1, 20)}) {
+        std::string path = ThreadedLoadCsv(file.first, file.second);
+        ProductDatabase one_products;
+        ProductStore one_store;
+        CategoryDatabase one_categories;
+        std::vector<std::string> one_field_names;
+        const std::size_t one_end = LoadDataFromFile(path, one_products, one_store, one_categories, one_field_names,
+                                                     {"Product Name", "Color"}, csv::Utf8Policy(), 1);
+        assert(one_products.size() == 170 && one_store.RowCount() == (file.first == 240 ? 241u : 300u));
+        // Chunks of a few rows each, down to chunks with no row start of their own
+        for (std::size_t thread_count : {2, 3, 8, 64}) {
+            ProductDatabase products;
+            ProductStore store;
+            CategoryDatabase categories;
+            std::vector<std::string> field_names;
+            assert(LoadDataFromFile(path, products, store, categories, field_names, {"Product Name", "Color"}, csv::Utf8Policy(),
+                                    thread_count, 1) == one_end);
+            assert(field_names == one_field_names);
+            assert(products.size() == one_products.size());
+            for (auto && product : one_products) {
+                auto && i = products.Find(product.first);
+                assert(i != products.end() && (*i).second == product.second);
+            }
+            // Listed in the same order, with replaced rows dropped
+            assert(categories.size() == one_categories.size());
+            for (auto && category : one_categories) {
+                auto && i = categories.Find(category.first);
+                assert(i != categories.end() && (*i).second == category.second);
+            }
+            assert(store.RowCount() == one_store.RowCount() && store.ColumnCount() == one_store.ColumnCount());
+            for (ProductStore::RowId row = 0; row < store.RowCount(); row++) {
+                assert(store.GetRowStart(row) == one_store.GetRowStart(row));
+                for (std::size_t column = 0; column < store.ColumnCount(); column++) assert(store.GetField(row, column) == one_store.GetField(row, column));
+            }
+        }
+    }
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// ENCODING TESTING       ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+void StringPoolTest() {
+    std::cout << "StringPoolTest";
+    StringPool pool;
+    assert(pool.size() == 0 && pool.Find("Acme") == StringPool::kNotFound);
+    assert(pool.Intern("Acme") == 0 && pool.Intern("LEGO") == 1 && pool.Intern("") == 2);
+    // Interned again: the same id, nothing added
+    assert(pool.Intern("Acme") == 0 && pool.Intern(std::string("LE") + "GO") == 1);
+    assert(pool.size() == 3);
+    assert(pool.Find("LEGO") == 1 && pool.Find("") == 2 && pool.Find("Hasbro") == StringPool::kNotFound);
+    assert(pool.Get(0) == "Acme" && pool.Get(1) == "LEGO" && pool.Get(2).empty());
+    std::cout << Pass();
+}
+
+void StringPoolGrowthTest() {
+    std::cout << "StringPoolGrowthTest";
+    StringPool pool;
+    pool.Intern("value 0");
+    const std::string_view first = pool.Get(0);
+    // Every other value is too long for a std::string's own buffer
+    for (int i = 1; i < 20000; i++) {
+        std::string value = (i % 2 == 0 ? "value " : "a much longer value, past any small string buffer ") + std::to_string(i);
+        assert(pool.Intern(value) == static_cast<StringPool::Id>(i));
+    }
+    assert(pool.size() == 20000);
+    // Views taken before the pool grew still hold
+    assert(first == "value 0" && first.data() == pool.Get(0).data());
+    for (int i = 0; i < 20000; i++) {
+        std::string value = (i % 2 == 0 ? "value " : "a much longer value, past any small string buffer ") + std::to_string(i);
+        assert(pool.Find(value) == static_cast<StringPool::Id>(i) && pool.Get(static_cast<StringPool::Id>(i)) == value);
+        assert(pool.Intern(value) == static_cast<StringPool::Id>(i));
+    }
+    assert(pool.size() == 20000);
+    assert(pool.MemoryBytes() > 20000 * sizeof(std::string));
+    // Moved, it keeps its strings where they were
+    StringPool moved(std::move(pool));
+    assert(moved.size() == 20000 && moved.Find("value 0") == 0 && moved.Get(0).data() == first.data());
+    std::cout << Pass();
+}
+
+void ChooseEncodingsTest() {
+    std::cout << "ChooseEncodingsTest";
+    // Checked once this many rows are in (kSampleRows in product_store.cc), and again at each
+    //  doubling
+    constexpr int kSampleRows = 4096;
+    const char* const kBrands[] = {"Acme", "LEGO", "Hasbro", "Mattel"};
+    ProductStore store({"Uniq Id", "Brand Name", "Selling Price"});
+    for (int i = 0; i < kSampleRows - 1; i++) {
+        // 4 brands; prices repeat every 2048 rows, 2 rows each
+        store.AddRow({"id" + std::to_string(i), kBrands[i % 4], "$" + std::to_string(i % 2048)}, 0);
+    }
+    // Every column starts encoded
+    assert(store.IsEncoded(0) && store.IsEncoded(1) && store.IsEncoded(2));
+    store.AddRow({"id" + std::to_string(kSampleRows - 1), kBrands[(kSampleRows - 1) % 4], "$" + std::to_string((kSampleRows - 1) % 2048)}, 0);
+    // A value per row, and 2 rows a value, are too few to be worth a dictionary
+    assert(!store.IsEncoded(0) && !store.IsEncoded(2));
+    assert(store.IsEncoded(1) && store.DistinctCount(1) == 4);
+    for (int i = 0; i < kSampleRows; i++) {
+        const ProductStore::RowId row = static_cast<ProductStore::RowId>(i);
+        assert(store.GetField(row, 0) == "id" + std::to_string(i) && store.GetField(row, 1) == kBrands[i % 4]);
+        assert(store.GetField(row, 2) == "$" + std::to_string(i % 2048));
+    }
+    // Plain columns stay plain, and a few more rows don't change the brands
+    for (int i = kSampleRows; i < 2 * kSampleRows; i++) store.AddRow({"id" + std::to_string(i), kBrands[i % 4], "$1"}, 0);
+    assert(!store.IsEncoded(0) && store.IsEncoded(1) && !store.IsEncoded(2));
+    assert(store.GetField(2 * kSampleRows - 1, 1) == kBrands[3] && store.GetField(2 * kSampleRows - 1, 2) == "$1");
+
+    // A store too small to reach the sample is checked by ShrinkToFit
+    ProductStore small({"Uniq Id", "Brand Name"});
+    for (int i = 0; i < 100; i++) small.AddRow({"id" + std::to_string(i), kBrands[i % 4]}, 0);
+    small.ShrinkToFit();
+    assert(!small.IsEncoded(0) && small.IsEncoded(1));
+    assert(small.GetField(99, 0) == "id99" && small.GetField(99, 1) == kBrands[3]);
+    std::cout << Pass();
+}
+
+void FilterTest() {
+    std::cout << "FilterTest";
+    const char* const kBrands[] = {"Acme", "LEGO", "Hasbro"};
+    ProductStore store({"Uniq Id", "Brand Name"});
+    for (int i = 0; i < 300; i++) store.AddRow({"id" + std::to_string(i), kBrands[i % 3]}, 0);
+    store.ShrinkToFit();
+    // Ids are plain, brands encoded: both branches of Filter
+    assert(!store.IsEncoded(0) && store.IsEncoded(1));
+    std::vector<ProductStore::RowId> rows;
+    // The odd rows from the last down, to check the order given is kept
+    for (int i = 299; i >= 0; i -= 2) rows.push_back(static_cast<ProductStore::RowId>(i));
+    for (std::size_t column = 0; column < store.ColumnCount(); column++) {
+        for (std::string_view value : {"Acme", "LEGO", "Hasbro", "id7", "id8", "Mattel", ""}) {
+            std::vector<ProductStore::RowId> expected;
+            for (ProductStore::RowId row : rows) {
+                if (store.GetField(row, column) == value) expected.push_back(row);
+            }
+            assert(store.Filter(column, value, rows) == expected);
+        }
+    }
+    std::vector<ProductStore::RowId> lego = store.Filter(1, "LEGO", rows);
+    assert(lego.size() == 50 && lego.front() == 295 && lego.back() == 1);
+    // id7 is in rows, id8 isn't
+    assert(store.Filter(0, "id7", rows) == std::vector<ProductStore::RowId>{7});
+    assert(store.Filter(0, "id8", rows).empty());
+    // A value that isn't in the dictionary matches nothing
+    assert(store.Filter(1, "Mattel", rows).empty());
+    assert(store.Filter(1, "Acme", {}).empty());
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// INGEST TESTING         ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+void IngestNewRowsTest() {
+    std::cout << "IngestNewRowsTest";
+    std::string path = WriteCsv("a,Apple,Acme,,Toys | Puzzles,red\nb,Ball,LEGO,,Toys,blue\n");
+    Inventory inventory;
+    inventory.LoadCsv(path);
+    assert(inventory.CanIngest() && inventory.ProductCount() == 2);
+    // Nothing appended yet
+    Inventory::IngestResult result = inventory.IngestAppended(path);
+    assert(result.added == 0 && result.updated == 0 && !result.reloaded);
+    // A blank line in between is skipped
+    Append(path, "c,Cube,LEGO,,Toys | Games,white\n\nd,Dice,Acme,,Dice Games,black\n");
+    result = inventory.IngestAppended(path);
+    assert(result.added == 2 && result.updated == 0 && !result.reloaded);
+    assert(inventory.ProductCount() == 4);
+    assert((List(inventory, "Toys") == std::vector<std::string>{"a: Apple", "b: Ball", "c: Cube"}));
+    assert((List(inventory, "Games") == std::vector<std::string>{"c: Cube"}));
+    assert((List(inventory, "Dice Games") == std::vector<std::string>{"d: Dice"}));
+    assert(Field(inventory, "c", "Color") == "white" && Field(inventory, "d", "Brand Name") == "Acme");
+    assert(Field(inventory, "a", "Color") == "red");
+    std::cout << Pass();
+}
+
+void IngestUpdateTest() {
+    std::cout << "IngestUpdateTest";
+    std::string path = WriteCsv("a,Apple,Acme,,Toys | Puzzles,red\nb,Ball,LEGO,,Toys,blue\n");
+    Inventory inventory;
+    inventory.LoadCsv(path);
+    // Leaves Toys, stays in Puzzles, where it is listed under the row it was loaded with, and
+    //  joins Games
+    Append(path, "a,Apricot,Hasbro,,Puzzles | Games,green\n");
+    Inventory::IngestResult result = inventory.IngestAppended(path);
+    assert(result.added == 0 && result.updated == 1);
+    assert(inventory.ProductCount() == 2);
+    assert((List(inventory, "Toys") == std::vector<std::string>{"b: Ball"}));
+    assert((List(inventory, "Puzzles") == std::vector<std::string>{"a: Apricot"}));
+    assert((List(inventory, "Games") == std::vector<std::string>{"a: Apricot"}));
+    assert(Field(inventory, "a", "Product Name") == "Apricot" && Field(inventory, "a", "Color") == "green");
+    // Filtered on the fields of the product's new row
+    std::vector<std::string> filtered;
+    auto collect = [&filtered](std::string_view id, std::string_view name) { filtered.push_back(std::string(id) + ": " + std::string(name)); };
+    assert(inventory.VisitCategory("Puzzles", "Brand Name", "Hasbro", collect));
+    assert((filtered == std::vector<std::string>{"a: Apricot"}));
+    filtered.clear();
+    assert(inventory.VisitCategory("Puzzles", "Brand Name", "Acme", collect) && filtered.empty());
+
+    // Updated again: leaves Puzzles, which is left empty and dropped
+    Append(path, "a,Avocado,Acme,,Games,yellow\n");
+    result = inventory.IngestAppended(path);
+    assert(result.added == 0 && result.updated == 1);
+    assert((List(inventory, "Puzzles") == std::vector<std::string>{"none"}));
+    assert((List(inventory, "Games") == std::vector<std::string>{"a: Avocado"}));
+    // No categories at all is "NA"
+    Append(path, "b,Ball,LEGO,,,blue\n");
+    result = inventory.IngestAppended(path);
+    assert(result.updated == 1);
+    assert((List(inventory, "Toys") == std::vector<std::string>{"none"}));
+    assert((List(inventory, "NA") == std::vector<std::string>{"b: Ball"}));
+
+    // A snapshot of the updated data has the same products and categories
+    std::string snapshot_path = TemporaryPath("inventory_test.snapshot");
+    inventory.SaveSnapshot(snapshot_path, path);
+    std::string error;
+    assert(inventory.LoadSnapshot(snapshot_path, path, error));
+    assert(inventory.IsSnapshot() && !inventory.CanIngest() && inventory.ProductCount() == 2);
+    assert((List(inventory, "Games") == std::vector<std::string>{"a: Avocado"}));
+    assert((List(inventory, "NA") == std::vector<std::string>{"b: Ball"}));
+    assert((List(inventory, "Puzzles") == std::vector<std::string>{"none"}));
+    assert(Field(inventory, "a", "Color") == "yellow");
+    bool thrown = false;
+    try {
+        inventory.IngestAppended(path);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // The categories left are the ones the product was listed under, even once its old row
+    //  has been rewritten in place
+    path = WriteCsv("a,Apple,Acme,,Toys,red\n");
+    inventory.LoadCsv(path);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(kHeader.size() + std::string_view("a,Apple,Acme,,").size());
+        file << "Tops";
+    }
+    Append(path, "a,Apple,Acme,,Games,red\n");
+    result = inventory.IngestAppended(path);
+    assert(result.updated == 1);
+    assert((List(inventory, "Toys") == std::vector<std::string>{"none"}));
+    assert((List(inventory, "Games") == std::vector<std::string>{"a: Apple"}));
+    std::cout << Pass();
+}
+
+void PartialRowTest() {
+    std::cout << "PartialRowTest";
+    std::string path = WriteCsv("a,Apple,Acme,,Toys,red\n");
+    Inventory inventory;
+    inventory.LoadCsv(path);
+    // Not ended by a '\n' yet, so still being written
+    Append(path, "e,Egg,Acme,,Toys,wh");
+    Inventory::IngestResult result = inventory.IngestAppended(path);
+    assert(result.added == 0 && result.updated == 0);
+    assert(Field(inventory, "e", "Color") == "none");
+    Append(path, "ite\n");
+    result = inventory.IngestAppended(path);
+    assert(result.added == 1);
+    assert(Field(inventory, "e", "Color") == "white");
+    assert((List(inventory, "Toys") == std::vector<std::string>{"a: Apple", "e: Egg"}));
+    // Taken once
+    result = inventory.IngestAppended(path);
+    assert(result.added == 0 && result.updated == 0);
+
+    // Already there when the file is loaded: not loaded, and taken as new once it is finished
+    path = WriteCsv("a,Apple,Acme,,Toys,red\ne,Egg,Acme,,Toy");
+    inventory.LoadCsv(path);
+    assert(inventory.ProductCount() == 1 && Field(inventory, "e", "Color") == "none");
+    assert((List(inventory, "Toy") == std::vector<std::string>{"none"}));
+    Append(path, "s | Games,white\n");
+    result = inventory.IngestAppended(path);
+    assert(result.added == 1 && result.updated == 0);
+    assert((List(inventory, "Toys") == std::vector<std::string>{"a: Apple", "e: Egg"}));
+    assert((List(inventory, "Games") == std::vector<std::string>{"e: Egg"}));
+    assert((List(inventory, "Toy") == std::vector<std::string>{"none"}));
+    assert(Field(inventory, "e", "Category") == "Toys | Games");
+    std::cout << Pass();
+}
+
+void ShortenedFileTest() {
+    std::cout << "ShortenedFileTest";
+    std::string path = WriteCsv("a,Apple,Acme,,Toys,red\nb,Ball,LEGO,,Toys,blue\n");
+    Inventory inventory;
+    inventory.LoadCsv(path);
+    // Rewritten in place, shorter than what was parsed
+    WriteCsv("z,Zebra,Acme,,Animals,black\n");
+    Inventory::IngestResult result = inventory.IngestAppended(path);
+    assert(result.reloaded);
+    assert(inventory.ProductCount() == 1);
+    assert(Field(inventory, "a", "Color") == "none" && Field(inventory, "z", "Color") == "black");
+    assert((List(inventory, "Toys") == std::vector<std::string>{"none"}));
+    assert((List(inventory, "Animals") == std::vector<std::string>{"z: Zebra"}));
+    // Ingesting goes on from the end of the reloaded file
+    Append(path, "y,Yak,LEGO,,Animals,brown\n");
+    result = inventory.IngestAppended(path);
+    assert(result.added == 1 && !result.reloaded);
+    assert((List(inventory, "Animals") == std::vector<std::string>{"z: Zebra", "y: Yak"}));
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// WATCH TESTING          ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+#if defined(__linux__)
+void WatchChangesTest() {
+    std::cout << "WatchChangesTest";
+    std::string path = WriteCsv("a,Apple,Acme,,Toys,red\n");
+    Inventory inventory;
+    inventory.LoadCsv(path);
+    FileWatcher watcher;
+    std::string error;
+    assert(watcher.Start(path, error));
+    assert(watcher.IsWatching() && watcher.GetFilename() == path);
+    assert(watcher.Poll() == FileWatcher::Change::kNone);
+    Append(path, "b,Ball,LEGO,,Toys,blue\n");
+    assert(watcher.Poll() == FileWatcher::Change::kModified);
+    assert(inventory.IngestAppended(path).added == 1);
+    // chmod comes as an attribute change too, but leaves the same file at the path
+    std::filesystem::permissions(path, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+    assert(watcher.Poll() == FileWatcher::Change::kModified);
+    assert(watcher.Poll() == FileWatcher::Change::kNone);
+    assert(!watcher.Start(TemporaryPath("inventory_test_missing.csv"), error) && !watcher.IsWatching());
+    std::cout << Pass();
+}
+
+void WatchReplacedTest() {
+    std::cout << "WatchReplacedTest";
+    std::string path = WriteCsv("a,Apple,Acme,,Toys,red\n");
+    Inventory inventory;
+    inventory.LoadCsv(path);
+    FileWatcher watcher;
+    std::string error;
+    assert(watcher.Start(path, error));
+    // Renamed over the file while the inventory still maps it, so the old file is only
+    //  unlinked, and it takes the inode check to tell it from a chmod
+    std::string other = WriteCsv("z,Zebra,Acme,,Animals,black\n", "inventory_test_new.csv");
+    std::filesystem::rename(other, path);
+    assert(watcher.Poll() == FileWatcher::Change::kReplaced);
+    assert(watcher.IsWatching());
+    inventory.LoadCsv(path);
+    assert(Field(inventory, "a", "Color") == "none");
+    assert((List(inventory, "Animals") == std::vector<std::string>{"z: Zebra"}));
+    // The new file is watched instead
+    Append(path, "y,Yak,LEGO,,Animals,brown\n");
+    assert(watcher.Poll() == FileWatcher::Change::kModified);
+    assert(inventory.IngestAppended(path).added == 1);
+    assert((List(inventory, "Animals") == std::vector<std::string>{"z: Zebra", "y: Yak"}));
+    // Deleted, with nothing in its place: the watch stops
+    std::filesystem::remove(path);
+    assert(watcher.Poll() == FileWatcher::Change::kReplaced);
+    assert(!watcher.IsWatching());
+    std::cout << Pass();
+}
+#endif
+
+}
+
+namespace inventory_test {
+void TestAll() {
+    std::cout << "----- RUNNING ALL INVENTORY TESTS -----" << std::endl;
+    ProductStoreTest();
+    EncodingTest();
+    IngestTest();
+    WatchTest();
+    std::cout << "ALL INVENTORY TESTS PASSED" << std::endl;
+}
+void ProductStoreTest() {
+    std::cout << "----- Product Store Tests -----" << std::endl;
+    AddRowTest();
+    ColumnReadTest();
+    ProjectedColumnsTest();
+    ShrinkToFitTest();
+    ColumnLimitTest();
+    ThreadedLoadTest();
+    std::cout << "----- Product Store Tests passed" << std::endl;
+}
+void EncodingTest() {
+    std::cout << "----- Encoding Tests -----" << std::endl;
+    StringPoolTest();
+    StringPoolGrowthTest();
+    ChooseEncodingsTest();
+    FilterTest();
+    std::cout << "----- Encoding Tests passed" << std::endl;
+}
+void IngestTest() {
+    std::cout << "----- Ingest Tests -----" << std::endl;
+    IngestNewRowsTest();
+    IngestUpdateTest();
+    PartialRowTest();
+    ShortenedFileTest();
+    std::cout << "----- Ingest Tests passed" << std::endl;
+}
+void WatchTest() {
+    std::cout << "----- Watch Tests -----" << std::endl;
+#if defined(__linux__)
+    WatchChangesTest();
+    WatchReplacedTest();
+#endif
+    std::cout << "----- Watch Tests passed" << std::endl;
+}
+}
@@ -5,13 +5,204 @@
 #ifndef CSV_PARSER_H
 #define CSV_PARSER_H
 
+#include "decompressing_source.h"
+#include "structural_scanner.h"
+#include "utf8_validator.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
 #include <iostream>
-#include <vector>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace csv {
 
   std::vector<std::string> ReadLine(std::istream& input_stream, char escape_character = '"');
 
+  // The fields of a row. Readers fill the same Row again for every row, so once it has grown to
+  //  the widest row, reading allocates nothing.
+  typedef std::vector<std::string_view> Row;
+
+  // Reads a csv file through a memory mapping, one row at a time, with the same field and
+  //  escape semantics as ReadLine() (see docs.md). Fields are std::string_views into the
+  //  mapping; only quoted fields containing escape sequences are unescaped, into a buffer
+  //  owned by the reader. Either way a row's fields stay valid until the next ReadRow() call.
+  //  Delimiters and quotes are found through StructuralScanner's masks, a block at a time.
+  //  With a Utf8Policy set, each row is checked with Utf8Validator, and the fields of rows that
+  //  need it are sanitized into another buffer the reader owns.
+  class MappedReader {
+   public:
+    explicit MappedReader(char escape_character = '"');
+    ~MappedReader();
+    MappedReader(const MappedReader& other) = delete;
+    MappedReader& operator=(const MappedReader& other) = delete;
+
+    // Maps filename, closing any file opened before. Returns false if it can't be opened.
+    bool Open(const std::string& filename);
+    // Reads contents in place instead of a file. They must stay valid until Close().
+    void OpenBuffer(std::string_view contents);
+    void Close();
+    bool IsOpen() const;
+    // Bytes of the file, and how many have been read so far
+    std::size_t GetSize() const;
+    std::size_t GetPosition() const;
+    // Continues reading at byte position, which should be the start of a row
+    void Seek(std::size_t position);
+    // The whole file
+    std::string_view GetContents() const;
+
+    // Reads the next row into fields. Returns false, with fields empty, once the whole file
+    //  has been read.
+    bool ReadRow(Row& fields);
+    // Whether the last row read ended with a '\n', rather than with the end of the file
+    bool LastRowTerminated() const;
+    // What is done to the text of the fields read from now on. Keeps it as it is by default.
+    void SetUtf8Policy(const Utf8Policy& policy);
+
+   private:
+    enum class Status {
+      kEndOfField = 0,
+      kEndOfEntry,
+      kEndOfFile,
+    };
+
+    Status ReadField_(std::string_view& field);
+    bool ReadQuotedFieldFast_(std::string_view& field, Status& status);
+    Status ReadQuotedField_(std::string_view& field);
+    // Replaces the fields policy would change with sanitized copies in sanitized_
+    void SanitizeFields_(Row& fields);
+    // Scans the block starting block_offset characters into the file
+    void LoadBlock_(std::size_t block_offset);
+    // First character at or after from with its bit set in masks_.*mask, or the end of the file
+    const char* FindNext_(const char* from, uint64_t StructuralMasks::*mask);
+
+    char escape_character_;
+    const char* data_;
+    std::size_t size_;
+    // Next character to read
+    const char* position_;
+    // The mapping, or heap memory where files are read instead of mapped
+    void* mapping_;
+    StructuralScanner scanner_;
+    // Masks of the block at block_offset_ (kNoBlock before the first is scanned)
+    static constexpr std::size_t kNoBlock = ~static_cast<std::size_t>(0);
+    std::size_t block_offset_;
+    StructuralMasks masks_;
+    // Copy of a last block shorter than kBlockSize, as the scanner reads whole blocks
+    char tail_[StructuralScanner::kBlockSize];
+    // Unescaped quoted fields of the current row
+    std::string scratch_;
+    // Fields of the current row that live in scratch_: index, offset into scratch_, length.
+    //  Their views are only made once the row is done, as scratch_ may move while it grows.
+    struct ScratchField {
+      std::size_t index;
+      std::size_t offset;
+      std::size_t length;
+    };
+    std::vector<ScratchField> scratch_fields_;
+    // Set by ReadQuotedField_ when the field it returns is in scratch_
+    bool field_in_scratch_;
+    bool last_row_terminated_;
+    Utf8Policy utf8_policy_;
+    Utf8Validator validator_;
+    // Sanitized fields of the current row
+    std::string sanitized_;
+  };
+
+  // Reads csv rows from a file, a stream or any other source of bytes, with MappedReader's
+  //  semantics. Bytes are read in large blocks into a buffer the reader owns, and rows are
+  //  parsed from there, so the source is called once per block rather than once per character.
+  //  Fields are std::string_views into the buffer (or MappedReader's unescaping buffer), valid
+  //  until the next ReadRow() call. The buffer only grows for rows over half its size.
+  //  gzip and zstd files are decompressed as they are read, by a DecompressingSource.
+  class Reader {
+   public:
+    // Reads up to size bytes into buffer and returns how many it read; 0 once there are none
+    typedef std::function<std::size_t(char* buffer, std::size_t size)> Source;
+
+    static constexpr std::size_t kDefaultBufferSize = 1 << 20;
+
+    explicit Reader(char escape_character = '"', std::size_t buffer_size = kDefaultBufferSize);
+    ~Reader();
+    Reader(const Reader& other) = delete;
+    Reader& operator=(const Reader& other) = delete;
+
+    // Each closes whatever was open before. Returns false if filename can't be opened, or is
+    //  compressed in a format this build can't decompress (see GetError()).
+    bool Open(const std::string& filename);
+    // stream must outlive the reader, or the next Open() or Close()
+    void Open(std::istream& stream);
+    void Open(Source source);
+    void Close();
+
+    // Reads the next row into fields. Returns false, with fields empty, once the source has
+    //  no more bytes.
+    bool ReadRow(Row& fields);
+    // Bytes of the rows read so far
+    std::size_t GetPosition() const;
+    // See MappedReader::SetUtf8Policy()
+    void SetUtf8Policy(const Utf8Policy& policy);
+    // Why a compressed file couldn't be opened, or ended early (see
+    //  DecompressingSource::GetError()). Empty otherwise.
+    std::string GetError() const;
+
+   private:
+    // Keeps the unread bytes from row_start on, moved to the front of the buffer, and reads more
+    //  after them. Sets source_done_ if the source had none.
+    void Fill_(std::size_t row_start);
+
+    MappedReader parser_;
+    Source source_;
+    std::FILE* file_;
+    // Kept from one compressed file to the next, with its thread and blocks
+    std::unique_ptr<DecompressingSource> decompressor_;
+    std::vector<char> buffer_;
+    // Bytes of buffer_ filled from the source
+    std::size_t filled_;
+    // Bytes read from the source before the start of buffer_
+    std::size_t buffer_position_;
+    bool source_done_;
+  };
+
+  // Calls visit(row) for every row reader reads, filling the same Row each time, until visit
+  //  returns false. Returns the number of rows visited. Works with MappedReader and Reader.
+  template <typename RowReader, typename Visitor>
+  std::size_t ForEachRow(RowReader& reader, Visitor&& visit) {
+    Row row;
+    std::size_t count = 0;
+    while (reader.ReadRow(row)) {
+      count++;
+      if (!visit(static_cast<const Row&>(row))) {
+        break;
+      }
+    }
+    return count;
+  }
+
+  // Called with a chunk number, the fields of one of its rows and the byte where the row starts
+  //  (which MappedReader::Seek() takes to read it again). Returns false when no more rows are
+  //  wanted (see ReadChunks()).
+  typedef std::function<bool(std::size_t chunk, const Row& fields, std::size_t row_start)> ChunkVisitor;
+
+  // Reads the rows of filename from byte begin on (a row start, e.g. GetPosition() after the
+  //  header) on chunk_count threads. The rest of the file is split into chunk_count byte ranges
+  //  starting at rows, and each thread reads one with its own MappedReader, calling
+  //  visit(chunk, fields, row_start) for each row in order. Chunks are numbered in file order, so their
+  //  rows one after another are the rows a single MappedReader reads.
+  //
+  //  Where a row starts is guessed from counting quotes, which is right for files quoted as in
+  //  docs.md. Once all threads are done, every chunk is checked to start where the one before
+  //  it ended. If one doesn't, discard(chunk) is called to drop the rows of that chunk and all
+  //  later ones, and the rest of the file is read again on the calling thread as chunk.
+  //  After visit returns false for a chunk, that chunk is not read further and later chunks'
+  //  rows are to be ignored. Returns false if the file can't be opened. Fields are sanitized
+  //  as utf8_policy says (see MappedReader::SetUtf8Policy()).
+  bool ReadChunks(const std::string& filename, std::size_t begin, std::size_t chunk_count, const ChunkVisitor& visit,
+                  const std::function<void(std::size_t chunk)>& discard, char escape_character = '"',
+                  const Utf8Policy& utf8_policy = Utf8Policy());
+
 }
 #endif
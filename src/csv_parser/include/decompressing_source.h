@@ -0,0 +1,82 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#ifndef CSV_DECOMPRESSING_SOURCE_H
+#define CSV_DECOMPRESSING_SOURCE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace csv {
+
+  enum class Compression {
+    kNone = 0,
+    kGzip,  // Starts 1F 8B
+    kZstd,  // Starts 28 B5 2F FD
+  };
+
+  // Format of a file from its first bytes, or of the file at filename (kNone if it can't be read)
+  Compression DetectCompression(std::string_view first_bytes);
+  Compression DetectCompression(const std::string& filename);
+  // Whether this build can decompress the format: gzip needs zlib and zstd libzstd, found by
+  //  CMake when the library is built (kNone is always supported)
+  bool IsSupported(Compression compression);
+
+  // Decompresses a gzip or zstd file (or copies a file that isn't compressed) on a thread of
+  //  its own, block_count blocks of block_size bytes ahead of whoever calls Read(). Parsing one
+  //  block overlaps with decompressing the next, and nothing is written to disk. Read() fits
+  //  Reader::Source, and Reader::Open() uses this for files that start with a magic number.
+  class DecompressingSource {
+   public:
+    static constexpr std::size_t kDefaultBlockSize = 1 << 20;
+    static constexpr std::size_t kDefaultBlockCount = 4;
+
+    explicit DecompressingSource(std::size_t block_size = kDefaultBlockSize, std::size_t block_count = kDefaultBlockCount);
+    ~DecompressingSource();
+    DecompressingSource(const DecompressingSource& other) = delete;
+    DecompressingSource& operator=(const DecompressingSource& other) = delete;
+
+    // Starts decompressing filename, in the format its first bytes say, closing whatever was
+    //  open before. Returns false, with the reason in GetError(), if it can't be opened or
+    //  this build doesn't support the format.
+    bool Open(const std::string& filename);
+    // Stops the thread
+    void Close();
+
+    // Copies up to size decompressed bytes into buffer and returns how many; 0 once there are
+    //  none left, or after an error. Waits only while no block is ready.
+    std::size_t Read(char* buffer, std::size_t size);
+    // Why decompression stopped before the end of the data (cut off, corrupt, read error).
+    //  Empty if it didn't.
+    std::string GetError() const;
+
+   private:
+    struct Block {
+      std::vector<char> data;
+      std::size_t size;
+    };
+
+    std::vector<Block> blocks_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    // Signalled when a block is filled or the thread is done, and when a block is freed or
+    //  Close() is called
+    std::condition_variable filled_;
+    std::condition_variable freed_;
+    // Blocks filled and blocks read so far. Block n is blocks_[n % blocks_.size()].
+    std::size_t produced_;
+    std::size_t consumed_;
+    // Bytes read of the block being read
+    std::size_t read_offset_;
+    bool finished_;
+    bool stopping_;
+    std::string error_;
+  };
+
+}
+#endif
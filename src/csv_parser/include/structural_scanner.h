@@ -0,0 +1,83 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#ifndef CSV_STRUCTURAL_SCANNER_H
+#define CSV_STRUCTURAL_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace csv {
+
+  // Where the characters that matter to the parser are in a block of kBlockSize characters.
+  //  Bit i stands for character i of the block.
+  struct StructuralMasks {
+    uint64_t delimiters;  // ',' and '\n'
+    uint64_t quotes;      // '"' and the escape character
+  };
+
+  // Index of the lowest set bit of mask, which must not be 0: where the first character of a
+  //  mask is
+  inline unsigned int CountTrailingZeros(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned int>(__builtin_ctzll(mask));
+#else
+    unsigned int offset = 0;
+    while (((mask >> offset) & 1u) == 0) ++offset;
+    return offset;
+#endif
+  }
+
+  // Number of set bits of mask: how many characters a mask has
+  inline unsigned int PopCount(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned int>(__builtin_popcountll(mask));
+#else
+    unsigned int count = 0;
+    for (; mask != 0; mask &= mask - 1) ++count;
+    return count;
+#endif
+  }
+
+  // Instruction sets a StructuralScanner can use, narrowest first
+  enum class ScanLevel {
+    kScalar = 0,
+    kSse2,
+    kAvx2,
+  };
+
+  // Builds StructuralMasks 16 (SSE2) or 32 (AVX2) characters per instruction, picking the
+  //  widest level the processor supports when it is constructed. MappedReader consumes the
+  //  masks a bit at a time instead of testing every character, in the style of simdjson.
+  class StructuralScanner {
+   public:
+    static constexpr std::size_t kBlockSize = 64;
+
+    explicit StructuralScanner(char escape_character = '"');
+    // Falls back to narrower levels the processor doesn't support
+    StructuralScanner(char escape_character, ScanLevel level);
+
+    // Masks of the kBlockSize characters starting at block
+    StructuralMasks Scan(const char* block) const {
+      return scan_(block, escape_character_);
+    }
+    // Bit i of the result is the XOR of bits 0 to i of quotes: set from each opening quote up
+    //  to (not including) its closing quote, if every quote opens or closes one. Done with a
+    //  carry-less multiply where the processor has one.
+    uint64_t PrefixXor(uint64_t quotes) const {
+      return prefix_xor_(quotes);
+    }
+    ScanLevel GetLevel() const;
+
+    static bool IsSupported(ScanLevel level);
+    static ScanLevel GetBestLevel();
+
+   private:
+    char escape_character_;
+    ScanLevel level_;
+    StructuralMasks (*scan_)(const char* block, char escape_character);
+    uint64_t (*prefix_xor_)(uint64_t quotes);
+  };
+
+}
+#endif
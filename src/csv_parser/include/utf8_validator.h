@@ -0,0 +1,71 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#ifndef CSV_UTF8_VALIDATOR_H
+#define CSV_UTF8_VALIDATOR_H
+
+#include "structural_scanner.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace csv {
+
+  // What becomes of bytes that aren't part of a valid UTF-8 character
+  enum class InvalidUtf8 {
+    kKeep = 0,
+    kReplace,  // Each maximal invalid sequence becomes U+FFFD, as Unicode recommends
+    kDrop,
+  };
+
+  // What readers do to the text of fields (see SanitizeUtf8()). The default leaves every byte as
+  //  it is, and costs nothing.
+  struct Utf8Policy {
+    // Drops control characters other than '\n': C0 (including '\t' and '\r'), DEL and C1
+    //  (U+0080 to U+009F), any of which a terminal may take for part of an escape sequence
+    bool strip_control_characters = false;
+    InvalidUtf8 invalid = InvalidUtf8::kKeep;
+    // false drops every byte outside ASCII, as datafilter.py used to
+    bool keep_multibyte = true;
+
+    // Whether the policy can change any text at all
+    bool ChangesText() const;
+  };
+
+  // Checks text for invalid UTF-8, control characters and non-ASCII bytes in one pass, 32 (AVX2)
+  //  or 16 (SSE2) bytes at a time, picking the widest level the processor supports like
+  //  StructuralScanner. At the AVX2 level, UTF-8 is validated with the lookup tables of
+  //  Keiser and Lemire (simdutf); the SSE2 level skips runs of ASCII and decodes the rest.
+  class Utf8Validator {
+   public:
+    // Flags Check() returns
+    static constexpr uint32_t kInvalid = 1;    // Bytes that aren't valid UTF-8
+    static constexpr uint32_t kControl = 2;    // Control characters, as strip_control_characters means them
+    static constexpr uint32_t kMultibyte = 4;  // Bytes outside ASCII, valid or not
+
+    Utf8Validator();
+    // Falls back to narrower levels the processor doesn't support
+    explicit Utf8Validator(ScanLevel level);
+
+    uint32_t Check(std::string_view text) const {
+      return check_(text.data(), text.size());
+    }
+    bool IsValid(std::string_view text) const {
+      return (Check(text) & kInvalid) == 0;
+    }
+    // Whether SanitizeUtf8() would leave text as it is
+    bool IsClean(std::string_view text, const Utf8Policy& policy) const;
+    ScanLevel GetLevel() const;
+
+   private:
+    ScanLevel level_;
+    uint32_t (*check_)(const char* text, std::size_t size);
+  };
+
+  // Appends text to out, less what policy drops and with what it replaces replaced
+  void SanitizeUtf8(std::string_view text, const Utf8Policy& policy, std::string& out);
+
+}
+#endif
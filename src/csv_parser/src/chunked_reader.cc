@@ -0,0 +1,177 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#include "csv_parser.h"
+#include "structural_scanner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <thread>
+
+namespace {
+
+constexpr std::size_t kBlockSize = csv::StructuralScanner::kBlockSize;
+
+// Masks of the block at block_offset in contents, which may be the last, partial block
+csv::StructuralMasks ScanBlockAt(const csv::StructuralScanner& scanner, std::string_view contents, std::size_t block_offset) {
+  std::size_t length = contents.size() - block_offset;
+  if (length >= kBlockSize) {
+    return scanner.Scan(contents.data() + block_offset);
+  }
+  char tail[kBlockSize] = {};
+  std::memcpy(tail, contents.data() + block_offset, length);
+  csv::StructuralMasks masks = scanner.Scan(tail);
+  uint64_t in_file = (static_cast<uint64_t>(1) << length) - 1;
+  masks.delimiters &= in_file;
+  masks.quotes &= in_file;
+  return masks;
+}
+
+// Bits of the block at block_offset that stand for characters in [first, last)
+uint64_t RangeMask(std::size_t block_offset, std::size_t first, std::size_t last) {
+  uint64_t mask = ~static_cast<uint64_t>(0);
+  if (first > block_offset) {
+    mask <<= first - block_offset;
+  }
+  if (last < block_offset + kBlockSize) {
+    mask &= (static_cast<uint64_t>(1) << (last - block_offset)) - 1;
+  }
+  return mask;
+}
+
+// 1 if there is an odd number of quotes in [first, last)
+uint64_t QuoteParity(const csv::StructuralScanner& scanner, std::string_view contents, std::size_t first, std::size_t last) {
+  uint64_t parity = 0;
+  for (std::size_t block_offset = first / kBlockSize * kBlockSize; block_offset < last; block_offset += kBlockSize) {
+    uint64_t quotes = ScanBlockAt(scanner, contents, block_offset).quotes & RangeMask(block_offset, first, last);
+    parity ^= static_cast<uint64_t>(csv::PopCount(quotes)) & 1;
+  }
+  return parity;
+}
+
+// Where the first row at or after first starts: just past a '\n' outside quotes, where first
+//  is inside quotes if inside is 1. The end of contents if there is none.
+std::size_t FindRowStart(const csv::StructuralScanner& scanner, std::string_view contents, std::size_t first, uint64_t inside) {
+  const std::size_t size = contents.size();
+  for (std::size_t block_offset = first / kBlockSize * kBlockSize; block_offset < size; block_offset += kBlockSize) {
+    csv::StructuralMasks masks = ScanBlockAt(scanner, contents, block_offset);
+    uint64_t range = RangeMask(block_offset, first, size);
+    uint64_t quoted = scanner.PrefixXor(masks.quotes & range) ^ (0 - inside);
+    for (uint64_t delimiters = masks.delimiters & range & ~quoted; delimiters != 0; delimiters &= delimiters - 1) {
+      std::size_t offset = block_offset + static_cast<std::size_t>(csv::CountTrailingZeros(delimiters));
+      if (contents[offset] == '\n') {
+        return offset + 1;
+      }
+    }
+    inside = quoted >> (kBlockSize - 1);
+  }
+  return size;
+}
+
+// Calls work(i) for i in [0, count), each on its own thread (0 on this one), and rethrows the
+//  first exception one of them threw
+template <typename Work>
+void RunOnThreads(std::size_t count, const Work& work) {
+  std::vector<std::exception_ptr> errors(count);
+  auto run = [&](std::size_t i) {
+    try {
+      work(i);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < count; i++) {
+    threads.emplace_back(run, i);
+  }
+  run(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (const std::exception_ptr& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+}
+
+namespace csv {
+
+bool ReadChunks(const std::string& filename, std::size_t begin, std::size_t chunk_count, const ChunkVisitor& visit,
+                const std::function<void(std::size_t chunk)>& discard, char escape_character, const Utf8Policy& utf8_policy) {
+  MappedReader reader(escape_character);
+  if (!reader.Open(filename)) {
+    return false;
+  }
+  reader.SetUtf8Policy(utf8_policy);
+  const std::string_view contents = reader.GetContents();
+  const StructuralScanner scanner(escape_character);
+  chunk_count = std::max<std::size_t>(chunk_count, 1);
+  begin = std::min(begin, contents.size());
+
+  // Even split points, then the quote count of each range, in parallel, which is all it takes
+  //  to tell whether a split point is inside quotes
+  std::vector<std::size_t> splits(chunk_count + 1);
+  for (std::size_t chunk = 0; chunk <= chunk_count; chunk++) {
+    splits[chunk] = begin + (contents.size() - begin) / chunk_count * chunk;
+  }
+  splits[chunk_count] = contents.size();
+  std::vector<uint64_t> parities(chunk_count);
+  RunOnThreads(chunk_count, [&](std::size_t chunk) {
+    parities[chunk] = QuoteParity(scanner, contents, splits[chunk], splits[chunk + 1]);
+  });
+  std::vector<std::size_t> starts(chunk_count + 1);
+  starts[0] = begin;
+  starts[chunk_count] = contents.size();
+  uint64_t inside = 0;
+  for (std::size_t chunk = 1; chunk < chunk_count; chunk++) {
+    inside ^= parities[chunk - 1];
+    starts[chunk] = std::max(starts[chunk - 1], FindRowStart(scanner, contents, splits[chunk], inside));
+  }
+
+  // Each chunk reads the rows that start before the next chunk's start, so it ends on the first
+  //  row start at or after it
+  std::vector<std::size_t> ends(chunk_count);
+  std::vector<char> stopped(chunk_count, false);
+  RunOnThreads(chunk_count, [&](std::size_t chunk) {
+    MappedReader chunk_reader(escape_character);
+    chunk_reader.OpenBuffer(contents);
+    chunk_reader.SetUtf8Policy(utf8_policy);
+    chunk_reader.Seek(starts[chunk]);
+    std::vector<std::string_view> fields;
+    std::size_t row_start = starts[chunk];
+    while (row_start < starts[chunk + 1] && chunk_reader.ReadRow(fields)) {
+      if (!visit(chunk, fields, row_start)) {
+        stopped[chunk] = true;
+        break;
+      }
+      row_start = chunk_reader.GetPosition();
+    }
+    ends[chunk] = chunk_reader.GetPosition();
+  });
+
+  for (std::size_t chunk = 1; chunk < chunk_count; chunk++) {
+    if (stopped[chunk - 1]) {
+      break;
+    }
+    if (ends[chunk - 1] != starts[chunk]) {
+      // Guessed wrong (see docs.md), so everything from the last row known to be right on is read
+      //  again here
+      discard(chunk);
+      reader.Seek(ends[chunk - 1]);
+      std::vector<std::string_view> fields;
+      std::size_t row_start = ends[chunk - 1];
+      while (reader.ReadRow(fields) && visit(chunk, fields, row_start)) {
+        row_start = reader.GetPosition();
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,348 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#include "decompressing_source.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#if defined(CSV_PARSER_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(CSV_PARSER_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace {
+
+// Compressed bytes read from the file at a time
+constexpr std::size_t kInputSize = 1 << 18;
+
+// Turns a file into its decompressed bytes, a buffer at a time
+class Decoder {
+ public:
+  explicit Decoder(std::FILE* file) : file_(file) {}
+  virtual ~Decoder() {
+    std::fclose(file_);
+  }
+  Decoder(const Decoder& other) = delete;
+  Decoder& operator=(const Decoder& other) = delete;
+
+  // Fills up to size bytes of out and returns how many; fewer only at the end of the data, or
+  //  once error is set
+  virtual std::size_t Decode(char* out, std::size_t size) = 0;
+
+  // Empty unless the data was cut off, corrupt or couldn't be read
+  std::string error;
+
+ protected:
+  // Reads up to size bytes of the file. Sets error if reading fails.
+  std::size_t ReadInput_(void* buffer, std::size_t size) {
+    std::size_t read = std::fread(buffer, 1, size, file_);
+    if (read == 0 && std::ferror(file_)) {
+      error = "read error";
+    }
+    return read;
+  }
+
+ private:
+  std::FILE* file_;
+};
+
+class PlainDecoder : public Decoder {
+ public:
+  using Decoder::Decoder;
+
+  std::size_t Decode(char* out, std::size_t size) override {
+    std::size_t filled = 0;
+    while (filled < size) {
+      std::size_t read = ReadInput_(out + filled, size - filled);
+      if (read == 0) {
+        break;
+      }
+      filled += read;
+    }
+    return filled;
+  }
+};
+
+#if defined(CSV_PARSER_ZLIB)
+// Reads every member of a gzip file one after another, as gzip -d does
+class GzipDecoder : public Decoder {
+ public:
+  explicit GzipDecoder(std::FILE* file) : Decoder(file), input_(kInputSize), input_done_(false), member_open_(false), done_(false) {
+    std::memset(&stream_, 0, sizeof(stream_));
+    // 16 + the largest window: gzip headers only
+    if (inflateInit2(&stream_, 16 + MAX_WBITS) != Z_OK) {
+      error = "zlib initialization failed";
+      done_ = true;
+    }
+  }
+  ~GzipDecoder() override {
+    inflateEnd(&stream_);
+  }
+
+  std::size_t Decode(char* out, std::size_t size) override {
+    stream_.next_out = reinterpret_cast<Bytef*>(out);
+    // zlib counts in uInt, which blocks are far below
+    stream_.avail_out = static_cast<uInt>(size);
+    const uInt out_size = stream_.avail_out;
+    while (stream_.avail_out > 0 && !done_) {
+      if (stream_.avail_in == 0 && !input_done_) {
+        std::size_t read = ReadInput_(input_.data(), input_.size());
+        input_done_ = read == 0;
+        stream_.next_in = input_.data();
+        stream_.avail_in = static_cast<uInt>(read);
+      }
+      if (stream_.avail_in > 0) member_open_ = true;
+      const uInt avail_out_before = stream_.avail_out;
+      int status = inflate(&stream_, Z_NO_FLUSH);
+      if (status == Z_STREAM_END) {
+        member_open_ = false;
+        inflateReset(&stream_);
+        continue;
+      }
+      if (status != Z_OK && status != Z_BUF_ERROR) {
+        error = std::string("corrupt gzip data") + (stream_.msg != nullptr ? std::string(": ") + stream_.msg : std::string());
+        done_ = true;
+        break;
+      }
+      // No input left and nothing more comes out
+      if (input_done_ && stream_.avail_in == 0 && stream_.avail_out == avail_out_before) {
+        if (member_open_ && error.empty()) error = "gzip data is cut off";
+        done_ = true;
+      }
+    }
+    return out_size - stream_.avail_out;
+  }
+
+ private:
+  z_stream stream_;
+  std::vector<Bytef> input_;
+  bool input_done_;
+  // Whether a member has started and not ended
+  bool member_open_;
+  bool done_;
+};
+#endif
+
+#if defined(CSV_PARSER_ZSTD)
+// Reads every frame of a zstd file one after another
+class ZstdDecoder : public Decoder {
+ public:
+  explicit ZstdDecoder(std::FILE* file)
+      : Decoder(file), stream_(ZSTD_createDStream()), input_(ZSTD_DStreamInSize()), in_{input_.data(), 0, 0},
+        input_done_(false), frame_open_(false), done_(false) {
+    if (stream_ == nullptr || ZSTD_isError(ZSTD_initDStream(stream_))) {
+      error = "zstd initialization failed";
+      done_ = true;
+    }
+  }
+  ~ZstdDecoder() override {
+    ZSTD_freeDStream(stream_);
+  }
+
+  std::size_t Decode(char* out, std::size_t size) override {
+    ZSTD_outBuffer out_buffer = {out, size, 0};
+    while (out_buffer.pos < out_buffer.size && !done_) {
+      if (in_.pos == in_.size && !input_done_) {
+        std::size_t read = ReadInput_(input_.data(), input_.size());
+        input_done_ = read == 0;
+        in_.size = read;
+        in_.pos = 0;
+      }
+      const std::size_t pos_before = out_buffer.pos;
+      std::size_t result = ZSTD_decompressStream(stream_, &out_buffer, &in_);
+      if (ZSTD_isError(result)) {
+        error = std::string("corrupt zstd data: ") + ZSTD_getErrorName(result);
+        done_ = true;
+        break;
+      }
+      // 0 once a frame is done and flushed
+      frame_open_ = result != 0;
+      if (input_done_ && in_.pos == in_.size && out_buffer.pos == pos_before) {
+        if (frame_open_ && error.empty()) error = "zstd data is cut off";
+        done_ = true;
+      }
+    }
+    return out_buffer.pos;
+  }
+
+ private:
+  ZSTD_DStream* stream_;
+  std::vector<char> input_;
+  ZSTD_inBuffer in_;
+  bool input_done_;
+  bool frame_open_;
+  bool done_;
+};
+#endif
+
+}
+
+namespace csv {
+
+Compression DetectCompression(std::string_view first_bytes) {
+  if (first_bytes.size() >= 2 && first_bytes.substr(0, 2) == std::string_view("\x1F\x8B", 2)) {
+    return Compression::kGzip;
+  }
+  if (first_bytes.size() >= 4 && first_bytes.substr(0, 4) == std::string_view("\x28\xB5\x2F\xFD", 4)) {
+    return Compression::kZstd;
+  }
+  return Compression::kNone;
+}
+
+Compression DetectCompression(const std::string& filename) {
+  std::FILE* file = std::fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    return Compression::kNone;
+  }
+  char first_bytes[4];
+  std::size_t read = std::fread(first_bytes, 1, sizeof(first_bytes), file);
+  std::fclose(file);
+  return DetectCompression(std::string_view(first_bytes, read));
+}
+
+bool IsSupported(Compression compression) {
+  switch (compression) {
+    case Compression::kNone:
+      return true;
+#if defined(CSV_PARSER_ZLIB)
+    case Compression::kGzip:
+      return true;
+#endif
+#if defined(CSV_PARSER_ZSTD)
+    case Compression::kZstd:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+DecompressingSource::DecompressingSource(std::size_t block_size, std::size_t block_count)
+    : blocks_(std::max<std::size_t>(block_count, 1)), produced_(0), consumed_(0), read_offset_(0), finished_(true),
+      stopping_(false) {
+  for (Block& block : blocks_) {
+    block.data.resize(std::max<std::size_t>(block_size, 1));
+    block.size = 0;
+  }
+}
+
+DecompressingSource::~DecompressingSource() {
+  Close();
+}
+
+bool DecompressingSource::Open(const std::string& filename) {
+  Close();
+  Compression compression = DetectCompression(filename);
+  if (!IsSupported(compression)) {
+    error_ = filename + ": this build can't decompress " + (compression == Compression::kGzip ? "gzip" : "zstd");
+    return false;
+  }
+  std::FILE* file = std::fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    error_ = filename + ": can't be opened";
+    return false;
+  }
+  std::unique_ptr<Decoder> decoder;
+  switch (compression) {
+#if defined(CSV_PARSER_ZLIB)
+    case Compression::kGzip:
+      decoder = std::make_unique<GzipDecoder>(file);
+      break;
+#endif
+#if defined(CSV_PARSER_ZSTD)
+    case Compression::kZstd:
+      decoder = std::make_unique<ZstdDecoder>(file);
+      break;
+#endif
+    default:
+      decoder = std::make_unique<PlainDecoder>(file);
+      break;
+  }
+  finished_ = false;
+  // Fills free blocks in order until the data ends or Close() is called
+  thread_ = std::thread([this, decoder = std::move(decoder)]() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        freed_.wait(lock, [this] { return stopping_ || produced_ - consumed_ < blocks_.size(); });
+        if (stopping_) {
+          break;
+        }
+      }
+      // The reader doesn't touch this block until produced_ counts it
+      Block& block = blocks_[produced_ % blocks_.size()];
+      block.size = decoder->Decode(block.data.data(), block.data.size());
+      bool done = block.size < block.data.size() || !decoder->error.empty();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (block.size > 0) produced_++;
+        if (done) {
+          finished_ = true;
+          error_ = decoder->error;
+        }
+      }
+      filled_.notify_one();
+      if (done) {
+        break;
+      }
+    }
+  });
+  return true;
+}
+
+void DecompressingSource::Close() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    freed_.notify_one();
+    thread_.join();
+  }
+  produced_ = 0;
+  consumed_ = 0;
+  read_offset_ = 0;
+  finished_ = true;
+  stopping_ = false;
+  error_.clear();
+}
+
+std::size_t DecompressingSource::Read(char* buffer, std::size_t size) {
+  std::size_t copied = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (copied < size) {
+    if (consumed_ == produced_) {
+      // Whatever is here already goes back to the caller rather than waiting for more
+      if (finished_ || copied > 0) {
+        break;
+      }
+      filled_.wait(lock, [this] { return consumed_ != produced_ || finished_; });
+      continue;
+    }
+    const Block& block = blocks_[consumed_ % blocks_.size()];
+    lock.unlock();
+    std::size_t count = std::min(size - copied, block.size - read_offset_);
+    std::memcpy(buffer + copied, block.data.data() + read_offset_, count);
+    copied += count;
+    read_offset_ += count;
+    lock.lock();
+    if (read_offset_ == block.size) {
+      consumed_++;
+      read_offset_ = 0;
+      freed_.notify_one();
+    }
+  }
+  return copied;
+}
+
+std::string DecompressingSource::GetError() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return error_;
+}
+
+}
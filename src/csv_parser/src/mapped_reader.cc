@@ -0,0 +1,354 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#include "csv_parser.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+// No mmap; the file is read into memory instead
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// What an empty file reads from, as it has nothing to map
+const char kEmptyFile[1] = {'\0'};
+
+}
+
+namespace csv {
+
+MappedReader::MappedReader(char escape_character)
+    : escape_character_(escape_character), data_(nullptr), size_(0), position_(nullptr), mapping_(nullptr),
+      scanner_(escape_character), block_offset_(kNoBlock), masks_{0, 0}, field_in_scratch_(false),
+      last_row_terminated_(false) {}
+
+MappedReader::~MappedReader() {
+  Close();
+}
+
+bool MappedReader::Open(const std::string& filename) {
+  Close();
+#if defined(_WIN32)
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  size_ = static_cast<std::size_t>(file.tellg());
+  char* buffer = new char[size_ == 0 ? 1 : size_];
+  file.seekg(0);
+  file.read(buffer, static_cast<std::streamsize>(size_));
+  mapping_ = buffer;
+  if (!file) {
+    Close();
+    return false;
+  }
+  data_ = buffer;
+#else
+  int descriptor = ::open(filename.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    return false;
+  }
+  struct stat status;
+  if (::fstat(descriptor, &status) != 0) {
+    ::close(descriptor);
+    return false;
+  }
+  size_ = static_cast<std::size_t>(status.st_size);
+  if (size_ == 0) {  // mmap refuses a length of 0
+    ::close(descriptor);
+    data_ = kEmptyFile;
+    position_ = data_;
+    return true;
+  }
+  void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  // The mapping keeps the file open on its own
+  ::close(descriptor);
+  if (mapping == MAP_FAILED) {
+    size_ = 0;
+    return false;
+  }
+  // Rows are read front to back, so the kernel can read ahead aggressively
+  ::madvise(mapping, size_, MADV_SEQUENTIAL);
+  mapping_ = mapping;
+  data_ = static_cast<const char*>(mapping);
+#endif
+  position_ = data_;
+  return true;
+}
+
+void MappedReader::OpenBuffer(std::string_view contents) {
+  Close();
+  data_ = contents.empty() ? kEmptyFile : contents.data();
+  size_ = contents.size();
+  position_ = data_;
+}
+
+void MappedReader::SetUtf8Policy(const Utf8Policy& policy) {
+  utf8_policy_ = policy;
+}
+
+void MappedReader::Close() {
+  if (mapping_ != nullptr) {
+#if defined(_WIN32)
+    delete[] static_cast<char*>(mapping_);
+#else
+    ::munmap(mapping_, size_);
+#endif
+  }
+  mapping_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+  position_ = nullptr;
+  block_offset_ = kNoBlock;
+}
+
+bool MappedReader::IsOpen() const {
+  return data_ != nullptr;
+}
+
+std::size_t MappedReader::GetSize() const {
+  return size_;
+}
+
+std::size_t MappedReader::GetPosition() const {
+  return static_cast<std::size_t>(position_ - data_);
+}
+
+void MappedReader::Seek(std::size_t position) {
+  position_ = data_ + std::min(position, size_);
+}
+
+bool MappedReader::LastRowTerminated() const {
+  return last_row_terminated_;
+}
+
+std::string_view MappedReader::GetContents() const {
+  return std::string_view(data_, size_);
+}
+
+bool MappedReader::ReadRow(Row& fields) {
+  fields.clear();
+  scratch_.clear();
+  scratch_fields_.clear();
+  if (position_ == data_ + size_) {
+    last_row_terminated_ = false;
+    return false;
+  }
+  const char* row_start = position_;
+  Status status;
+  do {  // Same loop as ReadLine()
+    std::string_view field;
+    status = ReadField_(field);
+    if (field_in_scratch_) {
+      scratch_fields_.push_back({fields.size(), static_cast<std::size_t>(field.data() - scratch_.data()), field.size()});
+    }
+    fields.push_back(field);
+  } while (status != Status::kEndOfEntry && status != Status::kEndOfFile);
+  last_row_terminated_ = status == Status::kEndOfEntry;
+  for (const ScratchField& scratch_field : scratch_fields_) {
+    fields[scratch_field.index] = std::string_view(scratch_.data() + scratch_field.offset, scratch_field.length);
+  }
+  // The whole row is checked in one go, and clean rows (nearly all) are done. Unescaping only
+  //  removes ASCII characters, so the fields of a clean row are clean too.
+  if (utf8_policy_.ChangesText() &&
+      !validator_.IsClean(std::string_view(row_start, static_cast<std::size_t>(position_ - row_start)), utf8_policy_)) {
+    SanitizeFields_(fields);
+  }
+  return true;
+}
+
+void MappedReader::SanitizeFields_(Row& fields) {
+  sanitized_.clear();
+  scratch_fields_.clear();  // Reused for the fields in sanitized_
+  for (std::size_t i = 0; i < fields.size(); i++) {
+    if (!validator_.IsClean(fields[i], utf8_policy_)) {
+      std::size_t offset = sanitized_.size();
+      SanitizeUtf8(fields[i], utf8_policy_, sanitized_);
+      scratch_fields_.push_back({i, offset, sanitized_.size() - offset});
+    }
+  }
+  for (const ScratchField& sanitized_field : scratch_fields_) {
+    fields[sanitized_field.index] = std::string_view(sanitized_.data() + sanitized_field.offset, sanitized_field.length);
+  }
+}
+
+// Follows ReadField() in csv_parser.cc, a field at a time instead of a character at a time
+MappedReader::Status MappedReader::ReadField_(std::string_view& field) {
+  const char* end = data_ + size_;
+  field_in_scratch_ = false;
+  while (position_ != end && *position_ == ' ') {  // ignore leading whitespace
+    ++position_;
+  }
+  if (position_ == end) {
+    field = std::string_view();
+    return Status::kEndOfFile;
+  }
+  if (*position_ == '"') {
+    ++position_;
+    Status status;
+    if (escape_character_ == '"' && ReadQuotedFieldFast_(field, status)) {
+      return status;
+    }
+    return ReadQuotedField_(field);
+  }
+  // An empty field is one whose delimiter is right here
+  const char* delimiter = FindNext_(position_, &StructuralMasks::delimiters);
+  field = std::string_view(position_, static_cast<std::size_t>(delimiter - position_));
+  if (delimiter == end) {
+    position_ = end;
+    return Status::kEndOfFile;
+  }
+  position_ = delimiter + 1;
+  return *delimiter == ',' ? Status::kEndOfField : Status::kEndOfEntry;
+}
+
+// With '"' as the escape character, ReadLine() ends a quoted field at the first quote followed
+//  by a delimiter, reading "" as a quote on the way. When every quote in between is part of a
+//  "" pair, that is the first delimiter outside quotes, counting quotes from the opening one:
+//  the first delimiter bit left clear by PrefixXor(). Returns false, leaving position_ as it
+//  is, for fields that aren't so (or end the file), which ReadQuotedField_ reads instead.
+bool MappedReader::ReadQuotedFieldFast_(std::string_view& field, Status& status) {
+  constexpr std::size_t kBlockSize = StructuralScanner::kBlockSize;
+  const std::size_t opening = static_cast<std::size_t>(position_ - data_) - 1;
+  const char* delimiter = nullptr;
+  uint64_t inside = 0;  // All ones while the previous block ended inside quotes
+  for (std::size_t block_offset = opening / kBlockSize * kBlockSize; block_offset < size_; block_offset += kBlockSize) {
+    if (block_offset != block_offset_) LoadBlock_(block_offset);
+    uint64_t quotes = masks_.quotes;
+    uint64_t delimiters = masks_.delimiters;
+    if (block_offset < opening) {  // Only from the opening quote on
+      uint64_t from_opening = ~static_cast<uint64_t>(0) << (opening - block_offset);
+      quotes &= from_opening;
+      delimiters &= from_opening;
+    }
+    uint64_t quoted = scanner_.PrefixXor(quotes) ^ inside;
+    uint64_t outside_delimiters = delimiters & ~quoted;
+    if (outside_delimiters != 0) {
+      delimiter = data_ + block_offset + CountTrailingZeros(outside_delimiters);
+      break;
+    }
+    inside = 0 - (quoted >> (kBlockSize - 1));
+  }
+  // Text after the closing quote (a quirk of ReadLine()) makes the field go on
+  if (delimiter == nullptr || delimiter[-1] != '"') {
+    return false;
+  }
+  const char* first = position_;
+  const char* last = delimiter - 1;
+  const char* quote = static_cast<const char*>(std::memchr(first, '"', static_cast<std::size_t>(last - first)));
+  if (quote == nullptr) {
+    field = std::string_view(first, static_cast<std::size_t>(last - first));
+  } else {
+    // Unescape into scratch_, which ReadRow() rolls back with the row if this isn't a pair
+    const std::size_t scratch_start = scratch_.size();
+    while (quote != nullptr) {
+      if (quote + 1 == last || quote[1] != '"') {
+        scratch_.resize(scratch_start);
+        return false;
+      }
+      scratch_.append(first, static_cast<std::size_t>(quote + 1 - first));
+      first = quote + 2;
+      quote = static_cast<const char*>(std::memchr(first, '"', static_cast<std::size_t>(last - first)));
+    }
+    scratch_.append(first, static_cast<std::size_t>(last - first));
+    field_in_scratch_ = true;
+    field = std::string_view(scratch_.data() + scratch_start, scratch_.size() - scratch_start);
+  }
+  position_ = delimiter + 1;
+  status = *delimiter == ',' ? Status::kEndOfField : Status::kEndOfEntry;
+  return true;
+}
+
+// position_ is just past the opening quote. The field is read as runs of plain characters,
+//  split by escape sequences. As long as there is only one run, the field is a view of it.
+//  The first escape sequence copies it to scratch_, and later runs are appended there.
+MappedReader::Status MappedReader::ReadQuotedField_(std::string_view& field) {
+  const char* end = data_ + size_;
+  const char* run = position_;
+  const std::size_t scratch_start = scratch_.size();
+  Status status;
+  const char* run_end;
+  while (true) {
+    const char* special = FindNext_(position_, &StructuralMasks::quotes);
+    if (special == end) {
+      run_end = end;
+      position_ = end;
+      status = Status::kEndOfFile;
+      break;
+    }
+    if (*special != escape_character_) {  // Closing quote, when it isn't the escape character
+      run_end = special;
+      position_ = special + 1;
+      status = Status::kEndOfField;
+      break;
+    }
+    const char* escaped = special + 1;
+    if (escaped == end) {
+      run_end = special;
+      position_ = end;
+      status = Status::kEndOfFile;
+      break;
+    }
+    // With '"' as the escape character, (",) and ("\n) close the field
+    if (escape_character_ == '"' && (*escaped == ',' || *escaped == '\n')) {
+      run_end = special;
+      position_ = escaped + 1;
+      status = *escaped == ',' ? Status::kEndOfField : Status::kEndOfEntry;
+      break;
+    }
+    // Anything else is kept as it is, without the escape character
+    field_in_scratch_ = true;
+    scratch_.append(run, static_cast<std::size_t>(special - run));
+    run = escaped;
+    position_ = escaped + 1;
+  }
+  if (!field_in_scratch_) {
+    field = std::string_view(run, static_cast<std::size_t>(run_end - run));
+    return status;
+  }
+  scratch_.append(run, static_cast<std::size_t>(run_end - run));
+  field = std::string_view(scratch_.data() + scratch_start, scratch_.size() - scratch_start);
+  return status;
+}
+
+void MappedReader::LoadBlock_(std::size_t block_offset) {
+  block_offset_ = block_offset;
+  std::size_t length = size_ - block_offset;
+  if (length >= StructuralScanner::kBlockSize) {
+    masks_ = scanner_.Scan(data_ + block_offset);
+    return;
+  }
+  std::memcpy(tail_, data_ + block_offset, length);
+  masks_ = scanner_.Scan(tail_);
+  // Whatever is in the rest of tail_ isn't part of the file
+  uint64_t in_file = (static_cast<uint64_t>(1) << length) - 1;
+  masks_.delimiters &= in_file;
+  masks_.quotes &= in_file;
+}
+
+const char* MappedReader::FindNext_(const char* from, uint64_t StructuralMasks::*mask) {
+  constexpr std::size_t kBlockSize = StructuralScanner::kBlockSize;
+  const char* end = data_ + size_;
+  while (from != end) {
+    std::size_t offset = static_cast<std::size_t>(from - data_);
+    std::size_t block_offset = offset / kBlockSize * kBlockSize;
+    if (block_offset != block_offset_) LoadBlock_(block_offset);
+    uint64_t bits = (masks_.*mask) >> (offset - block_offset);
+    if (bits != 0) {
+      return from + CountTrailingZeros(bits);
+    }
+    from = data_ + std::min(block_offset + kBlockSize, size_);
+  }
+  return end;
+}
+
+}
@@ -0,0 +1,112 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#include "csv_parser.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace csv {
+
+Reader::Reader(char escape_character, std::size_t buffer_size)
+    : parser_(escape_character), file_(nullptr), buffer_(std::max<std::size_t>(buffer_size, 1)), filled_(0),
+      buffer_position_(0), source_done_(true) {}
+
+Reader::~Reader() {
+  Close();
+}
+
+bool Reader::Open(const std::string& filename) {
+  Close();
+  if (DetectCompression(filename) != Compression::kNone) {
+    if (decompressor_ == nullptr) decompressor_ = std::make_unique<DecompressingSource>();
+    if (!decompressor_->Open(filename)) {
+      return false;
+    }
+    DecompressingSource* decompressor = decompressor_.get();
+    source_ = [decompressor](char* buffer, std::size_t size) { return decompressor->Read(buffer, size); };
+    source_done_ = false;
+    return true;
+  }
+  file_ = std::fopen(filename.c_str(), "rb");
+  if (file_ == nullptr) {
+    return false;
+  }
+  std::FILE* file = file_;
+  // Rows are read out of buffer_, so the FILE's own buffer would only add a copy
+  std::setvbuf(file, nullptr, _IONBF, 0);
+  source_ = [file](char* buffer, std::size_t size) { return std::fread(buffer, 1, size, file); };
+  source_done_ = false;
+  return true;
+}
+
+void Reader::Open(std::istream& stream) {
+  Open([&stream](char* buffer, std::size_t size) {
+    stream.read(buffer, static_cast<std::streamsize>(size));
+    return static_cast<std::size_t>(stream.gcount());
+  });
+}
+
+void Reader::Open(Source source) {
+  Close();
+  source_ = std::move(source);
+  source_done_ = false;
+}
+
+void Reader::Close() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+  if (decompressor_ != nullptr) {
+    decompressor_->Close();
+  }
+  source_ = nullptr;
+  parser_.Close();
+  filled_ = 0;
+  buffer_position_ = 0;
+  source_done_ = true;
+}
+
+// A row is only taken once it ends in a '\n', or the source is done: a row that runs into the
+//  end of the buffer may go on in bytes not read yet, so it is read again after a Fill_().
+bool Reader::ReadRow(Row& fields) {
+  while (true) {
+    std::size_t row_start = parser_.GetPosition();
+    if (parser_.ReadRow(fields) && (parser_.LastRowTerminated() || source_done_)) {
+      return true;
+    }
+    if (source_done_) {
+      return false;
+    }
+    Fill_(row_start);
+  }
+}
+
+std::size_t Reader::GetPosition() const {
+  return buffer_position_ + parser_.GetPosition();
+}
+
+void Reader::SetUtf8Policy(const Utf8Policy& policy) {
+  parser_.SetUtf8Policy(policy);
+}
+
+std::string Reader::GetError() const {
+  return decompressor_ != nullptr ? decompressor_->GetError() : std::string();
+}
+
+void Reader::Fill_(std::size_t row_start) {
+  std::size_t kept = filled_ - row_start;
+  // A row taking up most of the buffer would otherwise be read again for every few bytes
+  if (kept * 2 > buffer_.size()) {
+    buffer_.resize(buffer_.size() * 2);
+  }
+  std::memmove(buffer_.data(), buffer_.data() + row_start, kept);
+  buffer_position_ += row_start;
+  std::size_t read = source_(buffer_.data() + kept, buffer_.size() - kept);
+  source_done_ = read == 0;
+  filled_ = kept + read;
+  parser_.OpenBuffer(std::string_view(buffer_.data(), filled_));
+}
+
+}
@@ -0,0 +1,125 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#include "structural_scanner.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// SSE2 and AVX2 functions are compiled for their instruction set one by one (the target
+//  attribute), so the library builds without -mavx2 and only calls them where supported
+#define CSV_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using csv::StructuralMasks;
+
+StructuralMasks ScanScalar(const char* block, char escape_character) {
+  StructuralMasks masks = {0, 0};
+  for (std::size_t i = 0; i < csv::StructuralScanner::kBlockSize; i++) {
+    char character = block[i];
+    masks.delimiters |= static_cast<uint64_t>(character == ',' || character == '\n') << i;
+    masks.quotes |= static_cast<uint64_t>(character == '"' || character == escape_character) << i;
+  }
+  return masks;
+}
+
+uint64_t PrefixXorScalar(uint64_t quotes) {
+  quotes ^= quotes << 1;
+  quotes ^= quotes << 2;
+  quotes ^= quotes << 4;
+  quotes ^= quotes << 8;
+  quotes ^= quotes << 16;
+  quotes ^= quotes << 32;
+  return quotes;
+}
+
+#if CSV_SCANNER_X86
+__attribute__((target("sse2")))
+StructuralMasks ScanSse2(const char* block, char escape_character) {
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i escape = _mm_set1_epi8(escape_character);
+  StructuralMasks masks = {0, 0};
+  for (int i = 0; i < 4; i++) {
+    __m128i characters = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+    __m128i delimiters = _mm_or_si128(_mm_cmpeq_epi8(characters, comma), _mm_cmpeq_epi8(characters, newline));
+    __m128i quotes = _mm_or_si128(_mm_cmpeq_epi8(characters, quote), _mm_cmpeq_epi8(characters, escape));
+    masks.delimiters |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(delimiters))) << (16 * i);
+    masks.quotes |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(quotes))) << (16 * i);
+  }
+  return masks;
+}
+
+__attribute__((target("avx2")))
+StructuralMasks ScanAvx2(const char* block, char escape_character) {
+  const __m256i comma = _mm256_set1_epi8(',');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i escape = _mm256_set1_epi8(escape_character);
+  StructuralMasks masks = {0, 0};
+  for (int i = 0; i < 2; i++) {
+    __m256i characters = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+    __m256i delimiters = _mm256_or_si256(_mm256_cmpeq_epi8(characters, comma), _mm256_cmpeq_epi8(characters, newline));
+    __m256i quotes = _mm256_or_si256(_mm256_cmpeq_epi8(characters, quote), _mm256_cmpeq_epi8(characters, escape));
+    masks.delimiters |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(delimiters))) << (32 * i);
+    masks.quotes |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(quotes))) << (32 * i);
+  }
+  return masks;
+}
+
+// Multiplying by all ones without carries XORs every bit into all the bits above it
+__attribute__((target("sse2,pclmul")))
+uint64_t PrefixXorClmul(uint64_t quotes) {
+  __m128i product = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(quotes)), _mm_set1_epi8(-1), 0);
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+}
+#endif
+
+}
+
+namespace csv {
+
+StructuralScanner::StructuralScanner(char escape_character) : StructuralScanner(escape_character, GetBestLevel()) {}
+
+StructuralScanner::StructuralScanner(char escape_character, ScanLevel level)
+    : escape_character_(escape_character), level_(level), scan_(ScanScalar), prefix_xor_(PrefixXorScalar) {
+  while (!IsSupported(level_)) {
+    level_ = static_cast<ScanLevel>(static_cast<int>(level_) - 1);
+  }
+#if CSV_SCANNER_X86
+  if (level_ == ScanLevel::kSse2) scan_ = ScanSse2;
+  if (level_ == ScanLevel::kAvx2) scan_ = ScanAvx2;
+  if (level_ != ScanLevel::kScalar && __builtin_cpu_supports("pclmul")) prefix_xor_ = PrefixXorClmul;
+#endif
+}
+
+ScanLevel StructuralScanner::GetLevel() const {
+  return level_;
+}
+
+bool StructuralScanner::IsSupported(ScanLevel level) {
+  switch (level) {
+    case ScanLevel::kScalar:
+      return true;
+#if CSV_SCANNER_X86
+    case ScanLevel::kSse2:
+      return __builtin_cpu_supports("sse2");
+    case ScanLevel::kAvx2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+ScanLevel StructuralScanner::GetBestLevel() {
+  ScanLevel level = ScanLevel::kAvx2;
+  while (!IsSupported(level)) {
+    level = static_cast<ScanLevel>(static_cast<int>(level) - 1);
+  }
+  return level;
+}
+
+}
@@ -0,0 +1,330 @@
+// See LICENSE.txt in project root
+// SPDX-License-Identifier: MIT
+
+#include "utf8_validator.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// Compiled for SSE2 and AVX2 function by function, as in structural_scanner.cc
+#define CSV_UTF8_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using csv::Utf8Validator;
+
+// Length of the character starting at text, sets valid. For bytes that don't start a valid
+//  character, the length of the maximal subpart: the lead byte and the continuation bytes that
+//  fit it before the first that doesn't (at least 1).
+std::size_t DecodeCharacter(const unsigned char* text, std::size_t size, bool& valid) {
+  const unsigned char lead = text[0];
+  valid = true;
+  if (lead < 0x80) {
+    return 1;
+  }
+  std::size_t length;
+  // Range of the second byte, which rules out overlong forms, surrogates and code points past
+  //  U+10FFFF. The others are 0x80 to 0xBF.
+  unsigned char low = 0x80, high = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    if (lead == 0xE0) low = 0xA0;
+    if (lead == 0xED) high = 0x9F;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    if (lead == 0xF0) low = 0x90;
+    if (lead == 0xF4) high = 0x8F;
+  } else {
+    valid = false;
+    return 1;
+  }
+  for (std::size_t i = 1; i < length; i++) {
+    if (i == size || text[i] < low || text[i] > high) {
+      valid = false;
+      return i;
+    }
+    low = 0x80;
+    high = 0xBF;
+  }
+  return length;
+}
+
+bool IsAsciiControl(unsigned char character) {
+  return (character < 0x20 && character != '\n') || character == 0x7F;
+}
+
+// U+0080 to U+009F, given a valid character
+bool IsC1Control(const unsigned char* character, std::size_t length) {
+  return length == 2 && character[0] == 0xC2 && character[1] < 0xA0;
+}
+
+// Adds the flags of the character at text to found and returns its length
+std::size_t CheckCharacter(const unsigned char* text, std::size_t size, uint32_t& found) {
+  if (text[0] < 0x80) {
+    if (IsAsciiControl(text[0])) found |= Utf8Validator::kControl;
+    return 1;
+  }
+  found |= Utf8Validator::kMultibyte;
+  bool valid;
+  std::size_t length = DecodeCharacter(text, size, valid);
+  if (!valid) {
+    found |= Utf8Validator::kInvalid;
+  } else if (IsC1Control(text, length)) {
+    found |= Utf8Validator::kControl;
+  }
+  return length;
+}
+
+uint32_t CheckScalar(const char* text, std::size_t size) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+  uint32_t found = 0;
+  for (std::size_t i = 0; i < size;) {
+    i += CheckCharacter(bytes + i, size - i, found);
+  }
+  return found;
+}
+
+#if CSV_UTF8_X86
+// Blocks of 16 ASCII characters are only checked for control characters. A block with other
+//  bytes is decoded a character at a time, up to the first character boundary past its end.
+__attribute__((target("sse2")))
+uint32_t CheckSse2(const char* text, std::size_t size) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+  const __m128i space = _mm_set1_epi8(0x20);
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i del = _mm_set1_epi8(0x7F);
+  uint32_t found = 0;
+  std::size_t i = 0;
+  while (i + 16 <= size) {
+    __m128i characters = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    if (_mm_movemask_epi8(characters) != 0) {
+      for (std::size_t block_end = i + 16; i < block_end;) {
+        i += CheckCharacter(bytes + i, size - i, found);
+      }
+      continue;
+    }
+    // All below 0x80, so the signed comparison is right
+    __m128i controls = _mm_andnot_si128(_mm_cmpeq_epi8(characters, newline), _mm_cmplt_epi8(characters, space));
+    controls = _mm_or_si128(controls, _mm_cmpeq_epi8(characters, del));
+    if (_mm_movemask_epi8(controls) != 0) found |= Utf8Validator::kControl;
+    i += 16;
+  }
+  while (i < size) {
+    i += CheckCharacter(bytes + i, size - i, found);
+  }
+  return found;
+}
+
+// Keiser and Lemire's "lookup" algorithm (Validating UTF-8 In Less Than One Instruction Per
+//  Byte, 2021). Each error a byte and the byte before it can make has a bit, and three table
+//  lookups, by the high and low nibble of the byte before and the high nibble of the byte,
+//  return the bits each nibble allows. A bit set in all three is an error. Third and fourth
+//  bytes of a character, which look like two continuation bytes in a row, are told apart from
+//  errors by the bytes 2 and 3 back.
+constexpr uint8_t kTooShort = 1 << 0;    // 11______ 0_______ or 11______ 11______
+constexpr uint8_t kTooLong = 1 << 1;     // 0_______ 10______
+constexpr uint8_t kOverlong3 = 1 << 2;   // 11100000 100_____
+constexpr uint8_t kTooLarge = 1 << 3;    // 11110100 1001____ and above
+constexpr uint8_t kSurrogate = 1 << 4;   // 11101101 101_____
+constexpr uint8_t kOverlong2 = 1 << 5;   // 1100000_ 10______
+constexpr uint8_t kTooLarge1000 = 1 << 6;  // 11110101 1000____ and above
+constexpr uint8_t kOverlong4 = 1 << 6;   // 11110000 1000____
+constexpr uint8_t kTwoContinuations = 1 << 7;  // 10______ 10______
+constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoContinuations;
+
+// By the high nibble of the byte before
+alignas(16) constexpr uint8_t kByte1High[16] = {
+    kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,  // ASCII
+    kTwoContinuations, kTwoContinuations, kTwoContinuations, kTwoContinuations,      // Continuation
+    kTooShort | kOverlong2,                                                          // 1100
+    kTooShort,                                                                       // 1101
+    kTooShort | kOverlong3 | kSurrogate,                                             // 1110
+    kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,                              // 1111
+};
+// By the low nibble of the byte before
+alignas(16) constexpr uint8_t kByte1Low[16] = {
+    kCarry | kOverlong3 | kOverlong2 | kOverlong4,  // 0000
+    kCarry | kOverlong2,                            // 0001
+    kCarry,
+    kCarry,
+    kCarry | kTooLarge,                             // 0100
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000 | kSurrogate,  // 1101
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+};
+// By the high nibble of the byte
+alignas(16) constexpr uint8_t kByte2High[16] = {
+    kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,  // ASCII
+    kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge1000 | kOverlong4,     // 1000
+    kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge,                      // 1001
+    kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,                      // 1010
+    kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,                      // 1011
+    kTooShort, kTooShort, kTooShort, kTooShort,                                              // Lead
+};
+// A block ending in these is cut off in the middle of a character: 1111____ 3 bytes from the
+//  end, 111_____ 2 bytes from the end or 11______ at the end
+alignas(32) constexpr uint8_t kIncompleteBelow[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+struct Avx2Tables {
+  __m256i byte_1_high, byte_1_low, byte_2_high, low_nibble, incomplete_below;
+};
+
+// Bytes N back from each byte of input, taking the first from the end of previous
+template <int N>
+__attribute__((target("avx2"))) inline __m256i BytesBack(const __m256i& input, const __m256i& previous) {
+  return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(previous, input, 0x21), 16 - N);
+}
+
+// Checks the 32 bytes of input, the ones past in_range being padding, given the block before
+//  them. error collects the bits of UTF-8 errors; incomplete is set if input ends mid character.
+__attribute__((target("avx2")))
+inline void CheckBlockAvx2(const Avx2Tables& tables, const __m256i& input, const __m256i& previous, uint32_t in_range,
+                           __m256i& error, __m256i& incomplete, uint32_t& found) {
+  uint32_t multibyte = static_cast<uint32_t>(_mm256_movemask_epi8(input));
+  if (multibyte == 0) {
+    // An ASCII block can only be an error by cutting off the character before it
+    error = _mm256_or_si256(error, incomplete);
+    // All below 0x80, so the signed comparison is right
+    __m256i controls = _mm256_andnot_si256(_mm256_cmpeq_epi8(input, _mm256_set1_epi8('\n')),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), input));
+    controls = _mm256_or_si256(controls, _mm256_cmpeq_epi8(input, _mm256_set1_epi8(0x7F)));
+    if ((static_cast<uint32_t>(_mm256_movemask_epi8(controls)) & in_range) != 0) found |= Utf8Validator::kControl;
+    return;
+  }
+  found |= Utf8Validator::kMultibyte;
+  const __m256i previous_1 = BytesBack<1>(input, previous);
+  __m256i special_cases = _mm256_and_si256(
+      _mm256_and_si256(_mm256_shuffle_epi8(tables.byte_1_high, _mm256_and_si256(_mm256_srli_epi16(previous_1, 4), tables.low_nibble)),
+                       _mm256_shuffle_epi8(tables.byte_1_low, _mm256_and_si256(previous_1, tables.low_nibble))),
+      _mm256_shuffle_epi8(tables.byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), tables.low_nibble)));
+  // 0x80 and up where the byte 2 back starts a 3 or 4 byte character, or the byte 3 back a 4
+  //  byte one, so the byte must be its third or fourth
+  __m256i third = _mm256_subs_epu8(BytesBack<2>(input, previous), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+  __m256i fourth = _mm256_subs_epu8(BytesBack<3>(input, previous), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+  __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+  error = _mm256_or_si256(error, _mm256_xor_si256(must_continue, special_cases));
+  incomplete = _mm256_subs_epu8(input, tables.incomplete_below);
+
+  __m256i controls = _mm256_and_si256(_mm256_cmpgt_epi8(input, _mm256_set1_epi8(-1)),
+                                      _mm256_andnot_si256(_mm256_cmpeq_epi8(input, _mm256_set1_epi8('\n')),
+                                                          _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), input)));
+  controls = _mm256_or_si256(controls, _mm256_cmpeq_epi8(input, _mm256_set1_epi8(0x7F)));
+  // C1: 0xC2 then 0x80 to 0x9F, which are the bytes below 0xA0 taken as signed
+  controls = _mm256_or_si256(controls, _mm256_and_si256(_mm256_cmpeq_epi8(previous_1, _mm256_set1_epi8(static_cast<char>(0xC2))),
+                                                        _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0xA0)), input)));
+  if ((static_cast<uint32_t>(_mm256_movemask_epi8(controls)) & in_range) != 0) found |= Utf8Validator::kControl;
+}
+
+__attribute__((target("avx2")))
+uint32_t CheckAvx2(const char* text, std::size_t size) {
+  Avx2Tables tables;
+  tables.byte_1_high = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kByte1High)));
+  tables.byte_1_low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kByte1Low)));
+  tables.byte_2_high = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kByte2High)));
+  tables.low_nibble = _mm256_set1_epi8(0x0F);
+  tables.incomplete_below = _mm256_load_si256(reinterpret_cast<const __m256i*>(kIncompleteBelow));
+  __m256i error = _mm256_setzero_si256();
+  __m256i incomplete = _mm256_setzero_si256();
+  __m256i previous = _mm256_setzero_si256();
+  uint32_t found = 0;
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+    CheckBlockAvx2(tables, input, previous, ~static_cast<uint32_t>(0), error, incomplete, found);
+    previous = input;
+  }
+  if (i < size) {
+    // Padded with ASCII zeros, which end any character still open as too short
+    alignas(32) char tail[32] = {};
+    std::memcpy(tail, text + i, size - i);
+    __m256i input = _mm256_load_si256(reinterpret_cast<const __m256i*>(tail));
+    CheckBlockAvx2(tables, input, previous, (static_cast<uint32_t>(1) << (size - i)) - 1, error, incomplete, found);
+  }
+  error = _mm256_or_si256(error, incomplete);
+  if (!_mm256_testz_si256(error, error)) found |= Utf8Validator::kInvalid;
+  return found;
+}
+#endif
+
+}
+
+namespace csv {
+
+bool Utf8Policy::ChangesText() const {
+  return strip_control_characters || invalid != InvalidUtf8::kKeep || !keep_multibyte;
+}
+
+Utf8Validator::Utf8Validator() : Utf8Validator(StructuralScanner::GetBestLevel()) {}
+
+Utf8Validator::Utf8Validator(ScanLevel level) : level_(level), check_(CheckScalar) {
+  while (!StructuralScanner::IsSupported(level_)) {
+    level_ = static_cast<ScanLevel>(static_cast<int>(level_) - 1);
+  }
+#if CSV_UTF8_X86
+  if (level_ == ScanLevel::kSse2) check_ = CheckSse2;
+  if (level_ == ScanLevel::kAvx2) check_ = CheckAvx2;
+#endif
+}
+
+bool Utf8Validator::IsClean(std::string_view text, const Utf8Policy& policy) const {
+  if (!policy.ChangesText()) {
+    return true;
+  }
+  uint32_t found = Check(text);
+  return !((policy.strip_control_characters && (found & kControl) != 0) ||
+           (policy.invalid != InvalidUtf8::kKeep && (found & kInvalid) != 0) ||
+           (!policy.keep_multibyte && (found & kMultibyte) != 0));
+}
+
+ScanLevel Utf8Validator::GetLevel() const {
+  return level_;
+}
+
+void SanitizeUtf8(std::string_view text, const Utf8Policy& policy, std::string& out) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+  const std::size_t size = text.size();
+  std::size_t i = 0;
+  while (i < size) {
+    // Runs of characters that are kept are appended in one go
+    std::size_t run = i;
+    while (i < size && bytes[i] < 0x80 && !(policy.strip_control_characters && IsAsciiControl(bytes[i]))) {
+      i++;
+    }
+    out.append(text.data() + run, i - run);
+    if (i == size) {
+      break;
+    }
+    if (bytes[i] < 0x80) {  // A control character to strip
+      i++;
+      continue;
+    }
+    bool valid;
+    std::size_t length = DecodeCharacter(bytes + i, size - i, valid);
+    if (!policy.keep_multibyte) {
+      // Dropped, valid or not
+    } else if (!valid) {
+      if (policy.invalid == InvalidUtf8::kKeep) out.append(text.data() + i, length);
+      if (policy.invalid == InvalidUtf8::kReplace) out.append("\xEF\xBF\xBD");
+    } else if (!(policy.strip_control_characters && IsC1Control(bytes + i, length))) {
+      out.append(text.data() + i, length);
+    }
+    i += length;
+  }
+}
+
+}
@@ -0,0 +1,14 @@
+#ifndef CSV_PARSER_TEST_H
+#define CSV_PARSER_TEST_H
+
+namespace csv_parser_test {
+  void MappedReaderTest();
+  void ScannerTest();
+  void ParallelReadTest();
+  void StreamingReaderTest();
+  void Utf8Test();
+  void CompressedInputTest();
+  void TestAll();
+}
+
+#endif // !CSV_PARSER_TEST_H
@@ -0,0 +1,137 @@
+#include "csv_parser.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+
+// Checks that reading rows allocates nothing once the readers' buffers have grown to fit.
+//  Replaces the global operator new to count allocations, which is why it is an executable of
+//  its own rather than part of csv_parser_test::TestAll().
+// Usage: csv_parser_allocation_test
+
+namespace {
+std::size_t allocation_count = 0;
+}
+
+void* operator new(std::size_t size) {
+  allocation_count++;
+  if (void* memory = std::malloc(size == 0 ? 1 : size)) return memory;
+  throw std::bad_alloc();
+}
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+void operator delete(void* memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+namespace {
+
+std::string Pass() {
+  return " -- PASSED\n";
+}
+
+// Rows of every kind: plain, empty, quoted, and quoted with "" (unescaped into scratch space)
+std::string TestCsv(std::size_t row_count) {
+  std::string contents;
+  for (std::size_t i = 0; i < row_count; i++) {
+    contents += std::to_string(i) + ",plain field,,\"quoted, with comma\",\"has \"\"escapes\"\"\",  spaced";
+    contents += i % 7 == 0 ? ",\"multi\nline\"\n" : "\n";
+  }
+  return contents;
+}
+
+// Reads warm_up rows (which may grow buffers), then counts allocations over the rest
+template <typename RowReader>
+std::size_t AllocationsAfterWarmUp(RowReader& reader, std::size_t warm_up, std::size_t& rows) {
+  csv::Row row;
+  rows = 0;
+  for (; rows < warm_up && reader.ReadRow(row); rows++) {
+  }
+  std::size_t before = allocation_count;
+  while (reader.ReadRow(row)) rows++;
+  return allocation_count - before;
+}
+
+void MappedReaderAllocationTest(const std::string& path) {
+  std::cout << "MappedReaderAllocationTest";
+  csv::MappedReader reader;
+  assert(reader.Open(path));
+  std::size_t rows;
+  assert(AllocationsAfterWarmUp(reader, 100, rows) == 0 && rows == 20000);
+  std::cout << Pass();
+}
+
+// The buffer is refilled about 500 times, with rows cut at its end
+void ReaderAllocationTest(const std::string& path) {
+  std::cout << "ReaderAllocationTest";
+  csv::Reader reader('"', 4096);
+  assert(reader.Open(path));
+  std::size_t rows;
+  assert(AllocationsAfterWarmUp(reader, 100, rows) == 0 && rows == 20000);
+  std::ifstream file(path, std::ios::binary);
+  reader.Open(file);
+  assert(AllocationsAfterWarmUp(reader, 100, rows) == 0 && rows == 20000);
+  std::cout << Pass();
+}
+
+// Every other row has control characters and invalid bytes to sanitize
+void SanitizedReadAllocationTest() {
+  std::cout << "SanitizedReadAllocationTest";
+  std::string contents = TestCsv(20000);
+  std::string dirty;
+  for (std::size_t start = 0, row = 0; start < contents.size(); row++) {
+    std::size_t end = contents.find('\n', start) + 1;
+    dirty.append(contents, start, end - start - 1);
+    dirty += row % 2 == 0 ? ",\"Caf\xC3\xA9 \x1B[1mbold\x1B[0m \xFF\"\n" : ",Home D\xC3\xA9" "cor\n";
+    start = end;
+  }
+  std::string path = (std::filesystem::temp_directory_path() / "csv_parser_allocation_test_utf8.csv").string();
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << dirty;
+  csv::Utf8Policy policy;
+  policy.strip_control_characters = true;
+  policy.invalid = csv::InvalidUtf8::kReplace;
+  csv::MappedReader reader;
+  assert(reader.Open(path));
+  reader.SetUtf8Policy(policy);
+  std::size_t rows;
+  assert(AllocationsAfterWarmUp(reader, 100, rows) == 0);
+  std::remove(path.c_str());
+  std::cout << Pass();
+}
+
+void ForEachRowAllocationTest(const std::string& path) {
+  std::cout << "ForEachRowAllocationTest";
+  csv::Reader reader('"', 4096);
+  assert(reader.Open(path));
+  std::size_t field_count = 0, before = 0;
+  std::size_t rows = csv::ForEachRow(reader, [&](const csv::Row& row) {
+    field_count += row.size();
+    // The Row has grown by the 100th row
+    if (field_count / row.size() == 100) before = allocation_count;
+    return true;
+  });
+  assert(rows == 20000 && allocation_count == before);
+  std::cout << Pass();
+}
+
+}
+
+int main() {
+  std::cout << "----- RUNNING CSV PARSER ALLOCATION TESTS -----" << std::endl;
+  std::string path = (std::filesystem::temp_directory_path() / "csv_parser_allocation_test.csv").string();
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << TestCsv(20000);
+  MappedReaderAllocationTest(path);
+  ReaderAllocationTest(path);
+  ForEachRowAllocationTest(path);
+  SanitizedReadAllocationTest();
+  std::remove(path.c_str());
+  std::cout << "ALL CSV PARSER ALLOCATION TESTS PASSED" << std::endl;
+  return 0;
+}
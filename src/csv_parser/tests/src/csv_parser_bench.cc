@@ -0,0 +1,220 @@
+#include "csv_parser.h"
+#include "structural_scanner.h"
+#include "utf8_validator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Parsing throughput of ReadLine(), MappedReader (without and with a Utf8Policy) and Reader, of
+//  StructuralScanner and Utf8Validator at each level the processor supports, and of ReadChunks()
+//  on 1, 2, 4, ... threads. Not run at startup.
+// Usage: csv_parser_bench [file.csv]   (default: a synthetic ~100 MB file shaped like the dataset)
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// Rows like the dataset's: a hex id, plain fields, quoted fields with commas, and now and then
+//  a quoted field with "" escapes
+std::string SyntheticCsv(std::size_t target_bytes) {
+  std::string contents = "Uniq Id,Product Name,Brand Name,Asin,Category,Upc Ean Code,Selling Price,About Product\n";
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  for (std::size_t row = 0; contents.size() < target_bytes; row++) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    char id[33];
+    std::snprintf(id, sizeof(id), "%016llx%016llx", static_cast<unsigned long long>(state),
+                  static_cast<unsigned long long>(row));
+    contents += id;
+    contents += ",\"Wooden Puzzle, 48 Pieces\",,,Toys & Games | Puzzles | Jigsaw Puzzles,,$12.99,";
+    if (row % 8 == 0) {
+      contents += "\"Make sure this fits by entering your model number. | A \"\"classic\"\" for ages 3+\"\n";
+    } else {
+      contents += "\"Make sure this fits by entering your model number. | Bright colors, sturdy pieces | "
+                  "Great gift for kids and adults alike, hours of fun\"\n";
+    }
+  }
+  return contents;
+}
+
+void Report(const std::string& name, std::size_t bytes, std::size_t rows, std::size_t fields, Clock::duration time) {
+  double seconds = std::chrono::duration<double>(time).count();
+  std::cout << name << ": " << rows << " rows, " << fields << " fields in " << seconds * 1000 << " ms"
+            << " | " << static_cast<double>(bytes) / seconds / (1 << 20) << " MB/s" << std::endl;
+}
+
+void ReadLineBenchmark(const std::string& filename, std::size_t bytes) {
+  Clock::time_point start = Clock::now();
+  std::ifstream file(filename);
+  std::size_t rows = 0, fields = 0;
+  for (std::vector<std::string> row = csv::ReadLine(file); file || !row[0].empty(); row = csv::ReadLine(file)) {
+    rows++;
+    fields += row.size();
+  }
+  Report("ReadLine", bytes, rows, fields, Clock::now() - start);
+}
+
+void MappedReaderBenchmark(const std::string& filename, std::size_t bytes, const csv::Utf8Policy& policy = csv::Utf8Policy()) {
+  Clock::time_point start = Clock::now();
+  csv::MappedReader reader;
+  if (!reader.Open(filename)) {
+    std::cout << "MappedReader: can't open " << filename << std::endl;
+    return;
+  }
+  reader.SetUtf8Policy(policy);
+  std::vector<std::string_view> row;
+  std::size_t rows = 0, fields = 0;
+  while (reader.ReadRow(row)) {
+    rows++;
+    fields += row.size();
+  }
+  Report(policy.ChangesText() ? "MappedReader (sanitizing)" : "MappedReader", bytes, rows, fields, Clock::now() - start);
+}
+
+// bytes is the size of the csv, which for a compressed file is its size once decompressed
+void ReaderBenchmark(const std::string& filename, std::size_t bytes) {
+  Clock::time_point start = Clock::now();
+  csv::Reader reader;
+  if (!reader.Open(filename)) {
+    std::cout << "Reader: can't open " << filename << std::endl;
+    return;
+  }
+  std::size_t fields = 0;
+  std::size_t rows = csv::ForEachRow(reader, [&](const csv::Row& row) {
+    fields += row.size();
+    return true;
+  });
+  Report(csv::DetectCompression(filename) != csv::Compression::kNone ? "Reader (decompressing)" : "Reader", bytes, rows,
+         fields, Clock::now() - start);
+}
+
+// Decompression alone, what ReaderBenchmark() of a compressed file overlaps parsing with
+void DecompressBenchmark(const std::string& filename) {
+  Clock::time_point start = Clock::now();
+  csv::DecompressingSource source;
+  if (!source.Open(filename)) {
+    std::cout << "DecompressingSource: " << source.GetError() << std::endl;
+    return;
+  }
+  std::vector<char> buffer(csv::Reader::kDefaultBufferSize);
+  std::size_t bytes = 0, count;
+  while ((count = source.Read(buffer.data(), buffer.size())) > 0) bytes += count;
+  Report("DecompressingSource", bytes, 0, 0, Clock::now() - start);
+}
+
+// Reads the file with ReadChunks() on 1, 2, 4, ... up to hardware_concurrency() threads,
+//  copying every field into a string the way loading does
+void ChunkedReadScalingBenchmark(const std::string& filename, std::size_t bytes) {
+  std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  double one_thread_seconds = 0;
+  for (std::size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+    std::vector<std::vector<std::string>> chunk_fields(thread_count);
+    std::vector<std::size_t> chunk_rows(thread_count);
+    Clock::time_point start = Clock::now();
+    csv::ReadChunks(filename, 0, thread_count,
+        [&](std::size_t chunk, const std::vector<std::string_view>& row, std::size_t) {
+          chunk_rows[chunk]++;
+          for (std::string_view field : row) chunk_fields[chunk].emplace_back(field);
+          return true;
+        },
+        [&](std::size_t chunk) {
+          for (; chunk < thread_count; chunk++) {
+            chunk_fields[chunk].clear();
+            chunk_rows[chunk] = 0;
+          }
+        });
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (thread_count == 1) one_thread_seconds = seconds;
+    std::size_t rows = 0, fields = 0;
+    for (std::size_t chunk = 0; chunk < thread_count; chunk++) {
+      rows += chunk_rows[chunk];
+      fields += chunk_fields[chunk].size();
+    }
+    std::cout << "ReadChunks (" << thread_count << " threads): " << rows << " rows, " << fields << " fields in "
+              << seconds * 1000 << " ms | " << static_cast<double>(bytes) / seconds / (1 << 20) << " MB/s | "
+              << one_thread_seconds / seconds << "x" << std::endl;
+  }
+}
+
+// Masks for every block of contents, and from the quotes' prefix XOR the characters inside
+//  quotes, carried from block to block
+void ScanBenchmark(const std::string& contents, csv::ScanLevel level) {
+  static const char* const kLevelNames[] = {"scalar", "SSE2", "AVX2"};
+  csv::StructuralScanner scanner('"', level);
+  if (scanner.GetLevel() != level) return;
+  Clock::time_point start = Clock::now();
+  std::size_t delimiters = 0, quoted_characters = 0;
+  uint64_t inside = 0;
+  std::size_t block_count = contents.size() / csv::StructuralScanner::kBlockSize;
+  for (std::size_t i = 0; i < block_count; i++) {
+    csv::StructuralMasks masks = scanner.Scan(contents.data() + i * csv::StructuralScanner::kBlockSize);
+    delimiters += static_cast<std::size_t>(csv::PopCount(masks.delimiters));
+    uint64_t quoted = scanner.PrefixXor(masks.quotes) ^ inside;
+    quoted_characters += static_cast<std::size_t>(csv::PopCount(quoted));
+    inside = 0 - (quoted >> 63);
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "StructuralScanner (" << kLevelNames[static_cast<int>(level)] << "): " << delimiters << " delimiters in "
+            << seconds * 1000 << " ms | " << static_cast<double>(block_count * csv::StructuralScanner::kBlockSize) / seconds / (1 << 20)
+            << " MB/s" << std::endl;
+}
+}
+
+// Checks the whole file as one text
+void Utf8Benchmark(const std::string& contents, csv::ScanLevel level) {
+  static const char* const kLevelNames[] = {"scalar", "SSE2", "AVX2"};
+  csv::Utf8Validator validator(level);
+  if (validator.GetLevel() != level) return;
+  Clock::time_point start = Clock::now();
+  uint32_t found = validator.Check(contents);
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << "Utf8Validator (" << kLevelNames[static_cast<int>(level)] << "): "
+            << ((found & csv::Utf8Validator::kInvalid) != 0 ? "invalid" : "valid") << " in " << seconds * 1000 << " ms | "
+            << static_cast<double>(contents.size()) / seconds / (1 << 20) << " MB/s" << std::endl;
+}
+
+// Takes a csv file (a synthetic one by default) and, optionally, a gzip or zstd copy of it
+int main(int argc, char** argv) {
+  std::string filename;
+  bool synthetic = argc < 2;
+  if (synthetic) {
+    filename = (std::filesystem::temp_directory_path() / "csv_parser_bench.csv").string();
+    std::ofstream(filename, std::ios::binary | std::ios::trunc) << SyntheticCsv(100 << 20);
+  } else {
+    filename = argv[1];
+  }
+  std::size_t bytes = static_cast<std::size_t>(std::filesystem::file_size(filename));
+  std::cout << filename << " (" << bytes / (1 << 20) << " MB)" << std::endl;
+  // Once to get the file into the page cache, so neither run pays for the disk
+  MappedReaderBenchmark(filename, bytes);
+  ReadLineBenchmark(filename, bytes);
+  MappedReaderBenchmark(filename, bytes);
+  csv::Utf8Policy policy;
+  policy.strip_control_characters = true;
+  policy.invalid = csv::InvalidUtf8::kReplace;
+  MappedReaderBenchmark(filename, bytes, policy);
+  ReaderBenchmark(filename, bytes);
+  if (argc > 2) {
+    DecompressBenchmark(argv[2]);
+    ReaderBenchmark(argv[2], bytes);
+  }
+  ChunkedReadScalingBenchmark(filename, bytes);
+  std::stringstream contents;
+  contents << std::ifstream(filename, std::ios::binary).rdbuf();
+  for (csv::ScanLevel level : {csv::ScanLevel::kScalar, csv::ScanLevel::kSse2, csv::ScanLevel::kAvx2}) {
+    ScanBenchmark(contents.str(), level);
+  }
+  for (csv::ScanLevel level : {csv::ScanLevel::kScalar, csv::ScanLevel::kSse2, csv::ScanLevel::kAvx2}) {
+    Utf8Benchmark(contents.str(), level);
+  }
+  if (synthetic) std::remove(filename.c_str());
+  return 0;
+}
@@ -0,0 +1,852 @@
+#include "csv_parser.h"
+#include "csv_parser_test.h"
+#include "structural_scanner.h"
+#include "utf8_validator.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(CSV_PARSER_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(CSV_PARSER_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace {
+
+std::string Pass() {
+  return " -- PASSED\n";
+}
+
+// Writes contents to a file in the temporary directory and returns its path
+std::string WriteTemporaryFile(const std::string& contents) {
+  std::string path = (std::filesystem::temp_directory_path() / "csv_parser_test.csv").string();
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << contents;
+  return path;
+}
+
+// Reads contents with MappedReader and with ReadLine(), and checks both give the same rows.
+//  Past the last row ReadLine() keeps returning a single empty field, and MappedReader
+//  returns false.
+void CheckSameRows(const std::string& contents, char escape_character) {
+  std::string path = WriteTemporaryFile(contents);
+  csv::MappedReader reader(escape_character);
+  assert(reader.Open(path) && reader.GetSize() == contents.size());
+  std::istringstream stream(contents);
+  std::vector<std::string_view> fields;
+  while (reader.ReadRow(fields)) {
+    std::vector<std::string> expected = csv::ReadLine(stream, escape_character);
+    assert(fields.size() == expected.size());
+    for (std::size_t i = 0; i < fields.size(); i++) {
+      assert(fields[i] == expected[i]);
+    }
+  }
+  assert(fields.empty() && reader.GetPosition() == contents.size());
+  std::vector<std::string> after = csv::ReadLine(stream, escape_character);
+  assert(after.size() == 1 && after[0].empty());
+  std::remove(path.c_str());
+}
+
+// Random text made of the characters the parser treats specially, and a few others
+std::string RandomCsv(std::mt19937& random, std::size_t length, char escape_character) {
+  const std::string kAlphabet = std::string("ab ,\n\"\"\"") + escape_character;
+  std::uniform_int_distribution<std::size_t> pick(0, kAlphabet.size() - 1);
+  std::string contents(length, ' ');
+  for (char& character : contents) {
+    character = kAlphabet[pick(random)];
+  }
+  return contents;
+}
+
+////                        ////////////////////////////////////////////////////
+//// MAPPED READER TESTING  ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// The examples of docs.md, with both escape characters
+void DocsExamplesTest() {
+  std::cout << "DocsExamplesTest";
+  const std::vector<std::string> kExamples = {
+      "Ordinary String,Second String\n",
+      "\"Quoted String\", \"Second Quote\"\n",
+      "\"  Quoted Whitespace\",  Leading Whitespace\n",
+      "\"Escaped ^\" Special Character in Quotes\"\n",
+      "\"Escaped \"\" Special Character in Quotes\"\n",
+      "one,\" two\", \"three\"\n",
+  };
+  for (const std::string& example : kExamples) {
+    CheckSameRows(example, '"');
+    CheckSameRows(example, '^');
+  }
+  std::cout << Pass();
+}
+
+// Quoted fields with several escape sequences in one row (the unescaped copies must survive
+//  the scratch buffer growing), escaped escape characters, embedded delimiters and newlines
+void EscapeSequenceTest() {
+  std::cout << "EscapeSequenceTest";
+  std::string long_run(5000, 'x');
+  CheckSameRows("\"a \"\"b\"\" c\",\"" + long_run + "\"\"\",\"d,\ne\"\"\"\n\"\"\"\"\n", '"');
+  CheckSameRows("\"a ^\"b^\" c\",\"" + long_run + "^^\",\"d,\ne^x\"\n\"^\"\",plain^\n", '^');
+  std::string path = WriteTemporaryFile("\"1\"\"\",\"" + long_run + "\"\"\"\n");
+  csv::MappedReader reader;
+  std::vector<std::string_view> fields;
+  assert(reader.Open(path) && reader.ReadRow(fields) && fields.size() == 2);
+  assert(fields[0] == "1\"" && fields[1] == long_run + "\"");
+  std::remove(path.c_str());
+  std::cout << Pass();
+}
+
+// Rows ReadLine() handles in its own particular way: empty fields, blank lines, a missing
+//  final newline, text after a closing quote, carriage returns and fields that end the file
+//  inside quotes
+void EdgeCaseTest() {
+  std::cout << "EdgeCaseTest";
+  const std::vector<std::string> kEdgeCases = {
+      "", "\n", "a", "a,", ",", ",,\n,", "  ,  x  ,\n   ", "a\n\nb\n", "\"abc\"x,y\n",
+      "\"abc\" ,y\n", "a,b\r\nc,d\r\n", "\"unterminated", "\"ends on quote\"", "\"a\"\n\"b\"",
+      "x\"y,z\n", "\"\",\"\"\n",
+  };
+  for (const std::string& edge_case : kEdgeCases) {
+    CheckSameRows(edge_case, '"');
+    CheckSameRows(edge_case, '^');
+  }
+  std::cout << Pass();
+}
+
+void OpenTest() {
+  std::cout << "OpenTest";
+  csv::MappedReader reader;
+  std::vector<std::string_view> fields = {"left over"};
+  assert(!reader.Open("no/such/file.csv") && !reader.IsOpen());
+  assert(!reader.ReadRow(fields) && fields.empty());
+  std::string path = WriteTemporaryFile("a,b\n");
+  assert(reader.Open(path) && reader.IsOpen() && reader.ReadRow(fields) && fields.size() == 2);
+  // Opening again starts over
+  assert(reader.Open(path) && reader.GetPosition() == 0 && reader.ReadRow(fields) && fields[1] == "b");
+  reader.Close();
+  assert(!reader.IsOpen() && !reader.ReadRow(fields));
+  std::remove(path.c_str());
+  std::cout << Pass();
+}
+
+// Random mixes of delimiters, quotes and escape characters, long enough to span several
+//  scanner blocks, read the same as with ReadLine()
+void RandomInputTest() {
+  std::cout << "RandomInputTest";
+  std::mt19937 random(223);
+  for (std::size_t length : {1, 63, 64, 65, 200, 1000}) {
+    for (int i = 0; i < 50; i++) {
+      CheckSameRows(RandomCsv(random, length, '"'), '"');
+      CheckSameRows(RandomCsv(random, length, '^'), '^');
+    }
+  }
+  // Well formed quoted fields, which take the fast path, across block boundaries
+  std::string contents;
+  for (int i = 0; contents.size() < 5000; i++) {
+    contents += "\"" + std::string(static_cast<std::size_t>(i % 70), 'q') + (i % 3 == 0 ? "\"\"" : "") + "\"";
+    contents += i % 5 == 0 ? "\n" : ",";
+  }
+  CheckSameRows(contents, '"');
+  std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// STREAMING READER TESTING //////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// Reads contents with Reader, from a stream and from a file, with buffers of buffer_size bytes,
+//  and checks the rows are MappedReader's
+void CheckReaderRows(const std::string& contents, char escape_character, std::size_t buffer_size) {
+  std::string path = WriteTemporaryFile(contents);
+  csv::MappedReader mapped(escape_character);
+  assert(mapped.Open(path));
+  std::istringstream stream(contents);
+  csv::Reader stream_reader(escape_character, buffer_size);
+  stream_reader.Open(stream);
+  csv::Reader file_reader(escape_character, buffer_size);
+  assert(file_reader.Open(path));
+  csv::Row expected, from_stream, from_file;
+  bool more;
+  do {
+    more = mapped.ReadRow(expected);
+    assert(stream_reader.ReadRow(from_stream) == more && from_stream == expected);
+    assert(file_reader.ReadRow(from_file) == more && from_file == expected);
+    assert(stream_reader.GetPosition() == mapped.GetPosition() && file_reader.GetPosition() == mapped.GetPosition());
+  } while (more);
+  std::remove(path.c_str());
+}
+
+// Rows cut at every possible place by the end of the buffer, from buffers of 1 byte (which
+//  grow) up to ones that hold the whole input
+void ReaderTest() {
+  std::cout << "ReaderTest";
+  std::mt19937 random(19);
+  std::string long_row = "\"" + std::string(3000, 'x') + "\"\"\n\",y\n";
+  for (std::size_t buffer_size : {1, 2, 3, 7, 64, 1000, 1 << 16}) {
+    CheckReaderRows("a,b\n\"c\"\"d\",\"e\nf\"\n  g,,\n\n   ", '"', buffer_size);
+    CheckReaderRows("", '"', buffer_size);
+    CheckReaderRows(long_row + long_row, '"', buffer_size);
+    for (int i = 0; i < 20; i++) {
+      CheckReaderRows(RandomCsv(random, 300, '"'), '"', buffer_size);
+      CheckReaderRows(RandomCsv(random, 300, '^'), '^', buffer_size);
+    }
+  }
+  csv::Reader reader;
+  csv::Row row = {"left over"};
+  assert(!reader.Open("no/such/file.csv") && !reader.ReadRow(row) && row.empty());
+  std::cout << Pass();
+}
+
+void ForEachRowTest() {
+  std::cout << "ForEachRowTest";
+  std::istringstream stream("1,a\n2,b\n3,c\n4,d\n");
+  csv::Reader reader;
+  reader.Open(stream);
+  std::string seen;
+  // Stops after the row visit returns false for
+  std::size_t count = csv::ForEachRow(reader, [&](const csv::Row& row) {
+    seen += std::string(row[0]) + std::string(row[1]);
+    return row[0] != "3";
+  });
+  assert(count == 3 && seen == "1a2b3c");
+  assert(csv::ForEachRow(reader, [](const csv::Row&) { return true; }) == 1);
+  std::string path = WriteTemporaryFile("x,y\nz\n");
+  csv::MappedReader mapped;
+  assert(mapped.Open(path));
+  std::size_t field_count = 0;
+  assert(csv::ForEachRow(mapped, [&](const csv::Row& row) { field_count += row.size(); return true; }) == 2);
+  assert(field_count == 3);
+  std::remove(path.c_str());
+  std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// CHUNKED READ TESTING   ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+typedef std::vector<std::vector<std::string>> Rows;
+
+// Rows of path from begin on with a single MappedReader, up to the first whose first field is
+//  stop_at (never, if stop_at is null). Where each row starts goes into row_starts, if not null.
+Rows ReadSequentially(const std::string& path, std::size_t begin, char escape_character, const char* stop_at = nullptr,
+                      std::vector<std::size_t>* row_starts = nullptr) {
+  csv::MappedReader reader(escape_character);
+  assert(reader.Open(path));
+  reader.Seek(begin);
+  Rows rows;
+  std::vector<std::string_view> fields;
+  std::size_t row_start = reader.GetPosition();
+  while (reader.ReadRow(fields) && !(stop_at != nullptr && fields[0] == stop_at)) {
+    rows.emplace_back(fields.begin(), fields.end());
+    if (row_starts != nullptr) row_starts->push_back(row_start);
+    row_start = reader.GetPosition();
+  }
+  return rows;
+}
+
+// Rows of path from begin on with ReadChunks, the chunks one after another. discarded tells
+//  whether a chunk started in the wrong place. Row starts go into row_starts, as above.
+Rows ReadInChunks(const std::string& path, std::size_t begin, std::size_t chunk_count, char escape_character, bool& discarded,
+                  const char* stop_at = nullptr, std::vector<std::size_t>* row_starts = nullptr) {
+  std::vector<Rows> chunks(chunk_count);
+  std::vector<std::vector<std::size_t>> chunk_row_starts(chunk_count);
+  std::vector<char> stopped(chunk_count, false);
+  discarded = false;
+  bool opened = csv::ReadChunks(path, begin, chunk_count,
+      [&](std::size_t chunk, const std::vector<std::string_view>& fields, std::size_t row_start) {
+        if (stop_at != nullptr && fields[0] == stop_at) {
+          stopped[chunk] = true;
+          return false;
+        }
+        chunks[chunk].emplace_back(fields.begin(), fields.end());
+        chunk_row_starts[chunk].push_back(row_start);
+        return true;
+      },
+      [&](std::size_t chunk) {
+        discarded = true;
+        for (; chunk < chunk_count; chunk++) {
+          chunks[chunk].clear();
+          chunk_row_starts[chunk].clear();
+          stopped[chunk] = false;
+        }
+      },
+      escape_character);
+  assert(opened);
+  Rows rows;
+  for (std::size_t chunk = 0; chunk < chunk_count; chunk++) {
+    rows.insert(rows.end(), chunks[chunk].begin(), chunks[chunk].end());
+    if (row_starts != nullptr) row_starts->insert(row_starts->end(), chunk_row_starts[chunk].begin(), chunk_row_starts[chunk].end());
+    if (stopped[chunk]) break;
+  }
+  return rows;
+}
+
+// Rows with quoted commas, quotes and newlines, split into 1 to 9 chunks: the rows and where
+//  they start are the same as read in one go, and every chunk starts where the quote count says
+void ChunkedReadTest() {
+  std::cout << "ChunkedReadTest";
+  std::string contents = "Uniq Id,Name,About\n";
+  for (int i = 0; i < 500; i++) {
+    contents += std::to_string(i) + ",\"Item, number " + std::to_string(i) + "\",";
+    contents += i % 3 == 0 ? "\"multi\nline \"\"quoted\"\"\n text\"\n" : "plain\n";
+  }
+  std::string path = WriteTemporaryFile(contents);
+  std::size_t header_end = contents.find('\n') + 1;
+  std::vector<std::size_t> expected_starts;
+  Rows expected = ReadSequentially(path, header_end, '"', nullptr, &expected_starts);
+  assert(expected.size() == 500 && expected_starts[0] == header_end);
+  for (std::size_t chunk_count = 1; chunk_count <= 9; chunk_count++) {
+    bool discarded;
+    std::vector<std::size_t> starts;
+    assert(ReadInChunks(path, header_end, chunk_count, '"', discarded, nullptr, &starts) == expected && !discarded);
+    assert(starts == expected_starts);
+  }
+  // More chunks than rows
+  std::string small_path = WriteTemporaryFile("a,b\n\"c\nd\",e\n");
+  bool discarded;
+  assert(ReadInChunks(small_path, 0, 16, '"', discarded) == ReadSequentially(small_path, 0, '"') && !discarded);
+  std::remove(small_path.c_str());
+  std::remove(path.c_str());
+  std::cout << Pass();
+}
+
+// Random text, where the quote count is often wrong about where rows start, still reads the
+//  same as in one go, as misplaced chunks are read again
+void ChunkedRandomInputTest() {
+  std::cout << "ChunkedRandomInputTest";
+  std::mt19937 random(18);
+  bool any_discarded = false;
+  for (char escape_character : {'"', '^'}) {
+    for (int i = 0; i < 100; i++) {
+      std::string path = WriteTemporaryFile(RandomCsv(random, 2000, escape_character));
+      std::vector<std::size_t> expected_starts;
+      Rows expected = ReadSequentially(path, 0, escape_character, nullptr, &expected_starts);
+      for (std::size_t chunk_count : {2, 3, 7}) {
+        bool discarded;
+        std::vector<std::size_t> starts;
+        assert(ReadInChunks(path, 0, chunk_count, escape_character, discarded, nullptr, &starts) == expected);
+        assert(starts == expected_starts);
+        any_discarded |= discarded;
+      }
+      std::remove(path.c_str());
+    }
+  }
+  assert(any_discarded);
+  std::cout << Pass();
+}
+
+// Rows after the one visit stops at are left out, whichever chunk they are in
+void ChunkedStopTest() {
+  std::cout << "ChunkedStopTest";
+  std::string contents;
+  for (int i = 0; i < 300; i++) {
+    contents += (i == 170 ? std::string("stop") : std::to_string(i)) + ",\"x\ny\"\n";
+  }
+  std::string path = WriteTemporaryFile(contents);
+  Rows expected = ReadSequentially(path, 0, '"', "stop");
+  assert(expected.size() == 170);
+  for (std::size_t chunk_count = 1; chunk_count <= 6; chunk_count++) {
+    bool discarded;
+    assert(ReadInChunks(path, 0, chunk_count, '"', discarded, "stop") == expected);
+  }
+  assert(!csv::ReadChunks("no/such/file.csv", 0, 4, [](std::size_t, const std::vector<std::string_view>&, std::size_t) { return true; },
+                          [](std::size_t) {}));
+  std::remove(path.c_str());
+  std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// SCANNER TESTING        ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// Every level the processor supports builds the same masks as the scalar scanner
+void ScanLevelTest() {
+  std::cout << "ScanLevelTest";
+  std::mt19937 random(22);
+  for (char escape_character : {'"', '^'}) {
+    csv::StructuralScanner scalar(escape_character, csv::ScanLevel::kScalar);
+    for (csv::ScanLevel level : {csv::ScanLevel::kSse2, csv::ScanLevel::kAvx2}) {
+      csv::StructuralScanner scanner(escape_character, level);
+      assert(csv::StructuralScanner::IsSupported(level) == (scanner.GetLevel() == level));
+      for (int i = 0; i < 1000; i++) {
+        std::string block = RandomCsv(random, csv::StructuralScanner::kBlockSize, escape_character);
+        csv::StructuralMasks expected = scalar.Scan(block.data());
+        csv::StructuralMasks masks = scanner.Scan(block.data());
+        assert(masks.delimiters == expected.delimiters && masks.quotes == expected.quotes);
+      }
+    }
+  }
+  // Bit i is character i
+  std::string block(csv::StructuralScanner::kBlockSize, 'a');
+  block[0] = ',';
+  block[9] = '"';
+  block[63] = '\n';
+  csv::StructuralMasks masks = csv::StructuralScanner().Scan(block.data());
+  assert(masks.delimiters == (1ull | 1ull << 63) && masks.quotes == 1ull << 9);
+  std::cout << Pass();
+}
+
+// The carry-less multiply matches XORing bit by bit
+void PrefixXorTest() {
+  std::cout << "PrefixXorTest";
+  csv::StructuralScanner scanner;
+  std::mt19937_64 random(3);
+  for (int i = 0; i < 1000; i++) {
+    uint64_t quotes = random() & random();
+    uint64_t expected = 0;
+    bool inside = false;
+    for (int bit = 0; bit < 64; bit++) {
+      inside ^= (quotes >> bit) & 1;
+      expected |= static_cast<uint64_t>(inside) << bit;
+    }
+    assert(scanner.PrefixXor(quotes) == expected);
+  }
+  assert(scanner.PrefixXor(0) == 0 && scanner.PrefixXor(1) == ~0ull && scanner.PrefixXor(0b1001) == 0b0111);
+  std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// UTF-8 TESTING          ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+const csv::ScanLevel kAllLevels[] = {csv::ScanLevel::kScalar, csv::ScanLevel::kSse2, csv::ScanLevel::kAvx2};
+
+// Pieces of text: ASCII, csv syntax, valid characters of 2 to 4 bytes, controls (C1 as well)
+//  and invalid sequences (overlong, surrogate, past U+10FFFF, cut off, stray bytes)
+std::string RandomUtf8(std::mt19937& random, std::size_t piece_count) {
+  static const char* const kPieces[] = {
+      "a", "b", " ", ",", "\"", "\n", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xC2\x85", "\xC2\xA0",
+      "\x1B", "\t", "\r", "\x7F", "\x80", "\xBF", "\xC0\xAF", "\xE0\x80\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80",
+      "\xF5", "\xFF", "\xE2\x82", "\xF0\x9F", "\xC3", "abcdefghijklmnopqrstuvwxyz0123456789"};
+  std::uniform_int_distribution<std::size_t> pick(0, sizeof(kPieces) / sizeof(kPieces[0]) - 1);
+  std::string text;
+  for (std::size_t i = 0; i < piece_count; i++) {
+    text += kPieces[pick(random)];
+  }
+  return text;
+}
+
+// Examples of each flag, at every level, and with 40 ASCII characters before them so they
+//  also land past the first block
+void Utf8CheckTest() {
+  std::cout << "Utf8CheckTest";
+  const uint32_t kInvalid = csv::Utf8Validator::kInvalid, kControl = csv::Utf8Validator::kControl,
+                 kMultibyte = csv::Utf8Validator::kMultibyte;
+  const std::pair<std::string, uint32_t> kCases[] = {
+      {"", 0},
+      {"Home Decor\n", 0},
+      {"Home D\xC3\xA9" "cor", kMultibyte},
+      {"\xE2\x82\xAC 5 \xF0\x9F\x98\x80", kMultibyte},
+      {"\xEF\xBF\xBD", kMultibyte},
+      {"\xF4\x8F\xBF\xBF", kMultibyte},         // U+10FFFF
+      {"\xED\x9F\xBF", kMultibyte},             // U+D7FF, before the surrogates
+      {"a\tb", kControl},
+      {"\x1B[31m", kControl},
+      {"\x7F", kControl},
+      {"\r\n", kControl},
+      {"\xC2\x9B", kMultibyte | kControl},       // C1
+      {"\xC2\xA0", kMultibyte},                  // No-break space
+      {"\xC3", kMultibyte | kInvalid},            // Cut off
+      {"\xF0\x9F\x98", kMultibyte | kInvalid},
+      {"\xC3" "a", kMultibyte | kInvalid},
+      {"\x80", kMultibyte | kInvalid},            // Stray continuation
+      {"\xC0\xAF", kMultibyte | kInvalid},        // Overlong
+      {"\xE0\x9F\xBF", kMultibyte | kInvalid},
+      {"\xF0\x8F\xBF\xBF", kMultibyte | kInvalid},
+      {"\xED\xA0\x80", kMultibyte | kInvalid},    // Surrogate
+      {"\xF4\x90\x80\x80", kMultibyte | kInvalid},  // Past U+10FFFF
+      {"\xF8\x88\x80\x80\x80", kMultibyte | kInvalid},
+      {"\xE2\x82\xAC\xAC", kMultibyte | kInvalid},  // One continuation too many
+  };
+  for (csv::ScanLevel level : kAllLevels) {
+    csv::Utf8Validator validator(level);
+    assert(csv::StructuralScanner::IsSupported(level) == (validator.GetLevel() == level));
+    for (const std::pair<std::string, uint32_t>& test_case : kCases) {
+      assert(validator.Check(test_case.first) == test_case.second);
+      assert(validator.Check(std::string(40, 'x') + test_case.first) == test_case.second);
+      assert(validator.IsValid(test_case.first) == ((test_case.second & kInvalid) == 0));
+    }
+  }
+  std::cout << Pass();
+}
+
+// Every level finds the same as the scalar validator, with characters split across blocks
+void Utf8LevelTest() {
+  std::cout << "Utf8LevelTest";
+  std::mt19937 random(21);
+  csv::Utf8Validator scalar(csv::ScanLevel::kScalar);
+  for (int i = 0; i < 3000; i++) {
+    std::string text = RandomUtf8(random, static_cast<std::size_t>(i % 60));
+    uint32_t expected = scalar.Check(text);
+    for (csv::ScanLevel level : kAllLevels) {
+      assert(csv::Utf8Validator(level).Check(text) == expected);
+    }
+  }
+  std::cout << Pass();
+}
+
+void SanitizeTest() {
+  std::cout << "SanitizeTest";
+  auto sanitize = [](std::string_view text, bool strip_control_characters, csv::InvalidUtf8 invalid, bool keep_multibyte) {
+    csv::Utf8Policy policy;
+    policy.strip_control_characters = strip_control_characters;
+    policy.invalid = invalid;
+    policy.keep_multibyte = keep_multibyte;
+    std::string out;
+    csv::SanitizeUtf8(text, policy, out);
+    return out;
+  };
+  const csv::InvalidUtf8 kKeep = csv::InvalidUtf8::kKeep, kReplace = csv::InvalidUtf8::kReplace,
+                         kDrop = csv::InvalidUtf8::kDrop;
+  // What datafilter.py did, and what it should have done
+  assert(sanitize("Home D\xC3\xA9" "cor", true, kDrop, false) == "Home Dcor");
+  assert(sanitize("Home D\xC3\xA9" "cor", true, kReplace, true) == "Home D\xC3\xA9" "cor");
+  assert(sanitize("a\x1B[31mb\tc\r\nd\x7F\xC2\x9B" "e", true, kKeep, true) == "a[31mbc\nde");
+  assert(sanitize("a\x1B[31mb\tc\r\nd\x7F\xC2\x9B" "e", false, kKeep, true) == "a\x1B[31mb\tc\r\nd\x7F\xC2\x9B" "e");
+  // One U+FFFD per maximal subpart
+  assert(sanitize("a\xC3(b", false, kReplace, true) == "a\xEF\xBF\xBD(b");
+  assert(sanitize("\xE0\x80\x80", false, kReplace, true) == "\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD");
+  assert(sanitize("\xF0\x9F\x98", false, kReplace, true) == "\xEF\xBF\xBD");
+  assert(sanitize("\xF0\x9F\x98!\xF0\x9F\x98\x80", false, kDrop, true) == "!\xF0\x9F\x98\x80");
+  assert(sanitize("\xF0\x9F\x98!", false, kKeep, true) == "\xF0\x9F\x98!");
+  // Appends
+  csv::Utf8Policy policy;
+  policy.strip_control_characters = true;
+  std::string out = "x";
+  csv::SanitizeUtf8("\ty", policy, out);
+  assert(out == "xy");
+  assert(!csv::Utf8Policy().ChangesText());
+
+  // IsClean() is whether SanitizeUtf8() changes the text, for every policy and level
+  std::mt19937 random(7);
+  for (int i = 0; i < 1000; i++) {
+    std::string text = RandomUtf8(random, static_cast<std::size_t>(i % 40));
+    for (int policy_number = 0; policy_number < 12; policy_number++) {
+      policy.strip_control_characters = policy_number % 2 == 0;
+      policy.keep_multibyte = policy_number / 2 % 2 == 0;
+      policy.invalid = static_cast<csv::InvalidUtf8>(policy_number / 4);
+      out.clear();
+      csv::SanitizeUtf8(text, policy, out);
+      for (csv::ScanLevel level : kAllLevels) {
+        assert(csv::Utf8Validator(level).IsClean(text, policy) == (out == text));
+      }
+    }
+  }
+  std::cout << Pass();
+}
+
+// Rows read with a policy are the rows read without one, every field sanitized on its own,
+//  with MappedReader, Reader and ReadChunks
+void SanitizedReadTest() {
+  std::cout << "SanitizedReadTest";
+  csv::Utf8Policy policy;
+  policy.strip_control_characters = true;
+  policy.invalid = csv::InvalidUtf8::kReplace;
+  std::mt19937 random(12);
+  for (int i = 0; i < 100; i++) {
+    // Some rows are clean, so both kinds are read one after another
+    std::string contents;
+    for (int row = 0; row < 20; row++) {
+      contents += row % 3 == 0 ? RandomUtf8(random, 20) : "Home Decor,\"Toys, Games\",\"a \"\"b\"\"\"\n";
+    }
+    std::string path = WriteTemporaryFile(contents);
+    Rows expected = ReadSequentially(path, 0, '"');
+    for (std::vector<std::string>& row : expected) {
+      for (std::string& field : row) {
+        std::string sanitized;
+        csv::SanitizeUtf8(field, policy, sanitized);
+        field = sanitized;
+      }
+    }
+    csv::MappedReader reader;
+    assert(reader.Open(path));
+    reader.SetUtf8Policy(policy);
+    csv::Reader stream_reader('"', 64);
+    std::istringstream stream(contents);
+    stream_reader.Open(stream);
+    stream_reader.SetUtf8Policy(policy);
+    std::vector<std::string_view> fields, stream_fields;
+    for (const std::vector<std::string>& row : expected) {
+      assert(reader.ReadRow(fields) && stream_reader.ReadRow(stream_fields));
+      assert(std::vector<std::string>(fields.begin(), fields.end()) == row);
+      assert(std::vector<std::string>(stream_fields.begin(), stream_fields.end()) == row);
+    }
+    assert(!reader.ReadRow(fields) && !stream_reader.ReadRow(stream_fields));
+    std::vector<Rows> chunks(3);
+    csv::ReadChunks(path, 0, chunks.size(),
+        [&](std::size_t chunk, const std::vector<std::string_view>& row, std::size_t) {
+          chunks[chunk].emplace_back(row.begin(), row.end());
+          return true;
+        },
+        [&](std::size_t chunk) {
+          for (; chunk < chunks.size(); chunk++) chunks[chunk].clear();
+        },
+        '"', policy);
+    Rows chunk_rows;
+    for (const Rows& chunk : chunks) chunk_rows.insert(chunk_rows.end(), chunk.begin(), chunk.end());
+    assert(chunk_rows == expected);
+    std::remove(path.c_str());
+  }
+  std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// COMPRESSED INPUT TESTING ////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+void DetectCompressionTest() {
+  std::cout << "DetectCompressionTest";
+  assert(csv::DetectCompression(std::string_view("\x1F\x8B\x08\x00", 4)) == csv::Compression::kGzip);
+  assert(csv::DetectCompression(std::string_view("\x28\xB5\x2F\xFD", 4)) == csv::Compression::kZstd);
+  assert(csv::DetectCompression(std::string_view("\x28\xB5\x2F", 3)) == csv::Compression::kNone);
+  assert(csv::DetectCompression(std::string_view("a,b\n")) == csv::Compression::kNone);
+  assert(csv::DetectCompression(std::string_view()) == csv::Compression::kNone);
+  assert(csv::DetectCompression(std::string("no/such/file.csv")) == csv::Compression::kNone);
+  std::string path = WriteTemporaryFile(std::string("\x1F\x8B", 2) + "rest");
+  assert(csv::DetectCompression(path) == csv::Compression::kGzip);
+  std::remove(path.c_str());
+  assert(csv::IsSupported(csv::Compression::kNone));
+  std::cout << Pass();
+}
+
+// Every byte of a file that isn't compressed comes back in order, through rings of any size
+void DecompressingSourceTest() {
+  std::cout << "DecompressingSourceTest";
+  std::mt19937 random(22);
+  std::string contents = RandomCsv(random, 10000, '"');
+  std::string path = WriteTemporaryFile(contents);
+  for (std::size_t block_size : {1, 7, 4096, 1 << 16}) {
+    for (std::size_t block_count : {1, 2, 4}) {
+      csv::DecompressingSource source(block_size, block_count);
+      assert(source.Open(path));
+      std::string read;
+      char buffer[1000];
+      std::size_t count;
+      // Reads of a varying size, smaller and larger than a block
+      while ((count = source.Read(buffer, 1 + read.size() % sizeof(buffer))) > 0) {
+        read.append(buffer, count);
+      }
+      assert(read == contents && source.GetError().empty() && source.Read(buffer, sizeof(buffer)) == 0);
+    }
+  }
+  // Closing before the end stops the thread; opening again starts over
+  csv::DecompressingSource source(16, 2);
+  char buffer[8];
+  assert(source.Open(path) && source.Read(buffer, sizeof(buffer)) == sizeof(buffer));
+  source.Close();
+  assert(source.Read(buffer, sizeof(buffer)) == 0);
+  assert(source.Open(path) && source.Read(buffer, sizeof(buffer)) == sizeof(buffer));
+  assert(std::string_view(buffer, sizeof(buffer)) == std::string_view(contents).substr(0, sizeof(buffer)));
+  std::remove(path.c_str());
+  assert(!source.Open("no/such/file.csv") && !source.GetError().empty());
+  std::cout << Pass();
+}
+
+#if defined(CSV_PARSER_ZLIB) || defined(CSV_PARSER_ZSTD)
+// Reads a compressed file with Reader, with buffers of buffer_size bytes, and checks the rows
+//  are MappedReader's rows of contents
+void CheckCompressedRows(const std::string& contents, const std::string& compressed, std::size_t buffer_size) {
+  csv::MappedReader mapped;
+  mapped.OpenBuffer(contents);
+  std::string path = WriteTemporaryFile(compressed);
+  csv::Reader reader('"', buffer_size);
+  assert(reader.Open(path));
+  csv::Row expected, row;
+  bool more;
+  do {
+    more = mapped.ReadRow(expected);
+    assert(reader.ReadRow(row) == more && row == expected && reader.GetPosition() == mapped.GetPosition());
+  } while (more);
+  assert(reader.GetError().empty());
+  reader.Close();
+  std::remove(path.c_str());
+}
+#endif
+
+#if defined(CSV_PARSER_ZLIB)
+// contents as a gzip file of member_count members, as concatenating gzip files makes
+std::string Gzip(const std::string& contents, std::size_t member_count = 1) {
+  std::string compressed;
+  std::size_t member_size = contents.size() / member_count + 1;
+  for (std::size_t begin = 0; begin < contents.size() || begin == 0; begin += member_size) {
+    std::string_view member = std::string_view(contents).substr(begin, member_size);
+    z_stream stream = {};
+    // 16 + the largest window: a gzip header and trailer
+    assert(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    std::string out(deflateBound(&stream, static_cast<uLong>(member.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(member.data()));
+    stream.avail_in = static_cast<uInt>(member.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    assert(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    compressed += out;
+  }
+  return compressed;
+}
+
+// Rows of gzip files of one or more members, cut at every place by the buffer's end
+void GzipReadTest() {
+  std::cout << "GzipReadTest";
+  assert(csv::IsSupported(csv::Compression::kGzip));
+  std::mt19937 random(31);
+  std::string long_row = "\"" + std::string(3000, 'x') + "\"\"\n\",y\n";
+  for (std::size_t buffer_size : {1, 7, 64, 1 << 16}) {
+    CheckCompressedRows("a,b\n\"c\"\"d\",\"e\nf\"\n  g,,\n\n   ", Gzip("a,b\n\"c\"\"d\",\"e\nf\"\n  g,,\n\n   "), buffer_size);
+    CheckCompressedRows("", Gzip(""), buffer_size);
+    CheckCompressedRows(long_row + long_row, Gzip(long_row + long_row, 3), buffer_size);
+    for (int i = 0; i < 10; i++) {
+      std::string contents = RandomCsv(random, 2000, '"');
+      CheckCompressedRows(contents, Gzip(contents, 1 + i % 4), buffer_size);
+    }
+  }
+  // More than the ring holds, so the thread waits for blocks to be freed
+  std::string contents;
+  for (int i = 0; contents.size() < (5 << 20); i++) {
+    contents += std::to_string(i) + ",\"Home Decor | Toys\"," + std::string(static_cast<std::size_t>(i % 90), 'z') + "\n";
+  }
+  CheckCompressedRows(contents, Gzip(contents, 2), csv::Reader::kDefaultBufferSize);
+  std::cout << Pass();
+}
+
+// A file cut off or corrupted in the middle reads up to there, then GetError() says why
+void CorruptGzipTest() {
+  std::cout << "CorruptGzipTest";
+  std::string contents;
+  for (int i = 0; i < 20000; i++) contents += std::to_string(i) + ",row\n";
+  std::string compressed = Gzip(contents);
+  std::string cut_off = compressed.substr(0, compressed.size() / 2);
+  std::string corrupt = compressed;
+  for (std::size_t i = corrupt.size() / 2; i < corrupt.size() / 2 + 64; i++) corrupt[i] = static_cast<char>(~corrupt[i]);
+  for (const std::string& damaged : {cut_off, corrupt}) {
+    std::string path = WriteTemporaryFile(damaged);
+    csv::Reader reader;
+    assert(reader.Open(path));
+    csv::Row row;
+    std::size_t row_count = 0;
+    while (reader.ReadRow(row)) {
+      // Rows before the damage are whole (the last one may be cut short)
+      if (row_count + 1 < 10) assert(row.size() == 2 && row[0] == std::to_string(row_count) && row[1] == "row");
+      row_count++;
+    }
+    assert(!reader.GetError().empty() && (damaged != cut_off || row_count < 20000));
+    // The error goes with the file
+    reader.Close();
+    assert(reader.GetError().empty());
+    std::remove(path.c_str());
+  }
+  std::cout << Pass();
+}
+#endif
+
+#if defined(CSV_PARSER_ZSTD)
+void ZstdReadTest() {
+  std::cout << "ZstdReadTest";
+  assert(csv::IsSupported(csv::Compression::kZstd));
+  std::mt19937 random(32);
+  for (int i = 0; i < 10; i++) {
+    std::string contents = RandomCsv(random, 5000, '"');
+    std::string compressed(ZSTD_compressBound(contents.size()), '\0');
+    compressed.resize(ZSTD_compress(compressed.data(), compressed.size(), contents.data(), contents.size(), 3));
+    // Two frames one after another, as concatenating zstd files makes
+    CheckCompressedRows(contents + contents, compressed + compressed, 64);
+    std::string path = WriteTemporaryFile(compressed.substr(0, compressed.size() / 2));
+    csv::Reader reader;
+    csv::Row row;
+    assert(reader.Open(path));
+    while (reader.ReadRow(row)) {
+    }
+    assert(!reader.GetError().empty());
+    reader.Close();
+    std::remove(path.c_str());
+  }
+  std::cout << Pass();
+}
+#else
+// Without libzstd a zstd file isn't read as text
+void ZstdReadTest() {
+  std::cout << "ZstdReadTest";
+  assert(!csv::IsSupported(csv::Compression::kZstd));
+  std::string path = WriteTemporaryFile(std::string("\x28\xB5\x2F\xFD", 4) + "frame");
+  csv::Reader reader;
+  assert(!reader.Open(path) && !reader.GetError().empty());
+  std::remove(path.c_str());
+  std::cout << Pass();
+}
+#endif
+
+////                        ////////////////////////////////////////////////////
+}
+
+namespace csv_parser_test {
+void TestAll() {
+  std::cout << "----- RUNNING ALL CSV PARSER TESTS -----" << std::endl;
+  MappedReaderTest();
+  ScannerTest();
+  ParallelReadTest();
+  StreamingReaderTest();
+  Utf8Test();
+  CompressedInputTest();
+  std::cout << "ALL CSV PARSER TESTS PASSED" << std::endl;
+}
+void MappedReaderTest() {
+  std::cout << "----- Mapped Reader Tests -----" << std::endl;
+  DocsExamplesTest();
+  EscapeSequenceTest();
+  EdgeCaseTest();
+  OpenTest();
+  RandomInputTest();
+  std::cout << "----- Mapped Reader Tests passed" << std::endl;
+}
+void ParallelReadTest() {
+  std::cout << "----- Chunked Read Tests -----" << std::endl;
+  ChunkedReadTest();
+  ChunkedRandomInputTest();
+  ChunkedStopTest();
+  std::cout << "----- Chunked Read Tests passed" << std::endl;
+}
+void StreamingReaderTest() {
+  std::cout << "----- Streaming Reader Tests -----" << std::endl;
+  ReaderTest();
+  ForEachRowTest();
+  std::cout << "----- Streaming Reader Tests passed" << std::endl;
+}
+void ScannerTest() {
+  std::cout << "----- Structural Scanner Tests -----" << std::endl;
+  ScanLevelTest();
+  PrefixXorTest();
+  std::cout << "----- Structural Scanner Tests passed" << std::endl;
+}
+void Utf8Test() {
+  std::cout << "----- UTF-8 Tests -----" << std::endl;
+  Utf8CheckTest();
+  Utf8LevelTest();
+  SanitizeTest();
+  SanitizedReadTest();
+  std::cout << "----- UTF-8 Tests passed" << std::endl;
+}
+void CompressedInputTest() {
+  std::cout << "----- Compressed Input Tests -----" << std::endl;
+  DetectCompressionTest();
+  DecompressingSourceTest();
+#if defined(CSV_PARSER_ZLIB)
+  GzipReadTest();
+  CorruptGzipTest();
+#endif
+  ZstdReadTest();
+  std::cout << "----- Compressed Input Tests passed" << std::endl;
+}
+}
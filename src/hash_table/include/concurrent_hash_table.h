@@ -0,0 +1,405 @@
+#ifndef CONCURRENT_HASH_TABLE_H
+#define CONCURRENT_HASH_TABLE_H
+
+#include "epoch.h"
+#include "hash_policy.h"
+#include <atomic>
+#include <cstddef> //std::size_t
+#include <cstdint>
+#include <mutex>
+#include <utility> //std::move, std::forward
+
+// Thread-safe chained hash table. Same bucket layout as HashTable<..., ChainedLayout>: an array
+//  of bucket heads, each the start of a singly linked chain.
+//
+// Reads (Find, Visit, Contains, ForEach) take no locks. They pin an epoch (see epoch.h) and walk
+//  the chains with acquire loads, a bounded number of steps, so they are wait-free.
+// Writes lock one of kStripeCount mutexes, chosen by the low bits of the bucket index. Items are
+//  never changed in place: an overwrite links in a new node and retires the old one, so a reader
+//  always sees a whole item.
+// Resizing is cooperative. The writer that crosses the load limit allocates the next array, and
+//  from then on every write first moves a chunk of kMigrationChunk buckets into it. A moved
+//  bucket's head is replaced by a forwarding marker, which sends readers and writers on to the
+//  next array. The writer that moves the last chunk makes the next array the current one.
+//  Capacities stay powers of two of at least kStripeCount, so an old bucket and both of the
+//  buckets it splits into share a stripe.
+//
+// Values are handed out by copy (Find) or by reference inside a callback (Visit, ForEach), as
+//  an iterator could outlive the epoch that keeps its node alive.
+template <typename Key, typename Value>
+class ConcurrentHashTable {
+public:
+    ConcurrentHashTable();
+    // Not thread-safe: no other thread may use the table while it is destroyed.
+    ~ConcurrentHashTable();
+    ConcurrentHashTable(const ConcurrentHashTable& other) = delete;
+    ConcurrentHashTable& operator=(const ConcurrentHashTable& other) = delete;
+
+    // Copies the value for key into value. Returns false if key is not present.
+    bool Find(const Key& key, Value& value) const;
+    template <typename K, EnableIfTransparentLookup<Key, K> = 0>
+    bool Find(const K& key, Value& value) const;
+    // Calls visit(const Value&) with the value for key, while it is guaranteed to stay alive.
+    //  Returns false (and doesn't call visit) if key is not present.
+    template <typename Visitor>
+    bool Visit(const Key& key, Visitor&& visit) const;
+    template <typename K, typename Visitor, EnableIfTransparentLookup<Key, K> = 0>
+    bool Visit(const K& key, Visitor&& visit) const;
+    bool Contains(const Key& key) const;
+    // Calls visit(const Key&, const Value&) for every item. Items inserted or deleted during the
+    //  walk may or may not be seen, and an item may be seen twice if a resize is in progress.
+    template <typename Visitor>
+    void ForEach(Visitor&& visit) const;
+
+    // Inserts or overwrites
+    void Insert(const Key& key, const Value& value);
+    void Insert(Key&& key, Value&& value);
+    // Returns false if key was not present
+    bool Delete(const Key& key);
+
+    // Both are approximate while other threads are writing
+    std::size_t size() const;
+    std::size_t capacity() const;
+
+private:
+    /////// BEGIN SETTINGS
+    static constexpr std::size_t kStripeCount = 64;
+    static constexpr std::size_t kInitialCapacity = kStripeCount;
+    // Resize once size exceeds capacity * kMaxLoadNumerator / kMaxLoadDenominator
+    static constexpr std::size_t kMaxLoadNumerator = 3;
+    static constexpr std::size_t kMaxLoadDenominator = 4;
+    // Buckets a writer moves per operation during a resize
+    static constexpr std::size_t kMigrationChunk = 16;
+    /////// END SETTINGS
+
+    // Items are allocated apart from chain nodes, so that a resize can build the new chains
+    //  out of new nodes pointing at the same items, without copying keys or values.
+    struct Item {
+        template <typename K, typename V>
+        Item(K&& key, V&& value) : key_(std::forward<K>(key)), value_(std::forward<V>(value)) {}
+        const Key key_;
+        const Value value_;
+    };
+    struct Node {
+        Node(Item* item, Node* next) : item_(item), next_(next) {}
+        Item* item_;
+        std::atomic<Node*> next_;
+    };
+    struct BucketArray {
+        explicit BucketArray(std::size_t capacity);
+        ~BucketArray();
+        const std::size_t capacity_;
+        std::atomic<Node*>* heads_;
+        // Set while this array is being moved into a bigger one
+        std::atomic<BucketArray*> next_;
+        // Next bucket to be claimed for moving, and number of buckets moved so far
+        std::atomic<std::size_t> claim_index_;
+        std::atomic<std::size_t> moved_count_;
+    };
+    struct alignas(64) Stripe {
+        std::mutex mutex_;
+    };
+
+    template <typename K>
+    const Item* FindItem_(const K& key, std::size_t hash) const;
+    template <typename K, typename V>
+    void Insert_(K&& key, V&& value);
+    template <typename K>
+    std::size_t Hash_(const K& key) const;
+    std::mutex& StripeFor_(std::size_t hash) const;
+    void StartResize_(BucketArray* array);
+    void HelpResize_(BucketArray* array);
+    void MoveBucket_(BucketArray* array, std::size_t index);
+    static Node* Forwarded_();
+    static void DeleteNode_(void* node);
+    static void DeleteItem_(void* item);
+    static void DeleteArray_(void* array);
+
+    HashTableHash<Key> hasher_;
+    HashTableKeyEqual<Key> key_equal_;
+    std::atomic<BucketArray*> array_;
+    std::atomic<std::size_t> size_;
+    mutable Stripe stripes_[kStripeCount];
+};
+
+template<typename Key, typename Value>
+ConcurrentHashTable<Key, Value>::BucketArray::BucketArray(std::size_t capacity)
+    : capacity_(capacity), heads_(new std::atomic<Node*>[capacity]), next_(nullptr), claim_index_(0), moved_count_(0) {
+    for (std::size_t i = 0; i < capacity_; i++) {
+        heads_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+template<typename Key, typename Value>
+ConcurrentHashTable<Key, Value>::BucketArray::~BucketArray() {
+    delete[] heads_;
+}
+
+template<typename Key, typename Value>
+ConcurrentHashTable<Key, Value>::ConcurrentHashTable()
+    : array_(new BucketArray(kInitialCapacity)), size_(0) {}
+
+template<typename Key, typename Value>
+ConcurrentHashTable<Key, Value>::~ConcurrentHashTable() {
+    // Chains still reachable from the current array and, mid-resize, from the next one. Nodes
+    //  and items already retired belong to the epoch domain.
+    BucketArray* array = array_.load(std::memory_order_acquire);
+    while (array != nullptr) {
+        for (std::size_t i = 0; i < array->capacity_; i++) {
+            Node* node = array->heads_[i].load(std::memory_order_relaxed);
+            if (node == Forwarded_()) continue;
+            while (node != nullptr) {
+                Node* next = node->next_.load(std::memory_order_relaxed);
+                delete node->item_;
+                delete node;
+                node = next;
+            }
+        }
+        BucketArray* next = array->next_.load(std::memory_order_relaxed);
+        delete array;
+        array = next;
+    }
+}
+
+template<typename Key, typename Value>
+bool ConcurrentHashTable<Key, Value>::Find(const Key &key, Value &value) const {
+    return Visit(key, [&value](const Value& found) { value = found; });
+}
+
+template<typename Key, typename Value>
+template<typename K, EnableIfTransparentLookup<Key, K>>
+bool ConcurrentHashTable<Key, Value>::Find(const K &key, Value &value) const {
+    return Visit(key, [&value](const Value& found) { value = found; });
+}
+
+template<typename Key, typename Value>
+template<typename Visitor>
+bool ConcurrentHashTable<Key, Value>::Visit(const Key &key, Visitor &&visit) const {
+    EpochDomain::Guard guard(EpochDomain::Global());
+    const Item* item = FindItem_(key, Hash_(key));
+    if (item == nullptr) return false;
+    visit(item->value_);
+    return true;
+}
+
+template<typename Key, typename Value>
+template<typename K, typename Visitor, EnableIfTransparentLookup<Key, K>>
+bool ConcurrentHashTable<Key, Value>::Visit(const K &key, Visitor &&visit) const {
+    EpochDomain::Guard guard(EpochDomain::Global());
+    const Item* item = FindItem_(key, Hash_(key));
+    if (item == nullptr) return false;
+    visit(item->value_);
+    return true;
+}
+
+template<typename Key, typename Value>
+bool ConcurrentHashTable<Key, Value>::Contains(const Key &key) const {
+    EpochDomain::Guard guard(EpochDomain::Global());
+    return FindItem_(key, Hash_(key)) != nullptr;
+}
+
+template<typename Key, typename Value>
+template<typename Visitor>
+void ConcurrentHashTable<Key, Value>::ForEach(Visitor &&visit) const {
+    EpochDomain::Guard guard(EpochDomain::Global());
+    for (BucketArray* array = array_.load(std::memory_order_acquire); array != nullptr;
+         array = array->next_.load(std::memory_order_acquire)) {
+        for (std::size_t i = 0; i < array->capacity_; i++) {
+            Node* node = array->heads_[i].load(std::memory_order_acquire);
+            if (node == Forwarded_()) continue; // Its items are visited in the next array
+            for (; node != nullptr; node = node->next_.load(std::memory_order_acquire)) {
+                visit(node->item_->key_, node->item_->value_);
+            }
+        }
+    }
+}
+
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::Insert(const Key &key, const Value &value) {
+    Insert_(key, value);
+}
+
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::Insert(Key &&key, Value &&value) {
+    Insert_(std::move(key), std::move(value));
+}
+
+template<typename Key, typename Value>
+template<typename K, typename V>
+void ConcurrentHashTable<Key, Value>::Insert_(K &&key, V &&value) {
+    EpochDomain::Guard guard(EpochDomain::Global());
+    std::size_t hash = Hash_(key);
+    // Built before locking, so the stripe is held only for the relinking
+    Item* item = new Item(std::forward<K>(key), std::forward<V>(value));
+    BucketArray* array = array_.load(std::memory_order_acquire);
+    HelpResize_(array);
+    bool inserted = false;
+    {
+        std::lock_guard<std::mutex> lock(StripeFor_(hash));
+        std::size_t index = hash & (array->capacity_ - 1);
+        // Buckets that were moved forward to the next array. The stripe stays the same.
+        while (array->heads_[index].load(std::memory_order_acquire) == Forwarded_()) {
+            array = array->next_.load(std::memory_order_acquire);
+            index = hash & (array->capacity_ - 1);
+        }
+        std::atomic<Node*>* link = &array->heads_[index];
+        Node* node = link->load(std::memory_order_relaxed);
+        while (node != nullptr && !key_equal_(node->item_->key_, item->key_)) {
+            link = &node->next_;
+            node = link->load(std::memory_order_relaxed);
+        }
+        if (node != nullptr) {
+            // Overwrite: the new node takes the old one's place in the chain
+            Node* replacement = new Node(item, node->next_.load(std::memory_order_relaxed));
+            link->store(replacement, std::memory_order_release);
+            EpochDomain::Global().Retire(node->item_, &DeleteItem_);
+            EpochDomain::Global().Retire(node, &DeleteNode_);
+        } else {
+            // New items go at the head, which readers can pick up with one acquire load
+            Node* head = array->heads_[index].load(std::memory_order_relaxed);
+            array->heads_[index].store(new Node(item, head), std::memory_order_release);
+            inserted = true;
+        }
+    }
+    if (inserted) {
+        std::size_t new_size = size_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (new_size > array->capacity_ / kMaxLoadDenominator * kMaxLoadNumerator) StartResize_(array);
+    }
+}
+
+template<typename Key, typename Value>
+bool ConcurrentHashTable<Key, Value>::Delete(const Key &key) {
+    EpochDomain::Guard guard(EpochDomain::Global());
+    std::size_t hash = Hash_(key);
+    BucketArray* array = array_.load(std::memory_order_acquire);
+    HelpResize_(array);
+    std::lock_guard<std::mutex> lock(StripeFor_(hash));
+    std::size_t index = hash & (array->capacity_ - 1);
+    while (array->heads_[index].load(std::memory_order_acquire) == Forwarded_()) {
+        array = array->next_.load(std::memory_order_acquire);
+        index = hash & (array->capacity_ - 1);
+    }
+    std::atomic<Node*>* link = &array->heads_[index];
+    Node* node = link->load(std::memory_order_relaxed);
+    while (node != nullptr && !key_equal_(node->item_->key_, key)) {
+        link = &node->next_;
+        node = link->load(std::memory_order_relaxed);
+    }
+    if (node == nullptr) return false;
+    // A reader standing on node still finds the rest of the chain through it
+    link->store(node->next_.load(std::memory_order_relaxed), std::memory_order_release);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    EpochDomain::Global().Retire(node->item_, &DeleteItem_);
+    EpochDomain::Global().Retire(node, &DeleteNode_);
+    return true;
+}
+
+template<typename Key, typename Value>
+std::size_t ConcurrentHashTable<Key, Value>::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value>
+std::size_t ConcurrentHashTable<Key, Value>::capacity() const {
+    return array_.load(std::memory_order_acquire)->capacity_;
+}
+
+// Caller is pinned. Follows forwarding markers into newer arrays.
+template<typename Key, typename Value>
+template<typename K>
+const typename ConcurrentHashTable<Key, Value>::Item* ConcurrentHashTable<Key, Value>::FindItem_(const K &key, std::size_t hash) const {
+    BucketArray* array = array_.load(std::memory_order_acquire);
+    Node* node = array->heads_[hash & (array->capacity_ - 1)].load(std::memory_order_acquire);
+    while (node == Forwarded_()) {
+        array = array->next_.load(std::memory_order_acquire);
+        node = array->heads_[hash & (array->capacity_ - 1)].load(std::memory_order_acquire);
+    }
+    for (; node != nullptr; node = node->next_.load(std::memory_order_acquire)) {
+        if (key_equal_(node->item_->key_, key)) return node->item_;
+    }
+    return nullptr;
+}
+
+// std::hash is the identity for integers on common standard libraries, and buckets are picked
+//  by the low bits, so the hash is mixed first (same mix as the flat layout).
+template<typename Key, typename Value>
+template<typename K>
+std::size_t ConcurrentHashTable<Key, Value>::Hash_(const K &key) const {
+    uint64_t hash = static_cast<uint64_t>(hasher_(key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(hash ^ (hash >> 32));
+}
+
+template<typename Key, typename Value>
+std::mutex & ConcurrentHashTable<Key, Value>::StripeFor_(std::size_t hash) const {
+    return stripes_[hash & (kStripeCount - 1)].mutex_;
+}
+
+// Installs the next array unless another writer already did
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::StartResize_(BucketArray *array) {
+    if (array->next_.load(std::memory_order_acquire) != nullptr) return;
+    if (array != array_.load(std::memory_order_acquire)) return; // A resize already finished
+    BucketArray* next = new BucketArray(array->capacity_ * 2);
+    BucketArray* expected = nullptr;
+    if (!array->next_.compare_exchange_strong(expected, next, std::memory_order_acq_rel)) delete next;
+}
+
+// Moves one chunk of buckets if array is being resized. The writer that moves the last bucket
+//  publishes the next array and retires this one.
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::HelpResize_(BucketArray *array) {
+    if (array->next_.load(std::memory_order_acquire) == nullptr) return;
+    std::size_t first = array->claim_index_.fetch_add(kMigrationChunk, std::memory_order_relaxed);
+    if (first >= array->capacity_) return;
+    std::size_t last = first + kMigrationChunk < array->capacity_ ? first + kMigrationChunk : array->capacity_;
+    for (std::size_t i = first; i < last; i++) {
+        MoveBucket_(array, i);
+    }
+    if (array->moved_count_.fetch_add(last - first, std::memory_order_acq_rel) + (last - first) == array->capacity_) {
+        array_.store(array->next_.load(std::memory_order_acquire), std::memory_order_release);
+        EpochDomain::Global().Retire(array, &DeleteArray_);
+    }
+}
+
+// Splits bucket index of array into buckets index and index + capacity of the next array, then
+//  forwards it. The new chains are made of new nodes pointing at the same items, because readers
+//  may still be walking the old chain.
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::MoveBucket_(BucketArray *array, std::size_t index) {
+    BucketArray* next = array->next_.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lock(stripes_[index & (kStripeCount - 1)].mutex_);
+    // Nobody reaches these two buckets of next until this one is forwarded
+    Node* node = array->heads_[index].load(std::memory_order_relaxed);
+    while (node != nullptr) {
+        std::size_t target = Hash_(node->item_->key_) & (next->capacity_ - 1);
+        next->heads_[target].store(new Node(node->item_, next->heads_[target].load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        Node* old_node = node;
+        node = node->next_.load(std::memory_order_relaxed);
+        EpochDomain::Global().Retire(old_node, &DeleteNode_);
+    }
+    // Release publishes the new chains to anyone who follows the marker
+    array->heads_[index].store(Forwarded_(), std::memory_order_release);
+}
+
+template<typename Key, typename Value>
+typename ConcurrentHashTable<Key, Value>::Node* ConcurrentHashTable<Key, Value>::Forwarded_() {
+    static Node marker(nullptr, nullptr);
+    return &marker;
+}
+
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::DeleteNode_(void *node) {
+    delete static_cast<Node*>(node);
+}
+
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::DeleteItem_(void *item) {
+    delete static_cast<Item*>(item);
+}
+
+template<typename Key, typename Value>
+void ConcurrentHashTable<Key, Value>::DeleteArray_(void *array) {
+    delete static_cast<BucketArray*>(array);
+}
+
+#endif // !CONCURRENT_HASH_TABLE_H
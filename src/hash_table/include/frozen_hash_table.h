@@ -0,0 +1,211 @@
+#ifndef FROZEN_HASH_TABLE_H
+#define FROZEN_HASH_TABLE_H
+
+#include "hash_table.h"
+#include "frozen_slots.h"
+#include "perfect_hash.h"
+#include <cstddef> //std::size_t
+#include <cstdint>
+#include <iterator> //std::begin, std::end
+#include <stdexcept> //std::invalid_argument
+#include <utility> //std::pair, std::move
+#include <vector>
+
+// Read-only table built once from a finished HashTable. A minimal perfect hash function (see
+//  perfect_hash.h) gives every key its own slot in [0, size()), so there are no buckets, empty
+//  slots or chains: items sit in one array indexed by slot, and a lookup computes the slot,
+//  compares that one key and is done. std::string keys are packed into one character buffer
+//  (see frozen_slots.h) and come back as std::string_view.
+//
+// Find, FindMany, begin and end work like HashTable's, except that items are const. Nothing
+//  can be inserted or deleted; build a HashTable and freeze it again instead.
+template <typename Key, typename Value, typename Hash = HashTableHash<Key>>
+class FrozenHashTable : private HashTableCounters<kHashTableStatsEnabled> {
+public:
+    typedef Key KeyType;
+    typedef Value ValueType;
+    // const Key&, or std::string_view for std::string keys
+    typedef typename FrozenSlots<Key, Value>::KeyReference KeyReference;
+
+    class Iterator {
+    public:
+        Iterator(const FrozenHashTable& table, std::size_t slot) : table_(&table), slot_(slot) {}
+        Iterator& operator++() {
+            ++slot_;
+            return *this;
+        }
+        std::pair<KeyReference, const Value&> operator*() const {
+            return {table_->slots_.GetKey(slot_), table_->slots_.GetValue(slot_)};
+        }
+        bool operator==(const Iterator& right) const { return table_ == right.table_ && slot_ == right.slot_; }
+        bool operator!=(const Iterator& right) const { return !(*this == right); }
+    private:
+        const FrozenHashTable* table_;
+        std::size_t slot_;
+    };
+
+    FrozenHashTable() = default;
+    // Moves every item out of table, leaving it empty. If two keys hash alike under hasher the
+    //  table is left as it was and std::invalid_argument is thrown; with a 64-bit hash that
+    //  takes about 2^32 keys, or a hasher that ignores part of the key.
+    template <typename Layout, template <typename> class NodeAllocator, typename TableHash>
+    explicit FrozenHashTable(HashTable<Key, Value, Layout, NodeAllocator, TableHash>&& table, const Hash& hasher = Hash());
+    // From a range of pairs (anything with .first and .second). Later duplicates overwrite
+    //  earlier ones, as in HashTable.
+    template <typename ForwardIt>
+    FrozenHashTable(ForwardIt first, ForwardIt last, const Hash& hasher = Hash());
+
+    Iterator Find(const Key& key) const;
+    // Lookup without building a Key, for key types the hash policy accepts (see hash_policy.h)
+    template <typename K, EnableIfTransparentLookup<Key, K, Hash> = 0>
+    Iterator Find(const K& key) const;
+    // Like HashTable::FindMany: hashes and prefetches a few keys ahead of the one it resolves
+    template <typename KeyRange, typename OutputIt>
+    void FindMany(const KeyRange& keys, OutputIt out) const;
+    // Items come in slot order, which depends on the keys only
+    Iterator begin() const;
+    Iterator end() const;
+
+    std::size_t size() const;
+    // Always size(): every slot is full
+    std::size_t capacity() const;
+    // Every item is found in one probe, so the histogram has a single entry at 1
+    HashTableStats GetStats() const;
+
+private:
+    /////// BEGIN SETTINGS
+    // Keys between each FindMany stage: hashing, slot prefetch and resolving
+    static constexpr std::size_t kPrefetchDistance = 8;
+    /////// END SETTINGS
+
+    template <typename K>
+    Iterator Find_(const K& key, std::size_t slot) const;
+    template <typename K>
+    uint64_t Hash_(const K& key) const;
+
+    Hash hasher_;
+    HashTableKeyEqual<Key> key_equal_;
+    perfect_hash::Function function_;
+    FrozenSlots<Key, Value> slots_;
+};
+
+template<typename Key, typename Value, typename Hash>
+template<typename Layout, template <typename> class NodeAllocator, typename TableHash>
+FrozenHashTable<Key, Value, Hash>::FrozenHashTable(HashTable<Key, Value, Layout, NodeAllocator, TableHash> &&table, const Hash &hasher)
+    : hasher_(hasher) {
+    // Built from the hashes first, so that a failure leaves table untouched
+    std::vector<uint64_t> hashes;
+    hashes.reserve(table.size());
+    for (auto && item : table) hashes.push_back(Hash_(item.first));
+    if (!function_.Build(hashes)) {
+        throw std::invalid_argument("FrozenHashTable: keys with equal hashes can't be told apart");
+    }
+    // Iteration order doesn't change in between, so item i still has hashes[i]
+    std::vector<Key> keys;
+    std::vector<Value> values;
+    keys.reserve(table.size());
+    values.reserve(table.size());
+    std::vector<std::size_t> order(table.size());
+    for (auto && item : table) {
+        order[function_.Slot(hashes[keys.size()])] = keys.size();
+        keys.push_back(std::move(item.first));
+        values.push_back(std::move(item.second));
+    }
+    table = HashTable<Key, Value, Layout, NodeAllocator, TableHash>();
+    slots_.Assign(keys, values, order);
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename ForwardIt>
+FrozenHashTable<Key, Value, Hash>::FrozenHashTable(ForwardIt first, ForwardIt last, const Hash &hasher)
+    : FrozenHashTable(HashTable<Key, Value>(first, last), hasher) {}
+
+template<typename Key, typename Value, typename Hash>
+typename FrozenHashTable<Key, Value, Hash>::Iterator FrozenHashTable<Key, Value, Hash>::Find(const Key &key) const {
+    if (slots_.size() == 0) return end();
+    return Find_(key, function_.Slot(Hash_(key)));
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename K, EnableIfTransparentLookup<Key, K, Hash>>
+typename FrozenHashTable<Key, Value, Hash>::Iterator FrozenHashTable<Key, Value, Hash>::Find(const K &key) const {
+    if (slots_.size() == 0) return end();
+    return Find_(key, function_.Slot(Hash_(key)));
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename KeyRange, typename OutputIt>
+void FrozenHashTable<Key, Value, Hash>::FindMany(const KeyRange &keys, OutputIt out) const {
+    // Key i is hashed (and its displacement prefetched) at step i - 2 * kPrefetchDistance, has
+    //  its slot computed and prefetched at step i - kPrefetchDistance and is resolved at step i.
+    //  Its hash, then its slot, stays in ring[i % (2 * kPrefetchDistance)] in between.
+    constexpr std::size_t kRingSize = 2 * kPrefetchDistance;
+    uint64_t ring[kRingSize];
+    auto hash_lead = std::begin(keys);
+    auto last = std::end(keys);
+    std::size_t hashed = 0, slotted = 0, resolved = 0;
+    for (auto current = std::begin(keys);; ++current, ++resolved) {
+        for (; hashed < resolved + kRingSize && hash_lead != last; ++hashed, ++hash_lead) {
+            ring[hashed % kRingSize] = Hash_(*hash_lead);
+            PrefetchForRead(function_.DisplacementAddress(ring[hashed % kRingSize]));
+        }
+        for (; slotted < resolved + kPrefetchDistance && slotted < hashed; ++slotted) {
+            if (slots_.size() == 0) continue;
+            std::size_t slot = function_.Slot(ring[slotted % kRingSize]);
+            ring[slotted % kRingSize] = slot;
+            PrefetchForRead(slots_.SlotAddress(slot));
+        }
+        if (current == last) break;
+        *out++ = slots_.size() == 0 ? end() : Find_(*current, static_cast<std::size_t>(ring[resolved % kRingSize]));
+    }
+}
+
+template<typename Key, typename Value, typename Hash>
+typename FrozenHashTable<Key, Value, Hash>::Iterator FrozenHashTable<Key, Value, Hash>::begin() const {
+    return Iterator(*this, 0);
+}
+
+template<typename Key, typename Value, typename Hash>
+typename FrozenHashTable<Key, Value, Hash>::Iterator FrozenHashTable<Key, Value, Hash>::end() const {
+    return Iterator(*this, slots_.size());
+}
+
+template<typename Key, typename Value, typename Hash>
+std::size_t FrozenHashTable<Key, Value, Hash>::size() const {
+    return slots_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+std::size_t FrozenHashTable<Key, Value, Hash>::capacity() const {
+    return slots_.size();
+}
+
+template<typename Key, typename Value, typename Hash>
+HashTableStats FrozenHashTable<Key, Value, Hash>::GetStats() const {
+    HashTableStats stats;
+    stats.table_count = 1;
+    stats.size = slots_.size();
+    stats.capacity = slots_.size();
+    stats.chain_length_histogram[1] = slots_.size();
+    stats.longest_chain = slots_.size() == 0 ? 0 : 1;
+    stats.array_bytes = function_.MemoryBytes() + slots_.ArrayBytes();
+    stats.heap_bytes = slots_.HeapBytes();
+    this->ReportCounters(stats);
+    return stats;
+}
+
+// The only key key can be is the one in its slot
+template<typename Key, typename Value, typename Hash>
+template<typename K>
+typename FrozenHashTable<Key, Value, Hash>::Iterator FrozenHashTable<Key, Value, Hash>::Find_(const K &key, std::size_t slot) const {
+    this->CountLookup(1);
+    return key_equal_(slots_.GetKey(slot), key) ? Iterator(*this, slot) : end();
+}
+
+template<typename Key, typename Value, typename Hash>
+template<typename K>
+uint64_t FrozenHashTable<Key, Value, Hash>::Hash_(const K &key) const {
+    return static_cast<uint64_t>(hasher_(key));
+}
+
+#endif // !FROZEN_HASH_TABLE_H
@@ -2,154 +2,431 @@
 #define HASH_TABLE_H
 
 #include "hash_table_container.h"
-#include <functional> //std::hash
+#include "hash_policy.h"
+#include "hash_table_stats.h"
+#include "node_pool.h"
+#include "occupancy_bitmap.h"
+#include "prefetch.h"
+#include <algorithm> //std::min, std::max
+#include <cstddef> //std::size_t
+#include <cstdint> //uint64_t
+#include <iterator> //std::distance, std::begin, std::end
+#include <new> // placement new
 #include <stdexcept> // out_of_range error when dereferencing invalid iterator
-#include <utility> //std::pair
+#include <utility> //std::pair, std::forward
 
-template <typename Key, typename Value>
+// Storage policies, selected through HashTable's Layout parameter.
+// ChainedLayout: bucket heads live in one array, colliding items are linked out-of-array nodes.
+// FlatLayout: open addressing, items live in one array and are probed 16 control bytes at a
+//  time (see flat_hash_table.h).
+struct ChainedLayout {};
+struct FlatLayout {};
+
+template <typename Table>
 class Iterator;
 
-template <typename Key, typename Value>
-class HashTable {
+// NodeAllocator provides storage for the out-of-array nodes of the chained layout (see
+//  node_pool.h). Each table owns its own allocator. The flat layout has no nodes and ignores it.
+// Hash maps keys to std::size_t (see hash_policy.h). The default for std::string is a seeded
+//  wyhash-style hash; HashDistributionReport (hash_distribution.h) checks how a hasher spreads
+//  a given key set.
+// GetStats() reports chain lengths and memory use, plus lookup and rehash counters when built
+//  with HASH_TABLE_STATS (see hash_table_stats.h).
+template <typename Key, typename Value, typename Layout = ChainedLayout,
+          template <typename> class NodeAllocator = NodePool, typename Hash = HashTableHash<Key>>
+class HashTable : private HashTableCounters<kHashTableStatsEnabled> {
 public:
+    typedef Key KeyType;
+    typedef Value ValueType;
+
     HashTable();
     ~HashTable();
 
     HashTable(const HashTable& other);
+    HashTable(HashTable&& other) noexcept;
+    // Uses hasher instead of a default-constructed Hash, e.g. HashTableHash<std::string>(seed)
+    explicit HashTable(const Hash& hasher);
+    // Builds the table from a range of pairs (anything with .first and .second), allocating
+    //  the final capacity once instead of growing through every intermediate size.
+    template <typename ForwardIt>
+    HashTable(ForwardIt first, ForwardIt last);
 
-    Iterator<Key, Value> Find(const Key &key);
+    // Const like begin(), so const tables (e.g. the values of a FrozenHashTable) can be searched.
+    //  The value can still be changed through the iterator.
+    Iterator<HashTable> Find(const Key &key) const;
+    // Lookup without building a Key, for key types the hash policy accepts (see hash_policy.h)
+    template <typename K, EnableIfTransparentLookup<Key, K, Hash> = 0>
+    Iterator<HashTable> Find(const K &key) const;
+    // Looks up every key in keys (a range of Key, or of a key type the hash policy accepts) and
+    //  writes one iterator per key to out, end() for keys that aren't present. Buckets are
+    //  prefetched a few keys ahead of the one being resolved, so the cache misses of a batch
+    //  overlap instead of being paid one after another. Iterators can't be assigned, so out
+    //  should construct them, e.g. std::back_inserter(vector).
+    template <typename KeyRange, typename OutputIt>
+    void FindMany(const KeyRange& keys, OutputIt out) const;
     void Insert(const Key& key, const Value& value);
+    // Moves value (and key) into the table instead of copying them
+    void Insert(const Key& key, Value&& value);
+    void Insert(Key&& key, Value&& value);
+    // Constructs the value in place from value_args, replacing any existing value for key.
+    //  Returns the item and whether key was newly inserted.
+    template <typename... Args>
+    std::pair<Iterator<HashTable>, bool> Emplace(const Key& key, Args&&... value_args);
+    template <typename... Args>
+    std::pair<Iterator<HashTable>, bool> Emplace(Key&& key, Args&&... value_args);
+    // Like Emplace, but if key already exists nothing is constructed and its value is kept.
+    template <typename... Args>
+    std::pair<Iterator<HashTable>, bool> TryEmplace(const Key& key, Args&&... value_args);
+    template <typename... Args>
+    std::pair<Iterator<HashTable>, bool> TryEmplace(Key&& key, Args&&... value_args);
     void Delete(const Key& key);
-    Iterator<Key, Value> begin() const;
-    Iterator<Key, Value> end() const;
+    template <typename K, EnableIfTransparentLookup<Key, K, Hash> = 0>
+    void Delete(const K& key);
+    Iterator<HashTable> begin() const;
+    Iterator<HashTable> end() const;
 
-    unsigned int size() const;
-    unsigned int capacity() const;
+    std::size_t size() const;
+    std::size_t capacity() const;
     float GetLoadFactor() const;
+    // Grows the table so that item_count items fit without a rehash. Never shrinks.
+    void Reserve(std::size_t item_count);
+    // In incremental mode a rehash is spread over the following Insert, Emplace, TryEmplace and
+    //  Delete calls: each one first initializes part of the new array, and once that is done
+    //  moves a few old buckets into it. Lookups check both arrays until the move is done. This
+    //  bounds the cost of any single insert. Turning the mode off finishes a rehash in progress.
+    //  Off by default.
+    void SetIncrementalRehash(bool enabled);
+    // True while an incremental rehash is in progress
+    bool IsRehashing() const;
+    // Walks every bucket, so it costs about as much as iterating the table
+    HashTableStats GetStats() const;
 
     HashTable& operator=(const HashTable& other);
     HashTable& operator=(HashTable&& other) noexcept;
 
 private:
-    friend Iterator<Key, Value>;
+    friend Iterator<HashTable>;
 
     /////// BEGIN SETTINGS
     // Rehash threshold
-    static constexpr unsigned int kMaxContainerDepth = 2;
+    static constexpr std::size_t kMaxContainerDepth = 2;
     static constexpr float kMaxLoadFactor = 0.7;
-    static constexpr unsigned int kMaxTableCapacity = 32768;
+    // A chain longer than kMaxContainerDepth only causes a rehash once the table is at least
+    //  this full. Without a floor, a handful of keys sharing a hash would double the table
+    //  on every insert.
+    static constexpr float kMinLoadFactorForDepthRehash = 0.5;
+    // Work done per mutating operation during an incremental rehash: buckets of the new array
+    //  initialized, then old buckets moved. Both phases together must finish within the ~0.7 *
+    //  old capacity inserts it takes to need the next doubling: 2 / 16 + 1 / 4 of that is 0.375.
+    static constexpr std::size_t kInitBucketsPerStep = 16;
+    static constexpr std::size_t kMigrationBucketsPerStep = 4;
+    // Keys FindMany hashes and prefetches ahead of the one it is resolving
+    static constexpr std::size_t kPrefetchDistance = 8;
     /////// END SETTINGS
 
-    int FindValidNode_(int start_index) const;
-    void Rehash_();
+    // Index/depth value meaning "no such node"
+    static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+    std::size_t FindValidNode_(std::size_t start_index) const;
+    std::size_t FindFirstValidNode_() const;
+    void ResetFirstOccupied_(std::size_t start_index);
+    void Rehash_(std::size_t new_size, HashTableContainer<Key, Value>** tracked_node = nullptr);
+    void MoveBucket_(HashTableContainer<Key, Value>& head, HashTableContainer<Key, Value> *destination_array, std::size_t array_size,
+                     OccupancyBitmap& destination_occupancy, HashTableContainer<Key, Value>** tracked_node = nullptr);
+    void StartIncrementalRehash_(std::size_t new_size);
+    void RehashStep_(std::size_t init_count, std::size_t migration_count);
+    void FinishRehash_();
+    static HashTableContainer<Key, Value>* AllocateArray_(std::size_t array_size);
+    static void FreeArray_(HashTableContainer<Key, Value>* array, std::size_t first, std::size_t last);
     void UpdateLoadFactor_();
-    bool RequireRehash_(int new_node_index);
-    unsigned int GetNextSize_() const;
-
-    std::pair<int, bool> InsertAt_(HashTableContainer<Key, Value> *destination_array, unsigned int array_size,
-                                   const Key &key, const Value &value);
-    std::pair<int, bool> InsertAt_(HashTableContainer<Key, Value> *destination_array, unsigned int array_size, HashTableContainer<Key, Value>&& source);
-    HashTableContainer<Key, Value>* Get(int index, int depth = 0) const;
-    void DeleteAt_(int index, int depth);
-    std::pair<int, int> Find_(const Key &key);
-    int GetPotentialIndex_(const Key &key);
-    int GetPotentialIndexUnsized(const Key &key, unsigned int table_capacity);
-
-    std::hash<Key> hasher_;
+    bool RequireRehash_(std::size_t new_node_index);
+    std::size_t GetNextSize_() const;
+    std::size_t GetReserveSize_(std::size_t item_count) const;
+
+    template <typename K, typename... Args>
+    std::pair<Iterator<HashTable>, bool> Emplace_(bool assign, K&& key, Args&&... value_args);
+    template <typename K, typename... Args>
+    std::pair<HashTableContainer<Key, Value>*, bool> InsertAt_(std::size_t index, std::size_t hash, bool assign, K&& key, Args&&... value_args);
+    HashTableContainer<Key, Value>* MoveHeadInto_(HashTableContainer<Key, Value> *destination_array, std::size_t array_size,
+                                                  OccupancyBitmap& destination_occupancy, HashTableContainer<Key, Value>& head);
+    HashTableContainer<Key, Value>* RelinkNodeInto_(HashTableContainer<Key, Value> *destination_array, std::size_t array_size,
+                                                    OccupancyBitmap& destination_occupancy, HashTableContainer<Key, Value>* node);
+    template <typename... Args>
+    HashTableContainer<Key, Value>* NewNode_(Args&&... args);
+    void DeleteNode_(HashTableContainer<Key, Value>* node);
+    void Release_();
+    HashTableContainer<Key, Value>* Get(std::size_t index, std::size_t depth = 0) const;
+    void DeleteAt_(std::size_t index, std::size_t depth);
+    template <typename K>
+    Iterator<HashTable> FindIterator_(const K &key, std::size_t hash) const;
+    template <typename K>
+    void Delete_(const K &key);
+    template <typename K>
+    std::pair<std::size_t, std::size_t> Find_(const K &key, std::size_t hash) const;
+    std::size_t GetPotentialIndex_(std::size_t hash) const;
+    std::size_t GetPotentialIndexUnsized(std::size_t hash, std::size_t table_capacity) const;
+    std::size_t GetNodeHash_(const HashTableContainer<Key, Value>& node) const;
+    bool NodeHashMatches_(const HashTableContainer<Key, Value>& node, std::size_t hash) const;
+    template <typename K>
+    bool NodeMatches_(const HashTableContainer<Key, Value>& node, std::size_t hash, const K& key) const;
+    void PrefetchChain_(const HashTableContainer<Key, Value>& head, std::size_t hash) const;
+
+    Hash hasher_;
+    HashTableKeyEqual<Key> key_equal_;
+    NodeAllocator<HashTableContainer<Key, Value>> node_allocator_;
     HashTableContainer<Key, Value>* container_array_;
-    unsigned int size_;
-    unsigned int capacity_;
+    // Which heads of container_array_ hold an item. Iteration skips empty buckets with it.
+    OccupancyBitmap occupancy_;
+    // No bucket below this index is occupied (it may be lower than the first occupied one).
+    //  Kept up by the calls that change the table, so begin() skips the empty start of the
+    //  table without writing anything.
+    std::size_t first_occupied_;
+    std::size_t size_;
+    std::size_t capacity_;
+    // Array being emptied by an incremental rehash, or nullptr. Buckets below migrate_index_
+    //  have already been moved. To Get() and the iterator, its buckets follow the current
+    //  array's: index capacity_ + i is old bucket i.
+    HashTableContainer<Key, Value>* old_array_;
+    OccupancyBitmap old_occupancy_;
+    std::size_t old_capacity_;
+    std::size_t migrate_index_;
+    // Raw storage for the next array of an incremental rehash, or nullptr. Only its first
+    //  pending_initialized_ buckets are constructed. It replaces the current array once all are.
+    HashTableContainer<Key, Value>* pending_array_;
+    std::size_t pending_capacity_;
+    std::size_t pending_initialized_;
+    bool incremental_rehash_;
     float load_factor_;
+    // Item count promised by Reserve(). Long chains don't trigger a rehash below this size.
+    std::size_t reserved_;
 };
 
 
 // Iterator Definition
-template <typename Key, typename Value>
+template <typename Table>
 class Iterator {
+    typedef typename Table::KeyType Key;
+    typedef typename Table::ValueType Value;
 public:
     Iterator() = delete; // No default constructor, reference to table is required
     ~Iterator() = default;    // destructor
     Iterator(const Iterator& other) = default; // copy constructor
 
     // parameterized constructor for non-iterable iterator (returned by find())
-    Iterator(const HashTable<Key, Value>& main_table, HashTableContainer<Key, Value>* current_node);
+    Iterator(const Table& main_table, HashTableContainer<Key, Value>* current_node);
 
     // parameterized constructor for iterable iterator (used by range-based for loops)
-    explicit Iterator(const HashTable<Key, Value>& main_table);
-    //Iterator<Key, Value>& operator=(Iterator<Key,Value>& right); // Copy assignment
-    Iterator<Key, Value>& operator++(); // pre-increment operator
+    explicit Iterator(const Table& main_table);
+    //Iterator<Table>& operator=(Iterator<Table>& right); // Copy assignment
+    Iterator<Table>& operator++(); // pre-increment operator
     std::pair<Key&,Value&> operator*() const; // de-reference operator
-    bool operator!=(const Iterator<Key, Value>& right) const; // inequality operator
-    bool operator==(const Iterator<Key, Value>& right) const;
+    bool operator!=(const Iterator<Table>& right) const; // inequality operator
+    bool operator==(const Iterator<Table>& right) const;
 private:
-    friend HashTable<Key, Value>;
-    // index of -1 indicates a non-iterable iter-inator (a platypus?)
-    int index_;
+    friend Table;
+    // index of kNotFound indicates a non-iterable iter-inator (a platypus?)
+    std::size_t index_;
     HashTableContainer<Key, Value>* current_node_;
-    const HashTable<Key, Value>& main_table_;
+    const Table& main_table_;
 };
 
 /*
-template<typename Key, typename Value>
-Iterator<Key, Value>::Iterator() {
+template<typename Table>
+Iterator<Table>::Iterator() {
     index_ = -1;
     current_node_ = nullptr;
     main_table_ = nullptr;
 }
 */
 
-template<typename Key, typename Value>
-HashTable<Key, Value>::HashTable() {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, Layout, NodeAllocator, Hash>::HashTable() {
     size_ = 0;
     capacity_ = 0;
+    reserved_ = 0;
     UpdateLoadFactor_();
     container_array_ = nullptr;
+    first_occupied_ = 0;
+    old_array_ = nullptr;
+    old_capacity_ = 0;
+    migrate_index_ = 0;
+    pending_array_ = nullptr;
+    pending_capacity_ = 0;
+    pending_initialized_ = 0;
+    incremental_rehash_ = false;
 }
 
-template<typename Key, typename Value>
-HashTable<Key, Value>::~HashTable() {
-    for (int i = 0; i < capacity(); i++) {
-        HashTableContainer<Key, Value>* current_node = &container_array_[i];
-        HashTableContainer<Key, Value>* temp_ptr = nullptr;
-        if (current_node->IsValid() && current_node->GetNext() != nullptr) {
-                current_node = current_node->GetNext(); // Skip node in array
-            while (current_node != nullptr) {
-                temp_ptr = current_node->GetNext();
-                delete current_node;
-                current_node = temp_ptr;
-            }
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, Layout, NodeAllocator, Hash>::~HashTable() {
+    Release_();
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, Layout, NodeAllocator, Hash>::HashTable(const HashTable &other) : HashTable() {
+    *this = other;
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, Layout, NodeAllocator, Hash>::HashTable(HashTable &&other) noexcept : HashTable() {
+    *this = std::move(other);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, Layout, NodeAllocator, Hash>::HashTable(const Hash &hasher) : HashTable() {
+    hasher_ = hasher;
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename ForwardIt>
+HashTable<Key, Value, Layout, NodeAllocator, Hash>::HashTable(ForwardIt first, ForwardIt last) : HashTable() {
+    Reserve(static_cast<std::size_t>(std::distance(first, last)));
+    for (; first != last; ++first) {
+        Insert(first->first, first->second);
+    }
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>> HashTable<Key, Value, Layout, NodeAllocator, Hash>::Find(const Key &key) const {
+    return FindIterator_(key, hasher_(key));
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K, EnableIfTransparentLookup<Key, K, Hash>>
+Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>> HashTable<Key, Value, Layout, NodeAllocator, Hash>::Find(const K &key) const {
+    return FindIterator_(key, hasher_(key));
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename KeyRange, typename OutputIt>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::FindMany(const KeyRange &keys, OutputIt out) const {
+    // Key i is hashed and its bucket head prefetched at step i - 2 * kPrefetchDistance. At step
+    //  i - kPrefetchDistance, when the head has arrived, the data of the head's key (or the
+    //  next node, if the head's cached hash doesn't match) is prefetched. Key i is resolved at
+    //  step i. Its hash stays in hashes[i % (2 * kPrefetchDistance)] in between.
+    constexpr std::size_t kRingSize = 2 * kPrefetchDistance;
+    std::size_t hashes[kRingSize];
+    auto hash_lead = std::begin(keys);
+    auto last = std::end(keys);
+    std::size_t hashed = 0, head_read = 0, resolved = 0;
+    for (auto current = std::begin(keys);; ++current, ++resolved) {
+        for (; hashed < resolved + kRingSize && hash_lead != last; ++hashed, ++hash_lead) {
+            std::size_t& hash = hashes[hashed % kRingSize];
+            hash = hasher_(*hash_lead);
+            if (capacity_ != 0) PrefetchForRead(&container_array_[GetPotentialIndex_(hash)]);
+        }
+        for (; head_read < resolved + kPrefetchDistance && head_read < hashed; ++head_read) {
+            if (capacity_ != 0) PrefetchChain_(container_array_[GetPotentialIndex_(hashes[head_read % kRingSize])], hashes[head_read % kRingSize]);
         }
+        if (current == last) break;
+        *out++ = FindIterator_(*current, hashes[resolved % kRingSize]);
     }
-    //delete[] container_array_;
 }
 
-template<typename Key, typename Value>
-HashTable<Key, Value>::HashTable(const HashTable &other) {
-    *this = other;
+// Second FindMany stage for a bucket whose head was prefetched: the memory a lookup of hash
+//  reads next.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::PrefetchChain_(const HashTableContainer<Key, Value> &head, std::size_t hash) const {
+    if (!head.IsValid()) return;
+    if (NodeHashMatches_(head, hash)) PrefetchKeyData(head.GetKey());
+    else if (head.GetNext() != nullptr) PrefetchForRead(head.GetNext());
 }
 
-template<typename Key, typename Value>
-Iterator<Key, Value> HashTable<Key, Value>::Find(const Key &key) {
-    std::pair<int, int> location = Find_(key);
-    if (location.first != -1 && location.second != -1) {
-        return Iterator<Key, Value>(*this, this->Get(location.first, location.second));
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>> HashTable<Key, Value, Layout, NodeAllocator, Hash>::FindIterator_(const K &key, std::size_t hash) const {
+    std::pair<std::size_t, std::size_t> location = Find_(key, hash);
+    if (location.first != kNotFound && location.second != kNotFound) {
+        return Iterator<HashTable>(*this, this->Get(location.first, location.second));
     }
     // else
     return this->end();
 }
 
-template<typename Key, typename Value>
-void HashTable<Key, Value>::Insert(const Key &key, const Value &value) {
-    if (capacity() == 0) Rehash_(); // Rehash on initial insertion, takes the form of solely allocating an initial table
-    std::pair<int, bool> result = InsertAt_(container_array_, this->capacity(), key, value);
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Insert(const Key &key, const Value &value) {
+    Emplace_(true, key, value);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Insert(const Key &key, Value &&value) {
+    Emplace_(true, key, std::move(value));
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Insert(Key &&key, Value &&value) {
+    Emplace_(true, std::move(key), std::move(value));
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, Layout, NodeAllocator, Hash>::Emplace(const Key &key, Args &&... value_args) {
+    return Emplace_(true, key, std::forward<Args>(value_args)...);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, Layout, NodeAllocator, Hash>::Emplace(Key &&key, Args &&... value_args) {
+    return Emplace_(true, std::move(key), std::forward<Args>(value_args)...);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, Layout, NodeAllocator, Hash>::TryEmplace(const Key &key, Args &&... value_args) {
+    return Emplace_(false, key, std::forward<Args>(value_args)...);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, Layout, NodeAllocator, Hash>::TryEmplace(Key &&key, Args &&... value_args) {
+    return Emplace_(false, std::move(key), std::forward<Args>(value_args)...);
+}
+
+// Shared by Insert, Emplace and TryEmplace. assign says whether an existing value is replaced.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K, typename... Args>
+std::pair<Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, Layout, NodeAllocator, Hash>::Emplace_(bool assign, K &&key, Args &&... value_args) {
+    if (capacity() == 0) Rehash_(GetNextSize_()); // Rehash on initial insertion, takes the form of solely allocating an initial table
+    std::size_t hash = hasher_(key);
+    if (IsRehashing()) {
+        RehashStep_(kInitBucketsPerStep, kMigrationBucketsPerStep);
+        // Move key's old bucket now, so the key can only be in the current array
+        if (old_array_ != nullptr) {
+            std::size_t old_index = GetPotentialIndexUnsized(hash, old_capacity_);
+            MoveBucket_(old_array_[old_index], container_array_, capacity(), occupancy_);
+            old_occupancy_.Clear(old_index);
+            first_occupied_ = 0;
+        }
+    }
+    std::size_t index = GetPotentialIndex_(hash);
+    std::pair<HashTableContainer<Key, Value>*, bool> result = InsertAt_(index, hash, assign, std::forward<K>(key), std::forward<Args>(value_args)...);
     if (!result.second /*if no key collision*/) {++size_;UpdateLoadFactor_();}
-    if (RequireRehash_(result.first /*index*/)) {Rehash_();}
+    // The key may have been moved into the table, so the rehash keeps track of its node instead
+    //  of the item being looked up again afterwards. An incremental rehash doesn't move it yet.
+    // A rehash already in progress is left to finish first.
+    if (RequireRehash_(index)) {
+        if (!incremental_rehash_) Rehash_(GetNextSize_(), &result.first);
+        else if (!IsRehashing()) StartIncrementalRehash_(GetNextSize_());
+    }
+    return std::make_pair(Iterator<HashTable>(*this, result.first), !result.second);
 }
 
-template<typename Key, typename Value>
-void HashTable<Key, Value>::Delete(const Key &key) {
-    std::pair<int, int> location = Find_(key);
-    if (location.first != -1 && location.second != -1) {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Delete(const Key &key) {
+    Delete_(key);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K, EnableIfTransparentLookup<Key, K, Hash>>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Delete(const K &key) {
+    Delete_(key);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Delete_(const K &key) {
+    if (IsRehashing()) RehashStep_(kInitBucketsPerStep, kMigrationBucketsPerStep);
+    std::pair<std::size_t, std::size_t> location = Find_(key, hasher_(key));
+    if (location.first != kNotFound && location.second != kNotFound) {
         DeleteAt_(location.first, location.second);
         --size_;
         UpdateLoadFactor_();
@@ -160,101 +437,267 @@ void HashTable<Key, Value>::Delete(const Key &key) {
 //  form a linked list longer than kMaxContainerDepth. This edge case will not be handled
 //  automatically, and will instead be caught if another container is inserted at that index.
 //
-// This implementation is very inefficient, as it de-allocates and re-allocates the out-of-array nodes when they could
-//  simply be re-used. However, doing so (with my current implementation) would require traversing a singly-linked list backwards and
-//  would only affect the efficiency during re-hashes (of which there are only 15 that are relevant given current max table size)
-template<typename Key, typename Value>
-void HashTable<Key, Value>::Rehash_() {
-    unsigned int new_size = GetNextSize_();
-    if (new_size == capacity()) return; // Don't rehash if new table size is same as old one.
-    HashTableContainer<Key, Value>* new_table = new HashTableContainer<Key, Value>[new_size];
-    if (new_table == nullptr) return; // Dynamic allocation failed, don't rehash
-    for (Iterator<Key, Value> item = this->begin(); item != this->end(); ++item)
-    {
-        this->InsertAt_(new_table, new_size, std::move(*(item.current_node_)));
+// If tracked_node is given, it is updated to the new location of the item it points to.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Rehash_(std::size_t new_size, HashTableContainer<Key, Value>** tracked_node) {
+    if (IsRehashing()) FinishRehash_();
+    RehashTimer timer(*this);
+    HashTableContainer<Key, Value>* new_table = AllocateArray_(new_size);
+    OccupancyBitmap new_occupancy;
+    new_occupancy.Reset(new_size);
+    for (std::size_t i = FindValidNode_(0); i != kNotFound; i = FindValidNode_(i + 1)) {
+        this->MoveBucket_(container_array_[i], new_table, new_size, new_occupancy, tracked_node);
     }
+    FreeArray_(container_array_, 0, capacity());
     this->capacity_ = new_size;
-    delete[] container_array_;
     this->container_array_ = new_table;
+    occupancy_ = std::move(new_occupancy);
+    ResetFirstOccupied_(0);
+    UpdateLoadFactor_();
+    this->CountRehash();
+}
 
+// Moves every item of the chain starting at head into destination_array and leaves head empty.
+// Out-of-array nodes are re-used: each one is unlinked from its old chain and linked into its
+//  new one, so the only copies made are of the items stored in the old array itself.
+// If tracked_node is given, it is updated to the new location of the item it points to.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::MoveBucket_(HashTableContainer<Key, Value> &head, HashTableContainer<Key, Value> *destination_array, std::size_t array_size,
+                                                        OccupancyBitmap &destination_occupancy, HashTableContainer<Key, Value> **tracked_node) {
+    if (!head.IsValid()) return;
+    // Read the rest of the chain before the head is moved out
+    HashTableContainer<Key, Value>* current_node = head.GetNext();
+    HashTableContainer<Key, Value>* new_location = this->MoveHeadInto_(destination_array, array_size, destination_occupancy, head);
+    if (tracked_node != nullptr && *tracked_node == &head) *tracked_node = new_location;
+    while (current_node != nullptr && current_node->IsValid()) {
+        HashTableContainer<Key, Value>* next_node = current_node->GetNext();
+        new_location = this->RelinkNodeInto_(destination_array, array_size, destination_occupancy, current_node);
+        if (tracked_node != nullptr && *tracked_node == current_node) *tracked_node = new_location;
+        current_node = next_node;
+    }
+    head.SetNext(nullptr);
 }
 
-// Returns std::pair<int, bool>.
-// int (first) is index of head of linked list containing inserted node.
-// bool (second) is true iff a valid node containing that key already exists (and has been overwritten)
-template<typename Key, typename Value>
-std::pair<int, bool> HashTable<Key, Value>::InsertAt_(HashTableContainer<Key, Value> *destination_array,
-                                                      unsigned int array_size, const Key &key, const Value &value) {
-    // Internal function. Does not verify inputs. (array_size being 0, destination_array being nullptr...)
-    unsigned int potential_index = GetPotentialIndexUnsized(key, array_size);
-    HashTableContainer<Key, Value>* current_node = &destination_array[potential_index];
-    HashTableContainer<Key, Value>* previous_node = nullptr;
+// Begins an incremental rehash. Only allocates the new array; initializing it is left to
+//  RehashStep_, as constructing millions of buckets at once is itself a long stall.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::StartIncrementalRehash_(std::size_t new_size) {
+    pending_array_ = static_cast<HashTableContainer<Key, Value>*>(::operator new(new_size * sizeof(HashTableContainer<Key, Value>)));
+    pending_capacity_ = new_size;
+    pending_initialized_ = 0;
+}
 
-    while (current_node != nullptr) {
-        if (current_node->GetKey() == key || !current_node->IsValid()) {
-            // Override previous value if node with same key already exists,
-            //  or if an invalid node that can contain the new node is found.
-            bool node_was_valid = current_node->IsValid();
-            *current_node = HashTableContainer<Key, Value>(key, value);
-            return std::make_pair(potential_index, node_was_valid);
+// Advances an incremental rehash. While the pending array is being initialized, constructs up
+//  to init_count of its buckets and swaps it in once all are done. After that, moves up to
+//  migration_count old buckets into the current array, and frees the old array once it is empty.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::RehashStep_(std::size_t init_count, std::size_t migration_count) {
+    RehashTimer timer(*this);
+    if (pending_array_ != nullptr) {
+        std::size_t end = std::min(pending_capacity_, pending_initialized_ + init_count);
+        for (; pending_initialized_ < end; pending_initialized_++) {
+            new (&pending_array_[pending_initialized_]) HashTableContainer<Key, Value>();
         }
+        if (pending_initialized_ < pending_capacity_) return;
+        old_array_ = container_array_;
+        old_occupancy_ = std::move(occupancy_);
+        old_capacity_ = capacity_;
+        migrate_index_ = 0;
+        container_array_ = pending_array_;
+        occupancy_.Reset(pending_capacity_);
+        first_occupied_ = 0;
+        capacity_ = pending_capacity_;
+        pending_array_ = nullptr;
+        pending_capacity_ = 0;
+        pending_initialized_ = 0;
+        UpdateLoadFactor_();
+        return;
+    }
+    // Moved buckets are destroyed right away, so freeing the old array at the end costs nothing
+    //  per bucket.
+    // Their bits are left set; iteration starts past migrate_index_ anyway.
+    for (std::size_t moved = 0; moved < migration_count && migrate_index_ < old_capacity_; moved++) {
+        MoveBucket_(old_array_[migrate_index_], container_array_, capacity(), occupancy_);
+        old_array_[migrate_index_++].~HashTableContainer<Key, Value>();
+        first_occupied_ = 0;
+    }
+    if (old_array_ != nullptr && migrate_index_ == old_capacity_) {
+        FreeArray_(old_array_, 0, 0);
+        old_array_ = nullptr;
+        old_occupancy_.Reset(0);
+        old_capacity_ = 0;
+        migrate_index_ = 0;
+        // Lowered to 0 while buckets were moved, as where they went isn't tracked
+        ResetFirstOccupied_(0);
+        this->CountRehash();
+    }
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::FinishRehash_() {
+    if (pending_array_ != nullptr) RehashStep_(pending_capacity_, 0);
+    RehashStep_(0, old_capacity_);
+}
+
+// Arrays are raw storage with every bucket constructed in place, so that an incremental rehash
+//  can construct its array a piece at a time and still free it the same way.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTableContainer<Key, Value>* HashTable<Key, Value, Layout, NodeAllocator, Hash>::AllocateArray_(std::size_t array_size) {
+    HashTableContainer<Key, Value>* array = static_cast<HashTableContainer<Key, Value>*>(::operator new(array_size * sizeof(HashTableContainer<Key, Value>)));
+    for (std::size_t i = 0; i < array_size; i++) {
+        new (&array[i]) HashTableContainer<Key, Value>();
+    }
+    return array;
+}
+
+// Destroys the buckets in [first, last), the ones still constructed, and frees array.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::FreeArray_(HashTableContainer<Key, Value> *array, std::size_t first, std::size_t last) {
+    if (array == nullptr) return;
+    for (std::size_t i = first; i < last; i++) {
+        array[i].~HashTableContainer<Key, Value>();
+    }
+    ::operator delete(array);
+}
 
+// Returns std::pair<HashTableContainer*, bool>.
+// HashTableContainer* (first) is the node now holding key.
+// bool (second) is true iff a valid node containing that key already exists. Its value is
+//  replaced with one constructed from value_args if assign is true, and left alone otherwise.
+// New items are constructed in place, in the head at index or in a new node at the end of its chain.
+// hash is hasher_(key), stored in the new node when hashes are cached.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K, typename... Args>
+std::pair<HashTableContainer<Key, Value>*, bool> HashTable<Key, Value, Layout, NodeAllocator, Hash>::InsertAt_(std::size_t index, std::size_t hash, bool assign, K &&key, Args &&... value_args) {
+    // Internal function. Does not verify inputs. (index being out of range, capacity being 0...)
+    HashTableContainer<Key, Value>* current_node = &container_array_[index];
+    HashTableContainer<Key, Value>* previous_node = nullptr;
+    while (current_node != nullptr && current_node->IsValid()) {
+        if (NodeMatches_(*current_node, hash, key)) {
+            // Override previous value if node with same key already exists
+            if (assign) current_node->GetValueRef() = Value(std::forward<Args>(value_args)...);
+            return std::make_pair(current_node, true);
+        }
         previous_node = current_node;
         current_node = current_node->GetNext();
-        /* redesign rendered this unnecessary
-        // True if we reach the end of the linked list (or if linked list is empty)
-        if (!current_node->IsValid()) {
-            // Current node is linked list HEAD
-            if (previous_node == nullptr) {
-                *current_node = HashTableContainer<Key, Value>(key, value);
-                return std::make_pair(potential_index, false);
-            } else if
+    }
+    if (previous_node == nullptr) {
+        // Empty bucket. Only heads are ever invalid, so this is the node in the array.
+        // If construction throws, the head is put back as an empty node before rethrowing.
+        current_node->~HashTableContainer<Key, Value>();
+        try {
+            new (current_node) HashTableContainer<Key, Value>(std::piecewise_construct, std::forward<K>(key), std::forward<Args>(value_args)...);
+        } catch (...) {
+            new (current_node) HashTableContainer<Key, Value>();
+            throw;
         }
-        */
+        current_node->SetHash(hash);
+        occupancy_.Set(index);
+        if (index < first_occupied_) first_occupied_ = index;
+        return std::make_pair(current_node, false);
     }
-    // True iff we reach the end of a non-zero-length linked list. previous_node will not be nullptr.
-    previous_node->SetNext(new HashTableContainer<Key, Value>(key, value));
-    return std::make_pair(potential_index, false);
+    // We reached the end of a non-zero-length linked list. previous_node will not be nullptr.
+    current_node = NewNode_(std::piecewise_construct, std::forward<K>(key), std::forward<Args>(value_args)...);
+    current_node->SetHash(hash);
+    previous_node->SetNext(current_node);
+    return std::make_pair(current_node, false);
 }
 
-template<typename Key, typename Value>
-std::pair<int, bool> HashTable<Key, Value>::InsertAt_(HashTableContainer<Key, Value> *destination_array, unsigned int array_size, HashTableContainer<Key, Value>&& source) {
-    // Internal function. Does not verify inputs. (array_size being 0, destination_array being nullptr...)
-    unsigned int potential_index = GetPotentialIndexUnsized(source.GetKey(), array_size);
-    HashTableContainer<Key, Value>* current_node = &destination_array[potential_index];
-    HashTableContainer<Key, Value>* previous_node = nullptr;
+// Moves an item out of the old array into destination_array during a rehash. The item takes
+//  the head of its new bucket if that is free, otherwise it gets a node right behind the head.
+// Returns the item's new location.
+// Internal function. Does not verify inputs, and assumes the key is not in destination_array.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTableContainer<Key, Value>* HashTable<Key, Value, Layout, NodeAllocator, Hash>::MoveHeadInto_(HashTableContainer<Key, Value> *destination_array, std::size_t array_size,
+                                                                                        OccupancyBitmap &destination_occupancy, HashTableContainer<Key, Value>& head) {
+    std::size_t bucket = GetPotentialIndexUnsized(GetNodeHash_(head), array_size);
+    HashTableContainer<Key, Value>* new_head = &destination_array[bucket];
+    if (!new_head->IsValid()) {
+        destination_occupancy.Set(bucket);
+        *new_head = std::move(head);
+        new_head->SetNext(nullptr);
+        return new_head;
+    }
+    HashTableContainer<Key, Value>* new_node = NewNode_(std::move(head));
+    new_node->SetNext(new_head->GetNext());
+    new_head->SetNext(new_node);
+    return new_node;
+}
 
-    while (current_node != nullptr) {
-        if (current_node->GetKey() == source.GetKey() || !current_node->IsValid()) {
-            // Override previous value if node with same key already exists,
-            //  or if an invalid node that can contain the new node is found.
-            bool node_was_valid = current_node->IsValid();
-            *current_node = std::move(source);
-            current_node->SetNext(nullptr);
-            return std::make_pair(potential_index, node_was_valid);
-        }
+// Links an existing out-of-array node into destination_array during a rehash, right behind
+//  the head of its new bucket. If that bucket is empty the item moves into the head instead
+//  and the node goes back to the allocator. Returns the item's new location.
+// Internal function. Does not verify inputs, and assumes the key is not in destination_array.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTableContainer<Key, Value>* HashTable<Key, Value, Layout, NodeAllocator, Hash>::RelinkNodeInto_(HashTableContainer<Key, Value> *destination_array, std::size_t array_size,
+                                                                                          OccupancyBitmap &destination_occupancy, HashTableContainer<Key, Value>* node) {
+    std::size_t bucket = GetPotentialIndexUnsized(GetNodeHash_(*node), array_size);
+    HashTableContainer<Key, Value>* new_head = &destination_array[bucket];
+    if (!new_head->IsValid()) {
+        destination_occupancy.Set(bucket);
+        *new_head = std::move(*node);
+        new_head->SetNext(nullptr);
+        DeleteNode_(node);
+        return new_head;
+    }
+    node->SetNext(new_head->GetNext());
+    new_head->SetNext(node);
+    return node;
+}
 
-        previous_node = current_node;
-        current_node = current_node->GetNext();
-        /* redesign rendered this unnecessary
-        // True if we reach the end of the linked list (or if linked list is empty)
-        if (!current_node->IsValid()) {
-            // Current node is linked list HEAD
-            if (previous_node == nullptr) {
-                *current_node = HashTableContainer<Key, Value>(key, value);
-                return std::make_pair(potential_index, false);
-            } else if
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+HashTableContainer<Key, Value>* HashTable<Key, Value, Layout, NodeAllocator, Hash>::NewNode_(Args&&... args) {
+    HashTableContainer<Key, Value>* node = node_allocator_.Allocate();
+    try {
+        new (node) HashTableContainer<Key, Value>(std::forward<Args>(args)...);
+    } catch (...) {
+        node_allocator_.Deallocate(node);
+        throw;
+    }
+    return node;
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::DeleteNode_(HashTableContainer<Key, Value>* node) {
+    node->~HashTableContainer<Key, Value>();
+    node_allocator_.Deallocate(node);
+}
+
+// Destroys every item and frees the array, leaving an empty table with capacity 0.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Release_() {
+    for (std::size_t i = FindValidNode_(0); i != kNotFound; i = FindValidNode_(i + 1)) {
+        HashTableContainer<Key, Value>* current_node = this->Get(i)->GetNext(); // Skip node in array
+        while (current_node != nullptr) {
+            HashTableContainer<Key, Value>* next_node = current_node->GetNext();
+            DeleteNode_(current_node);
+            current_node = next_node;
         }
-        */
     }
-    // True iff we reach the end of a non-zero-length linked list. previous_node will not be nullptr.
-    previous_node->SetNext(new HashTableContainer<Key, Value>(source));
-    return std::make_pair(potential_index, false);
+    FreeArray_(container_array_, 0, capacity());
+    container_array_ = nullptr;
+    occupancy_.Reset(0);
+    first_occupied_ = 0;
+    FreeArray_(old_array_, migrate_index_, old_capacity_);
+    old_array_ = nullptr;
+    old_occupancy_.Reset(0);
+    old_capacity_ = 0;
+    migrate_index_ = 0;
+    // Pending buckets are all empty, so they hold no nodes
+    FreeArray_(pending_array_, 0, pending_initialized_);
+    pending_array_ = nullptr;
+    pending_capacity_ = 0;
+    pending_initialized_ = 0;
+    size_ = 0;
+    capacity_ = 0;
+    reserved_ = 0;
+    UpdateLoadFactor_();
 }
 
 // As this is an internal function, it is assumed that the index and depth values are already verified.
-template<typename Key, typename Value>
-void HashTable<Key, Value>::DeleteAt_(int index, int depth) {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::DeleteAt_(std::size_t index, std::size_t depth) {
     HashTableContainer<Key, Value>* head_node = this->Get(index);
     HashTableContainer<Key, Value>* current_node = head_node->GetIndex(depth);
     HashTableContainer<Key, Value>* next_node = current_node->GetNext();
@@ -265,16 +708,15 @@ void HashTable<Key, Value>::DeleteAt_(int index, int depth) {
         //  leaving it here anyway just in case.
         if (next_node != nullptr && next_node->IsValid()) {
             // There is a next item
-            *current_node = *next_node; // Replace current node with next node
-            // Delete out-of-array copy of next_node.
-            // I could have designed this better by having a dedicated linked-list class
-            //  rather than linked nodes. As-is, a destructed node will call the destructor of the
-            //  next node in the list if the current node is valid when destructed.
-            next_node->SetInvalid();
-            delete next_node;
+            *current_node = std::move(*next_node); // Replace current node with next node (next_node's link included)
+            // Return the now empty out-of-array node to the allocator.
+            DeleteNode_(next_node);
         } else {
             // There is no next item. We cannot delete the current node, as it is part of the container array.
             current_node->SetInvalid();
+            if (index < capacity()) occupancy_.Clear(index);
+            else old_occupancy_.Clear(index - capacity());
+            if (index == first_occupied_) ResetFirstOccupied_(index + 1);
         }
     } else {
         // Update previous node to point at next node
@@ -282,123 +724,265 @@ void HashTable<Key, Value>::DeleteAt_(int index, int depth) {
         previous_node->SetNext(next_node);
 
         // Delete current node
-        current_node->SetInvalid();
-        delete current_node;
+        DeleteNode_(current_node);
     }
 }
 
-template<typename Key, typename Value>
-std::pair<int, int> HashTable<Key, Value>::Find_(const Key &key) {
-    //if (this->capacity() == 0) return std::make_pair(-1, -1); // State validation should occur in public functions
-    int potential_index = GetPotentialIndex_(key);
-    int depth = 0;
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+std::pair<std::size_t, std::size_t> HashTable<Key, Value, Layout, NodeAllocator, Hash>::Find_(const K &key, std::size_t hash) const {
+    //if (this->capacity() == 0) return std::make_pair(kNotFound, kNotFound); // State validation should occur in public functions
+    std::size_t potential_index = GetPotentialIndex_(hash);
+    std::size_t depth = 0;
     HashTableContainer<Key,Value>* current_node = this->Get(potential_index);
     while (current_node != nullptr && current_node->IsValid()) {
-        if (current_node->GetKey() == key) {return std::make_pair(potential_index, depth);}
+        if (NodeMatches_(*current_node, hash, key)) {
+            this->CountLookup(depth + 1);
+            return std::make_pair(potential_index, depth);
+        }
+        current_node = current_node->GetNext();
+        depth++;
+    }
+    if (old_array_ == nullptr) {
+        this->CountLookup(depth);
+        return std::make_pair(kNotFound, kNotFound);
+    }
+    // During an incremental rehash the key may still be in its old bucket
+    std::size_t probes = depth;
+    potential_index = capacity() + GetPotentialIndexUnsized(hash, old_capacity_);
+    depth = 0;
+    current_node = this->Get(potential_index);
+    while (current_node != nullptr && current_node->IsValid()) {
+        if (NodeMatches_(*current_node, hash, key)) {
+            this->CountLookup(probes + depth + 1);
+            return std::make_pair(potential_index, depth);
+        }
         current_node = current_node->GetNext();
         depth++;
     }
-    return std::make_pair(-1, -1);
+    this->CountLookup(probes + depth);
+    return std::make_pair(kNotFound, kNotFound);
 }
 
-template<typename Key, typename Value>
-int HashTable<Key, Value>::GetPotentialIndex_(const Key &key) {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::GetPotentialIndex_(std::size_t hash) const {
     if (capacity_ == 0) {return 0;}
     //else
-    return this->GetPotentialIndexUnsized(key, this->capacity());
+    return this->GetPotentialIndexUnsized(hash, this->capacity());
 }
 
-template <typename Key, typename Value>
-int HashTable<Key, Value>::GetPotentialIndexUnsized(const Key &key, unsigned int table_capacity)
+// Table capacities are always powers of two (see GetNextSize_), so the low bits of the hash
+//  select the bucket and no division is needed.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::GetPotentialIndexUnsized(std::size_t hash, std::size_t table_capacity) const
 {
-    return hasher_(key) % table_capacity;
+    return hash & (table_capacity - 1);
+}
+
+// The stored hash if there is one, so that rehashing never hashes a key again
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::GetNodeHash_(const HashTableContainer<Key, Value> &node) const {
+    if constexpr (HashTableContainer<Key, Value>::kCachesHash) return node.GetHash();
+    else return hasher_(node.GetKey());
 }
 
-template<typename Key, typename Value>
-Iterator<Key, Value> HashTable<Key, Value>::begin() const {
-    return Iterator<Key, Value>(*this);
+// False only if node's cached hash shows it can't hold a key with this hash
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+bool HashTable<Key, Value, Layout, NodeAllocator, Hash>::NodeHashMatches_(const HashTableContainer<Key, Value> &node, std::size_t hash) const {
+    if constexpr (HashTableContainer<Key, Value>::kCachesHash) return node.GetHash() == hash;
+    else return true;
 }
 
-template<typename Key, typename Value>
-Iterator<Key, Value> HashTable<Key, Value>::end() const {
-    return Iterator<Key, Value>(*this,nullptr);
+// With cached hashes, nodes whose hash differs are skipped without comparing keys
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+bool HashTable<Key, Value, Layout, NodeAllocator, Hash>::NodeMatches_(const HashTableContainer<Key, Value> &node, std::size_t hash, const K &key) const {
+    return NodeHashMatches_(node, hash) && key_equal_(node.GetKey(), key);
 }
 
-template<typename Key, typename Value>
-unsigned int HashTable<Key, Value>::size() const{
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>> HashTable<Key, Value, Layout, NodeAllocator, Hash>::begin() const {
+    return Iterator<HashTable>(*this);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+Iterator<HashTable<Key, Value, Layout, NodeAllocator, Hash>> HashTable<Key, Value, Layout, NodeAllocator, Hash>::end() const {
+    return Iterator<HashTable>(*this,nullptr);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::size() const{
     return size_;
 }
 
-template<typename Key, typename Value>
-unsigned int HashTable<Key, Value>::capacity() const{
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::capacity() const{
     return capacity_;
 }
 
-template<typename Key, typename Value>
-float HashTable<Key, Value>::GetLoadFactor() const{
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+float HashTable<Key, Value, Layout, NodeAllocator, Hash>::GetLoadFactor() const{
     return load_factor_;
 }
 
-template<typename Key, typename Value>
-HashTable<Key, Value> & HashTable<Key, Value>::operator=(const HashTable &other) {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::Reserve(std::size_t item_count) {
+    if (item_count > reserved_) reserved_ = item_count;
+    std::size_t new_size = GetReserveSize_(item_count);
+    if (new_size > capacity()) Rehash_(new_size);
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::SetIncrementalRehash(bool enabled) {
+    incremental_rehash_ = enabled;
+    if (!enabled && IsRehashing()) FinishRehash_();
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+bool HashTable<Key, Value, Layout, NodeAllocator, Hash>::IsRehashing() const {
+    return pending_array_ != nullptr || old_array_ != nullptr;
+}
+
+// During an incremental rehash, the old buckets not yet moved count as chains as well.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTableStats HashTable<Key, Value, Layout, NodeAllocator, Hash>::GetStats() const {
+    HashTableStats stats;
+    stats.table_count = 1;
+    stats.size = size_;
+    stats.capacity = capacity_;
+    std::size_t occupied = 0;
+    for (std::size_t i = FindValidNode_(0); i != kNotFound; i = FindValidNode_(i + 1)) {
+        std::size_t length = 0;
+        for (const HashTableContainer<Key, Value>* node = this->Get(i); node != nullptr && node->IsValid(); node = node->GetNext()) {
+            stats.heap_bytes += HashTableHeapBytes(node->GetKey()) + HashTableHeapBytes(node->GetValue());
+            length++;
+        }
+        stats.CountChain(length);
+        stats.node_bytes += (length - 1) * sizeof(HashTableContainer<Key, Value>);
+        occupied++;
+    }
+    stats.chain_length_histogram[0] += capacity_ + old_capacity_ - migrate_index_ - occupied;
+    stats.array_bytes = (capacity_ + old_capacity_ + pending_capacity_) * sizeof(HashTableContainer<Key, Value>)
+                        + (capacity_ + 63) / 64 * sizeof(uint64_t) + (old_capacity_ + 63) / 64 * sizeof(uint64_t);
+    this->ReportCounters(stats);
+    return stats;
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, Layout, NodeAllocator, Hash> & HashTable<Key, Value, Layout, NodeAllocator, Hash>::operator=(const HashTable &other) {
     if (this == &other) {return *this;}
+    Release_();
+    hasher_ = other.hasher_;
+    incremental_rehash_ = other.incremental_rehash_;
+    if (other.capacity() == 0) {return *this;}
     size_ = other.size();
     capacity_ = other.capacity();
+    reserved_ = other.reserved_;
     UpdateLoadFactor_();
-    container_array_ = new HashTableContainer<Key, Value>[capacity()];
-    for (int i = 0; i < capacity(); i++) {
-        HashTableContainer<Key, Value>* current_node = other.Get(i);
-        container_array_[i] = *current_node;
-        for (int depth = 0;; depth++) {
-         if (current_node->IsValid() && current_node->GetNext() != nullptr) {
-             HashTableContainer<Key, Value>* next_node = current_node->GetNext();
-             HashTableContainer<Key, Value>* new_node = new HashTableContainer<Key, Value>(*next_node);
-             current_node->SetNext(new_node);
-             current_node = new_node;
-         }   else {
-             break;
-         }
+    container_array_ = AllocateArray_(capacity());
+    occupancy_ = other.occupancy_; // Same buckets are occupied in the copy
+    for (std::size_t i = other.occupancy_.FindNext(0, capacity()); i != capacity(); i = other.occupancy_.FindNext(i + 1, capacity())) {
+        HashTableContainer<Key, Value>* source_node = other.Get(i);
+        // Copy the chain node by node. The copied nodes still point into other's chain, so
+        //  every link is rewritten as the copy is built.
+        HashTableContainer<Key, Value>* current_node = &container_array_[i];
+        *current_node = *source_node;
+        for (source_node = source_node->GetNext(); source_node != nullptr && source_node->IsValid(); source_node = source_node->GetNext()) {
+            HashTableContainer<Key, Value>* new_node = NewNode_(*source_node);
+            current_node->SetNext(new_node);
+            current_node = new_node;
+        }
+        current_node->SetNext(nullptr);
+    }
+    // Items other hasn't moved out of its old array yet go straight to their buckets here
+    for (std::size_t i = other.capacity() + other.migrate_index_; i < other.capacity() + other.old_capacity_; i++) {
+        for (HashTableContainer<Key, Value>* source_node = other.Get(i); source_node != nullptr && source_node->IsValid(); source_node = source_node->GetNext()) {
+            std::size_t hash = GetNodeHash_(*source_node);
+            InsertAt_(GetPotentialIndex_(hash), hash, true, source_node->GetKey(), source_node->GetValue());
         }
     }
+    ResetFirstOccupied_(0);
     return *this;
 }
 
-template<typename Key, typename Value>
-HashTable<Key, Value> & HashTable<Key, Value>::operator=(HashTable &&other) noexcept {
-    this->~HashTable();
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, Layout, NodeAllocator, Hash> & HashTable<Key, Value, Layout, NodeAllocator, Hash>::operator=(HashTable &&other) noexcept {
+    if (this == &other) {return *this;}
+    Release_();
+    hasher_ = other.hasher_;
+    // The nodes belong to other's allocator, so the allocators are exchanged along with them.
+    node_allocator_.Swap(other.node_allocator_);
     this->container_array_ = other.container_array_;
     other.container_array_ = nullptr;
+    occupancy_ = std::move(other.occupancy_);
+    first_occupied_ = other.first_occupied_;
+    other.first_occupied_ = 0;
+    old_array_ = other.old_array_;
+    other.old_array_ = nullptr;
+    old_occupancy_ = std::move(other.old_occupancy_);
+    old_capacity_ = other.old_capacity_;
+    migrate_index_ = other.migrate_index_;
+    pending_array_ = other.pending_array_;
+    other.pending_array_ = nullptr;
+    pending_capacity_ = other.pending_capacity_;
+    pending_initialized_ = other.pending_initialized_;
+    incremental_rehash_ = other.incremental_rehash_;
+    other.old_capacity_ = 0;
+    other.migrate_index_ = 0;
+    other.pending_capacity_ = 0;
+    other.pending_initialized_ = 0;
     capacity_ = other.capacity();
     size_ = other.size();
+    reserved_ = other.reserved_;
     other.capacity_ = 0;
     other.size_ = 0;
+    other.reserved_ = 0;
     UpdateLoadFactor_();
+    other.UpdateLoadFactor_();
     return *this;
 }
 
-template<typename Key, typename Value>
-int HashTable<Key, Value>::FindValidNode_(int start_index) const {
-    if (start_index < 0 || start_index >= this->capacity()) {return -1;}
-    while (this->Get(start_index) != nullptr) {
-        if (this->Get(start_index)->IsValid()) {
-            return start_index;
-        }
-        start_index++;
+// Index of the first occupied bucket at or after start_index, read from the occupancy bitmaps
+//  rather than the buckets themselves.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::FindValidNode_(std::size_t start_index) const {
+    if (start_index < this->capacity()) {
+        std::size_t index = occupancy_.FindNext(start_index, this->capacity());
+        if (index != this->capacity()) return index;
+        start_index = this->capacity();
     }
-    // Loop breaks if a valid node is found. If no valid nodes are found, return -1.
-    return -1;
+    if (start_index >= this->capacity() + old_capacity_) {return kNotFound;}
+    // Old buckets below migrate_index_ have been moved and destroyed
+    std::size_t old_index = std::max(start_index - this->capacity(), migrate_index_);
+    old_index = old_occupancy_.FindNext(old_index, old_capacity_);
+    if (old_index == old_capacity_) return kNotFound;
+    return this->capacity() + old_index;
+}
+
+// FindValidNode_(0), starting from first_occupied_
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::FindFirstValidNode_() const {
+    return FindValidNode_(first_occupied_);
+}
+
+// Sets first_occupied_ to the first occupied bucket at or after start_index, below which none
+//  is occupied, or past the last bucket if there is none.
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::ResetFirstOccupied_(std::size_t start_index) {
+    std::size_t index = FindValidNode_(start_index);
+    first_occupied_ = index == kNotFound ? this->capacity() + old_capacity_ : index;
 }
 
-template<typename Key, typename Value>
-void HashTable<Key, Value>::UpdateLoadFactor_() {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, Layout, NodeAllocator, Hash>::UpdateLoadFactor_() {
     if (this->capacity() == 0) load_factor_ = 0;
     else load_factor_ = this->size()/static_cast<float>(this->capacity());
 }
 
-template<typename Key, typename Value>
-bool HashTable<Key, Value>::RequireRehash_(int new_node_index) {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+bool HashTable<Key, Value, Layout, NodeAllocator, Hash>::RequireRehash_(std::size_t new_node_index) {
     // Verify most recent bucket size is less than max
-    int bucket_size = 0;
+    std::size_t bucket_size = 0;
     HashTableContainer<Key, Value>* current_node = this->Get(new_node_index);
     while (current_node != nullptr) {
         if (current_node->IsValid()) {
@@ -408,7 +992,7 @@ bool HashTable<Key, Value>::RequireRehash_(int new_node_index) {
             break;
         }
     }
-    if (bucket_size > kMaxContainerDepth) {
+    if (bucket_size > kMaxContainerDepth && GetLoadFactor() >= kMinLoadFactorForDepthRehash && size() > reserved_) {
         return true;
     }
     // Else
@@ -420,48 +1004,54 @@ bool HashTable<Key, Value>::RequireRehash_(int new_node_index) {
 
 }
 
-template<typename Key, typename Value>
-unsigned int HashTable<Key, Value>::GetNextSize_() const {
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::GetNextSize_() const {
     if (capacity_ == 0) return 1;
     //else
-    if (kMaxTableCapacity == 0) return this->capacity() * 2;
-    //else
-    if (this->capacity() * 2 <= kMaxTableCapacity) return this->capacity() * 2;
-    //else
-    return kMaxTableCapacity; // proposed capacity was greater than kMaxTableCapacity
+    return this->capacity() * 2;
 }
 
-template<typename Key, typename Value>
-HashTableContainer<Key, Value> * HashTable<Key, Value>::Get(int index, int depth) const {
-    if (index < 0 || index >= this->capacity()) return nullptr;
-    HashTableContainer<Key, Value>* current_node = &container_array_[index];
-    for (int i = 0; i < depth; i++) {
+// Smallest (power of two) capacity that holds item_count items without exceeding kMaxLoadFactor
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, Layout, NodeAllocator, Hash>::GetReserveSize_(std::size_t item_count) const {
+    std::size_t new_size = 1;
+    while (item_count > static_cast<double>(new_size) * kMaxLoadFactor) new_size *= 2;
+    return new_size;
+}
+
+template<typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+HashTableContainer<Key, Value> * HashTable<Key, Value, Layout, NodeAllocator, Hash>::Get(std::size_t index, std::size_t depth) const {
+    HashTableContainer<Key, Value>* current_node;
+    if (index < this->capacity()) current_node = &container_array_[index];
+    else if (index - this->capacity() < old_capacity_) current_node = &old_array_[index - this->capacity()];
+    else return nullptr;
+    for (std::size_t i = 0; i < depth; i++) {
         current_node = current_node->GetNext();
     }
     return current_node;
 }
 
-template<typename Key, typename Value>
-Iterator<Key, Value>::Iterator(const HashTable<Key, Value>& main_table, HashTableContainer<Key, Value> *current_node) : main_table_(main_table) {
+template<typename Table>
+Iterator<Table>::Iterator(const Table& main_table, HashTableContainer<Key, Value> *current_node) : main_table_(main_table) {
+    index_ = Table::kNotFound;
     if (main_table.size() == 0 || current_node == nullptr) {
-        index_ = -1;
         current_node_ = nullptr;
         return;
     }
     current_node_ = current_node;
 }
 
-template<typename Key, typename Value>
-Iterator<Key, Value>::Iterator(const HashTable<Key, Value> &main_table) : main_table_(main_table) {
-    index_ = main_table.FindValidNode_(0);
-    if (index_ == -1) current_node_ = nullptr;
+template<typename Table>
+Iterator<Table>::Iterator(const Table &main_table) : main_table_(main_table) {
+    index_ = main_table.FindFirstValidNode_();
+    if (index_ == Table::kNotFound) current_node_ = nullptr;
     else current_node_ = main_table_.Get(index_);
 }
 
-template<typename Key, typename Value>
-Iterator<Key, Value> & Iterator<Key, Value>::operator++() {
+template<typename Table>
+Iterator<Table> & Iterator<Table>::operator++() {
     // If current iterator is non-iterable
-    if (index_ == -1) {
+    if (index_ == Table::kNotFound) {
         current_node_ = nullptr;
         return *this;
     }
@@ -475,19 +1065,19 @@ Iterator<Key, Value> & Iterator<Key, Value>::operator++() {
     // else
     // Find the next valid node in the array. If none are found, invalidate the iterator and set current_node to nullptr
     index_ = main_table_.FindValidNode_(++index_);
-    if (index_ == -1) current_node_ = nullptr;
+    if (index_ == Table::kNotFound) current_node_ = nullptr;
     else current_node_ = main_table_.Get(index_);
     return *this;
 }
 
-template<typename Key, typename Value>
-std::pair<Key&,Value&> Iterator<Key, Value>::operator*() const {
+template<typename Table>
+std::pair<typename Table::KeyType&, typename Table::ValueType&> Iterator<Table>::operator*() const {
     if (current_node_ == nullptr) {throw std::out_of_range("Error, dereferencing invalid iterator");}
     return std::pair<Key&,Value&>(current_node_->GetKeyRef(), current_node_->GetValueRef());
 }
 
-template<typename Key, typename Value>
-bool Iterator<Key, Value>::operator!=(const Iterator<Key, Value> &right) const {
+template<typename Table>
+bool Iterator<Table>::operator!=(const Iterator<Table> &right) const {
     if (this == &right) return false;
     if (this->current_node_ == right.current_node_
         && this->index_ == right.index_
@@ -495,8 +1085,19 @@ bool Iterator<Key, Value>::operator!=(const Iterator<Key, Value> &right) const {
     return true;
 }
 
-template<typename Key, typename Value>
-bool Iterator<Key, Value>::operator==(const Iterator<Key, Value> &right) const {
+template<typename Table>
+bool Iterator<Table>::operator==(const Iterator<Table> &right) const {
     return !(this->operator!=(right));
 }
+
+// A table held as the key or value of another table counts towards that table's heap_bytes
+//  (see HashTableHeapBytes in hash_table_stats.h). Covers both layouts.
+template <typename Key, typename Value, typename Layout, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTableHeapBytes(const HashTable<Key, Value, Layout, NodeAllocator, Hash>& table) {
+    return table.GetStats().TotalBytes();
+}
+
+// Specialization for FlatLayout. Needs the primary template above.
+#include "flat_hash_table.h"
+
 #endif // !HASH_TABLE_H
@@ -0,0 +1,197 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept> // runtime_error when every thread slot is taken
+#include <vector>
+
+// Epoch-based reclamation for ConcurrentHashTable.
+//
+// Readers pin the current epoch for the length of an operation by writing it to their thread's
+//  slot: one load and one store, no loops, so pinning is wait-free. Memory unlinked by a writer
+//  is retired with the epoch it was unlinked in, and only freed once the global epoch has moved
+//  two steps past that. The epoch only moves when every pinned thread has seen the current one,
+//  so no thread that could still hold a pointer to retired memory is left by then.
+//
+// One domain is shared by every table in the process (EpochDomain::Global()), so a thread needs
+//  one slot no matter how many tables it reads.
+class EpochDomain {
+public:
+    /////// BEGIN SETTINGS
+    // Threads that can be registered at once. Registration throws beyond this.
+    static constexpr std::size_t kMaxThreads = 256;
+    // Retired objects collected before a reclamation pass is attempted
+    static constexpr std::size_t kReclaimThreshold = 64;
+    /////// END SETTINGS
+
+    // Pins the epoch of the calling thread for its lifetime. Guards may nest.
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& domain);
+        ~Guard();
+        Guard(const Guard& other) = delete;
+        Guard& operator=(const Guard& other) = delete;
+    private:
+        EpochDomain& domain_;
+        std::size_t slot_;
+    };
+
+    EpochDomain();
+    ~EpochDomain();
+    EpochDomain(const EpochDomain& other) = delete;
+    EpochDomain& operator=(const EpochDomain& other) = delete;
+
+    static EpochDomain& Global();
+
+    // Hands object to the domain, which calls deleter(object) once no pinned thread can see it.
+    void Retire(void* object, void (*deleter)(void*));
+    // Frees everything retired so far. Only safe when no thread is pinned (e.g. in tests).
+    void ReclaimAll();
+
+private:
+    static constexpr uint64_t kQuiescent = UINT64_MAX;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch_{kQuiescent};
+        std::atomic<bool> in_use_{false};
+    };
+    struct Retired {
+        void* object_;
+        void (*deleter_)(void*);
+        uint64_t epoch_;
+    };
+    // The calling thread's slot in this domain, and how deeply it is pinned
+    struct ThreadRecord {
+        EpochDomain* domain_ = nullptr;
+        std::size_t slot_ = 0;
+        std::size_t depth_ = 0;
+        ~ThreadRecord();
+    };
+
+    ThreadRecord& GetThreadRecord_();
+    std::size_t AcquireSlot_();
+    bool TryAdvance_();
+    // Moves everything that is safe to free from retired_ to ready. Caller holds retired_mutex_.
+    //  Deleters run after the lock is released, as they may retire objects themselves.
+    void TakeReclaimable_(std::vector<Retired>& ready);
+
+    std::atomic<uint64_t> global_epoch_;
+    Slot slots_[kMaxThreads];
+    std::mutex retired_mutex_;
+    std::vector<Retired> retired_;
+};
+
+inline EpochDomain::Guard::Guard(EpochDomain &domain) : domain_(domain) {
+    ThreadRecord& record = domain_.GetThreadRecord_();
+    slot_ = record.slot_;
+    if (record.depth_++ == 0) {
+        // seq_cst so that the store is visible before any shared pointer is read
+        domain_.slots_[slot_].epoch_.store(domain_.global_epoch_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    }
+}
+
+inline EpochDomain::Guard::~Guard() {
+    ThreadRecord& record = domain_.GetThreadRecord_();
+    if (--record.depth_ == 0) {
+        domain_.slots_[slot_].epoch_.store(kQuiescent, std::memory_order_release);
+    }
+}
+
+inline EpochDomain::EpochDomain() : global_epoch_(0) {}
+
+inline EpochDomain::~EpochDomain() {
+    ReclaimAll();
+}
+
+inline EpochDomain & EpochDomain::Global() {
+    static EpochDomain domain;
+    return domain;
+}
+
+inline void EpochDomain::Retire(void *object, void (*deleter)(void *)) {
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired_.push_back(Retired{object, deleter, global_epoch_.load(std::memory_order_acquire)});
+        if (retired_.size() >= kReclaimThreshold) {
+            TryAdvance_();
+            TakeReclaimable_(ready);
+        }
+    }
+    for (Retired& retired : ready) {
+        retired.deleter_(retired.object_);
+    }
+}
+
+inline void EpochDomain::ReclaimAll() {
+    // Deleters may retire more objects, so keep going until nothing is left
+    for (;;) {
+        std::vector<Retired> ready;
+        {
+            std::lock_guard<std::mutex> lock(retired_mutex_);
+            ready.swap(retired_);
+        }
+        if (ready.empty()) return;
+        for (Retired& retired : ready) {
+            retired.deleter_(retired.object_);
+        }
+    }
+}
+
+// Thread records are per thread, not per domain. Only the global domain is used in practice;
+//  a thread that switches domains gives up its old slot first.
+inline EpochDomain::ThreadRecord & EpochDomain::GetThreadRecord_() {
+    thread_local ThreadRecord record;
+    if (record.domain_ != this) {
+        if (record.domain_ != nullptr && record.depth_ != 0) {
+            throw std::runtime_error("Error, thread is pinned in another epoch domain");
+        }
+        if (record.domain_ != nullptr) record.domain_->slots_[record.slot_].in_use_.store(false, std::memory_order_release);
+        record.slot_ = AcquireSlot_();
+        record.domain_ = this;
+    }
+    return record;
+}
+
+inline EpochDomain::ThreadRecord::~ThreadRecord() {
+    if (domain_ != nullptr) domain_->slots_[slot_].in_use_.store(false, std::memory_order_release);
+}
+
+inline std::size_t EpochDomain::AcquireSlot_() {
+    for (std::size_t i = 0; i < kMaxThreads; i++) {
+        bool expected = false;
+        if (!slots_[i].in_use_.load(std::memory_order_relaxed)
+            && slots_[i].in_use_.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Error, too many threads registered with the epoch domain");
+}
+
+// Moves the global epoch forward by one if every pinned thread has seen the current one.
+inline bool EpochDomain::TryAdvance_() {
+    uint64_t epoch = global_epoch_.load(std::memory_order_seq_cst);
+    for (Slot& slot : slots_) {
+        uint64_t pinned = slot.epoch_.load(std::memory_order_seq_cst);
+        if (pinned != kQuiescent && pinned != epoch) return false;
+    }
+    return global_epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
+
+inline void EpochDomain::TakeReclaimable_(std::vector<Retired>& ready) {
+    uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+    std::size_t kept = 0;
+    for (Retired& retired : retired_) {
+        if (retired.epoch_ + 2 <= epoch) {
+            ready.push_back(retired);
+        } else {
+            retired_[kept++] = retired;
+        }
+    }
+    retired_.resize(kept);
+}
+
+#endif // !EPOCH_H
@@ -0,0 +1,589 @@
+#ifndef FLAT_HASH_TABLE_H
+#define FLAT_HASH_TABLE_H
+
+// Included at the end of hash_table.h, which declares the primary HashTable template.
+
+#include "flat_hash_table_group.h"
+#include "hash_policy.h"
+#include "hash_table_stats.h"
+#include "prefetch.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator> //std::distance, std::begin, std::end
+#include <new> // placement new
+#include <stdexcept> // out_of_range error when dereferencing invalid iterator
+#include <utility> //std::pair, std::move, std::forward
+
+template <typename Key, typename Value>
+struct FlatHashTableSlot {
+    FlatHashTableSlot(const Key& key, const Value& value) : key_(key), value_(value) {}
+    template <typename K, typename... Args>
+    FlatHashTableSlot(std::piecewise_construct_t, K&& key, Args&&... value_args)
+        : key_(std::forward<K>(key)), value_(std::forward<Args>(value_args)...) {}
+    FlatHashTableSlot(FlatHashTableSlot&& other) = default;
+    Key key_;
+    Value value_;
+};
+
+template <typename Table>
+class FlatIterator;
+
+// Open-addressing storage. Every slot has a control byte holding either kFlatEmpty,
+//  kFlatDeleted, or the low 7 bits (H2) of the hash of the key stored there. The rest of the
+//  hash (H1) picks the first group of 16 slots to probe. A lookup compares H2 against a whole
+//  group at once and only touches the slots that match, so a miss usually reads one group of
+//  control bytes and no keys at all.
+//
+// Groups are aligned and probed in triangular order (+1, +2, +3... groups), which visits every
+//  group exactly once because the group count is a power of two. A probe stops at the first
+//  group that contains an empty slot.
+//
+// Slots live in one array, so the NodeAllocator parameter is only accepted for interface
+//  compatibility with the chained layout.
+template <typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+class HashTable<Key, Value, FlatLayout, NodeAllocator, Hash> : private HashTableCounters<kHashTableStatsEnabled> {
+public:
+    typedef Key KeyType;
+    typedef Value ValueType;
+
+    HashTable();
+    ~HashTable();
+
+    HashTable(const HashTable& other);
+    HashTable(HashTable&& other) noexcept;
+    // Uses hasher instead of a default-constructed Hash, e.g. HashTableHash<std::string>(seed)
+    explicit HashTable(const Hash& hasher);
+    // Builds the table from a range of pairs (anything with .first and .second) at its final size.
+    template <typename ForwardIt>
+    HashTable(ForwardIt first, ForwardIt last);
+
+    FlatIterator<HashTable> Find(const Key &key) const;
+    // Lookup without building a Key, for key types the hash policy accepts (see hash_policy.h)
+    template <typename K, EnableIfTransparentLookup<Key, K, Hash> = 0>
+    FlatIterator<HashTable> Find(const K &key) const;
+    // Looks up every key in keys and writes one iterator per key to out (end() if missing).
+    //  Pipelined in two stages ahead of the key being resolved: first the key's control group
+    //  is prefetched, then, once it has arrived, the slot its H2 matches.
+    template <typename KeyRange, typename OutputIt>
+    void FindMany(const KeyRange& keys, OutputIt out) const;
+    void Insert(const Key& key, const Value& value);
+    // Moves value (and key) into the table instead of copying them
+    void Insert(const Key& key, Value&& value);
+    void Insert(Key&& key, Value&& value);
+    // Constructs the value in place from value_args, replacing any existing value for key.
+    //  Returns the item and whether key was newly inserted.
+    template <typename... Args>
+    std::pair<FlatIterator<HashTable>, bool> Emplace(const Key& key, Args&&... value_args);
+    template <typename... Args>
+    std::pair<FlatIterator<HashTable>, bool> Emplace(Key&& key, Args&&... value_args);
+    // Like Emplace, but if key already exists nothing is constructed and its value is kept.
+    template <typename... Args>
+    std::pair<FlatIterator<HashTable>, bool> TryEmplace(const Key& key, Args&&... value_args);
+    template <typename... Args>
+    std::pair<FlatIterator<HashTable>, bool> TryEmplace(Key&& key, Args&&... value_args);
+    void Delete(const Key& key);
+    template <typename K, EnableIfTransparentLookup<Key, K, Hash> = 0>
+    void Delete(const K& key);
+    FlatIterator<HashTable> begin() const;
+    FlatIterator<HashTable> end() const;
+
+    std::size_t size() const;
+    std::size_t capacity() const;
+    float GetLoadFactor() const;
+    // Grows the table so that item_count items fit without a rehash. Never shrinks.
+    void Reserve(std::size_t item_count);
+    // Probe lengths are found by hashing every key again, so this costs more than iterating
+    HashTableStats GetStats() const;
+
+    HashTable& operator=(const HashTable& other);
+    HashTable& operator=(HashTable&& other) noexcept;
+
+private:
+    friend FlatIterator<HashTable>;
+    typedef FlatHashTableSlot<Key, Value> Slot;
+
+    /////// BEGIN SETTINGS
+    // Rehash once full + deleted slots would exceed kMaxLoadNumerator / kMaxLoadDenominator
+    static constexpr std::size_t kMaxLoadNumerator = 7;
+    static constexpr std::size_t kMaxLoadDenominator = 8;
+    // Keys between each FindMany stage: hashing, slot prefetch and resolving
+    static constexpr std::size_t kPrefetchDistance = 8;
+    /////// END SETTINGS
+
+    static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+    template <typename K>
+    FlatIterator<HashTable> FindIterator_(const K &key) const;
+    void PrefetchGroup_(std::size_t hash) const;
+    void PrefetchSlot_(std::size_t hash) const;
+    template <typename K>
+    void Delete_(const K &key);
+    template <typename K, typename... Args>
+    std::pair<FlatIterator<HashTable>, bool> Emplace_(bool assign, K&& key, Args&&... value_args);
+    template <typename K>
+    std::size_t Find_(const K &key, std::size_t hash) const;
+    std::size_t FindInsertSlot_(std::size_t hash) const;
+    std::size_t FindFullSlot_(std::size_t start_index) const;
+    void Rehash_(std::size_t new_capacity);
+    void Release_();
+    std::size_t MaxLoad_() const;
+    template <typename K>
+    std::size_t Hash_(const K &key) const;
+
+    Hash hasher_;
+    HashTableKeyEqual<Key> key_equal_;
+    int8_t* control_;
+    Slot* slots_;
+    std::size_t size_;
+    std::size_t deleted_;
+    std::size_t capacity_;
+};
+
+// Iterator Definition
+template <typename Table>
+class FlatIterator {
+    typedef typename Table::KeyType Key;
+    typedef typename Table::ValueType Value;
+public:
+    FlatIterator() = delete; // No default constructor, reference to table is required
+    ~FlatIterator() = default;
+    FlatIterator(const FlatIterator& other) = default;
+
+    // index == main_table.capacity() is the end iterator
+    FlatIterator(const Table& main_table, std::size_t index);
+
+    FlatIterator<Table>& operator++(); // pre-increment operator
+    std::pair<Key&,Value&> operator*() const; // de-reference operator
+    bool operator!=(const FlatIterator<Table>& right) const;
+    bool operator==(const FlatIterator<Table>& right) const;
+private:
+    const Table* main_table_;
+    std::size_t index_;
+};
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::HashTable()
+    : control_(nullptr), slots_(nullptr), size_(0), deleted_(0), capacity_(0) {}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::~HashTable() {
+    Release_();
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::HashTable(const HashTable &other) : HashTable() {
+    *this = other;
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::HashTable(HashTable &&other) noexcept : HashTable() {
+    *this = std::move(other);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::HashTable(const Hash &hasher) : HashTable() {
+    hasher_ = hasher;
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename ForwardIt>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::HashTable(ForwardIt first, ForwardIt last) : HashTable() {
+    Reserve(static_cast<std::size_t>(std::distance(first, last)));
+    for (; first != last; ++first) {
+        Insert(first->first, first->second);
+    }
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Find(const Key &key) const {
+    return FindIterator_(key);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename K, EnableIfTransparentLookup<Key, K, Hash>>
+FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Find(const K &key) const {
+    return FindIterator_(key);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename KeyRange, typename OutputIt>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::FindMany(const KeyRange &keys, OutputIt out) const {
+    // Key i is hashed (and its group prefetched) at step i - 2 * kPrefetchDistance, has its
+    //  slot prefetched at step i - kPrefetchDistance and is resolved at step i. Its hash stays
+    //  in hashes[i % (2 * kPrefetchDistance)] in between.
+    constexpr std::size_t kRingSize = 2 * kPrefetchDistance;
+    std::size_t hashes[kRingSize];
+    auto hash_lead = std::begin(keys);
+    auto last = std::end(keys);
+    std::size_t hashed = 0, slot_prefetched = 0, resolved = 0;
+    for (auto current = std::begin(keys);; ++current, ++resolved) {
+        for (; hashed < resolved + kRingSize && hash_lead != last; ++hashed, ++hash_lead) {
+            hashes[hashed % kRingSize] = Hash_(*hash_lead);
+            PrefetchGroup_(hashes[hashed % kRingSize]);
+        }
+        for (; slot_prefetched < resolved + kPrefetchDistance && slot_prefetched < hashed; ++slot_prefetched) {
+            PrefetchSlot_(hashes[slot_prefetched % kRingSize]);
+        }
+        if (current == last) break;
+        std::size_t index = Find_(*current, hashes[resolved % kRingSize]);
+        *out++ = index == kNotFound ? this->end() : FlatIterator<HashTable>(*this, index);
+    }
+}
+
+// First group on hash's probe sequence
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::PrefetchGroup_(std::size_t hash) const {
+    if (capacity_ == 0) return;
+    const std::size_t group_mask = capacity_ / FlatHashTableGroup::kWidth - 1;
+    PrefetchForRead(control_ + ((hash >> 7) & group_mask) * FlatHashTableGroup::kWidth);
+}
+
+// First slot of hash's first group whose control byte matches its H2, if any. Reads the group,
+//  so it should already have been prefetched.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::PrefetchSlot_(std::size_t hash) const {
+    if (capacity_ == 0) return;
+    const std::size_t group_mask = capacity_ / FlatHashTableGroup::kWidth - 1;
+    const std::size_t group_start = ((hash >> 7) & group_mask) * FlatHashTableGroup::kWidth;
+    FlatBitMask match = FlatHashTableGroup(control_ + group_start).Match(static_cast<int8_t>(hash & 0x7F));
+    if (match.Any()) PrefetchForRead(&slots_[group_start + match.Lowest()]);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::FindIterator_(const K &key) const {
+    std::size_t index = Find_(key, Hash_(key));
+    if (index == kNotFound) return this->end();
+    return FlatIterator<HashTable>(*this, index);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Insert(const Key &key, const Value &value) {
+    Emplace_(true, key, value);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Insert(const Key &key, Value &&value) {
+    Emplace_(true, key, std::move(value));
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Insert(Key &&key, Value &&value) {
+    Emplace_(true, std::move(key), std::move(value));
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Emplace(const Key &key, Args &&... value_args) {
+    return Emplace_(true, key, std::forward<Args>(value_args)...);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Emplace(Key &&key, Args &&... value_args) {
+    return Emplace_(true, std::move(key), std::forward<Args>(value_args)...);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::TryEmplace(const Key &key, Args &&... value_args) {
+    return Emplace_(false, key, std::forward<Args>(value_args)...);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename... Args>
+std::pair<FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::TryEmplace(Key &&key, Args &&... value_args) {
+    return Emplace_(false, std::move(key), std::forward<Args>(value_args)...);
+}
+
+// Shared by Insert, Emplace and TryEmplace. assign says whether an existing value is replaced.
+//  New items are constructed directly in their slot.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename K, typename... Args>
+std::pair<FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>>, bool> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Emplace_(bool assign, K &&key, Args &&... value_args) {
+    std::size_t hash = Hash_(key);
+    std::size_t index = Find_(key, hash);
+    if (index != kNotFound) {
+        // Key collision, overwrite previous value
+        if (assign) slots_[index].value_ = Value(std::forward<Args>(value_args)...);
+        return std::make_pair(FlatIterator<HashTable>(*this, index), false);
+    }
+    if (size_ + deleted_ + 1 > MaxLoad_()) {
+        // Grow if the table is genuinely full. If tombstones are what filled it, rebuilding at
+        //  the same capacity is enough to clear them.
+        if (capacity_ == 0) Rehash_(FlatHashTableGroup::kWidth);
+        else if (size_ + 1 > MaxLoad_() / 2) Rehash_(capacity_ * 2);
+        else Rehash_(capacity_);
+    }
+    index = FindInsertSlot_(hash);
+    new (&slots_[index]) Slot(std::piecewise_construct, std::forward<K>(key), std::forward<Args>(value_args)...);
+    if (control_[index] == kFlatDeleted) --deleted_;
+    control_[index] = static_cast<int8_t>(hash & 0x7F);
+    ++size_;
+    return std::make_pair(FlatIterator<HashTable>(*this, index), true);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Delete(const Key &key) {
+    Delete_(key);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename K, EnableIfTransparentLookup<Key, K, Hash>>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Delete(const K &key) {
+    Delete_(key);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Delete_(const K &key) {
+    std::size_t index = Find_(key, Hash_(key));
+    if (index == kNotFound) return;
+    slots_[index].~Slot();
+    --size_;
+    // Probes stop at the first group with an empty slot. If this slot's group already has one,
+    //  no probe ever continued past this group and the slot can go straight back to empty.
+    FlatHashTableGroup group(control_ + (index & ~(FlatHashTableGroup::kWidth - 1)));
+    if (group.MatchEmpty().Any()) {
+        control_[index] = kFlatEmpty;
+    } else {
+        control_[index] = kFlatDeleted;
+        ++deleted_;
+    }
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::begin() const {
+    return FlatIterator<HashTable>(*this, FindFullSlot_(0));
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+FlatIterator<HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>> HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::end() const {
+    return FlatIterator<HashTable>(*this, capacity_);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::size() const {
+    return size_;
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::capacity() const {
+    return capacity_;
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+float HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::GetLoadFactor() const {
+    if (capacity_ == 0) return 0;
+    return size_ / static_cast<float>(capacity_);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Reserve(std::size_t item_count) {
+    std::size_t new_capacity = FlatHashTableGroup::kWidth;
+    while (item_count > new_capacity / kMaxLoadDenominator * kMaxLoadNumerator) new_capacity *= 2;
+    if (new_capacity > capacity_) Rehash_(new_capacity);
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash> & HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::operator=(const HashTable &other) {
+    if (this == &other) return *this;
+    Release_();
+    hasher_ = other.hasher_;
+    if (other.capacity_ == 0) return *this;
+    // Same capacity and same hasher, so every item can go in the same slot as in other.
+    control_ = new int8_t[other.capacity_];
+    slots_ = static_cast<Slot*>(::operator new(other.capacity_ * sizeof(Slot)));
+    capacity_ = other.capacity_;
+    for (std::size_t i = 0; i < capacity_; i++) {
+        control_[i] = other.control_[i];
+        if (control_[i] >= 0) new (&slots_[i]) Slot(other.slots_[i].key_, other.slots_[i].value_);
+    }
+    size_ = other.size_;
+    deleted_ = other.deleted_;
+    return *this;
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTable<Key, Value, FlatLayout, NodeAllocator, Hash> & HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::operator=(HashTable &&other) noexcept {
+    if (this == &other) return *this;
+    Release_();
+    hasher_ = other.hasher_;
+    control_ = other.control_;
+    slots_ = other.slots_;
+    size_ = other.size_;
+    deleted_ = other.deleted_;
+    capacity_ = other.capacity_;
+    other.control_ = nullptr;
+    other.slots_ = nullptr;
+    other.size_ = 0;
+    other.deleted_ = 0;
+    other.capacity_ = 0;
+    return *this;
+}
+
+// Returns the slot index holding key, or kNotFound.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+std::size_t HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Find_(const K &key, std::size_t hash) const {
+    if (capacity_ == 0) {
+        this->CountLookup(0);
+        return kNotFound;
+    }
+    const std::size_t group_mask = capacity_ / FlatHashTableGroup::kWidth - 1;
+    const int8_t h2 = static_cast<int8_t>(hash & 0x7F);
+    std::size_t group_index = (hash >> 7) & group_mask;
+    for (std::size_t step = 1; step <= group_mask + 1; step++) {
+        const std::size_t group_start = group_index * FlatHashTableGroup::kWidth;
+        FlatHashTableGroup group(control_ + group_start);
+        for (FlatBitMask match = group.Match(h2); match.Any(); match.ClearLowest()) {
+            std::size_t index = group_start + match.Lowest();
+            if (key_equal_(slots_[index].key_, key)) {
+                this->CountLookup(step);
+                return index;
+            }
+        }
+        if (group.MatchEmpty().Any()) {
+            this->CountLookup(step);
+            return kNotFound;
+        }
+        group_index = (group_index + step) & group_mask;
+    }
+    this->CountLookup(group_mask + 1);
+    return kNotFound;
+}
+
+// Returns the first empty or deleted slot on hash's probe sequence.
+// Internal function. Assumes the table has at least one free slot.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::FindInsertSlot_(std::size_t hash) const {
+    const std::size_t group_mask = capacity_ / FlatHashTableGroup::kWidth - 1;
+    std::size_t group_index = (hash >> 7) & group_mask;
+    for (std::size_t step = 1;; step++) {
+        const std::size_t group_start = group_index * FlatHashTableGroup::kWidth;
+        FlatBitMask free_slots = FlatHashTableGroup(control_ + group_start).MatchEmptyOrDeleted();
+        if (free_slots.Any()) return group_start + free_slots.Lowest();
+        group_index = (group_index + step) & group_mask;
+    }
+}
+
+// Returns the first full slot at or after start_index, or capacity_ if there is none.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::FindFullSlot_(std::size_t start_index) const {
+    std::size_t group_start = start_index & ~(FlatHashTableGroup::kWidth - 1);
+    std::size_t offset = start_index - group_start;
+    while (group_start < capacity_) {
+        FlatBitMask full = FlatHashTableGroup(control_ + group_start).MatchFull();
+        // Drop slots before start_index in the first group
+        for (; full.Any() && full.Lowest() < offset; full.ClearLowest()) {}
+        if (full.Any()) return group_start + full.Lowest();
+        group_start += FlatHashTableGroup::kWidth;
+        offset = 0;
+    }
+    return capacity_;
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Rehash_(std::size_t new_capacity) {
+    RehashTimer timer(*this);
+    int8_t* old_control = control_;
+    Slot* old_slots = slots_;
+    std::size_t old_capacity = capacity_;
+
+    control_ = new int8_t[new_capacity];
+    slots_ = static_cast<Slot*>(::operator new(new_capacity * sizeof(Slot)));
+    capacity_ = new_capacity;
+    deleted_ = 0;
+    for (std::size_t i = 0; i < new_capacity; i++) control_[i] = kFlatEmpty;
+
+    for (std::size_t i = 0; i < old_capacity; i++) {
+        if (old_control[i] < 0) continue;
+        std::size_t hash = Hash_(old_slots[i].key_);
+        std::size_t index = FindInsertSlot_(hash);
+        new (&slots_[index]) Slot(std::move(old_slots[i]));
+        control_[index] = static_cast<int8_t>(hash & 0x7F);
+        old_slots[i].~Slot();
+    }
+    delete[] old_control;
+    ::operator delete(old_slots);
+    this->CountRehash();
+}
+
+// An item's chain length is the number of groups a lookup of it probes.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+HashTableStats HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::GetStats() const {
+    HashTableStats stats;
+    stats.table_count = 1;
+    stats.size = size_;
+    stats.capacity = capacity_;
+    stats.array_bytes = capacity_ * (sizeof(Slot) + sizeof(int8_t));
+    const std::size_t group_mask = capacity_ / FlatHashTableGroup::kWidth - 1;
+    for (std::size_t i = FindFullSlot_(0); i < capacity_; i = FindFullSlot_(i + 1)) {
+        const std::size_t target_group = i / FlatHashTableGroup::kWidth;
+        std::size_t group_index = (Hash_(slots_[i].key_) >> 7) & group_mask;
+        std::size_t step = 1;
+        for (; group_index != target_group; step++) group_index = (group_index + step) & group_mask;
+        stats.CountChain(step);
+        stats.heap_bytes += HashTableHeapBytes(slots_[i].key_) + HashTableHeapBytes(slots_[i].value_);
+    }
+    this->ReportCounters(stats);
+    return stats;
+}
+
+// Destroys all items and frees both arrays, leaving an empty table with capacity 0.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+void HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Release_() {
+    for (std::size_t i = 0; i < capacity_; i++) {
+        if (control_[i] >= 0) slots_[i].~Slot();
+    }
+    delete[] control_;
+    ::operator delete(slots_);
+    control_ = nullptr;
+    slots_ = nullptr;
+    size_ = 0;
+    deleted_ = 0;
+    capacity_ = 0;
+}
+
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+std::size_t HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::MaxLoad_() const {
+    return capacity_ / kMaxLoadDenominator * kMaxLoadNumerator;
+}
+
+// std::hash is the identity function for integers on common standard libraries. H2 comes from
+//  the low bits and H1 from the high bits, so the bits need to be mixed before they are split.
+template<typename Key, typename Value, template <typename> class NodeAllocator, typename Hash>
+template<typename K>
+std::size_t HashTable<Key, Value, FlatLayout, NodeAllocator, Hash>::Hash_(const K &key) const {
+    uint64_t hash = static_cast<uint64_t>(hasher_(key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(hash ^ (hash >> 32));
+}
+
+template<typename Table>
+FlatIterator<Table>::FlatIterator(const Table &main_table, std::size_t index)
+    : main_table_(&main_table), index_(index) {}
+
+template<typename Table>
+FlatIterator<Table> & FlatIterator<Table>::operator++() {
+    if (index_ < main_table_->capacity_) index_ = main_table_->FindFullSlot_(index_ + 1);
+    return *this;
+}
+
+template<typename Table>
+std::pair<typename Table::KeyType&, typename Table::ValueType&> FlatIterator<Table>::operator*() const {
+    if (index_ >= main_table_->capacity_) {throw std::out_of_range("Error, dereferencing invalid iterator");}
+    typename Table::Slot& slot = main_table_->slots_[index_];
+    return std::pair<Key&,Value&>(slot.key_, slot.value_);
+}
+
+template<typename Table>
+bool FlatIterator<Table>::operator!=(const FlatIterator<Table> &right) const {
+    return main_table_ != right.main_table_ || index_ != right.index_;
+}
+
+template<typename Table>
+bool FlatIterator<Table>::operator==(const FlatIterator<Table> &right) const {
+    return !(this->operator!=(right));
+}
+
+#endif // !FLAT_HASH_TABLE_H
@@ -0,0 +1,107 @@
+#ifndef FLAT_HASH_TABLE_GROUP_H
+#define FLAT_HASH_TABLE_GROUP_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLAT_HASH_TABLE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Control byte values. A full slot stores the low 7 bits of its hash (H2), so every
+//  full control byte is non-negative and every special value has the sign bit set.
+enum FlatControl : int8_t {
+    kFlatEmpty = -128,
+    kFlatDeleted = -2,
+};
+
+// Set of slot offsets within a group, one bit per slot.
+class FlatBitMask {
+public:
+    explicit FlatBitMask(uint32_t mask) : mask_(mask) {}
+
+    bool Any() const { return mask_ != 0; }
+    // Offset of the lowest set bit. Only valid if Any() is true.
+    unsigned int Lowest() const {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned int>(__builtin_ctz(mask_));
+#else
+        unsigned int offset = 0;
+        while (((mask_ >> offset) & 1u) == 0) ++offset;
+        return offset;
+#endif
+    }
+    void ClearLowest() { mask_ &= mask_ - 1; }
+
+private:
+    uint32_t mask_;
+};
+
+// kWidth consecutive control bytes, compared in one step.
+class FlatHashTableGroup {
+public:
+    static constexpr std::size_t kWidth = 16;
+
+    explicit FlatHashTableGroup(const int8_t* control) {
+#ifdef FLAT_HASH_TABLE_SSE2
+        control_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control));
+#else
+        for (std::size_t i = 0; i < kWidth; i++) control_[i] = control[i];
+#endif
+    }
+
+    // Slots whose control byte equals h2
+    FlatBitMask Match(int8_t h2) const {
+#ifdef FLAT_HASH_TABLE_SSE2
+        return FlatBitMask(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), control_))));
+#else
+        return MatchScalar_(h2);
+#endif
+    }
+
+    FlatBitMask MatchEmpty() const {
+        return Match(kFlatEmpty);
+    }
+
+    // Empty and deleted are the only control bytes with the sign bit set
+    FlatBitMask MatchEmptyOrDeleted() const {
+#ifdef FLAT_HASH_TABLE_SSE2
+        return FlatBitMask(static_cast<uint32_t>(_mm_movemask_epi8(control_)));
+#else
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < kWidth; i++) {
+            if (control_[i] < 0) mask |= 1u << i;
+        }
+        return FlatBitMask(mask);
+#endif
+    }
+
+    FlatBitMask MatchFull() const {
+#ifdef FLAT_HASH_TABLE_SSE2
+        return FlatBitMask(~static_cast<uint32_t>(_mm_movemask_epi8(control_)) & 0xFFFFu);
+#else
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < kWidth; i++) {
+            if (control_[i] >= 0) mask |= 1u << i;
+        }
+        return FlatBitMask(mask);
+#endif
+    }
+
+private:
+#ifdef FLAT_HASH_TABLE_SSE2
+    __m128i control_;
+#else
+    FlatBitMask MatchScalar_(int8_t h2) const {
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < kWidth; i++) {
+            if (control_[i] == h2) mask |= 1u << i;
+        }
+        return FlatBitMask(mask);
+    }
+    int8_t control_[kWidth];
+#endif
+};
+
+#endif // !FLAT_HASH_TABLE_GROUP_H
@@ -0,0 +1,112 @@
+#ifndef FROZEN_SLOTS_H
+#define FROZEN_SLOTS_H
+
+#include "hash_table_stats.h"
+#include <cstddef>
+#include <cstring> //std::memcpy
+#include <string>
+#include <string_view>
+#include <utility> //std::move
+#include <vector>
+
+// Items of a FrozenHashTable, one slot each, in one array indexed by slot. A lookup reads the
+//  key and the value from the same slot.
+template <typename Key, typename Value>
+class FrozenSlots {
+public:
+    typedef const Key& KeyReference;
+
+    // Takes keys[order[0]] and values[order[0]], then order[1], ... out of keys and values
+    void Assign(std::vector<Key>& keys, std::vector<Value>& values, const std::vector<std::size_t>& order) {
+        slots_.clear();
+        slots_.reserve(order.size());
+        for (std::size_t i : order) slots_.push_back(Slot{std::move(keys[i]), std::move(values[i])});
+    }
+    KeyReference GetKey(std::size_t slot) const { return slots_[slot].key_; }
+    const Value& GetValue(std::size_t slot) const { return slots_[slot].value_; }
+    // Memory a lookup of slot reads, for prefetching
+    const void* SlotAddress(std::size_t slot) const { return &slots_[slot]; }
+    std::size_t size() const { return slots_.size(); }
+    std::size_t ArrayBytes() const { return slots_.capacity() * sizeof(Slot); }
+    std::size_t HeapBytes() const {
+        std::size_t bytes = 0;
+        for (const Slot& slot : slots_) bytes += HashTableHeapBytes(slot.key_) + HashTableHeapBytes(slot.value_);
+        return bytes;
+    }
+
+private:
+    struct Slot {
+        Key key_;
+        Value value_;
+    };
+    std::vector<Slot> slots_;
+};
+
+// std::string keys up to kInlineKeyLength characters are stored in their slot, so a lookup
+//  finds key and value in the same place. Longer keys are packed back to back into one
+//  character buffer, and their slot holds where they start. Keys are handed out as
+//  std::string_view either way.
+template <typename Value>
+class FrozenSlots<std::string, Value> {
+public:
+    typedef std::string_view KeyReference;
+
+    void Assign(std::vector<std::string>& keys, std::vector<Value>& values, const std::vector<std::size_t>& order) {
+        std::size_t length = 0;
+        for (const std::string& key : keys) {
+            if (key.size() > kInlineKeyLength) length += key.size();
+        }
+        characters_.clear();
+        characters_.reserve(length);
+        slots_.clear();
+        slots_.reserve(order.size());
+        for (std::size_t i : order) {
+            slots_.push_back(Slot{keys[i].size(), {}, std::move(values[i])});
+            Slot& slot = slots_.back();
+            if (slot.key_length_ <= kInlineKeyLength) {
+                std::memcpy(slot.key_, keys[i].data(), slot.key_length_);
+            } else {
+                std::size_t offset = characters_.size();
+                std::memcpy(slot.key_, &offset, sizeof(offset));
+                characters_ += keys[i];
+            }
+        }
+    }
+    KeyReference GetKey(std::size_t index) const {
+        const Slot& slot = slots_[index];
+        if (slot.key_length_ <= kInlineKeyLength) return std::string_view(slot.key_, slot.key_length_);
+        std::size_t offset;
+        std::memcpy(&offset, slot.key_, sizeof(offset));
+        return std::string_view(characters_.data() + offset, slot.key_length_);
+    }
+    const Value& GetValue(std::size_t slot) const { return slots_[slot].value_; }
+    const void* SlotAddress(std::size_t slot) const { return &slots_[slot]; }
+    std::size_t size() const { return slots_.size(); }
+    std::size_t ArrayBytes() const { return slots_.capacity() * sizeof(Slot); }
+    // The character buffer counts as the keys' memory
+    std::size_t HeapBytes() const {
+        std::size_t bytes = characters_.capacity();
+        for (const Slot& slot : slots_) bytes += HashTableHeapBytes(slot.value_);
+        return bytes;
+    }
+
+private:
+    /////// BEGIN SETTINGS
+    // Fits the dataset's 32-character uniq_id
+    static constexpr std::size_t kInlineKeyLength = 32;
+    /////// END SETTINGS
+
+    struct Slot {
+        std::size_t key_length_;
+        // The key itself, or the offset of its first character in characters_
+        char key_[kInlineKeyLength];
+        Value value_;
+    };
+    static_assert(kInlineKeyLength >= sizeof(std::size_t), "a slot must be able to hold an offset");
+
+    std::vector<Slot> slots_;
+    // Keys longer than kInlineKeyLength
+    std::string characters_;
+};
+
+#endif // !FROZEN_SLOTS_H
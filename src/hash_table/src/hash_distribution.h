@@ -0,0 +1,84 @@
+#ifndef HASH_DISTRIBUTION_H
+#define HASH_DISTRIBUTION_H
+
+#include <cmath> //std::exp
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// How evenly a hasher spreads a set of keys over the buckets of a chained table. Buckets are
+//  picked from the low bits of the hash, exactly as HashTable<..., ChainedLayout> does, which
+//  is the harshest test: the flat layout mixes the hash first.
+//
+// The "expected" figures are those of a uniformly random hash (keys per bucket follow a
+//  Poisson distribution with mean key_count / bucket_count).
+struct HashDistributionReport {
+    /////// BEGIN SETTINGS
+    // Chain lengths counted separately. Longer chains all go into the last histogram entry.
+    static constexpr std::size_t kHistogramSize = 8;
+    /////// END SETTINGS
+
+    std::size_t key_count = 0;
+    std::size_t bucket_count = 0;
+    std::size_t empty_buckets = 0;
+    double expected_empty_buckets = 0;
+    // Keys that are not the first in their bucket
+    std::size_t collisions = 0;
+    double expected_collisions = 0;
+    std::size_t longest_chain = 0;
+    // Chi-squared statistic of the bucket sizes divided by its degrees of freedom. Close to 1
+    //  for a uniform hash; well above 1 means keys cluster in some buckets.
+    double chi_squared_ratio = 0;
+    // chain_length_histogram[i] is the number of buckets holding i keys
+    std::vector<std::size_t> chain_length_histogram;
+};
+
+// Analyzes the keys in [first, last) with hasher over bucket_count buckets, rounded up to a
+//  power of two (at least 2) like a table's capacity.
+template <typename Hash, typename ForwardIt>
+HashDistributionReport AnalyzeHashDistribution(ForwardIt first, ForwardIt last, std::size_t bucket_count, const Hash& hasher);
+
+std::ostream& operator<<(std::ostream& out, const HashDistributionReport& report);
+
+template <typename Hash, typename ForwardIt>
+HashDistributionReport AnalyzeHashDistribution(ForwardIt first, ForwardIt last, std::size_t bucket_count, const Hash& hasher) {
+    HashDistributionReport report;
+    report.bucket_count = 2;
+    while (report.bucket_count < bucket_count) report.bucket_count *= 2;
+    std::vector<std::size_t> bucket_sizes(report.bucket_count, 0);
+    for (; first != last; ++first) {
+        bucket_sizes[hasher(*first) & (report.bucket_count - 1)]++;
+        report.key_count++;
+    }
+    double load = static_cast<double>(report.key_count) / static_cast<double>(report.bucket_count);
+    report.expected_empty_buckets = static_cast<double>(report.bucket_count) * std::exp(-load);
+    // Every key but the first in each occupied bucket collides
+    report.expected_collisions = static_cast<double>(report.key_count) - (static_cast<double>(report.bucket_count) - report.expected_empty_buckets);
+    report.chain_length_histogram.assign(HashDistributionReport::kHistogramSize, 0);
+    double chi_squared = 0;
+    for (std::size_t size : bucket_sizes) {
+        if (size == 0) report.empty_buckets++;
+        else report.collisions += size - 1;
+        if (size > report.longest_chain) report.longest_chain = size;
+        report.chain_length_histogram[size < HashDistributionReport::kHistogramSize ? size : HashDistributionReport::kHistogramSize - 1]++;
+        double difference = static_cast<double>(size) - load;
+        chi_squared += difference * difference;
+    }
+    if (load > 0) report.chi_squared_ratio = chi_squared / load / static_cast<double>(report.bucket_count - 1);
+    return report;
+}
+
+inline std::ostream & operator<<(std::ostream &out, const HashDistributionReport &report) {
+    out << report.key_count << " keys in " << report.bucket_count << " buckets" << std::endl
+        << "  empty buckets: " << report.empty_buckets << " (uniform: " << report.expected_empty_buckets << ")" << std::endl
+        << "  collisions:    " << report.collisions << " (uniform: " << report.expected_collisions << ")" << std::endl
+        << "  longest chain: " << report.longest_chain << std::endl
+        << "  chi-squared / degrees of freedom: " << report.chi_squared_ratio << " (uniform: ~1)" << std::endl
+        << "  chain lengths:";
+    for (std::size_t i = 0; i < report.chain_length_histogram.size(); i++) {
+        out << " " << i << (i + 1 == report.chain_length_histogram.size() ? "+" : "") << ":" << report.chain_length_histogram[i];
+    }
+    return out << std::endl;
+}
+
+#endif // !HASH_DISTRIBUTION_H
@@ -0,0 +1,67 @@
+#ifndef HASH_POLICY_H
+#define HASH_POLICY_H
+
+#include <cstddef> //std::size_t
+#include <cstdint>
+#include <functional> //std::hash, std::equal_to
+#include <string>
+#include <string_view>
+#include <type_traits> //std::enable_if, std::void_t, std::is_scalar
+#include <utility> //std::declval
+#include "string_hash.h"
+
+// Hash and equality policies used by HashTable.
+//
+// HashTableHash is the default for HashTable's Hash parameter. Any type with a
+//  std::size_t operator()(const Key&) const can be used instead.
+//
+// For std::string keys both policies are transparent: they also accept std::string_view,
+//  const char* and string literals, and hash them exactly like the equivalent std::string.
+//  Find() and Delete() take any such key without building a std::string first.
+template <typename Key>
+struct HashTableHash : std::hash<Key> {};
+
+// Seeded wyhash-style hash (see string_hash.h). Default-constructed hashers share a random
+//  per-process seed. Pass a seed for reproducible bucket placement, e.g. in tests.
+template <>
+struct HashTableHash<std::string> {
+    typedef void is_transparent;
+    HashTableHash() : seed_(string_hash::DefaultSeed()) {}
+    explicit HashTableHash(uint64_t seed) : seed_(seed) {}
+    std::size_t operator()(std::string_view key) const noexcept {
+        return static_cast<std::size_t>(string_hash::Hash(key.data(), key.size(), seed_));
+    }
+private:
+    uint64_t seed_;
+};
+
+template <typename Key>
+struct HashTableKeyEqual : std::equal_to<Key> {};
+
+// std::equal_to<> compares with the operator== of the two operand types and is transparent
+template <>
+struct HashTableKeyEqual<std::string> : std::equal_to<> {};
+
+// Whether chained table nodes store the hash of their key. Rehashing then reuses the stored
+//  hash instead of hashing every key again, and chain walks compare hashes before keys.
+//  On by default for keys that are expensive to hash or compare (std::string and other class
+//  types), off for integers, enums and pointers, where it would only make nodes bigger.
+//  Specialize to override for a key type.
+template <typename Key>
+struct HashTableCacheHash : std::integral_constant<bool, !std::is_scalar<Key>::value> {};
+
+// True if both policies are transparent and Hash accepts a K
+template <typename Hash, typename KeyEqual, typename K, typename = void>
+struct IsTransparentPolicy : std::false_type {};
+
+template <typename Hash, typename KeyEqual, typename K>
+struct IsTransparentPolicy<Hash, KeyEqual, K,
+        std::void_t<typename Hash::is_transparent, typename KeyEqual::is_transparent,
+                    decltype(std::declval<const Hash&>()(std::declval<const K&>()))>> : std::true_type {};
+
+// Enables a lookup overload taking K only when the policies of Key accept it
+template <typename Key, typename K, typename Hash = HashTableHash<Key>>
+using EnableIfTransparentLookup = typename std::enable_if<
+        IsTransparentPolicy<Hash, HashTableKeyEqual<Key>, K>::value, int>::type;
+
+#endif // !HASH_POLICY_H
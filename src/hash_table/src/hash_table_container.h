@@ -5,15 +5,42 @@
 #ifndef HASH_TABLE_CONTAINER_H
 #define HASH_TABLE_CONTAINER_H
 #include <algorithm>
+#include <cstddef>
+#include <utility> //std::forward, std::piecewise_construct_t
+#include "hash_policy.h"
+
+// Hash stored alongside a key (see HashTableCacheHash). Empty when not caching, so nodes
+//  of e.g. integer-keyed tables don't grow.
+template <bool Cache>
+class HashTableHashCache {
+public:
+    static constexpr bool kCachesHash = false;
+    std::size_t GetHash() const { return 0; }
+    void SetHash(std::size_t) {}
+};
+
+template <>
+class HashTableHashCache<true> {
+public:
+    static constexpr bool kCachesHash = true;
+    std::size_t GetHash() const { return hash_; }
+    void SetHash(std::size_t hash) { hash_ = hash; }
+private:
+    std::size_t hash_ = 0;
+};
 
 template <typename Key, typename Value>
-class HashTableContainer {
+class HashTableContainer : public HashTableHashCache<HashTableCacheHash<Key>::value> {
 public:
     HashTableContainer();  // Constructor
     ~HashTableContainer(); // Destructor
     HashTableContainer(HashTableContainer<Key, Value>& other); // Copy constructor
     HashTableContainer(HashTableContainer<Key, Value>&& other) noexcept; // Move constructor
     HashTableContainer(const Key& key, const Value& value, HashTableContainer<Key, Value>* next_ptr = nullptr);  // Parameterized constructor
+    // Constructs key_ from key and value_ from value_args directly, with no default construction
+    //  or assignment in between.
+    template <typename K, typename... Args>
+    HashTableContainer(std::piecewise_construct_t, K&& key, Args&&... value_args);
     HashTableContainer<Key, Value>& operator=(const HashTableContainer<Key, Value>& right); // Copy Assignment
     HashTableContainer<Key, Value>& operator=(HashTableContainer<Key, Value> &&right) noexcept;
 
@@ -33,7 +60,7 @@ public:
     HashTableContainer<Key, Value>* GetNext() const;
     void SetNext(HashTableContainer<Key, Value>* next);
 
-    HashTableContainer<Key, Value>* GetIndex(unsigned int index);
+    HashTableContainer<Key, Value>* GetIndex(std::size_t index);
     
 private:
     bool is_valid_;
@@ -83,12 +110,18 @@ HashTableContainer<Key, Value>::HashTableContainer(const Key &key, const Value &
     this->SetValid();
 }
 
+template<typename Key, typename Value>
+template<typename K, typename... Args>
+HashTableContainer<Key, Value>::HashTableContainer(std::piecewise_construct_t, K &&key, Args &&... value_args)
+    : is_valid_(true), key_(std::forward<K>(key)), value_(std::forward<Args>(value_args)...), next_node_(nullptr) {}
+
 template<typename Key, typename Value>
 HashTableContainer<Key, Value> & HashTableContainer<Key, Value>::operator=(const HashTableContainer<Key, Value> &right) {
     if (this == &right) return *this;
     this->SetNext(right.GetNext());
     this->SetValue(right.GetValue());
     this->SetKey(right.GetKey());
+    this->SetHash(right.GetHash());
     this->SetValidity(right.IsValid());
     return *this;
 }
@@ -100,6 +133,7 @@ HashTableContainer<Key, Value> & HashTableContainer<Key, Value>::operator=(HashT
     this->next_node_ = right.next_node_;
     this->value_ = std::move(right.value_);
     this->key_ = std::move(right.key_);
+    this->SetHash(right.GetHash());
     this->SetValidity(right.IsValid());
     right.SetInvalid();
     return *this;
@@ -166,8 +200,8 @@ void HashTableContainer<Key, Value>::SetNext(HashTableContainer<Key, Value> *nex
 }
 
 template<typename Key, typename Value>
-HashTableContainer<Key, Value> * HashTableContainer<Key, Value>::GetIndex(unsigned int index) {
-    int temp_index = 0;
+HashTableContainer<Key, Value> * HashTableContainer<Key, Value>::GetIndex(std::size_t index) {
+    std::size_t temp_index = 0;
     HashTableContainer<Key, Value>* temp_node = this;
     while (temp_index != index) {
         if (temp_node == nullptr || !temp_node->IsValid()) return nullptr;
@@ -0,0 +1,181 @@
+#ifndef HASH_TABLE_STATS_H
+#define HASH_TABLE_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Lookup and rehash counters are compiled in only when HASH_TABLE_STATS is defined (CMake
+//  option of the same name). Without it the counters are an empty base class and every update
+//  compiles to nothing. Sizes, chain lengths and memory are read from the table when
+//  GetStats() is called, so they are always available.
+#ifdef HASH_TABLE_STATS
+inline constexpr bool kHashTableStatsEnabled = true;
+#else
+inline constexpr bool kHashTableStatsEnabled = false;
+#endif
+
+// Snapshot returned by HashTable::GetStats(). Reports of several tables can be summed with +=.
+struct HashTableStats {
+    /////// BEGIN SETTINGS
+    // Chain lengths counted separately. Longer chains all go into the last histogram entry.
+    static constexpr std::size_t kHistogramSize = 8;
+    /////// END SETTINGS
+
+    // False when built without HASH_TABLE_STATS: lookups, probes and rehashes are then all 0.
+    bool counters_enabled = kHashTableStatsEnabled;
+    // Tables summed into this report
+    std::size_t table_count = 0;
+    std::size_t size = 0;
+    std::size_t capacity = 0;
+    // Chained layout: chain_length_histogram[i] is the number of buckets holding i items.
+    // Flat layout: the number of items found in the i-th group of their probe sequence
+    //  (index 0 is unused, every item is at least one group in).
+    std::vector<std::size_t> chain_length_histogram = std::vector<std::size_t>(kHistogramSize, 0);
+    std::size_t longest_chain = 0;
+
+    // Key lookups made by Find, FindMany and Delete, and on the flat layout also by every insert
+    //  (which checks for an existing key first). Probes are the nodes compared (chained) or
+    //  control groups read (flat) by those lookups.
+    uint64_t lookups = 0;
+    uint64_t probes = 0;
+    // Completed rehashes, and the time spent in them. An incremental rehash counts once, with the
+    //  time of all its steps.
+    uint64_t rehashes = 0;
+    uint64_t rehash_nanoseconds = 0;
+
+    // Bucket or slot arrays, control bytes and occupancy bitmaps
+    std::size_t array_bytes = 0;
+    // Out-of-array nodes of the chained layout
+    std::size_t node_bytes = 0;
+    // Memory owned by the keys and values themselves: string buffers, vectors, nested tables
+    std::size_t heap_bytes = 0;
+
+    std::size_t TotalBytes() const { return array_bytes + node_bytes + heap_bytes; }
+    void CountChain(std::size_t length);
+    HashTableStats& operator+=(const HashTableStats& other);
+};
+
+std::ostream& operator<<(std::ostream& out, const HashTableStats& stats);
+
+// Heap memory a key or value owns beyond its own sizeof. Called unqualified, so an overload
+//  declared next to any other type that owns memory is found by argument-dependent lookup.
+template <typename T>
+std::size_t HashTableHeapBytes(const T&) { return 0; }
+
+// Short strings live inside the object itself (small string optimization) and own nothing.
+inline std::size_t HashTableHeapBytes(const std::string& string) {
+    const char* data = string.data();
+    const char* object = reinterpret_cast<const char*>(&string);
+    if (data >= object && data < object + sizeof(std::string)) return 0;
+    return string.capacity() + 1;
+}
+
+template <typename T>
+std::size_t HashTableHeapBytes(const std::vector<T>& vector) {
+    std::size_t bytes = vector.capacity() * sizeof(T);
+    for (const T& item : vector) bytes += HashTableHeapBytes(item);
+    return bytes;
+}
+
+// Counters kept by a table. Tables inherit from HashTableCounters<kHashTableStatsEnabled>.
+template <bool Enabled>
+class HashTableCounters {
+public:
+    // Adds the time until it is destroyed to the rehash time
+    class RehashTimer {
+    public:
+        explicit RehashTimer(const HashTableCounters&) {}
+    };
+
+    void CountLookup(std::size_t) const {}
+    void CountRehash() const {}
+    void ReportCounters(HashTableStats&) const {}
+};
+
+template <>
+class HashTableCounters<true> {
+public:
+    class RehashTimer {
+    public:
+        explicit RehashTimer(const HashTableCounters& counters)
+            : counters_(counters), start_(std::chrono::steady_clock::now()) {}
+        ~RehashTimer() {
+            counters_.rehash_nanoseconds_ += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+        }
+        RehashTimer(const RehashTimer& other) = delete;
+        RehashTimer& operator=(const RehashTimer& other) = delete;
+    private:
+        const HashTableCounters& counters_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Lookups are const on some layouts, hence the mutable counters
+    void CountLookup(std::size_t probes) const {
+        ++lookups_;
+        probes_ += probes;
+    }
+    void CountRehash() const { ++rehashes_; }
+    void ReportCounters(HashTableStats& stats) const {
+        stats.lookups = lookups_;
+        stats.probes = probes_;
+        stats.rehashes = rehashes_;
+        stats.rehash_nanoseconds = rehash_nanoseconds_;
+    }
+
+private:
+    mutable uint64_t lookups_ = 0;
+    mutable uint64_t probes_ = 0;
+    mutable uint64_t rehashes_ = 0;
+    mutable uint64_t rehash_nanoseconds_ = 0;
+};
+
+inline void HashTableStats::CountChain(std::size_t length) {
+    chain_length_histogram[length < kHistogramSize ? length : kHistogramSize - 1]++;
+    if (length > longest_chain) longest_chain = length;
+}
+
+inline HashTableStats & HashTableStats::operator+=(const HashTableStats &other) {
+    counters_enabled = counters_enabled && other.counters_enabled;
+    table_count += other.table_count;
+    size += other.size;
+    capacity += other.capacity;
+    for (std::size_t i = 0; i < kHistogramSize; i++) {
+        chain_length_histogram[i] += other.chain_length_histogram[i];
+    }
+    if (other.longest_chain > longest_chain) longest_chain = other.longest_chain;
+    lookups += other.lookups;
+    probes += other.probes;
+    rehashes += other.rehashes;
+    rehash_nanoseconds += other.rehash_nanoseconds;
+    array_bytes += other.array_bytes;
+    node_bytes += other.node_bytes;
+    heap_bytes += other.heap_bytes;
+    return *this;
+}
+
+inline std::ostream & operator<<(std::ostream &out, const HashTableStats &stats) {
+    out << stats.size << " items, capacity " << stats.capacity;
+    if (stats.table_count != 1) out << " (" << stats.table_count << " tables)";
+    out << std::endl << "  chain lengths:";
+    for (std::size_t i = 0; i < stats.chain_length_histogram.size(); i++) {
+        out << " " << i << (i + 1 == stats.chain_length_histogram.size() ? "+" : "") << ":" << stats.chain_length_histogram[i];
+    }
+    out << std::endl << "  longest chain: " << stats.longest_chain << std::endl;
+    if (stats.counters_enabled) {
+        out << "  lookups: " << stats.lookups << ", probes: " << stats.probes;
+        if (stats.lookups != 0) out << " (" << static_cast<double>(stats.probes) / static_cast<double>(stats.lookups) << " per lookup)";
+        out << std::endl << "  rehashes: " << stats.rehashes << ", "
+            << static_cast<double>(stats.rehash_nanoseconds) / 1e6 << " ms" << std::endl;
+    } else {
+        out << "  lookup and rehash counters: not compiled in (build with -DHASH_TABLE_STATS=ON)" << std::endl;
+    }
+    return out << "  memory: " << stats.TotalBytes() << " bytes (arrays " << stats.array_bytes << ", nodes "
+               << stats.node_bytes << ", keys and values " << stats.heap_bytes << ")" << std::endl;
+}
+
+#endif // !HASH_TABLE_STATS_H
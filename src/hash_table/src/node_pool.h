@@ -0,0 +1,113 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <new> // operator new/delete
+#include <utility> //std::swap
+#include <vector>
+
+// Slab allocator for the out-of-array nodes of a chained HashTable. Each table owns one pool.
+//
+// Storage is carved out of slabs that double in size (kFirstSlabSize, 2x, 4x... up to
+//  kMaxSlabSize nodes), so nodes allocated together sit next to each other in memory and a
+//  table with millions of nodes makes a few hundred allocations instead of millions.
+//  Deallocated nodes go on a free list and are handed out again before any new slab space.
+//  Memory is only returned to the system when the pool is destroyed.
+//
+// Allocate() returns uninitialized storage and Deallocate() expects an already destroyed
+//  object; construction is the caller's job. Any class template with the same interface can
+//  be passed to HashTable as its NodeAllocator (see NewDeleteAllocator).
+template <typename T>
+class NodePool {
+public:
+    NodePool();
+    ~NodePool();
+    // A pool hands out pointers into its own slabs, so it can't be copied.
+    NodePool(const NodePool& other) = delete;
+    NodePool& operator=(const NodePool& other) = delete;
+
+    T* Allocate();
+    void Deallocate(T* node);
+    void Swap(NodePool& other) noexcept;
+
+private:
+    /////// BEGIN SETTINGS
+    static constexpr std::size_t kFirstSlabSize = 8;
+    static constexpr std::size_t kMaxSlabSize = 4096;
+    /////// END SETTINGS
+
+    // Storage for one node. While the node is on the free list, the same bytes hold the link.
+    union Block {
+        Block* next_free_;
+        alignas(T) unsigned char storage_[sizeof(T)];
+    };
+
+    void AddSlab_();
+
+    std::vector<Block*> slabs_;
+    std::size_t next_slab_size_;
+    Block* free_list_;
+    // Unused part of the newest slab
+    Block* bump_;
+    Block* bump_end_;
+};
+
+// Plain new/delete per node. Same interface as NodePool.
+template <typename T>
+class NewDeleteAllocator {
+public:
+    T* Allocate() { return static_cast<T*>(::operator new(sizeof(T))); }
+    void Deallocate(T* node) { ::operator delete(node); }
+    void Swap(NewDeleteAllocator&) noexcept {}
+};
+
+template<typename T>
+NodePool<T>::NodePool()
+    : next_slab_size_(kFirstSlabSize), free_list_(nullptr), bump_(nullptr), bump_end_(nullptr) {}
+
+template<typename T>
+NodePool<T>::~NodePool() {
+    for (Block* slab : slabs_) {
+        ::operator delete(slab);
+    }
+}
+
+template<typename T>
+T* NodePool<T>::Allocate() {
+    Block* block;
+    if (free_list_ != nullptr) {
+        block = free_list_;
+        free_list_ = free_list_->next_free_;
+    } else {
+        if (bump_ == bump_end_) AddSlab_();
+        block = bump_++;
+    }
+    return reinterpret_cast<T*>(block->storage_);
+}
+
+template<typename T>
+void NodePool<T>::Deallocate(T* node) {
+    Block* block = reinterpret_cast<Block*>(node);
+    block->next_free_ = free_list_;
+    free_list_ = block;
+}
+
+template<typename T>
+void NodePool<T>::Swap(NodePool &other) noexcept {
+    slabs_.swap(other.slabs_);
+    std::swap(next_slab_size_, other.next_slab_size_);
+    std::swap(free_list_, other.free_list_);
+    std::swap(bump_, other.bump_);
+    std::swap(bump_end_, other.bump_end_);
+}
+
+template<typename T>
+void NodePool<T>::AddSlab_() {
+    Block* slab = static_cast<Block*>(::operator new(next_slab_size_ * sizeof(Block)));
+    slabs_.push_back(slab);
+    bump_ = slab;
+    bump_end_ = slab + next_slab_size_;
+    if (next_slab_size_ < kMaxSlabSize) next_slab_size_ *= 2;
+}
+
+#endif // !NODE_POOL_H
@@ -0,0 +1,86 @@
+#ifndef OCCUPANCY_BITMAP_H
+#define OCCUPANCY_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring> //std::memcpy
+
+// One bit per bucket of a chained table's array, set while the bucket's head holds an item.
+// Iteration looks for the next set bit 64 buckets at a time instead of reading every bucket,
+//  so walking a sparse table never touches the keys and values of empty buckets.
+class OccupancyBitmap {
+public:
+    OccupancyBitmap() : words_(nullptr), word_count_(0) {}
+    ~OccupancyBitmap() { delete[] words_; }
+    OccupancyBitmap(const OccupancyBitmap& other) = delete;
+    OccupancyBitmap& operator=(const OccupancyBitmap& other);
+    OccupancyBitmap(OccupancyBitmap&& other) noexcept;
+    OccupancyBitmap& operator=(OccupancyBitmap&& other) noexcept;
+
+    // Replaces the bitmap with bucket_count clear bits (none at all for 0)
+    void Reset(std::size_t bucket_count);
+    void Set(std::size_t index) { words_[index / 64] |= uint64_t(1) << (index % 64); }
+    void Clear(std::size_t index) { words_[index / 64] &= ~(uint64_t(1) << (index % 64)); }
+    // Index of the first set bit in [start, end), or end if there is none
+    std::size_t FindNext(std::size_t start, std::size_t end) const;
+
+private:
+    static unsigned int CountTrailingZeros_(uint64_t word);
+
+    uint64_t* words_;
+    std::size_t word_count_;
+};
+
+inline OccupancyBitmap & OccupancyBitmap::operator=(const OccupancyBitmap &other) {
+    if (this == &other) return *this;
+    Reset(other.word_count_ * 64);
+    if (word_count_ != 0) std::memcpy(words_, other.words_, word_count_ * sizeof(uint64_t));
+    return *this;
+}
+
+inline OccupancyBitmap::OccupancyBitmap(OccupancyBitmap &&other) noexcept : OccupancyBitmap() {
+    *this = static_cast<OccupancyBitmap&&>(other);
+}
+
+inline OccupancyBitmap & OccupancyBitmap::operator=(OccupancyBitmap &&other) noexcept {
+    if (this == &other) return *this;
+    delete[] words_;
+    words_ = other.words_;
+    word_count_ = other.word_count_;
+    other.words_ = nullptr;
+    other.word_count_ = 0;
+    return *this;
+}
+
+inline void OccupancyBitmap::Reset(std::size_t bucket_count) {
+    delete[] words_;
+    words_ = nullptr;
+    word_count_ = (bucket_count + 63) / 64;
+    if (word_count_ != 0) words_ = new uint64_t[word_count_](); // Zeroed
+}
+
+inline std::size_t OccupancyBitmap::FindNext(std::size_t start, std::size_t end) const {
+    if (start >= end) return end;
+    std::size_t word_index = start / 64;
+    // Bits below start are masked off in the first word
+    uint64_t word = words_[word_index] & (~uint64_t(0) << (start % 64));
+    std::size_t last_word = (end - 1) / 64;
+    while (word == 0) {
+        if (++word_index > last_word) return end;
+        word = words_[word_index];
+    }
+    std::size_t index = word_index * 64 + CountTrailingZeros_(word);
+    return index < end ? index : end;
+}
+
+inline unsigned int OccupancyBitmap::CountTrailingZeros_(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned int>(__builtin_ctzll(word));
+#else
+    unsigned int count = 0;
+    while (((word >> count) & 1u) == 0) ++count;
+    return count;
+#endif
+}
+
+#endif // !OCCUPANCY_BITMAP_H
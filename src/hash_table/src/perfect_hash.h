@@ -0,0 +1,149 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include "string_hash.h"
+#include <algorithm> //std::max
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Minimal perfect hash function in the hash-and-displace style of CHD and PTHash: maps each of
+//  n distinct 64-bit hashes to its own slot in [0, n), with no empty slots.
+//
+// Keys are split into about n / kAverageBucketSize buckets by their hash. Each bucket gets a
+//  displacement, chosen at build time so that every key of the bucket lands on a slot no other
+//  key has taken: slot = Reduce(Mix(key hash, displacement), n). Buckets are placed largest
+//  first, while the table is still empty enough for many keys to fit at once. A lookup reads
+//  one displacement and computes the slot, so there is nothing to probe.
+namespace perfect_hash {
+
+/////// BEGIN SETTINGS
+// Keys per bucket on average. Fewer makes the function bigger, more makes the build slower.
+inline constexpr std::size_t kAverageBucketSize = 4;
+// Seeds tried before giving up. A seed fails on an unlucky run of displacements, or when two
+//  keys of a bucket end up with the same mixed hash.
+inline constexpr std::size_t kMaxAttempts = 8;
+// Displacements tried per bucket before starting over with another seed, as a multiple of n.
+//  The last key of a build has a 1 in n chance per try, so this is its -log(failure rate).
+inline constexpr std::size_t kDisplacementTriesPerKey = 32;
+/////// END SETTINGS
+
+// Maps x onto [0, range) by the high half of x * range, which is faster than x % range
+inline std::size_t Reduce(uint64_t x, std::size_t range) {
+    uint64_t high = range;
+    string_hash::Multiply(x, high);
+    return static_cast<std::size_t>(high);
+}
+
+class Function {
+public:
+    // Builds the function for hashes. Returns false if no seed worked, which in practice means
+    //  two of them are equal: no function can tell those apart.
+    bool Build(const std::vector<uint64_t>& hashes);
+
+    // Slot of a hash given to Build(). Any other hash gets some slot in [0, size()).
+    std::size_t Slot(uint64_t hash) const {
+        uint64_t key_hash = KeyHash_(hash);
+        return SlotFor_(key_hash, displacements_[Reduce(key_hash, displacements_.size())]);
+    }
+    // Address Slot() reads, for prefetching
+    const void* DisplacementAddress(uint64_t hash) const {
+        return &displacements_[Reduce(KeyHash_(hash), displacements_.size())];
+    }
+    std::size_t size() const { return size_; }
+    std::size_t BucketCount() const { return displacements_.size(); }
+    std::size_t MemoryBytes() const { return displacements_.capacity() * sizeof(uint64_t); }
+
+private:
+    uint64_t KeyHash_(uint64_t hash) const {
+        return string_hash::Mix(hash ^ seed_ ^ string_hash::kSecret[0], string_hash::kSecret[1]);
+    }
+    std::size_t SlotFor_(uint64_t key_hash, uint64_t displacement) const {
+        return Reduce(string_hash::Mix(key_hash ^ string_hash::kSecret[2], displacement), size_);
+    }
+    static uint64_t Displacement_(uint64_t pilot) {
+        return string_hash::Mix(pilot ^ string_hash::kSecret[3], string_hash::kSecret[0]);
+    }
+    bool TryBuild_(const std::vector<uint64_t>& hashes);
+
+    uint64_t seed_ = 0;
+    std::size_t size_ = 0;
+    // One per bucket. Never empty, so Slot() needs no size check.
+    std::vector<uint64_t> displacements_ = std::vector<uint64_t>(1, 0);
+};
+
+inline bool Function::Build(const std::vector<uint64_t>& hashes) {
+    size_ = hashes.size();
+    displacements_.assign(std::max<std::size_t>(1, (size_ + kAverageBucketSize - 1) / kAverageBucketSize), 0);
+    for (std::size_t attempt = 0; attempt < kMaxAttempts; attempt++) {
+        // Fixed seeds, so the same keys always give the same function
+        seed_ = string_hash::Mix(attempt ^ string_hash::kSecret[2], string_hash::kSecret[3]);
+        if (TryBuild_(hashes)) return true;
+    }
+    size_ = 0;
+    displacements_.assign(1, 0);
+    return false;
+}
+
+inline bool Function::TryBuild_(const std::vector<uint64_t>& hashes) {
+    const std::size_t bucket_count = displacements_.size();
+    std::vector<uint64_t> key_hashes(size_);
+    // Keys sorted by bucket (counting sort): bucket b's keys are key_hashes[bucket_start[b]] on
+    std::vector<std::size_t> bucket_start(bucket_count + 1, 0);
+    for (uint64_t hash : hashes) bucket_start[Reduce(KeyHash_(hash), bucket_count) + 1]++;
+    std::size_t largest = 0;
+    for (std::size_t b = 0; b < bucket_count; b++) {
+        largest = std::max(largest, bucket_start[b + 1]);
+        bucket_start[b + 1] += bucket_start[b];
+    }
+    {
+        std::vector<std::size_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+        for (uint64_t hash : hashes) {
+            uint64_t key_hash = KeyHash_(hash);
+            key_hashes[fill[Reduce(key_hash, bucket_count)]++] = key_hash;
+        }
+    }
+    // Buckets sorted by size, largest first (counting sort again, sizes are small)
+    std::vector<std::size_t> size_start(largest + 2, 0);
+    for (std::size_t b = 0; b < bucket_count; b++) size_start[largest - (bucket_start[b + 1] - bucket_start[b]) + 1]++;
+    for (std::size_t s = 0; s <= largest; s++) size_start[s + 1] += size_start[s];
+    std::vector<std::size_t> order(bucket_count);
+    for (std::size_t b = 0; b < bucket_count; b++) order[size_start[largest - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+
+    std::vector<bool> taken(size_, false);
+    std::vector<std::size_t> slots(largest);
+    const uint64_t max_tries = static_cast<uint64_t>(size_) * kDisplacementTriesPerKey + 64;
+    for (std::size_t b : order) {
+        const uint64_t* keys = key_hashes.data() + bucket_start[b];
+        const std::size_t count = bucket_start[b + 1] - bucket_start[b];
+        if (count == 0) break; // The rest are empty as well
+        for (std::size_t i = 1; i < count; i++) {
+            for (std::size_t j = 0; j < i; j++) {
+                // No displacement separates these. Equal hashes fail this way under every seed.
+                if (keys[i] == keys[j]) return false;
+            }
+        }
+        bool placed = false;
+        for (uint64_t pilot = 0; pilot < max_tries && !placed; pilot++) {
+            const uint64_t displacement = Displacement_(pilot);
+            placed = true;
+            for (std::size_t i = 0; i < count && placed; i++) {
+                slots[i] = SlotFor_(keys[i], displacement);
+                if (taken[slots[i]]) placed = false;
+                for (std::size_t j = 0; j < i && placed; j++) {
+                    if (slots[j] == slots[i]) placed = false;
+                }
+            }
+            if (placed) {
+                displacements_[b] = displacement;
+                for (std::size_t i = 0; i < count; i++) taken[slots[i]] = true;
+            }
+        }
+        if (!placed) return false;
+    }
+    return true;
+}
+
+} // namespace perfect_hash
+
+#endif // !PERFECT_HASH_H
@@ -0,0 +1,32 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <string>
+
+#if !defined(__GNUC__) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// Hints that address will be read soon, so the cache line is fetched while other work runs.
+//  A no-op where the compiler has no prefetch intrinsic.
+inline void PrefetchForRead(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#elif defined(_M_X64) || defined(_M_IX86)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+// Prefetches memory a key owns outside of the table, like the characters of a long
+//  std::string, so comparing against the key doesn't miss the cache. Keys stored entirely in
+//  the table have nothing to prefetch.
+template <typename Key>
+void PrefetchKeyData(const Key&) {}
+
+inline void PrefetchKeyData(const std::string& key) {
+    PrefetchForRead(key.data());
+}
+
+#endif // !PREFETCH_H
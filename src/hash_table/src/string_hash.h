@@ -0,0 +1,122 @@
+#ifndef STRING_HASH_H
+#define STRING_HASH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring> //std::memcpy
+#include <random>
+
+// Seeded string hash in the style of wyhash: the input is read 8 or 16 bytes at a time and
+//  folded in with 64x64->128 bit multiplies. Short keys like our 32-character uniq_ids take two
+//  multiplies plus the finalizer, and every output bit depends on the seed, so keys can't be
+//  crafted offline to land in one bucket.
+namespace string_hash {
+
+/////// BEGIN SETTINGS
+// Odd 64-bit constants with 32 set bits, as used by wyhash
+inline constexpr uint64_t kSecret[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                                        0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+/////// END SETTINGS
+
+// Full 128-bit product of a and b, returned as its low and high halves
+inline void Multiply(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64_t>(product);
+    b = static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t a_high = a >> 32, a_low = static_cast<uint32_t>(a);
+    uint64_t b_high = b >> 32, b_low = static_cast<uint32_t>(b);
+    uint64_t high_high = a_high * b_high, high_low = a_high * b_low;
+    uint64_t low_high = a_low * b_high, low_low = a_low * b_low;
+    uint64_t middle = (low_low >> 32) + static_cast<uint32_t>(high_low) + static_cast<uint32_t>(low_high);
+    a = (middle << 32) | static_cast<uint32_t>(low_low);
+    b = high_high + (high_low >> 32) + (low_high >> 32) + (middle >> 32);
+#endif
+}
+
+// Folds the 128-bit product of a and b down to 64 bits
+inline uint64_t Mix(uint64_t a, uint64_t b) {
+    Multiply(a, b);
+    return a ^ b;
+}
+
+inline uint64_t Read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// 1 to 3 bytes: first, middle and last, so every byte is read at least once
+inline uint64_t Read3(const unsigned char* p, std::size_t length) {
+    return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+}
+
+inline uint64_t Hash(const void* data, std::size_t length, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    seed ^= Mix(seed ^ kSecret[0], kSecret[1]);
+    uint64_t a, b;
+    if (length <= 16) {
+        if (length >= 4) {
+            // Two overlapping pairs of 4-byte reads cover 4 to 16 bytes
+            std::size_t offset = (length >> 3) << 2;
+            a = (Read32(p) << 32) | Read32(p + offset);
+            b = (Read32(p + length - 4) << 32) | Read32(p + length - 4 - offset);
+        } else if (length > 0) {
+            a = Read3(p, length);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        std::size_t remaining = length;
+        if (remaining > 48) {
+            // Three independent lanes, so the multiplies can overlap
+            uint64_t lane1 = seed, lane2 = seed;
+            do {
+                seed = Mix(Read64(p) ^ kSecret[1], Read64(p + 8) ^ seed);
+                lane1 = Mix(Read64(p + 16) ^ kSecret[2], Read64(p + 24) ^ lane1);
+                lane2 = Mix(Read64(p + 32) ^ kSecret[3], Read64(p + 40) ^ lane2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (remaining > 16) {
+            seed = Mix(Read64(p) ^ kSecret[1], Read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        // Last 16 bytes, overlapping what was already read if the length isn't a multiple of 16
+        a = Read64(p + remaining - 16);
+        b = Read64(p + remaining - 8);
+    }
+    a ^= kSecret[1];
+    b ^= seed;
+    Multiply(a, b);
+    return Mix(a ^ kSecret[0] ^ length, b ^ kSecret[1]);
+}
+
+// Seed shared by every default-constructed string hasher in the process. Random per run, so
+//  bucket placement (and iteration order) differs between runs.
+inline uint64_t DefaultSeed() {
+    static const uint64_t seed = [] {
+        std::random_device device;
+        uint64_t entropy = (static_cast<uint64_t>(device()) << 32) ^ device();
+        // random_device may be deterministic on some platforms, so mix in the clock as well
+        entropy ^= static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        return Mix(entropy ^ kSecret[2], kSecret[3]);
+    }();
+    return seed;
+}
+
+} // namespace string_hash
+
+#endif // !STRING_HASH_H
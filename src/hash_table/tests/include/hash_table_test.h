@@ -1,12 +1,29 @@
 #ifndef HASH_TABLE_TEST_H
 #define HASH_TABLE_TEST_H
 
+#include <cstddef>
+
 namespace hash_table_test {
     void InsertTest();
     void FindTest();
     void DeleteTest();
     void TestAll();
     void IterationTest();
+    void FlatLayoutTest();
+    void ReserveTest();
+    void NodeAllocatorTest();
+    void LookupTest();
+    void EmplaceTest();
+    void IncrementalRehashTest();
+    void ConcurrentTest();
+    void HashCacheTest();
+    void OccupancyTest();
+    void HashPolicyTest();
+    void FindManyTest();
+    void StatsTest();
+    void FrozenTest();
+    // Not part of TestAll(). Peak memory grows with item_count (several GB at 50M items).
+    void StressTest(std::size_t item_count);
 }
 
 #endif // !HASH_TABLE_TEST_H
@@ -0,0 +1,284 @@
+#include "hash_table.h"
+#include "concurrent_hash_table.h"
+#include "frozen_hash_table.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Benchmarks for HashTable. Not run at startup.
+// Usage: hash_table_bench [item_count]   (default 1M)
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// splitmix64, same as the stress test's key generator
+uint64_t SyntheticKey(uint64_t i) {
+    uint64_t z = i + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Value at quantile q (0..1) of already sorted samples
+uint64_t Percentile(const std::vector<uint64_t>& sorted, double q) {
+    std::size_t index = static_cast<std::size_t>(q * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+// Times every single insert into an empty table, so the inserts that trigger a rehash show up
+//  in the tail instead of being averaged away.
+void InsertLatencyBenchmark(const std::string& name, std::size_t item_count, bool incremental) {
+    HashTable<uint64_t, uint64_t> table;
+    table.SetIncrementalRehash(incremental);
+    std::vector<uint64_t> latencies(item_count);
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < item_count; i++) {
+        Clock::time_point before = Clock::now();
+        table.Insert(SyntheticKey(i), i);
+        latencies[i] = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - before).count());
+    }
+    double total_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << ": " << item_count << " inserts in " << total_ms << " ms"
+              << " | p50 " << Percentile(latencies, 0.5) << " ns"
+              << " | p99 " << Percentile(latencies, 0.99) << " ns"
+              << " | p999 " << Percentile(latencies, 0.999) << " ns"
+              << " | max " << latencies.back() << " ns" << std::endl;
+}
+
+// 32 hex digits, the shape of the dataset's uniq_id
+std::string SyntheticId(uint64_t i) {
+    static const char kDigits[] = "0123456789abcdef";
+    std::string id(32, '0');
+    uint64_t high = SyntheticKey(i), low = SyntheticKey(high);
+    for (std::size_t d = 0; d < 16; d++) {
+        id[d] = kDigits[(high >> (4 * d)) & 0xF];
+        id[16 + d] = kDigits[(low >> (4 * d)) & 0xF];
+    }
+    return id;
+}
+
+// Hashes item_count id strings with the table's default hash and with std::hash
+void StringHashBenchmark(std::size_t item_count) {
+    std::vector<std::string> ids(item_count);
+    for (std::size_t i = 0; i < item_count; i++) ids[i] = SyntheticId(i);
+    HashTableHash<std::string> seeded;
+    std::hash<std::string> standard;
+    std::size_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for (const std::string& id : ids) sum += seeded(id);
+    double seeded_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    start = Clock::now();
+    for (const std::string& id : ids) sum += standard(id);
+    double standard_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << item_count << " id strings hashed: HashTableHash " << seeded_ms << " ms | std::hash "
+              << standard_ms << " ms (checksum " << sum % 1000 << ")" << std::endl;
+}
+
+// Inserts item_count id strings into an empty chained table (every doubling rehashes all keys
+//  inserted so far), then looks each one up.
+void StringKeyBenchmark(std::size_t item_count) {
+    std::vector<std::string> ids(item_count);
+    for (std::size_t i = 0; i < item_count; i++) ids[i] = SyntheticId(i);
+    HashTable<std::string, uint64_t> table;
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0; i < item_count; i++) {
+        table.Insert(ids[i], i);
+    }
+    double insert_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    start = Clock::now();
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < item_count; i++) {
+        found += table.Find(ids[i]) != table.end();
+    }
+    double find_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << item_count << " id strings: insert " << insert_ms << " ms | find " << find_ms << " ms"
+              << " (" << found << " found)" << std::endl;
+}
+
+// Fills a chained table with item_count keys, deletes all but every 1000th, then times full
+//  iterations of the now sparse table.
+void SparseIterationBenchmark(std::size_t item_count) {
+    HashTable<std::string, uint64_t> table;
+    for (std::size_t i = 0; i < item_count; i++) table.Insert(SyntheticId(i), i);
+    for (std::size_t i = 0; i < item_count; i++) {
+        if (i % 1000 != 0) table.Delete(SyntheticId(i));
+    }
+    const int kRounds = 100;
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (auto item : table) sum += item.second;
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / kRounds;
+    std::cout << table.size() << " items left in " << table.capacity() << " buckets: full iteration "
+              << ms << " ms (checksum " << sum << ")" << std::endl;
+}
+
+// Slice of a vector of keys, as a range for FindMany
+struct KeySpan {
+    const std::string* first_;
+    const std::string* last_;
+    const std::string* begin() const { return first_; }
+    const std::string* end() const { return last_; }
+};
+
+// Looks up item_count id strings in random order, in batches of kBatchSize, with a loop of
+//  Find and with FindMany. The table is far bigger than the cache, so nearly every lookup
+//  misses; FindMany overlaps those misses.
+template <typename Table>
+void FindManyBenchmark(const std::string& name, std::size_t item_count) {
+    const std::size_t kBatchSize = 256;
+    std::vector<std::string> ids(item_count);
+    for (std::size_t i = 0; i < item_count; i++) ids[i] = SyntheticId(i);
+    Table table;
+    for (std::size_t i = 0; i < item_count; i++) table.Insert(ids[i], i);
+    // Random order, with every fourth key missing from the table
+    std::vector<std::string> lookups(item_count);
+    for (std::size_t i = 0; i < item_count; i++) {
+        uint64_t pick = SyntheticKey(i + item_count);
+        lookups[i] = pick % 4 == 0 ? SyntheticId(item_count + i) : ids[pick % item_count];
+    }
+    std::vector<decltype(table.end())> found;
+    found.reserve(kBatchSize);
+    uint64_t looped_sum = 0, batched_sum = 0;
+    Clock::time_point start = Clock::now();
+    for (std::size_t first = 0; first < item_count; first += kBatchSize) {
+        std::size_t last = std::min(item_count, first + kBatchSize);
+        for (std::size_t i = first; i < last; i++) {
+            auto && q = table.Find(lookups[i]);
+            if (q != table.end()) looped_sum += (*q).second;
+        }
+    }
+    double looped_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    start = Clock::now();
+    for (std::size_t first = 0; first < item_count; first += kBatchSize) {
+        std::size_t last = std::min(item_count, first + kBatchSize);
+        found.clear();
+        table.FindMany(KeySpan{lookups.data() + first, lookups.data() + last}, std::back_inserter(found));
+        for (auto && q : found) {
+            if (q != table.end()) batched_sum += (*q).second;
+        }
+    }
+    double batched_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << name << ": " << item_count << " lookups, looped Find " << looped_ms << " ms | FindMany "
+              << batched_ms << " ms" << (looped_sum == batched_sum ? "" : " (MISMATCH)") << std::endl;
+}
+
+// Looks up every key of lookups with Find and returns the sum of the values found, so the
+//  lookups can't be optimized away
+template <typename Table>
+uint64_t LookupSum(Table& table, const std::vector<std::string>& lookups) {
+    uint64_t sum = 0;
+    for (const std::string& key : lookups) {
+        auto && q = table.Find(key);
+        if (q != table.end()) sum += (*q).second;
+    }
+    return sum;
+}
+
+template <typename Table>
+void TimeLookups(const std::string& name, Table& table, const std::vector<std::string>& lookups, double baseline_ms) {
+    Clock::time_point start = Clock::now();
+    uint64_t sum = LookupSum(table, lookups);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << name << ": " << lookups.size() << " lookups " << ms << " ms";
+    if (baseline_ms > 0) std::cout << " | " << baseline_ms / ms << "x chained";
+    std::cout << " (checksum " << sum % 1000 << ")" << std::endl;
+}
+
+// Freezes a table of item_count id strings, then looks the same random keys (a quarter of them
+//  missing) up in the chained, flat and frozen tables.
+void FrozenBenchmark(std::size_t item_count) {
+    std::vector<std::string> ids(item_count);
+    for (std::size_t i = 0; i < item_count; i++) ids[i] = SyntheticId(i);
+    HashTable<std::string, uint64_t> chained;
+    HashTable<std::string, uint64_t, FlatLayout> flat;
+    for (std::size_t i = 0; i < item_count; i++) {
+        chained.Insert(ids[i], i);
+        flat.Insert(ids[i], i);
+    }
+    HashTable<std::string, uint64_t, FlatLayout> to_freeze(flat);
+    Clock::time_point start = Clock::now();
+    FrozenHashTable<std::string, uint64_t> frozen(std::move(to_freeze));
+    double freeze_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "Freeze " << frozen.size() << " items: " << freeze_ms << " ms | memory "
+              << flat.GetStats().TotalBytes() / 1024 << " KiB flat, " << frozen.GetStats().TotalBytes() / 1024
+              << " KiB frozen" << std::endl;
+    std::vector<std::string> lookups(item_count);
+    for (std::size_t i = 0; i < item_count; i++) {
+        uint64_t pick = SyntheticKey(i + item_count);
+        lookups[i] = pick % 4 == 0 ? SyntheticId(item_count + i) : ids[pick % item_count];
+    }
+    start = Clock::now();
+    uint64_t sum = LookupSum(chained, lookups);
+    double chained_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::cout << "Chained: " << lookups.size() << " lookups " << chained_ms << " ms (checksum " << sum % 1000 << ")" << std::endl;
+    TimeLookups("Flat   ", flat, lookups, chained_ms);
+    TimeLookups("Frozen ", frozen, lookups, chained_ms);
+}
+
+// Lookups per second on a prefilled ConcurrentHashTable, for 1 thread up to every hardware
+//  thread. Each thread does the same number of lookups, so perfect scaling keeps the time flat.
+void ConcurrentReadScalingBenchmark(std::size_t item_count) {
+    ConcurrentHashTable<uint64_t, uint64_t> table;
+    for (std::size_t i = 0; i < item_count; i++) {
+        table.Insert(SyntheticKey(i), i);
+    }
+    std::size_t max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0) max_threads = 1;
+    double single_thread_rate = 0;
+    // 1, 2, 4, ... and finally max_threads itself if it isn't a power of two
+    for (std::size_t thread_count = 1; thread_count <= max_threads;
+         thread_count = thread_count < max_threads && thread_count * 2 > max_threads ? max_threads : thread_count * 2) {
+        std::vector<std::thread> threads;
+        std::vector<uint64_t> found(thread_count, 0);
+        Clock::time_point start = Clock::now();
+        for (std::size_t t = 0; t < thread_count; t++) {
+            threads.emplace_back([&table, &found, t, item_count]() {
+                uint64_t value = 0, hits = 0;
+                for (std::size_t i = 0; i < item_count; i++) {
+                    hits += table.Find(SyntheticKey((i * 7919 + t) % item_count), value);
+                }
+                found[t] = hits;
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        double rate = static_cast<double>(thread_count * item_count) / seconds;
+        if (thread_count == 1) single_thread_rate = rate;
+        std::cout << thread_count << " reader thread(s): " << rate / 1e6 << " M lookups/s"
+                  << " | speedup " << rate / single_thread_rate << "x" << std::endl;
+    }
+}
+}
+
+int main(int argc, char** argv) {
+    std::size_t item_count = 1000000;
+    if (argc > 1) item_count = std::strtoull(argv[1], nullptr, 10);
+    if (item_count == 0) return 0;
+    std::cout << "----- Insert latency (chained layout) -----" << std::endl;
+    InsertLatencyBenchmark("Stop-the-world rehash", item_count, false);
+    InsertLatencyBenchmark("Incremental rehash   ", item_count, true);
+    std::cout << "----- String hash -----" << std::endl;
+    StringHashBenchmark(item_count);
+    std::cout << "----- String keys (chained layout) -----" << std::endl;
+    StringKeyBenchmark(item_count);
+    std::cout << "----- Sparse iteration (chained layout) -----" << std::endl;
+    SparseIterationBenchmark(item_count);
+    std::cout << "----- Batched lookups -----" << std::endl;
+    FindManyBenchmark<HashTable<std::string, uint64_t>>("Chained", item_count);
+    FindManyBenchmark<HashTable<std::string, uint64_t, FlatLayout>>("Flat   ", item_count);
+    std::cout << "----- Frozen table -----" << std::endl;
+    FrozenBenchmark(item_count);
+    std::cout << "----- Read scaling (ConcurrentHashTable) -----" << std::endl;
+    ConcurrentReadScalingBenchmark(item_count);
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include "hash_table_test.h"
+
+#include <cstdlib>
+
+// Usage: hash_table_stress [item_count]   (default 50M)
+int main(int argc, char** argv) {
+    std::size_t item_count = 50000000;
+    if (argc > 1) item_count = std::strtoull(argv[1], nullptr, 10);
+    hash_table_test::StressTest(item_count);
+    return 0;
+}
@@ -1,4 +1,7 @@
 #include "hash_table.h"
+#include "concurrent_hash_table.h"
+#include "frozen_hash_table.h"
+#include "hash_distribution.h"
 #include "hash_table_test.h"
 #include "hash_table_test_i.h"
 
@@ -11,7 +14,8 @@ namespace {
 // 6 items inserted in case the table currently consists of 6 items (capacity 16).
 // At 12 items (capacity 32), this function will not reach the threshold of 23
 //  items required for another rehash.
-void ForceRehash(HashTable<std::string,std::string>& table) {
+template <typename Table>
+void ForceRehash(Table& table) {
     // Force an initial rehash. Table rehashes before, because capacity
     //  initializes to zero.
     // New table will have a load factor of 1 and will rehash on second insertion
@@ -190,6 +194,957 @@ void BasicIterationTest() {
     //  I'm running out of time to finish this assignment.
     std::cout << "BasicIterationTest" << Pass();
 }
+
+////                        ////////////////////////////////////////////////////
+//// FLAT LAYOUT TESTING    ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+typedef HashTable<std::string,std::string,FlatLayout> FlatTable;
+
+void FlatInsertFindDeleteTest() {
+    std::cout << "FlatInsertFindDeleteTest";
+    FlatTable table;
+    assert(table.Find("Empty") == table.end());
+    table.Delete("Empty");
+    table.Insert("Flat", "Insert Test");
+    table.Insert("Flat", "Duplicate Test");
+    auto && i = table.Find("Flat");
+    assert((*i).first == "Flat" && (*i).second == "Duplicate Test");
+    assert(table.size() == 1);
+    table.Delete("Flat");
+    assert(table.Find("Flat") == table.end() && table.size() == 0);
+    std::cout << Pass();
+}
+
+// Enough items to fill several groups, so probes have to cross group boundaries.
+void FlatRehashTest() {
+    std::cout << "FlatRehashTest";
+    FlatTable table;
+    table.Insert("Rehash", "Flat Test");
+    ForceRehash(table);
+    for (int i = 0; i < 1000; i++) {
+        table.Insert(std::to_string(i), std::to_string(i * 2));
+    }
+    assert(table.size() == 1007);
+    assert(table.GetLoadFactor() <= 0.875f);
+    for (int i = 0; i < 1000; i++) {
+        auto && q = table.Find(std::to_string(i));
+        assert(q != table.end() && (*q).second == std::to_string(i * 2));
+    }
+    auto && q = table.Find("Rehash");
+    assert(q != table.end() && (*q).second == "Flat Test");
+    std::cout << Pass();
+}
+
+// Repeated insert/delete cycles leave deleted slots behind. They must be reused or purged
+//  rather than grow the table forever.
+void FlatDeleteReuseTest() {
+    std::cout << "FlatDeleteReuseTest";
+    FlatTable table;
+    for (int round = 0; round < 200; round++) {
+        for (int i = 0; i < 10; i++) table.Insert(std::to_string(round * 10 + i), "Churn");
+        for (int i = 0; i < 10; i++) table.Delete(std::to_string(round * 10 + i));
+    }
+    assert(table.size() == 0 && table.capacity() <= 32);
+    assert(!(table.begin() != table.end()));
+    std::cout << Pass();
+}
+
+void FlatIterationTest() {
+    std::cout << "FlatIterationTest";
+    FlatTable table;
+    ForceRehash(table);
+    for (int i = 0; i < 100; i++) table.Insert(std::to_string(i), "Iteration");
+    for (int i = 0; i < 100; i += 2) table.Delete(std::to_string(i));
+    unsigned int count = 0;
+    for (auto&& i : table) {
+        count++;
+        assert(table.Find(i.first) != table.end());
+    }
+    assert(count == table.size() && count == 56);
+    std::cout << Pass();
+}
+
+// Copies must be deep: changing the copy cannot change the original.
+void FlatRecursiveTableTest() {
+    std::cout << "FlatRecursiveTableTest";
+    FlatTable table;
+    ForceRehash(table);
+    HashTable<std::string, FlatTable, FlatLayout> super_table;
+    super_table.Insert("Inner", table);
+    FlatTable copy = (*super_table.Find("Inner")).second;
+    copy.Insert("Only", "In Copy");
+    copy.Delete("Hello");
+    FlatTable& inner = (*super_table.Find("Inner")).second;
+    assert(inner.Find("Only") == inner.end());
+    assert(inner.Find("Hello") != inner.end());
+    assert(inner.size() == 6 && copy.size() == 6);
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// RESERVE TESTING        ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// After Reserve(n), inserting n items must not change the capacity.
+template <typename Table>
+void ReserveCapacityTest(const std::string& name) {
+    std::cout << name;
+    Table table;
+    table.Reserve(1000);
+    std::size_t reserved_capacity = table.capacity();
+    assert(reserved_capacity > 0);
+    for (int i = 0; i < 1000; i++) {
+        table.Insert(std::to_string(i), "Reserve");
+    }
+    assert(table.capacity() == reserved_capacity && table.size() == 1000);
+    table.Reserve(10); // Never shrinks
+    assert(table.capacity() == reserved_capacity);
+    assert(table.Find("999") != table.end());
+    std::cout << Pass();
+}
+
+template <typename Table>
+void BulkConstructTest(const std::string& name) {
+    std::cout << name;
+    std::vector<std::pair<std::string, std::string>> items;
+    for (int i = 0; i < 1000; i++) {
+        items.push_back(std::make_pair(std::to_string(i), std::to_string(i * 3)));
+    }
+    items.push_back(std::make_pair(std::string("5"), std::string("Duplicate"))); // Later items win
+    Table table(items.begin(), items.end());
+    assert(table.size() == 1000);
+    for (int i = 0; i < 1000; i++) {
+        auto && q = table.Find(std::to_string(i));
+        assert(q != table.end());
+        assert((*q).second == (i == 5 ? "Duplicate" : std::to_string(i * 3)));
+    }
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// NODE ALLOCATOR TESTING ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// NewDeleteAllocator that counts the nodes currently handed out, across all tables.
+template <typename T>
+class CountingAllocator {
+public:
+    static std::size_t live_;
+    T* Allocate() { ++live_; return allocator_.Allocate(); }
+    void Deallocate(T* node) { --live_; allocator_.Deallocate(node); }
+    void Swap(CountingAllocator& other) noexcept { allocator_.Swap(other.allocator_); }
+private:
+    NewDeleteAllocator<T> allocator_;
+};
+template <typename T>
+std::size_t CountingAllocator<T>::live_ = 0;
+
+// A freed node is the next one handed out.
+void NodePoolReuseTest() {
+    std::cout << "NodePoolReuseTest";
+    NodePool<HashTableContainer<std::string, std::string>> pool;
+    HashTableContainer<std::string, std::string>* first = pool.Allocate();
+    HashTableContainer<std::string, std::string>* second = pool.Allocate();
+    assert(first != second);
+    pool.Deallocate(first);
+    assert(pool.Allocate() == first);
+    pool.Deallocate(second);
+    pool.Deallocate(first);
+    std::cout << Pass();
+}
+
+// Every out-of-array node goes back to the allocator on delete, and rehashing relinks
+//  nodes instead of leaking them.
+void NodeAllocatorBalanceTest() {
+    std::cout << "NodeAllocatorBalanceTest";
+    typedef HashTableContainer<std::string, std::string> Node;
+    {
+        HashTable<std::string, std::string, ChainedLayout, CountingAllocator> table;
+        for (int i = 0; i < 5000; i++) {
+            table.Insert(std::to_string(i), "Node");
+        }
+        assert(CountingAllocator<Node>::live_ < table.size());
+        for (int i = 0; i < 5000; i += 2) {
+            table.Delete(std::to_string(i));
+        }
+        for (int i = 1; i < 5000; i += 2) {
+            auto && q = table.Find(std::to_string(i));
+            assert(q != table.end() && (*q).second == "Node");
+        }
+        for (int i = 1; i < 5000; i += 2) {
+            table.Delete(std::to_string(i));
+        }
+        assert(table.size() == 0 && CountingAllocator<Node>::live_ == 0);
+        for (int i = 0; i < 5000; i++) {
+            table.Insert(std::to_string(i), "Again");
+        }
+    }
+    assert(CountingAllocator<Node>::live_ == 0); // Destructor returned every node
+    std::cout << Pass();
+}
+
+// Copies own their chains, moves take them.
+void ChainedCopyMoveTest() {
+    std::cout << "ChainedCopyMoveTest";
+    HashTable<std::string, std::string> table;
+    for (int i = 0; i < 1000; i++) {
+        table.Insert(std::to_string(i), "Original");
+    }
+    HashTable<std::string, std::string> copy(table);
+    for (int i = 0; i < 1000; i += 2) {
+        copy.Delete(std::to_string(i));
+    }
+    copy.Insert("1", "Changed");
+    assert(table.size() == 1000 && copy.size() == 500);
+    for (int i = 0; i < 1000; i++) {
+        auto && q = table.Find(std::to_string(i));
+        assert(q != table.end() && (*q).second == "Original");
+    }
+    copy = table; // Replaces existing contents
+    assert(copy.size() == 1000 && (*copy.Find("1")).second == "Original");
+
+    HashTable<std::string, std::string> moved(std::move(copy));
+    assert(moved.size() == 1000 && copy.size() == 0 && copy.Find("1") == copy.end());
+    copy = std::move(moved);
+    assert(copy.size() == 1000 && (*copy.Find("999")).second == "Original");
+    copy.Insert("Reuse", "After move");
+    moved.Insert("Reuse", "After move"); // Moved-from table is still usable
+    assert(moved.size() == 1);
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// HETEROGENEOUS LOOKUP   ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// string_view, const char* and literal keys find and delete the same items as std::string keys.
+template <typename Table>
+void TransparentLookupTest(const std::string& name) {
+    std::cout << name;
+    static_assert(IsTransparentPolicy<HashTableHash<std::string>, HashTableKeyEqual<std::string>, std::string_view>::value,
+                  "std::string keys should accept std::string_view lookups");
+    Table table;
+    for (int i = 0; i < 1000; i++) {
+        table.Insert(std::to_string(i), std::to_string(i * 2));
+    }
+    std::string buffer = "find 123 trailing";
+    std::string_view view = std::string_view(buffer).substr(5, 3); // "123", not null-terminated
+    auto && q = table.Find(view);
+    assert(q != table.end() && (*q).second == "246");
+    const char* c_string = "999";
+    assert(table.Find(c_string) != table.end());
+    assert(table.Find(std::string_view("1000")) == table.end());
+    table.Delete(view);
+    table.Delete(c_string);
+    assert(table.size() == 998 && table.Find(std::string("123")) == table.end());
+    assert(table.Find("0") != table.end());
+    std::cout << Pass();
+}
+
+// Keys without a transparent policy keep the plain Key overloads and their implicit conversions.
+void NonTransparentLookupTest() {
+    std::cout << "NonTransparentLookupTest";
+    static_assert(!IsTransparentPolicy<HashTableHash<uint64_t>, HashTableKeyEqual<uint64_t>, int>::value,
+                  "integer keys should not use heterogeneous lookup");
+    HashTable<uint64_t, int, FlatLayout> table;
+    table.Insert(7, 49);
+    assert(table.Find(7) != table.end() && (*table.Find(7)).second == 49); // int converts to uint64_t
+    table.Delete(7);
+    assert(table.size() == 0);
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// MOVE / EMPLACE TESTING ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// Value that counts how often it is constructed and copied.
+struct CopyCounter {
+    static int copies_;
+    static int constructions_;
+    CopyCounter() { ++constructions_; }
+    explicit CopyCounter(int value) : value_(value) { ++constructions_; }
+    CopyCounter(const CopyCounter& other) : value_(other.value_) { ++copies_; }
+    CopyCounter(CopyCounter&& other) noexcept = default;
+    CopyCounter& operator=(const CopyCounter& other) { value_ = other.value_; ++copies_; return *this; }
+    CopyCounter& operator=(CopyCounter&& other) noexcept = default;
+    int value_ = 0;
+};
+int CopyCounter::copies_ = 0;
+int CopyCounter::constructions_ = 0;
+
+// Rvalue Insert, Emplace and TryEmplace never copy a value, including through rehashes.
+template <typename Table>
+void MoveInsertTest(const std::string& name) {
+    std::cout << name;
+    CopyCounter::copies_ = 0;
+    Table table;
+    for (int i = 0; i < 1000; i++) {
+        table.Insert(std::to_string(i), CopyCounter(i));
+    }
+    table.Insert("5", CopyCounter(-5)); // Overwrite
+    auto && emplaced = table.Emplace("1000", 1000);
+    assert(emplaced.second && (*emplaced.first).second.value_ == 1000);
+    auto && replaced = table.Emplace("6", -6); // Replaces existing value
+    assert(!replaced.second && (*replaced.first).second.value_ == -6);
+    assert(CopyCounter::copies_ == 0 && table.size() == 1001);
+    assert((*table.Find("5")).second.value_ == -5 && (*table.Find("999")).second.value_ == 999);
+    std::cout << Pass();
+}
+
+// TryEmplace leaves an existing value alone and doesn't construct anything for it.
+template <typename Table>
+void TryEmplaceTest(const std::string& name) {
+    std::cout << name;
+    Table table;
+    auto && first = table.TryEmplace("Key", 1);
+    assert(first.second && (*first.first).second.value_ == 1);
+    CopyCounter::constructions_ = 0;
+    auto && second = table.TryEmplace("Key", 2);
+    assert(!second.second && (*second.first).second.value_ == 1);
+    assert(CopyCounter::constructions_ == 0 && table.size() == 1);
+    // Iterators returned across a rehash point at the right item
+    for (int i = 0; i < 100; i++) {
+        auto && inserted = table.TryEmplace(std::to_string(i), i);
+        assert(inserted.second && (*inserted.first).first == std::to_string(i) && (*inserted.first).second.value_ == i);
+    }
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// INCREMENTAL REHASH     ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+std::size_t CountItems(const HashTable<std::string, std::string>& table) {
+    std::size_t count = 0;
+    for (auto && item : table) {
+        (void)item;
+        count++;
+    }
+    return count;
+}
+
+// Every item stays reachable through Find and iteration while it waits in the old array.
+void IncrementalInsertFindTest() {
+    std::cout << "IncrementalInsertFindTest";
+    HashTable<std::string, std::string> table;
+    table.SetIncrementalRehash(true);
+    bool saw_rehash = false;
+    for (int i = 0; i < 5000; i++) {
+        table.Insert(std::to_string(i), std::to_string(i));
+        if (table.IsRehashing()) {
+            saw_rehash = true;
+            assert(CountItems(table) == table.size());
+        }
+        for (int j = 0; j <= i; j += 97) {
+            auto && q = table.Find(std::to_string(j));
+            assert(q != table.end() && (*q).second == std::to_string(j));
+        }
+    }
+    assert(saw_rehash && table.size() == 5000);
+    table.Insert("42", "Overwritten"); // Duplicate of an item that may still be in the old array
+    assert(table.size() == 5000 && (*table.Find("42")).second == "Overwritten");
+    table.SetIncrementalRehash(false); // Finishes the move
+    assert(!table.IsRehashing() && CountItems(table) == 5000);
+    std::cout << Pass();
+}
+
+// Deletes and copies in the middle of an incremental rehash.
+void IncrementalDeleteCopyTest() {
+    std::cout << "IncrementalDeleteCopyTest";
+    HashTable<std::string, std::string> table;
+    table.SetIncrementalRehash(true);
+    int i = 0;
+    while (!table.IsRehashing() || table.size() < 100) {
+        table.Insert(std::to_string(i), "Value");
+        i++;
+    }
+    HashTable<std::string, std::string> copy(table);
+    assert(copy.size() == table.size() && CountItems(copy) == copy.size());
+    for (int j = 0; j < i; j += 2) {
+        table.Delete(std::to_string(j));
+    }
+    for (int j = 0; j < i; j++) {
+        assert((table.Find(std::to_string(j)) == table.end()) == (j % 2 == 0));
+        assert(copy.Find(std::to_string(j)) != copy.end());
+    }
+    assert(CountItems(table) == table.size() && table.size() == static_cast<std::size_t>(i / 2));
+    HashTable<std::string, std::string> moved(std::move(copy));
+    assert(moved.size() == static_cast<std::size_t>(i) && moved.Find("1") != moved.end());
+    std::cout << Pass();
+}
+
+// Single-threaded behaviour: insert, overwrite, delete, and growth through several resizes.
+void ConcurrentBasicTest() {
+    std::cout << "ConcurrentBasicTest";
+    ConcurrentHashTable<std::string, std::string> table;
+    std::string value;
+    assert(!table.Find("Missing", value) && !table.Delete("Missing"));
+    for (int i = 0; i < 5000; i++) {
+        table.Insert(std::to_string(i), std::to_string(i));
+    }
+    assert(table.size() == 5000 && table.capacity() >= 5000);
+    table.Insert("42", "Overwritten");
+    assert(table.size() == 5000 && table.Find(std::string_view("42"), value) && value == "Overwritten");
+    for (int i = 0; i < 5000; i += 2) {
+        assert(table.Delete(std::to_string(i)));
+    }
+    std::size_t visited = 0;
+    table.ForEach([&visited](const std::string& key, const std::string&) {
+        assert(std::stoi(key) % 2 == 1);
+        visited++;
+    });
+    assert(visited == 2500 && table.size() == 2500);
+    for (int i = 1; i < 5000; i += 2) {
+        assert(table.Contains(std::to_string(i)) && !table.Contains(std::to_string(i - 1)));
+    }
+    std::cout << Pass();
+}
+
+// Writers insert, overwrite and delete disjoint key ranges while readers look keys up.
+//  A reader must only ever see a key missing or holding one of the values written for it.
+void ConcurrentReadWriteTest(std::size_t keys_per_writer) {
+    std::cout << "ConcurrentReadWriteTest";
+    const std::size_t writer_count = 4, reader_count = 4;
+    ConcurrentHashTable<uint64_t, uint64_t> table;
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+    for (std::size_t w = 0; w < writer_count; w++) {
+        threads.emplace_back([&table, w, keys_per_writer]() {
+            uint64_t first = w * keys_per_writer, last = first + keys_per_writer;
+            for (uint64_t key = first; key < last; key++) table.Insert(key, key);
+            for (uint64_t key = first; key < last; key++) table.Insert(key, key + 1);
+            for (uint64_t key = first; key < last; key += 2) table.Delete(key);
+        });
+    }
+    for (std::size_t r = 0; r < reader_count; r++) {
+        threads.emplace_back([&table, &done, r, writer_count, keys_per_writer]() {
+            uint64_t key = r;
+            while (!done.load(std::memory_order_relaxed)) {
+                key = (key + 7919) % (writer_count * keys_per_writer);
+                table.Visit(key, [key](const uint64_t& value) {
+                    assert(value == key || value == key + 1);
+                    (void)value;
+                });
+            }
+        });
+    }
+    for (std::size_t w = 0; w < writer_count; w++) threads[w].join();
+    done.store(true);
+    for (std::size_t r = writer_count; r < threads.size(); r++) threads[r].join();
+    assert(table.size() == writer_count * keys_per_writer / 2);
+    for (uint64_t key = 0; key < writer_count * keys_per_writer; key++) {
+        uint64_t value = 0;
+        assert(table.Find(key, value) == (key % 2 == 1) && (key % 2 == 0 || value == key + 1));
+    }
+    std::cout << Pass();
+}
+
+// String key whose hash function counts its calls
+struct CountedHashKey {
+    std::string id_;
+    bool operator==(const CountedHashKey& other) const { return id_ == other.id_; }
+};
+std::size_t counted_hash_calls = 0;
+}
+
+template <>
+struct HashTableHash<CountedHashKey> {
+    std::size_t operator()(const CountedHashKey& key) const {
+        counted_hash_calls++;
+        return std::hash<std::string>()(key.id_);
+    }
+};
+
+namespace {
+// With cached hashes each insert or lookup hashes its key once, and rehashes hash nothing.
+void CachedHashRehashTest() {
+    std::cout << "CachedHashRehashTest";
+    static_assert(HashTableContainer<CountedHashKey, int>::kCachesHash, "class keys cache their hash");
+    static_assert(!HashTableContainer<uint64_t, int>::kCachesHash, "integer keys don't");
+    HashTable<CountedHashKey, int> table;
+    counted_hash_calls = 0;
+    for (int i = 0; i < 1000; i++) {
+        table.Insert(CountedHashKey{std::to_string(i)}, i);
+    }
+    assert(counted_hash_calls == 1000 && table.capacity() >= 1024);
+    for (int i = 0; i < 1000; i++) {
+        auto && q = table.Find(CountedHashKey{std::to_string(i)});
+        assert(q != table.end() && (*q).second == i);
+    }
+    assert(counted_hash_calls == 2000);
+    HashTable<CountedHashKey, int> copy(table); // Copies the stored hashes too
+    table.Delete(CountedHashKey{"0"});
+    assert(counted_hash_calls == 2001 && copy.size() == 1000 && copy.Find(CountedHashKey{"0"}) != copy.end());
+    std::cout << Pass();
+}
+
+// Inserts and deletes while the table grows incrementally, so lookups go through stored
+//  hashes in both the old and the new array.
+void CachedHashIncrementalTest() {
+    std::cout << "CachedHashIncrementalTest";
+    HashTable<std::string, int> table;
+    table.SetIncrementalRehash(true);
+    std::vector<bool> deleted(3000, false);
+    for (int i = 0; i < 3000; i++) {
+        table.Insert(std::to_string(i), i);
+        if (i % 7 == 0) {
+            table.Delete(std::to_string(i / 2));
+            deleted[i / 2] = true;
+        }
+    }
+    for (int i = 0; i < 3000; i++) {
+        auto && q = table.Find(std::to_string(i));
+        assert((q == table.end()) == deleted[i] && (deleted[i] || (*q).second == i));
+    }
+    std::cout << Pass();
+}
+
+// FindNext across word boundaries and at the end of a bitmap whose size isn't a multiple of 64.
+void OccupancyBitmapTest() {
+    std::cout << "OccupancyBitmapTest";
+    OccupancyBitmap bitmap;
+    bitmap.Reset(200);
+    assert(bitmap.FindNext(0, 200) == 200);
+    bitmap.Set(3);
+    bitmap.Set(64);
+    bitmap.Set(199);
+    assert(bitmap.FindNext(0, 200) == 3 && bitmap.FindNext(4, 200) == 64 && bitmap.FindNext(65, 200) == 199);
+    assert(bitmap.FindNext(65, 199) == 199 && bitmap.FindNext(200, 200) == 200);
+    bitmap.Clear(64);
+    assert(bitmap.FindNext(4, 200) == 199);
+    OccupancyBitmap copy;
+    copy = bitmap;
+    bitmap.Clear(3);
+    assert(copy.FindNext(0, 200) == 3 && bitmap.FindNext(0, 200) == 199);
+    std::cout << Pass();
+}
+
+// Iterates a table emptied down to a few items, deleting heads of chains so that buckets
+//  become empty again, and checks begin() after inserting in front of an earlier begin() and
+//  while the table is emptied from the front.
+template <typename Table>
+void SparseIterationTest(const std::string& name, bool incremental) {
+    std::cout << name;
+    Table table;
+    table.SetIncrementalRehash(incremental);
+    for (int i = 0; i < 5000; i++) table.Insert(std::to_string(i), i);
+    for (int i = 0; i < 5000; i++) {
+        if (i % 500 != 0) table.Delete(std::to_string(i));
+    }
+    int count = 0;
+    for (auto item : table) {
+        assert(std::stoi(item.first) % 500 == 0 && item.second % 500 == 0);
+        count++;
+    }
+    assert(count == 10 && table.size() == 10);
+    for (int i = 0; i < 5000; i += 500) table.Delete(std::to_string(i));
+    assert(!(table.begin() != table.end()));
+    table.Insert("Back", 1);
+    assert((*table.begin()).first == "Back");
+    table.Insert("Again", 2);
+    count = 0;
+    for (auto item : table) count += item.second;
+    assert(count == 3);
+    Table copy(table);
+    count = 0;
+    for (auto item : copy) count += item.second;
+    assert(count == 3);
+    // Emptied from the front, through a const table whose begin() only reads: each Delete
+    //  moves the start of the table past the bucket it empties
+    for (int i = 0; i < 1000; i++) table.Insert(std::to_string(i), i);
+    const Table& view = table;
+    count = 0;
+    while (view.begin() != view.end()) {
+        table.Delete(std::string((*view.begin()).first));
+        count++;
+    }
+    assert(count == 1002 && table.size() == 0);
+    std::cout << Pass();
+}
+
+// Any seed hashes std::string, std::string_view and const char* alike, every length takes a
+//  different path through the hash, and different seeds place keys differently.
+void SeededStringHashTest() {
+    std::cout << "SeededStringHashTest";
+    HashTableHash<std::string> hasher(1), other_seed(2);
+    std::string key;
+    std::size_t differing = 0;
+    for (int length = 0; length < 100; length++) {
+        assert(hasher(key) == hasher(std::string_view(key)) && hasher(key) == hasher(key.c_str()));
+        assert(hasher(key) == HashTableHash<std::string>(1)(key));
+        if (hasher(key) != other_seed(key)) differing++;
+        key.push_back(static_cast<char>('a' + length % 26));
+    }
+    assert(differing == 100);
+    // Strings differing in one byte, at every position of a 64-byte key
+    HashTable<std::size_t, int> seen;
+    std::string base(64, 'x');
+    for (std::size_t i = 0; i < base.size(); i++) {
+        std::string changed = base;
+        changed[i] = 'y';
+        seen.Insert(hasher(changed), 0);
+    }
+    assert(seen.size() == base.size());
+    std::cout << Pass();
+}
+
+// Tables built with a given hasher, or with a Hash type of their own
+struct TripleHash {
+    std::size_t operator()(uint64_t key) const { return static_cast<std::size_t>(key * 3); }
+};
+struct LengthHash {
+    std::size_t operator()(const std::string& key) const { return key.size(); }
+};
+
+template <typename Table>
+void CustomHashTest(const std::string& name) {
+    std::cout << name;
+    Table seeded(HashTableHash<std::string>(42));
+    for (int i = 0; i < 1000; i++) seeded.Insert(std::to_string(i), std::to_string(i));
+    Table copy(seeded);
+    Table assigned;
+    assigned = seeded; // Takes seeded's hasher along with its layout
+    for (int i = 0; i < 1000; i++) {
+        assert(copy.Find(std::to_string(i)) != copy.end() && assigned.Find(std::string_view(std::to_string(i))) != assigned.end());
+    }
+    std::cout << Pass();
+}
+
+void UserHashTypeTest() {
+    std::cout << "UserHashTypeTest";
+    HashTable<uint64_t, int, ChainedLayout, NodePool, TripleHash> chained;
+    HashTable<uint64_t, int, FlatLayout, NodePool, TripleHash> flat;
+    // Every key collides with several others under LengthHash; not transparent, so a string
+    //  literal converts to std::string for Find
+    HashTable<std::string, int, ChainedLayout, NodePool, LengthHash> by_length;
+    for (int i = 0; i < 500; i++) {
+        chained.Insert(i, i);
+        flat.Insert(i, i);
+        by_length.Insert(std::to_string(i), i);
+    }
+    for (int i = 0; i < 500; i++) {
+        assert((*chained.Find(i)).second == i && (*flat.Find(i)).second == i);
+        assert((*by_length.Find(std::to_string(i))).second == i);
+    }
+    assert(by_length.Find("42") != by_length.end());
+    std::cout << Pass();
+}
+
+// Figures for a perfect spread, for everything in one bucket, and for seeded uniq_id-like keys.
+void HashDistributionTest() {
+    std::cout << "HashDistributionTest";
+    std::vector<uint64_t> numbers;
+    for (uint64_t i = 0; i < 1024; i++) numbers.push_back(i);
+    HashDistributionReport perfect = AnalyzeHashDistribution(numbers.begin(), numbers.end(), 1000, std::hash<uint64_t>());
+    assert(perfect.bucket_count == 1024 && perfect.empty_buckets == 0 && perfect.collisions == 0);
+    assert(perfect.longest_chain == 1 && perfect.chi_squared_ratio == 0 && perfect.chain_length_histogram[1] == 1024);
+    HashDistributionReport clustered = AnalyzeHashDistribution(numbers.begin(), numbers.end(), 1024, [](uint64_t) { return std::size_t(7); });
+    assert(clustered.longest_chain == 1024 && clustered.collisions == 1023 && clustered.chi_squared_ratio > 100);
+    assert(clustered.chain_length_histogram[HashDistributionReport::kHistogramSize - 1] == 1);
+    std::vector<std::string> ids;
+    for (int i = 0; i < 20000; i++) ids.push_back(std::string(28, '0') + std::to_string(1000 + i % 9000) + std::to_string(i / 9000));
+    HashDistributionReport seeded = AnalyzeHashDistribution(ids.begin(), ids.end(), 32768, HashTableHash<std::string>(7));
+    assert(seeded.chi_squared_ratio > 0.9 && seeded.chi_squared_ratio < 1.1 && seeded.longest_chain < 10);
+    std::cout << Pass();
+}
+
+// FindMany must give the same answers as Find, in order, for hits, misses, transparent key
+//  types, batches shorter than the prefetch distance and empty tables. table starts empty and
+//  may be configured (e.g. for incremental rehashing) by the caller.
+template <typename Table>
+void FindManyMatchesFindTest(const std::string& name, Table& table) {
+    std::cout << name;
+    // Looked up through a const reference, as FindMany changes nothing
+    const Table& view = table;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 2500; i++) keys.push_back(std::to_string(i * 7 % 2500));
+    std::vector<decltype(table.end())> found;
+    view.FindMany(keys, std::back_inserter(found));
+    assert(found.size() == keys.size() && !(found[0] != table.end()));
+    for (int i = 0; i < 1000; i++) table.Insert(std::to_string(i), i);
+    found.clear();
+    view.FindMany(keys, std::back_inserter(found));
+    assert(found.size() == keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        assert(!(found[i] != table.Find(keys[i])));
+        assert(found[i] == table.end() || (*found[i]).first == keys[i]);
+    }
+    std::vector<std::string_view> views(keys.begin(), keys.begin() + 3);
+    found.clear();
+    view.FindMany(views, std::back_inserter(found));
+    assert(found.size() == 3 && (*found[1]).second == 7);
+    found.clear();
+    view.FindMany(std::vector<std::string>(), std::back_inserter(found));
+    assert(found.empty());
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// STATISTICS TESTING     ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// Keys longer than any small string buffer, so each one owns heap memory
+std::string LongKey(int i) {
+    return "a key too long for the small string buffer " + std::to_string(i);
+}
+
+// The counters move only when built with HASH_TABLE_STATS, and are 0 otherwise. Every
+//  successful lookup probes at least once.
+void CheckCounters(const HashTableStats& stats, uint64_t lookups, uint64_t hits, bool rehashed) {
+    assert(stats.counters_enabled == kHashTableStatsEnabled);
+    if (kHashTableStatsEnabled) {
+        assert(stats.lookups == lookups && stats.probes >= hits);
+        assert((stats.rehashes > 0) == rehashed);
+    } else {
+        assert(stats.lookups == 0 && stats.probes == 0 && stats.rehashes == 0 && stats.rehash_nanoseconds == 0);
+    }
+}
+
+// Every bucket is in the histogram once, every item is in a chain, and each item beyond the
+//  first of its chain is one node.
+void ChainedStatsTest(const std::string& name, bool incremental) {
+    std::cout << name;
+    // Fixed seed: with a random one the longest chain is only very likely to stay short
+    HashTable<std::string, int> table(HashTableHash<std::string>(1));
+    table.SetIncrementalRehash(incremental);
+    HashTableStats stats = table.GetStats();
+    assert(stats.table_count == 1 && stats.size == 0 && stats.TotalBytes() == 0);
+    CheckCounters(stats, 0, 0, false);
+    for (int i = 0; i < 3000; i++) table.Insert(LongKey(i), i);
+    for (int i = 0; i < 1000; i++) assert(table.Find(LongKey(i * 3)) != table.end());
+    for (int i = 0; i < 500; i++) assert(!(table.Find(std::to_string(i)) != table.end()));
+    stats = table.GetStats();
+    assert(stats.size == 3000 && stats.capacity == table.capacity());
+    std::size_t buckets = 0, items = 0;
+    for (std::size_t i = 0; i < HashTableStats::kHistogramSize; i++) {
+        buckets += stats.chain_length_histogram[i];
+        items += i * stats.chain_length_histogram[i];
+    }
+    // Chains are kept short, so none reaches the last "or longer" entry
+    assert(stats.longest_chain < HashTableStats::kHistogramSize - 1 && items == 3000);
+    if (!table.IsRehashing()) assert(buckets == table.capacity());
+    std::size_t occupied = buckets - stats.chain_length_histogram[0];
+    assert(stats.node_bytes == (3000 - occupied) * sizeof(HashTableContainer<std::string, int>));
+    assert(stats.array_bytes >= table.capacity() * sizeof(HashTableContainer<std::string, int>));
+    assert(stats.heap_bytes >= 3000 * LongKey(0).size());
+    CheckCounters(stats, 1500, 1000, true);
+    std::cout << Pass();
+}
+
+// Chain lengths of the flat layout are groups probed, at least 1 for every item
+void FlatStatsTest() {
+    std::cout << "FlatStatsTest";
+    HashTable<std::string, int, FlatLayout> table;
+    for (int i = 0; i < 3000; i++) table.Insert(LongKey(i), i);
+    for (int i = 0; i < 200; i++) table.Delete(LongKey(i));
+    for (int i = 0; i < 1000; i++) table.Find(LongKey(i));
+    HashTableStats stats = table.GetStats();
+    assert(stats.size == 2800 && stats.capacity == table.capacity());
+    assert(stats.chain_length_histogram[0] == 0 && stats.longest_chain >= 1);
+    std::size_t items = 0;
+    for (std::size_t count : stats.chain_length_histogram) items += count;
+    assert(items == 2800);
+    assert(stats.node_bytes == 0 && stats.array_bytes >= table.capacity() * (sizeof(std::string) + sizeof(int)));
+    assert(stats.heap_bytes >= 2800 * LongKey(0).size());
+    // Every Insert and Delete looks its key up as well
+    CheckCounters(stats, 4200, 1200, true);
+    std::cout << Pass();
+}
+
+// Reports add up, and a table stored in another table counts towards the outer one's memory
+void AggregateStatsTest() {
+    std::cout << "AggregateStatsTest";
+    HashTable<std::string, HashTable<std::string, std::string>, FlatLayout> outer;
+    HashTableStats inner_total;
+    for (int i = 0; i < 50; i++) {
+        HashTable<std::string, std::string> inner;
+        for (int j = 0; j <= i; j++) inner.Insert(LongKey(j), LongKey(i));
+        inner_total += inner.GetStats();
+        outer.Insert(std::to_string(i), std::move(inner));
+    }
+    assert(inner_total.table_count == 50 && inner_total.size == 50 * 51 / 2);
+    HashTableStats outer_stats = outer.GetStats();
+    assert(outer_stats.heap_bytes == inner_total.TotalBytes());
+    HashTableStats both = outer_stats;
+    both += inner_total;
+    assert(both.table_count == 51 && both.size == 50 + 50 * 51 / 2);
+    assert(both.TotalBytes() == outer_stats.TotalBytes() + inner_total.TotalBytes());
+    assert(both.longest_chain == std::max(outer_stats.longest_chain, inner_total.longest_chain));
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// FROZEN TABLE TESTING   ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// Every hash gets its own slot, for sizes around the bucket size and for a large set
+void PerfectHashTest() {
+    std::cout << "PerfectHashTest";
+    for (std::size_t size : {0, 1, 2, 3, 4, 5, 17, 1000, 20011}) {
+        std::vector<uint64_t> hashes;
+        for (std::size_t i = 0; i < size; i++) hashes.push_back(string_hash::Hash(&i, sizeof(i), 99));
+        perfect_hash::Function function;
+        assert(function.Build(hashes) && function.size() == size);
+        std::vector<bool> used(size, false);
+        for (uint64_t hash : hashes) {
+            std::size_t slot = function.Slot(hash);
+            assert(slot < size && !used[slot]);
+            used[slot] = true;
+        }
+    }
+    std::vector<uint64_t> repeated = {1, 2, 3, 2};
+    perfect_hash::Function function;
+    assert(!function.Build(repeated) && function.size() == 0);
+    std::cout << Pass();
+}
+
+// Freezing moves every item over and empties the source. Hits, misses and transparent key
+//  types all resolve in one probe, and iteration visits every item once.
+void FrozenFindTest() {
+    std::cout << "FrozenFindTest";
+    HashTable<std::string, int, FlatLayout> table;
+    for (int i = 0; i < 5000; i++) table.Insert(i % 2 ? LongKey(i) : std::to_string(i), i);
+    // Either side of the longest key kept in its slot
+    table.Insert(std::string(32, 'x'), 5000);
+    table.Insert(std::string(33, 'x'), 5001);
+    FrozenHashTable<std::string, int> frozen(std::move(table));
+    assert(table.size() == 0 && frozen.size() == 5002 && frozen.capacity() == 5002);
+    assert((*frozen.Find(std::string(32, 'x'))).second == 5000 && (*frozen.Find(std::string(33, 'x'))).second == 5001);
+    assert((*frozen.Find(std::string(33, 'x'))).first == std::string(33, 'x'));
+    for (int i = 0; i < 5000; i++) {
+        std::string key = i % 2 ? LongKey(i) : std::to_string(i);
+        auto found = frozen.Find(key);
+        assert(found != frozen.end() && (*found).first == key && (*found).second == i);
+        assert(frozen.Find(std::string_view(key)) == found);
+    }
+    assert(frozen.Find("1") == frozen.end() && frozen.Find(LongKey(2)) == frozen.end());
+    assert((*frozen.Find("42")).second == 42 && frozen.Find(std::string()) == frozen.end());
+    std::vector<bool> seen(5002, false);
+    for (auto && item : frozen) {
+        assert(!seen[item.second]);
+        seen[item.second] = true;
+    }
+    assert(std::count(seen.begin(), seen.end(), true) == 5002);
+    std::cout << Pass();
+}
+
+void FrozenEmptyTest() {
+    std::cout << "FrozenEmptyTest";
+    FrozenHashTable<std::string, int> frozen(HashTable<std::string, int>{});
+    FrozenHashTable<std::string, int> defaulted;
+    assert(frozen.size() == 0 && !(frozen.begin() != frozen.end()) && frozen.Find("a") == frozen.end());
+    assert(defaulted.Find(std::string("a")) == defaulted.end() && !(defaulted.begin() != defaulted.end()));
+    std::vector<decltype(frozen.end())> found;
+    std::vector<std::string> keys = {"a", "b"};
+    frozen.FindMany(keys, std::back_inserter(found));
+    assert(found.size() == 2 && found[0] == frozen.end() && found[1] == frozen.end());
+    std::cout << Pass();
+}
+
+// Keys other than std::string are kept as they are. The range constructor keeps the last of
+//  several items with the same key.
+void FrozenIntegerKeyTest() {
+    std::cout << "FrozenIntegerKeyTest";
+    std::vector<std::pair<uint64_t, std::string>> items;
+    for (uint64_t i = 0; i < 3000; i++) items.emplace_back(i * 1024, std::to_string(i));
+    items.emplace_back(0, "last");
+    FrozenHashTable<uint64_t, std::string> frozen(items.begin(), items.end());
+    assert(frozen.size() == 3000 && (*frozen.Find(0)).second == "last");
+    for (uint64_t i = 1; i < 3000; i++) {
+        assert((*frozen.Find(i * 1024)).second == std::to_string(i));
+        assert(frozen.Find(i * 1024 + 1) == frozen.end());
+    }
+    std::cout << Pass();
+}
+
+void FrozenFindManyTest() {
+    std::cout << "FrozenFindManyTest";
+    HashTable<std::string, int> table;
+    for (int i = 0; i < 1000; i++) table.Insert(std::to_string(i), i);
+    FrozenHashTable<std::string, int> frozen(std::move(table));
+    std::vector<std::string> keys;
+    for (int i = 0; i < 2500; i++) keys.push_back(std::to_string(i * 7 % 2500));
+    std::vector<decltype(frozen.end())> found;
+    frozen.FindMany(keys, std::back_inserter(found));
+    assert(found.size() == keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) assert(found[i] == frozen.Find(keys[i]));
+    std::vector<std::string_view> views(keys.begin(), keys.begin() + 3);
+    found.clear();
+    frozen.FindMany(views, std::back_inserter(found));
+    assert(found.size() == 3 && (*found[1]).second == 7);
+    std::cout << Pass();
+}
+
+// Keys LengthHash can't tell apart make the freeze throw, and the table keeps its items
+void FrozenEqualHashTest() {
+    std::cout << "FrozenEqualHashTest";
+    HashTable<std::string, int, ChainedLayout, NodePool, LengthHash> table;
+    table.Insert("ab", 1);
+    table.Insert("cd", 2);
+    table.Insert("efg", 3);
+    bool thrown = false;
+    try {
+        FrozenHashTable<std::string, int, LengthHash> frozen(std::move(table));
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown && table.size() == 3 && (*table.Find("cd")).second == 2);
+    table.Delete("cd");
+    FrozenHashTable<std::string, int, LengthHash> frozen(std::move(table));
+    assert((*frozen.Find("ab")).second == 1 && (*frozen.Find("efg")).second == 3 && frozen.Find("cd") == frozen.end());
+    std::cout << Pass();
+}
+
+// One probe per lookup, and the characters of every key are in one buffer
+void FrozenStatsTest() {
+    std::cout << "FrozenStatsTest";
+    HashTable<std::string, int> table;
+    for (int i = 0; i < 2000; i++) table.Insert(LongKey(i), i);
+    FrozenHashTable<std::string, int> frozen(std::move(table));
+    for (int i = 0; i < 1000; i++) frozen.Find(LongKey(i * 3));
+    HashTableStats stats = frozen.GetStats();
+    assert(stats.size == 2000 && stats.capacity == 2000);
+    assert(stats.chain_length_histogram[1] == 2000 && stats.longest_chain == 1);
+    std::size_t characters = 0;
+    for (int i = 0; i < 2000; i++) characters += LongKey(i).size();
+    assert(stats.heap_bytes >= characters && stats.array_bytes >= 2000 * (sizeof(int) + sizeof(std::size_t)));
+    CheckCounters(stats, 1000, 667, false);
+    if (kHashTableStatsEnabled) assert(stats.probes == 1000);
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// STRESS TESTING         ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+// splitmix64: a bijection on 64-bit integers, so distinct inputs give distinct, well spread keys.
+uint64_t SyntheticKey(uint64_t i) {
+    uint64_t z = i + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Inserts item_count distinct keys and checks, after every insert past the first few
+//  doublings, that the load factor stays within [min_load, max_load].
+template <typename Table>
+void LargeTableTest(const std::string& name, std::size_t item_count, float min_load, float max_load) {
+    std::cout << name << " (" << item_count << " items)" << std::flush;
+    Table table;
+    for (std::size_t i = 0; i < item_count; i++) {
+        table.Insert(SyntheticKey(i), i);
+        if (table.size() >= 1024) {
+            assert(table.GetLoadFactor() >= min_load && table.GetLoadFactor() <= max_load);
+        }
+    }
+    assert(table.size() == item_count);
+    for (std::size_t i = 0; i < item_count; i += 997) {
+        auto && q = table.Find(SyntheticKey(i));
+        assert(q != table.end() && (*q).second == i);
+    }
+    std::cout << " capacity " << table.capacity() << ", load factor " << table.GetLoadFactor() << Pass();
+}
 }
 
 namespace hash_table_test {
@@ -199,6 +1154,19 @@ void TestAll() {
     FindTest();
     DeleteTest();
     IterationTest();
+    FlatLayoutTest();
+    ReserveTest();
+    NodeAllocatorTest();
+    LookupTest();
+    EmplaceTest();
+    IncrementalRehashTest();
+    ConcurrentTest();
+    HashCacheTest();
+    OccupancyTest();
+    HashPolicyTest();
+    FindManyTest();
+    StatsTest();
+    FrozenTest();
     std::cout << "ALL TESTS PASSED" << std::endl;
 }
 void InsertTest() {
@@ -230,4 +1198,116 @@ void IterationTest() {
     BasicIterationTest();
     std::cout << "----- Iteration Tests passed" << std::endl;
 }
+void FlatLayoutTest() {
+    std::cout << "----- Flat Layout Tests -----" << std::endl;
+    FlatInsertFindDeleteTest();
+    FlatRehashTest();
+    FlatDeleteReuseTest();
+    FlatIterationTest();
+    FlatRecursiveTableTest();
+    std::cout << "----- Flat Layout Tests passed" << std::endl;
+}
+void ReserveTest() {
+    std::cout << "----- Reserve Tests -----" << std::endl;
+    ReserveCapacityTest<HashTable<std::string, std::string>>("ReserveCapacityTest");
+    ReserveCapacityTest<HashTable<std::string, std::string, FlatLayout>>("FlatReserveCapacityTest");
+    BulkConstructTest<HashTable<std::string, std::string>>("BulkConstructTest");
+    BulkConstructTest<HashTable<std::string, std::string, FlatLayout>>("FlatBulkConstructTest");
+    std::cout << "----- Reserve Tests passed" << std::endl;
+}
+void NodeAllocatorTest() {
+    std::cout << "----- Node Allocator Tests -----" << std::endl;
+    NodePoolReuseTest();
+    NodeAllocatorBalanceTest();
+    ChainedCopyMoveTest();
+    std::cout << "----- Node Allocator Tests passed" << std::endl;
+}
+void LookupTest() {
+    std::cout << "----- Heterogeneous Lookup Tests -----" << std::endl;
+    TransparentLookupTest<HashTable<std::string, std::string>>("TransparentLookupTest");
+    TransparentLookupTest<HashTable<std::string, std::string, FlatLayout>>("FlatTransparentLookupTest");
+    NonTransparentLookupTest();
+    std::cout << "----- Heterogeneous Lookup Tests passed" << std::endl;
+}
+void EmplaceTest() {
+    std::cout << "----- Move / Emplace Tests -----" << std::endl;
+    MoveInsertTest<HashTable<std::string, CopyCounter>>("MoveInsertTest");
+    MoveInsertTest<HashTable<std::string, CopyCounter, FlatLayout>>("FlatMoveInsertTest");
+    TryEmplaceTest<HashTable<std::string, CopyCounter>>("TryEmplaceTest");
+    TryEmplaceTest<HashTable<std::string, CopyCounter, FlatLayout>>("FlatTryEmplaceTest");
+    std::cout << "----- Move / Emplace Tests passed" << std::endl;
+}
+void IncrementalRehashTest() {
+    std::cout << "----- Incremental Rehash Tests -----" << std::endl;
+    IncrementalInsertFindTest();
+    IncrementalDeleteCopyTest();
+    std::cout << "----- Incremental Rehash Tests passed" << std::endl;
+}
+void ConcurrentTest() {
+    std::cout << "----- Concurrent Tests -----" << std::endl;
+    ConcurrentBasicTest();
+    ConcurrentReadWriteTest(2000);
+    std::cout << "----- Concurrent Tests passed" << std::endl;
+}
+void HashCacheTest() {
+    std::cout << "----- Hash Cache Tests -----" << std::endl;
+    CachedHashRehashTest();
+    CachedHashIncrementalTest();
+    std::cout << "----- Hash Cache Tests passed" << std::endl;
+}
+void OccupancyTest() {
+    std::cout << "----- Occupancy Bitmap Tests -----" << std::endl;
+    OccupancyBitmapTest();
+    SparseIterationTest<HashTable<std::string, int>>("SparseIterationTest", false);
+    SparseIterationTest<HashTable<std::string, int>>("IncrementalSparseIterationTest", true);
+    std::cout << "----- Occupancy Bitmap Tests passed" << std::endl;
+}
+void HashPolicyTest() {
+    std::cout << "----- Hash Policy Tests -----" << std::endl;
+    SeededStringHashTest();
+    CustomHashTest<HashTable<std::string, std::string>>("CustomHashTest");
+    CustomHashTest<HashTable<std::string, std::string, FlatLayout>>("FlatCustomHashTest");
+    UserHashTypeTest();
+    HashDistributionTest();
+    std::cout << "----- Hash Policy Tests passed" << std::endl;
+}
+void FindManyTest() {
+    std::cout << "----- FindMany Tests -----" << std::endl;
+    HashTable<std::string, int> chained, incremental;
+    HashTable<std::string, int, FlatLayout> flat;
+    incremental.SetIncrementalRehash(true);
+    FindManyMatchesFindTest("FindManyTest", chained);
+    FindManyMatchesFindTest("IncrementalFindManyTest", incremental);
+    FindManyMatchesFindTest("FlatFindManyTest", flat);
+    std::cout << "----- FindMany Tests passed" << std::endl;
+}
+void StatsTest() {
+    std::cout << "----- Statistics Tests -----" << std::endl;
+    ChainedStatsTest("ChainedStatsTest", false);
+    ChainedStatsTest("IncrementalStatsTest", true);
+    FlatStatsTest();
+    AggregateStatsTest();
+    std::cout << "----- Statistics Tests passed" << std::endl;
+}
+void FrozenTest() {
+    std::cout << "----- Frozen Table Tests -----" << std::endl;
+    PerfectHashTest();
+    FrozenFindTest();
+    FrozenEmptyTest();
+    FrozenIntegerKeyTest();
+    FrozenFindManyTest();
+    FrozenEqualHashTest();
+    FrozenStatsTest();
+    std::cout << "----- Frozen Table Tests passed" << std::endl;
+}
+void StressTest(std::size_t item_count) {
+    std::cout << "----- Stress Tests -----" << std::endl;
+    // Flat: grows at 7/8 full, so right after a doubling it is 7/16 full.
+    LargeTableTest<HashTable<uint64_t, uint64_t, FlatLayout>>("FlatLargeTableTest", item_count, 0.4375f, 0.875f);
+    // Chained: grows above 0.7, or on a long chain once at least 0.5 full.
+    LargeTableTest<HashTable<uint64_t, uint64_t>>("ChainedLargeTableTest", item_count, 0.25f, 0.7f);
+    // Spread over 4 writers, so every resize is shared between threads
+    ConcurrentReadWriteTest(item_count / 4);
+    std::cout << "----- Stress Tests passed" << std::endl;
+}
 }
\ No newline at end of file
@@ -5,8 +5,17 @@
 #ifndef INVENTORY_MANAGEMENT_HASH_TABLE_TEST_I_H
 #define INVENTORY_MANAGEMENT_HASH_TABLE_TEST_I_H
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 #endif //INVENTORY_MANAGEMENT_HASH_TABLE_TEST_I_H
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "hash_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Binary snapshot of the inventory: products (a uniq_id plus one value per field), categories
+//  and their product lists, and prebuilt hash indexes over both, in one file that is mapped
+//  into memory and read in place. Opening a snapshot checks its header and checksum and does
+//  nothing else, so a lookup right after Open() costs the same as any later one.
+//
+// File layout (version 1, native byte order, every section 8-byte aligned):
+//   FileHeader          magic, version, checksum of everything after the header, source stamp,
+//                       counts and section offsets
+//   field names         field_count StringRefs
+//   products            product_count records of 1 + field_count StringRefs: uniq_id, values
+//   product index       product_bucket_count uint32: product + 1, 0 for an empty bucket
+//   categories          category_count CategoryRecords
+//   category index      category_bucket_count uint32: category + 1, 0 for an empty bucket
+//   postings            uint32 product numbers, each category's run in one piece
+//   strings             every distinct string once, referenced by offset and length
+// Indexes are open-addressed with linear probing over a power-of-two bucket count, hashed with
+//  string_hash::Hash and the seed stored in the header.
+namespace snapshot {
+
+class Writer;
+
+// Size and modification time of the CSV file a snapshot was taken of. A snapshot whose stamp
+//  differs from the file's current one is stale. The all-zero stamp is no file's, and is never
+//  written.
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t modified = 0;
+
+    // Sets stamp to the file at path's, or returns false if it doesn't exist or can't be read
+    static bool Of(const std::string& path, SourceStamp& stamp);
+    bool IsSet() const { return *this != SourceStamp(); }
+    bool operator==(const SourceStamp& other) const { return size == other.size && modified == other.modified; }
+    bool operator!=(const SourceStamp& other) const { return !(*this == other); }
+};
+
+// A snapshot file mapped read-only. Strings returned point into the mapping and stay valid
+//  until the snapshot is closed or another file is opened.
+class Snapshot {
+public:
+    static constexpr uint32_t kNotFound = UINT32_MAX;
+
+    // Product numbers of one category
+    class PostingList {
+    public:
+        PostingList(const uint32_t* first, const uint32_t* last) : first_(first), last_(last) {}
+        const uint32_t* begin() const { return first_; }
+        const uint32_t* end() const { return last_; }
+        std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+    private:
+        const uint32_t* first_;
+        const uint32_t* last_;
+    };
+
+    Snapshot();
+    ~Snapshot();
+    Snapshot(const Snapshot& other) = delete;
+    Snapshot& operator=(const Snapshot& other) = delete;
+
+    // Maps path and checks its magic, version, byte order, section bounds and checksum. On
+    //  failure returns false with the reason in error, and the snapshot is left closed.
+    bool Open(const std::string& path, std::string& error);
+    void Close();
+    bool IsOpen() const;
+    void Swap(Snapshot& other) noexcept;
+    SourceStamp GetSource() const;
+    // Bytes of the mapped file
+    std::size_t GetSize() const;
+
+    std::size_t FieldCount() const;
+    std::string_view FieldName(std::size_t field) const;
+    // Field number of name, or kNotFound
+    uint32_t FindField(std::string_view name) const;
+
+    std::size_t ProductCount() const;
+    // Product number of id, or kNotFound
+    uint32_t FindProduct(std::string_view id) const;
+    std::string_view ProductId(uint32_t product) const;
+    std::string_view ProductField(uint32_t product, std::size_t field) const;
+
+    std::size_t CategoryCount() const;
+    std::string_view CategoryName(uint32_t category) const;
+    // Category number of name, or kNotFound
+    uint32_t FindCategory(std::string_view name) const;
+    PostingList CategoryProducts(uint32_t category) const;
+
+private:
+    struct StringRef {
+        uint32_t offset_;
+        uint32_t length_;
+    };
+    struct CategoryRecord {
+        StringRef name_;
+        uint32_t first_posting_;
+        uint32_t posting_count_;
+    };
+    struct FileHeader;
+    friend class Writer;
+
+    /////// BEGIN SETTINGS
+    static constexpr uint32_t kVersion = 1;
+    // Indexes are at most this full (numerator / denominator), so probes stay short
+    static constexpr std::size_t kMaxLoadNumerator = 1;
+    static constexpr std::size_t kMaxLoadDenominator = 2;
+    /////// END SETTINGS
+
+    bool Check_(std::string& error) const;
+    std::string_view String_(StringRef string) const;
+    const StringRef* ProductRecord_(uint32_t product) const;
+    // Bucket number of the string, or kNotFound; key(i) gives the string of entry i
+    template <typename GetKey>
+    uint32_t Probe_(const uint32_t* buckets, std::size_t bucket_count, std::string_view string, GetKey key) const;
+
+    const unsigned char* data_;
+    std::size_t size_;
+    // The mapping itself, or heap memory where files are read instead of mapped
+    void* mapping_;
+    const FileHeader* header_;
+};
+
+// Builds a snapshot in memory and writes it out.
+class Writer {
+public:
+    explicit Writer(const std::vector<std::string>& field_names);
+
+    // values[i] is the value of field i; missing values are empty. Adding an id a second time
+    //  replaces its values.
+    void AddProduct(std::string_view id, const std::vector<std::string_view>& values);
+    // Starts a category and returns its number, for AddToCategory
+    uint32_t AddCategory(std::string_view name);
+    // Ids that haven't been added as products are left out
+    void AddToCategory(uint32_t category, std::string_view product_id);
+    // Writes to a temporary file next to path and renames it over path, so a reader never sees
+    //  half a snapshot. Throws std::runtime_error if the file can't be written, or source isn't
+    //  set.
+    void Write(const std::string& path, const SourceStamp& source) const;
+
+private:
+    Snapshot::StringRef AddString_(std::string_view string);
+
+    std::vector<Snapshot::StringRef> field_names_;
+    // 1 + field count StringRefs per product: id, then values
+    std::vector<Snapshot::StringRef> product_records_;
+    HashTable<std::string, uint32_t> product_numbers_;
+    std::vector<Snapshot::StringRef> category_names_;
+    std::vector<std::vector<uint32_t>> category_products_;
+    // Every distinct string once, and where it starts in the pool
+    std::string pool_;
+    HashTable<std::string, uint32_t> string_offsets_;
+};
+
+} // namespace snapshot
+
+#endif // !SNAPSHOT_H
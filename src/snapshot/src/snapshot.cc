@@ -0,0 +1,482 @@
+#include "snapshot.h"
+#include "string_hash.h"
+
+#include <chrono>
+#include <cstring> //std::memcpy, std::memcmp
+#include <filesystem>
+#include <fstream>
+#include <stdexcept> // runtime_error when a snapshot can't be written
+#include <system_error>
+#include <utility> //std::swap
+
+#if defined(_WIN32)
+// No mmap; the file is read into memory instead
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace snapshot {
+
+namespace {
+
+/////// BEGIN SETTINGS
+constexpr char kMagic[8] = {'I', 'N', 'V', 'S', 'N', 'A', 'P', '\0'};
+// Written in native byte order; reads back differently on a machine of the other order
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr uint64_t kChecksumSeed = 0x5eed5eed5eed5eedull;
+constexpr std::size_t kSectionAlignment = 8;
+/////// END SETTINGS
+
+std::size_t AlignUp(std::size_t offset) {
+    return (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+bool IsPowerOfTwo(uint64_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+} // namespace
+
+struct Snapshot::FileHeader {
+    char magic_[8];
+    uint32_t version_;
+    uint32_t byte_order_;
+    uint64_t file_size_;
+    // string_hash::Hash of every byte after the header, seeded with kChecksumSeed
+    uint64_t checksum_;
+    uint64_t source_size_;
+    int64_t source_modified_;
+    // Seed of both indexes
+    uint64_t seed_;
+    uint32_t field_count_;
+    uint32_t product_count_;
+    uint32_t product_bucket_count_;
+    uint32_t category_count_;
+    uint32_t category_bucket_count_;
+    uint32_t posting_count_;
+    uint64_t field_names_offset_;
+    uint64_t products_offset_;
+    uint64_t product_index_offset_;
+    uint64_t categories_offset_;
+    uint64_t category_index_offset_;
+    uint64_t postings_offset_;
+    uint64_t strings_offset_;
+    uint64_t strings_size_;
+};
+
+bool SourceStamp::Of(const std::string &path, SourceStamp &stamp) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    if (error) return false;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+    stamp.size = size;
+    stamp.modified = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(modified.time_since_epoch()).count());
+    return true;
+}
+
+////                        ////////////////////////////////////////////////////
+//// READING                ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+Snapshot::Snapshot() : data_(nullptr), size_(0), mapping_(nullptr), header_(nullptr) {}
+
+Snapshot::~Snapshot() {
+    Close();
+}
+
+bool Snapshot::Open(const std::string &path, std::string &error) {
+    Close();
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    size_ = static_cast<std::size_t>(file.tellg());
+    unsigned char* buffer = new unsigned char[size_ == 0 ? 1 : size_];
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer), static_cast<std::streamsize>(size_));
+    mapping_ = buffer;
+    if (!file) {
+        Close();
+        error = "cannot read " + path;
+        return false;
+    }
+#else
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat status;
+    if (::fstat(descriptor, &status) != 0 || status.st_size == 0) {
+        ::close(descriptor);
+        error = path + " is empty";
+        return false;
+    }
+    size_ = static_cast<std::size_t>(status.st_size);
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0);
+    // The mapping keeps the file open on its own
+    ::close(descriptor);
+    if (mapping == MAP_FAILED) {
+        size_ = 0;
+        error = "cannot map " + path;
+        return false;
+    }
+    mapping_ = mapping;
+#endif
+    data_ = static_cast<const unsigned char*>(mapping_);
+    header_ = reinterpret_cast<const FileHeader*>(data_);
+    if (!Check_(error)) {
+        error = path + ": " + error;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void Snapshot::Close() {
+    if (mapping_ != nullptr) {
+#if defined(_WIN32)
+        delete[] static_cast<unsigned char*>(mapping_);
+#else
+        ::munmap(mapping_, size_);
+#endif
+    }
+    mapping_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+}
+
+bool Snapshot::IsOpen() const {
+    return header_ != nullptr;
+}
+
+void Snapshot::Swap(Snapshot &other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(mapping_, other.mapping_);
+    std::swap(header_, other.header_);
+}
+
+SourceStamp Snapshot::GetSource() const {
+    SourceStamp stamp;
+    stamp.size = header_->source_size_;
+    stamp.modified = header_->source_modified_;
+    return stamp;
+}
+
+std::size_t Snapshot::GetSize() const {
+    return size_;
+}
+
+std::size_t Snapshot::FieldCount() const {
+    return header_->field_count_;
+}
+
+std::string_view Snapshot::FieldName(std::size_t field) const {
+    return String_(reinterpret_cast<const StringRef*>(data_ + header_->field_names_offset_)[field]);
+}
+
+uint32_t Snapshot::FindField(std::string_view name) const {
+    // A few dozen fields at most, not worth an index
+    for (uint32_t i = 0; i < header_->field_count_; i++) {
+        if (FieldName(i) == name) return i;
+    }
+    return kNotFound;
+}
+
+std::size_t Snapshot::ProductCount() const {
+    return header_->product_count_;
+}
+
+uint32_t Snapshot::FindProduct(std::string_view id) const {
+    return Probe_(reinterpret_cast<const uint32_t*>(data_ + header_->product_index_offset_), header_->product_bucket_count_, id,
+                  [this](uint32_t product) { return ProductId(product); });
+}
+
+std::string_view Snapshot::ProductId(uint32_t product) const {
+    return String_(ProductRecord_(product)[0]);
+}
+
+std::string_view Snapshot::ProductField(uint32_t product, std::size_t field) const {
+    return String_(ProductRecord_(product)[1 + field]);
+}
+
+std::size_t Snapshot::CategoryCount() const {
+    return header_->category_count_;
+}
+
+std::string_view Snapshot::CategoryName(uint32_t category) const {
+    return String_(reinterpret_cast<const CategoryRecord*>(data_ + header_->categories_offset_)[category].name_);
+}
+
+uint32_t Snapshot::FindCategory(std::string_view name) const {
+    return Probe_(reinterpret_cast<const uint32_t*>(data_ + header_->category_index_offset_), header_->category_bucket_count_, name,
+                  [this](uint32_t category) { return CategoryName(category); });
+}
+
+Snapshot::PostingList Snapshot::CategoryProducts(uint32_t category) const {
+    const CategoryRecord& record = reinterpret_cast<const CategoryRecord*>(data_ + header_->categories_offset_)[category];
+    const uint32_t* first = reinterpret_cast<const uint32_t*>(data_ + header_->postings_offset_) + record.first_posting_;
+    return PostingList(first, first + record.posting_count_);
+}
+
+// Everything a lookup could read is checked here, once, so that lookups themselves never need
+//  bounds checks: section bounds and alignment, every string reference, index entry and
+//  posting. All of it is sequential reads over the file, well under the cost of the checksum.
+bool Snapshot::Check_(std::string &error) const {
+    if (size_ < sizeof(FileHeader) || std::memcmp(header_->magic_, kMagic, sizeof(kMagic)) != 0) {
+        error = "not a snapshot file";
+        return false;
+    }
+    if (header_->byte_order_ != kByteOrderMark) {
+        error = "written on a machine of the other byte order";
+        return false;
+    }
+    if (header_->version_ != kVersion) {
+        error = "snapshot version " + std::to_string(header_->version_) + ", expected " + std::to_string(kVersion);
+        return false;
+    }
+    if (header_->file_size_ != size_) {
+        error = "truncated";
+        return false;
+    }
+    const uint64_t record_size = (1 + static_cast<uint64_t>(header_->field_count_)) * sizeof(StringRef);
+    struct Section {
+        uint64_t offset_;
+        uint64_t size_;
+    };
+    const Section sections[] = {
+        {header_->field_names_offset_, header_->field_count_ * sizeof(StringRef)},
+        {header_->products_offset_, header_->product_count_ * record_size},
+        {header_->product_index_offset_, header_->product_bucket_count_ * sizeof(uint32_t)},
+        {header_->categories_offset_, header_->category_count_ * sizeof(CategoryRecord)},
+        {header_->category_index_offset_, header_->category_bucket_count_ * sizeof(uint32_t)},
+        {header_->postings_offset_, header_->posting_count_ * sizeof(uint32_t)},
+        {header_->strings_offset_, header_->strings_size_},
+    };
+    for (const Section& section : sections) {
+        if (section.offset_ % kSectionAlignment != 0 || section.offset_ < sizeof(FileHeader)
+            || section.offset_ > size_ || section.size_ > size_ - section.offset_) {
+            error = "section out of bounds";
+            return false;
+        }
+    }
+    if (string_hash::Hash(data_ + sizeof(FileHeader), size_ - sizeof(FileHeader), kChecksumSeed) != header_->checksum_) {
+        error = "checksum mismatch";
+        return false;
+    }
+    // Each index must have a free bucket, or a probe for a missing key would never end
+    if (!IsPowerOfTwo(header_->product_bucket_count_) || header_->product_count_ >= header_->product_bucket_count_
+        || !IsPowerOfTwo(header_->category_bucket_count_) || header_->category_count_ >= header_->category_bucket_count_) {
+        error = "bad index size";
+        return false;
+    }
+    auto string_ok = [this](StringRef string) {
+        return string.offset_ <= header_->strings_size_ && string.length_ <= header_->strings_size_ - string.offset_;
+    };
+    const StringRef* strings = reinterpret_cast<const StringRef*>(data_ + header_->field_names_offset_);
+    for (uint64_t i = 0; i < header_->field_count_; i++) {
+        if (!string_ok(strings[i])) {
+            error = "bad field name";
+            return false;
+        }
+    }
+    strings = reinterpret_cast<const StringRef*>(data_ + header_->products_offset_);
+    for (uint64_t i = 0; i < header_->product_count_ * (1 + static_cast<uint64_t>(header_->field_count_)); i++) {
+        if (!string_ok(strings[i])) {
+            error = "bad product record";
+            return false;
+        }
+    }
+    const CategoryRecord* categories = reinterpret_cast<const CategoryRecord*>(data_ + header_->categories_offset_);
+    for (uint32_t i = 0; i < header_->category_count_; i++) {
+        if (!string_ok(categories[i].name_) || categories[i].first_posting_ > header_->posting_count_
+            || categories[i].posting_count_ > header_->posting_count_ - categories[i].first_posting_) {
+            error = "bad category record";
+            return false;
+        }
+    }
+    const uint32_t* postings = reinterpret_cast<const uint32_t*>(data_ + header_->postings_offset_);
+    for (uint32_t i = 0; i < header_->posting_count_; i++) {
+        if (postings[i] >= header_->product_count_) {
+            error = "bad posting";
+            return false;
+        }
+    }
+    auto index_ok = [this](uint64_t offset, uint32_t bucket_count, uint32_t entry_count) {
+        const uint32_t* buckets = reinterpret_cast<const uint32_t*>(data_ + offset);
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < bucket_count; i++) {
+            if (buckets[i] > entry_count) return false;
+            if (buckets[i] != 0) used++;
+        }
+        return used == entry_count;
+    };
+    if (!index_ok(header_->product_index_offset_, header_->product_bucket_count_, header_->product_count_)
+        || !index_ok(header_->category_index_offset_, header_->category_bucket_count_, header_->category_count_)) {
+        error = "bad index";
+        return false;
+    }
+    return true;
+}
+
+std::string_view Snapshot::String_(StringRef string) const {
+    return std::string_view(reinterpret_cast<const char*>(data_ + header_->strings_offset_ + string.offset_), string.length_);
+}
+
+const Snapshot::StringRef* Snapshot::ProductRecord_(uint32_t product) const {
+    return reinterpret_cast<const StringRef*>(data_ + header_->products_offset_) + static_cast<std::size_t>(product) * (1 + header_->field_count_);
+}
+
+template <typename GetKey>
+uint32_t Snapshot::Probe_(const uint32_t *buckets, std::size_t bucket_count, std::string_view string, GetKey key) const {
+    const std::size_t mask = bucket_count - 1;
+    for (std::size_t i = string_hash::Hash(string.data(), string.size(), header_->seed_) & mask;; i = (i + 1) & mask) {
+        uint32_t entry = buckets[i];
+        if (entry == 0) return kNotFound;
+        if (key(entry - 1) == string) return entry - 1;
+    }
+}
+
+////                        ////////////////////////////////////////////////////
+//// WRITING                ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+Writer::Writer(const std::vector<std::string>& field_names) {
+    for (const std::string& name : field_names) field_names_.push_back(AddString_(name));
+}
+
+void Writer::AddProduct(std::string_view id, const std::vector<std::string_view>& values) {
+    auto && i = product_numbers_.TryEmplace(std::string(id), static_cast<uint32_t>(product_records_.size() / (1 + field_names_.size())));
+    std::size_t record = static_cast<std::size_t>((*i.first).second) * (1 + field_names_.size());
+    if (i.second) product_records_.resize(record + 1 + field_names_.size());
+    product_records_[record] = AddString_(id);
+    for (std::size_t field = 0; field < field_names_.size(); field++) {
+        product_records_[record + 1 + field] = AddString_(field < values.size() ? values[field] : std::string_view());
+    }
+}
+
+uint32_t Writer::AddCategory(std::string_view name) {
+    category_names_.push_back(AddString_(name));
+    category_products_.emplace_back();
+    return static_cast<uint32_t>(category_names_.size() - 1);
+}
+
+void Writer::AddToCategory(uint32_t category, std::string_view product_id) {
+    auto && i = product_numbers_.Find(product_id);
+    if (i != product_numbers_.end()) category_products_[category].push_back((*i).second);
+}
+
+Snapshot::StringRef Writer::AddString_(std::string_view string) {
+    auto && i = string_offsets_.TryEmplace(std::string(string), static_cast<uint32_t>(pool_.size()));
+    if (i.second) {
+        if (pool_.size() + string.size() > UINT32_MAX) throw std::runtime_error("Error, snapshot strings exceed 4 GB");
+        pool_.append(string);
+    }
+    return Snapshot::StringRef{(*i.first).second, static_cast<uint32_t>(string.size())};
+}
+
+void Writer::Write(const std::string &path, const SourceStamp &source) const {
+    // A snapshot stamped with no file's stamp would never be found stale
+    if (!source.IsSet()) throw std::runtime_error("Error, no source stamp for snapshot " + path);
+    typedef Snapshot::FileHeader FileHeader;
+    const uint32_t field_count = static_cast<uint32_t>(field_names_.size());
+    const uint32_t product_count = static_cast<uint32_t>(product_records_.size() / (1 + field_names_.size()));
+    const uint32_t category_count = static_cast<uint32_t>(category_names_.size());
+    // Smallest power of two that keeps an index within its maximum load
+    auto bucket_count_for = [](std::size_t entry_count) {
+        uint32_t bucket_count = 2;
+        while (entry_count * Snapshot::kMaxLoadDenominator > bucket_count * Snapshot::kMaxLoadNumerator) bucket_count *= 2;
+        return bucket_count;
+    };
+    std::size_t posting_count = 0;
+    for (const std::vector<uint32_t>& products : category_products_) posting_count += products.size();
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, kMagic, sizeof(kMagic));
+    header.version_ = Snapshot::kVersion;
+    header.byte_order_ = kByteOrderMark;
+    header.source_size_ = source.size;
+    header.source_modified_ = source.modified;
+    header.seed_ = string_hash::DefaultSeed();
+    header.field_count_ = field_count;
+    header.product_count_ = product_count;
+    header.product_bucket_count_ = bucket_count_for(product_count);
+    header.category_count_ = category_count;
+    header.category_bucket_count_ = bucket_count_for(category_count);
+    header.posting_count_ = static_cast<uint32_t>(posting_count);
+    std::size_t offset = AlignUp(sizeof(FileHeader));
+    header.field_names_offset_ = offset;
+    offset = AlignUp(offset + field_count * sizeof(Snapshot::StringRef));
+    header.products_offset_ = offset;
+    offset = AlignUp(offset + product_records_.size() * sizeof(Snapshot::StringRef));
+    header.product_index_offset_ = offset;
+    offset = AlignUp(offset + header.product_bucket_count_ * sizeof(uint32_t));
+    header.categories_offset_ = offset;
+    offset = AlignUp(offset + category_count * sizeof(Snapshot::CategoryRecord));
+    header.category_index_offset_ = offset;
+    offset = AlignUp(offset + header.category_bucket_count_ * sizeof(uint32_t));
+    header.postings_offset_ = offset;
+    offset = AlignUp(offset + posting_count * sizeof(uint32_t));
+    header.strings_offset_ = offset;
+    header.strings_size_ = pool_.size();
+    header.file_size_ = offset + pool_.size();
+
+    std::vector<unsigned char> file(header.file_size_, 0);
+    unsigned char* data = file.data();
+    if (!field_names_.empty()) {
+        std::memcpy(data + header.field_names_offset_, field_names_.data(), field_count * sizeof(Snapshot::StringRef));
+    }
+    if (!product_records_.empty()) {
+        std::memcpy(data + header.products_offset_, product_records_.data(), product_records_.size() * sizeof(Snapshot::StringRef));
+    }
+    auto insert_into_index = [this](uint32_t* buckets, uint32_t bucket_count, uint32_t entry, std::string_view key, uint64_t seed) {
+        std::size_t i = string_hash::Hash(key.data(), key.size(), seed) & (bucket_count - 1);
+        while (buckets[i] != 0) i = (i + 1) & (bucket_count - 1);
+        buckets[i] = entry + 1;
+    };
+    auto pool_string = [this](Snapshot::StringRef string) {
+        return std::string_view(pool_.data() + string.offset_, string.length_);
+    };
+    uint32_t* product_index = reinterpret_cast<uint32_t*>(data + header.product_index_offset_);
+    for (uint32_t i = 0; i < product_count; i++) {
+        insert_into_index(product_index, header.product_bucket_count_, i, pool_string(product_records_[i * (1 + static_cast<std::size_t>(field_count))]), header.seed_);
+    }
+    Snapshot::CategoryRecord* categories = reinterpret_cast<Snapshot::CategoryRecord*>(data + header.categories_offset_);
+    uint32_t* category_index = reinterpret_cast<uint32_t*>(data + header.category_index_offset_);
+    uint32_t* postings = reinterpret_cast<uint32_t*>(data + header.postings_offset_);
+    uint32_t next_posting = 0;
+    for (uint32_t i = 0; i < category_count; i++) {
+        categories[i].name_ = category_names_[i];
+        categories[i].first_posting_ = next_posting;
+        categories[i].posting_count_ = static_cast<uint32_t>(category_products_[i].size());
+        for (uint32_t product : category_products_[i]) postings[next_posting++] = product;
+        insert_into_index(category_index, header.category_bucket_count_, i, pool_string(category_names_[i]), header.seed_);
+    }
+    if (!pool_.empty()) std::memcpy(data + header.strings_offset_, pool_.data(), pool_.size());
+    header.checksum_ = string_hash::Hash(data + sizeof(FileHeader), file.size() - sizeof(FileHeader), kChecksumSeed);
+    std::memcpy(data, &header, sizeof(header));
+
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(file.size()));
+        if (!out) throw std::runtime_error("Error, cannot write " + temporary_path);
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (error) {
+        std::filesystem::remove(temporary_path, error);
+        throw std::runtime_error("Error, cannot replace " + path);
+    }
+}
+
+} // namespace snapshot
@@ -0,0 +1,10 @@
+#ifndef SNAPSHOT_TEST_H
+#define SNAPSHOT_TEST_H
+
+namespace snapshot_test {
+    void RoundTripTest();
+    void CorruptionTest();
+    void TestAll();
+}
+
+#endif // !SNAPSHOT_TEST_H
@@ -0,0 +1,276 @@
+#include "snapshot.h"
+#include "snapshot_test.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+std::string Pass() {
+    return " -- PASSED\n";
+}
+
+// Path of a file in the temporary directory
+std::string TemporaryPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+snapshot::SourceStamp TestStamp() {
+    snapshot::SourceStamp stamp;
+    stamp.size = 123;
+    stamp.modified = 456;
+    return stamp;
+}
+
+// Two fields, three products (the third added twice) and a category of two of them, one that
+//  was never added as a product left out
+std::string WriteSmallSnapshot() {
+    std::string path = TemporaryPath("snapshot_test.snapshot");
+    snapshot::Writer writer({"Product Name", "Brand Name"});
+    writer.AddProduct("a", {"Apple", "Acme"});
+    writer.AddProduct("b", {"Ball"});
+    writer.AddProduct("c", {"Cube", "LEGO"});
+    writer.AddProduct("a", {"Apricot", "Hasbro"});
+    uint32_t fruit = writer.AddCategory("Fruit");
+    writer.AddToCategory(fruit, "a");
+    writer.AddToCategory(fruit, "missing");
+    writer.AddToCategory(fruit, "c");
+    writer.AddCategory("Empty");
+    writer.Write(path, TestStamp());
+    return path;
+}
+
+// Opens path, which must fail with an error that says reason
+void CheckOpenFails(const std::string& path, const std::string& reason) {
+    snapshot::Snapshot snapshot;
+    std::string error;
+    assert(!snapshot.Open(path, error));
+    assert(error.find(reason) != std::string::npos);
+    assert(!snapshot.IsOpen());
+}
+
+////                        ////////////////////////////////////////////////////
+//// ROUND TRIP TESTING     ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+void WriteOpenTest() {
+    std::cout << "WriteOpenTest";
+    std::string path = WriteSmallSnapshot();
+    snapshot::Snapshot snapshot;
+    std::string error;
+    assert(snapshot.Open(path, error));
+    assert(snapshot.IsOpen());
+    assert(snapshot.GetSource() == TestStamp());
+    assert(snapshot.GetSize() == std::filesystem::file_size(path));
+    assert(snapshot.FieldCount() == 2);
+    assert(snapshot.FieldName(0) == "Product Name" && snapshot.FieldName(1) == "Brand Name");
+    assert(snapshot.FindField("Brand Name") == 1);
+    assert(snapshot.FindField("Color") == snapshot::Snapshot::kNotFound);
+    snapshot.Close();
+    assert(!snapshot.IsOpen());
+    std::cout << Pass();
+}
+
+void FindProductTest() {
+    std::cout << "FindProductTest";
+    std::string path = WriteSmallSnapshot();
+    snapshot::Snapshot snapshot;
+    std::string error;
+    assert(snapshot.Open(path, error));
+    assert(snapshot.ProductCount() == 3);
+    uint32_t ball = snapshot.FindProduct("b");
+    assert(ball != snapshot::Snapshot::kNotFound);
+    assert(snapshot.ProductId(ball) == "b");
+    assert(snapshot.ProductField(ball, 0) == "Ball");
+    // Missing values are empty
+    assert(snapshot.ProductField(ball, 1).empty());
+    assert(snapshot.FindProduct("missing") == snapshot::Snapshot::kNotFound);
+    assert(snapshot.FindProduct("") == snapshot::Snapshot::kNotFound);
+    std::cout << Pass();
+}
+
+void DuplicateProductTest() {
+    std::cout << "DuplicateProductTest";
+    std::string path = WriteSmallSnapshot();
+    snapshot::Snapshot snapshot;
+    std::string error;
+    assert(snapshot.Open(path, error));
+    // Added twice: one product, with the values added last
+    uint32_t apple = snapshot.FindProduct("a");
+    assert(apple != snapshot::Snapshot::kNotFound);
+    assert(snapshot.ProductField(apple, 0) == "Apricot" && snapshot.ProductField(apple, 1) == "Hasbro");
+    std::cout << Pass();
+}
+
+void CategoryTest() {
+    std::cout << "CategoryTest";
+    std::string path = WriteSmallSnapshot();
+    snapshot::Snapshot snapshot;
+    std::string error;
+    assert(snapshot.Open(path, error));
+    assert(snapshot.CategoryCount() == 2);
+    uint32_t fruit = snapshot.FindCategory("Fruit");
+    assert(fruit != snapshot::Snapshot::kNotFound && snapshot.CategoryName(fruit) == "Fruit");
+    // In the order added, without the id that was never a product
+    std::vector<std::string_view> ids;
+    for (uint32_t product : snapshot.CategoryProducts(fruit)) ids.push_back(snapshot.ProductId(product));
+    assert((ids == std::vector<std::string_view>{"a", "c"}));
+    uint32_t empty = snapshot.FindCategory("Empty");
+    assert(empty != snapshot::Snapshot::kNotFound && snapshot.CategoryProducts(empty).size() == 0);
+    assert(snapshot.FindCategory("Toys") == snapshot::Snapshot::kNotFound);
+    std::cout << Pass();
+}
+
+void ManyProductsTest() {
+    std::cout << "ManyProductsTest";
+    std::string path = TemporaryPath("snapshot_test.snapshot");
+    snapshot::Writer writer({"Product Name"});
+    uint32_t even = writer.AddCategory("Even");
+    for (int i = 0; i < 5000; i++) {
+        std::string id = "id" + std::to_string(i);
+        writer.AddProduct(id, {"name" + std::to_string(i)});
+        if (i % 2 == 0) writer.AddToCategory(even, id);
+    }
+    writer.Write(path, TestStamp());
+    snapshot::Snapshot snapshot;
+    std::string error;
+    assert(snapshot.Open(path, error));
+    assert(snapshot.ProductCount() == 5000);
+    for (int i = 0; i < 5000; i++) {
+        uint32_t product = snapshot.FindProduct("id" + std::to_string(i));
+        assert(product != snapshot::Snapshot::kNotFound);
+        assert(snapshot.ProductField(product, 0) == "name" + std::to_string(i));
+        assert(snapshot.FindProduct("other" + std::to_string(i)) == snapshot::Snapshot::kNotFound);
+    }
+    assert(snapshot.CategoryProducts(snapshot.FindCategory("Even")).size() == 2500);
+    std::cout << Pass();
+}
+
+void SourceStampTest() {
+    std::cout << "SourceStampTest";
+    std::string path = TemporaryPath("snapshot_test.csv");
+    WriteFile(path, "Uniq Id\n");
+    snapshot::SourceStamp stamp;
+    assert(snapshot::SourceStamp::Of(path, stamp));
+    assert(stamp.IsSet() && stamp.size == 8);
+    std::filesystem::remove(path);
+    snapshot::SourceStamp missing;
+    assert(!snapshot::SourceStamp::Of(path, missing));
+    assert(!missing.IsSet());
+    // A snapshot of no file is never written
+    snapshot::Writer writer({"Product Name"});
+    bool thrown = false;
+    try {
+        writer.Write(TemporaryPath("snapshot_test_unset.snapshot"), snapshot::SourceStamp());
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(!std::filesystem::exists(TemporaryPath("snapshot_test_unset.snapshot")));
+    std::cout << Pass();
+}
+
+////                        ////////////////////////////////////////////////////
+//// CORRUPTION TESTING     ///////////////////////////////////////////////////
+////                        //////////////////////////////////////////////////
+
+void FlippedByteTest() {
+    std::cout << "FlippedByteTest";
+    std::string path = WriteSmallSnapshot();
+    const std::string contents = ReadFile(path);
+    // Bytes of the header other than the checksum are checked on their own; every byte after
+    //  it is covered by the checksum
+    std::string flipped = contents;
+    flipped.back() ^= 0x01;
+    WriteFile(path, flipped);
+    CheckOpenFails(path, "checksum mismatch");
+    flipped = contents;
+    flipped[contents.size() / 2] ^= 0x40;
+    WriteFile(path, flipped);
+    CheckOpenFails(path, "checksum mismatch");
+    flipped = contents;
+    flipped[0] = 'X';
+    WriteFile(path, flipped);
+    CheckOpenFails(path, "not a snapshot file");
+    std::cout << Pass();
+}
+
+void TruncatedTest() {
+    std::cout << "TruncatedTest";
+    std::string path = WriteSmallSnapshot();
+    const std::string contents = ReadFile(path);
+    WriteFile(path, contents.substr(0, contents.size() - 1));
+    CheckOpenFails(path, "truncated");
+    WriteFile(path, contents.substr(0, contents.size() / 2));
+    CheckOpenFails(path, "truncated");
+    // Shorter than the header
+    WriteFile(path, contents.substr(0, 16));
+    CheckOpenFails(path, "not a snapshot file");
+    WriteFile(path, "");
+    CheckOpenFails(path, "is empty");
+    std::filesystem::remove(path);
+    CheckOpenFails(path, "cannot open");
+    std::cout << Pass();
+}
+
+void VersionTest() {
+    std::cout << "VersionTest";
+    std::string path = WriteSmallSnapshot();
+    std::string contents = ReadFile(path);
+    // The version follows the 8-byte magic
+    uint32_t version;
+    contents.copy(reinterpret_cast<char*>(&version), sizeof(version), 8);
+    assert(version == 1);
+    version++;
+    contents.replace(8, sizeof(version), reinterpret_cast<const char*>(&version), sizeof(version));
+    WriteFile(path, contents);
+    CheckOpenFails(path, "snapshot version 2, expected 1");
+    std::cout << Pass();
+}
+
+}
+
+namespace snapshot_test {
+void TestAll() {
+    std::cout << "----- RUNNING ALL SNAPSHOT TESTS -----" << std::endl;
+    RoundTripTest();
+    CorruptionTest();
+    std::cout << "ALL SNAPSHOT TESTS PASSED" << std::endl;
+}
+void RoundTripTest() {
+    std::cout << "----- Round Trip Tests -----" << std::endl;
+    WriteOpenTest();
+    FindProductTest();
+    DuplicateProductTest();
+    CategoryTest();
+    ManyProductsTest();
+    SourceStampTest();
+    std::cout << "----- Round Trip Tests passed" << std::endl;
+}
+void CorruptionTest() {
+    std::cout << "----- Corruption Tests -----" << std::endl;
+    FlippedByteTest();
+    TruncatedTest();
+    VersionTest();
+    std::cout << "----- Corruption Tests passed" << std::endl;
+}
+}